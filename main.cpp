@@ -9,6 +9,7 @@
 #include <memory>
 #include "core/util/Config.h"
 #include "core/tools/svm/TrainingSet.h"
+#include "core/tools/svm/TrainingSetFile.h"
 #include "core/tools/svm/libsvmopenmp/svm-train.h"
 #include "core/util/Matrix.h"
 #include "core/opencl/libsvm/OpenCLToolsTrain.h"
@@ -16,6 +17,8 @@
 #include "core/process/IProcessor.h"
 #include "core/util/rtti/ObjectFactory.h"
 #include "core/util/rtti/ObjectFactory.h"
+#include "core/util/predicition/libsvm/SvmModelVersion.h"
+#include "core/tools/regression/LogisticRegressionTrainer.h"
 
 using namespace std;
 using namespace core::util;
@@ -27,6 +30,8 @@ using namespace shadowdetection::opencl;
 using namespace core::tools::svm::libsvmopenmp;
 using namespace core::process;
 using namespace core::util::RTTI;
+using namespace core::util::prediction::svm;
+using namespace core::tools::regression;
 
 /**
  * global function for process single image
@@ -72,11 +77,14 @@ int main(int argc, char **argv) {
         try{
             TrainingSet ts(argv[2]);
             bool distribute = true;
-            string distributeStr = Config::getInstancePtr()->getPropertyValue("process.Training.distribute0and1");
+            string distributeStr = Config::getInstancePtr()->getPropertyValue("general.Training.distribute0and1");
             if (distributeStr.compare("false") == 0){
                 distribute = false;
             }
-            ts.process(argv[3], !distribute);
+            //text unless configured
+            const string* formatStr = Config::getInstancePtr()->getSnapshot()->find("general.Training.setFormat");
+            bool binary = formatStr != 0 && formatStr->compare("binary") == 0;
+            ts.process(argv[3], !distribute, binary);
         }
         catch (SDException& exc){
             cout << exc.handleException() << endl;
@@ -91,9 +99,48 @@ int main(int argc, char **argv) {
         return 0;
     }
         
-    if (argc >= 2 && strcmp(argv[1], "-training") == 0) {
+    if (argc >= 2 && strcmp(argv[1], "-convertmodel") == 0) {
         if (argc < 4){
-            cout << "training needs more parameters: input data file, output file" << endl;
+            cout << "convertmodel needs more parameters: input model file (text or binary), output binary model file" << endl;
+            return 0;
+        }
+        try{
+            SvmModelVersion model(argv[2], 0);
+            model.saveBinary(argv[3]);
+            cout << "Model with " << model.getL() << " support vectors written to " << argv[3] << endl;
+        }
+        catch (SDException& e){
+            cout << e.handleException() << endl;
+            exit(1);
+        }
+        Config::destroy();
+        return 0;
+    }
+    
+    if (argc >= 2 && strcmp(argv[1], "-convertset") == 0) {
+        if (argc < 4){
+            cout << "convertset needs more parameters: input training set (text or binary), output file (binary or text)" << endl;
+            return 0;
+        }
+        try{
+            TrainingSetFile::convert(argv[2], argv[3]);
+            cout << "Training set written to " << argv[3] << endl;
+        }
+        catch (SDException& e){
+            cout << e.handleException() << endl;
+            exit(1);
+        }
+        Config::destroy();
+        return 0;
+    }
+    
+    if (argc >= 2 && (strcmp(argv[1], "-training") == 0 || strcmp(argv[1], "-gridsearch") == 0)) {
+        bool gridSearch = strcmp(argv[1], "-gridsearch") == 0;
+        if (argc < 4){
+            if (gridSearch)
+                cout << "gridsearch needs more parameters: input data file, output report file" << endl;
+            else
+                cout << "training needs more parameters: input data file, output file" << endl;
             return 0;
         }
         try{
@@ -111,7 +158,7 @@ int main(int argc, char **argv) {
                 deviceId = tmp;
             OpenCLToolsTrain::getInstancePtr()->init(platformId, deviceId, false);
 #endif
-            int val = train(argv[2], argv[3]);
+            int val = gridSearch ? grid_search(argv[2], argv[3]) : train(argv[2], argv[3]);
             cout << val << endl;
         }
         catch (SDException& e){
@@ -126,6 +173,27 @@ int main(int argc, char **argv) {
         return 0;
     }
     
+    if (argc >= 2 && strcmp(argv[1], "-trainregression") == 0) {
+        if (argc < 4){
+            cout << "trainregression needs more parameters: input training set (text or binary), output file for regression config block" << endl;
+            return 0;
+        }
+        try{
+            LogisticRegressionTrainer trainer(argv[2]);
+            trainer.train();
+            trainer.writeConfig(argv[3]);
+            cout << "Regression trained in " << trainer.getIterations() << " iterations, border value " 
+                 << trainer.getBorderValue() << ", validation score " << trainer.getValidationScore() << endl;
+            cout << "Regression config block written to " << argv[3] << endl;
+        }
+        catch (SDException& e){
+            cout << e.handleException() << endl;
+            exit(1);
+        }
+        Config::destroy();
+        return 0;
+    }
+    
     //TODO instance ShadowDetection processor
     {
         string proccClassStr = Config::getInstancePtr()->getPropertyValue("general.classes.processorClass");
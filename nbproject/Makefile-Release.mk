@@ -36,20 +36,38 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 # Object Files
 OBJECTFILES= \
 	${OBJECTDIR}/main.o \
+	${OBJECTDIR}/src/cpp/core/opencl/DevicePool.o \
+	${OBJECTDIR}/src/cpp/core/opencl/DeviceSession.o \
+	${OBJECTDIR}/src/cpp/core/opencl/OpenCLProfiler.o \
 	${OBJECTDIR}/src/cpp/core/opencl/OpenClToolsBase.o \
+	${OBJECTDIR}/src/cpp/core/opencl/WorkGroupTuner.o \
 	${OBJECTDIR}/src/cpp/core/opencl/libsvm/OpenCLToolsPredict.o \
 	${OBJECTDIR}/src/cpp/core/opencl/libsvm/OpenCLToolsTrain.o \
 	${OBJECTDIR}/src/cpp/core/opencl/regression/OpenCLRegressionPredict.o \
 	${OBJECTDIR}/src/cpp/core/opencv/OpenCV2Tools.o \
 	${OBJECTDIR}/src/cpp/core/opencv/OpenCVTools.o \
 	${OBJECTDIR}/src/cpp/core/process/MakeSetProcessor.o \
+	${OBJECTDIR}/src/cpp/core/process/ProcessingContext.o \
 	${OBJECTDIR}/src/cpp/core/process/TrainingProcessor.o \
+	${OBJECTDIR}/src/cpp/core/tools/image/ImageAtlas.o \
+	${OBJECTDIR}/src/cpp/core/tools/regression/LogisticRegressionTrainer.o \
+	${OBJECTDIR}/src/cpp/core/tools/svm/FeatureCache.o \
+	${OBJECTDIR}/src/cpp/core/tools/svm/KernelMatrixFile.o \
+	${OBJECTDIR}/src/cpp/core/tools/svm/PixelSampler.o \
+	${OBJECTDIR}/src/cpp/core/tools/svm/RowDeduplicator.o \
+	${OBJECTDIR}/src/cpp/core/tools/svm/SvmLightReader.o \
 	${OBJECTDIR}/src/cpp/core/tools/svm/TrainingSet.o \
+	${OBJECTDIR}/src/cpp/core/tools/svm/TrainingSetFile.o \
 	${OBJECTDIR}/src/cpp/core/tools/svm/libsvmopenmp/svm-train.o \
+	${OBJECTDIR}/src/cpp/core/util/Bytes.o \
 	${OBJECTDIR}/src/cpp/core/util/Cofig.o \
+	${OBJECTDIR}/src/cpp/core/util/ConfigSnapshot.o \
 	${OBJECTDIR}/src/cpp/core/util/MemTracker.o \
+	${OBJECTDIR}/src/cpp/core/util/StageDispatcher.o \
 	${OBJECTDIR}/src/cpp/core/util/TabParser.o \
 	${OBJECTDIR}/src/cpp/core/util/Timer.o \
+	${OBJECTDIR}/src/cpp/core/util/predicition/ModelRegistry.o \
+	${OBJECTDIR}/src/cpp/core/util/predicition/libsvm/SvmModelVersion.o \
 	${OBJECTDIR}/src/cpp/core/util/predicition/libsvm/SvmPredict.o \
 	${OBJECTDIR}/src/cpp/core/util/predicition/regression/RegressionPredict.o \
 	${OBJECTDIR}/src/cpp/core/util/rtti/ObjectFactory.o \
@@ -93,11 +111,31 @@ ${OBJECTDIR}/main.o: main.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/main.o main.cpp
 
+${OBJECTDIR}/src/cpp/core/opencl/DevicePool.o: src/cpp/core/opencl/DevicePool.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/opencl
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/opencl/DevicePool.o src/cpp/core/opencl/DevicePool.cpp
+
+${OBJECTDIR}/src/cpp/core/opencl/DeviceSession.o: src/cpp/core/opencl/DeviceSession.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/opencl
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/opencl/DeviceSession.o src/cpp/core/opencl/DeviceSession.cpp
+
+${OBJECTDIR}/src/cpp/core/opencl/OpenCLProfiler.o: src/cpp/core/opencl/OpenCLProfiler.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/opencl
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/opencl/OpenCLProfiler.o src/cpp/core/opencl/OpenCLProfiler.cpp
+
 ${OBJECTDIR}/src/cpp/core/opencl/OpenClToolsBase.o: src/cpp/core/opencl/OpenClToolsBase.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/opencl
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/opencl/OpenClToolsBase.o src/cpp/core/opencl/OpenClToolsBase.cpp
 
+${OBJECTDIR}/src/cpp/core/opencl/WorkGroupTuner.o: src/cpp/core/opencl/WorkGroupTuner.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/opencl
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/opencl/WorkGroupTuner.o src/cpp/core/opencl/WorkGroupTuner.cpp
+
 ${OBJECTDIR}/src/cpp/core/opencl/libsvm/OpenCLToolsPredict.o: src/cpp/core/opencl/libsvm/OpenCLToolsPredict.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/opencl/libsvm
 	${RM} "$@.d"
@@ -128,31 +166,91 @@ ${OBJECTDIR}/src/cpp/core/process/MakeSetProcessor.o: src/cpp/core/process/MakeS
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/process/MakeSetProcessor.o src/cpp/core/process/MakeSetProcessor.cpp
 
+${OBJECTDIR}/src/cpp/core/process/ProcessingContext.o: src/cpp/core/process/ProcessingContext.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/process
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/process/ProcessingContext.o src/cpp/core/process/ProcessingContext.cpp
+
 ${OBJECTDIR}/src/cpp/core/process/TrainingProcessor.o: src/cpp/core/process/TrainingProcessor.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/process
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/process/TrainingProcessor.o src/cpp/core/process/TrainingProcessor.cpp
 
+${OBJECTDIR}/src/cpp/core/tools/image/ImageAtlas.o: src/cpp/core/tools/image/ImageAtlas.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/image
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/image/ImageAtlas.o src/cpp/core/tools/image/ImageAtlas.cpp
+
+${OBJECTDIR}/src/cpp/core/tools/regression/LogisticRegressionTrainer.o: src/cpp/core/tools/regression/LogisticRegressionTrainer.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/regression
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/regression/LogisticRegressionTrainer.o src/cpp/core/tools/regression/LogisticRegressionTrainer.cpp
+
+${OBJECTDIR}/src/cpp/core/tools/svm/FeatureCache.o: src/cpp/core/tools/svm/FeatureCache.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/FeatureCache.o src/cpp/core/tools/svm/FeatureCache.cpp
+
+${OBJECTDIR}/src/cpp/core/tools/svm/KernelMatrixFile.o: src/cpp/core/tools/svm/KernelMatrixFile.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/KernelMatrixFile.o src/cpp/core/tools/svm/KernelMatrixFile.cpp
+
+${OBJECTDIR}/src/cpp/core/tools/svm/PixelSampler.o: src/cpp/core/tools/svm/PixelSampler.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/PixelSampler.o src/cpp/core/tools/svm/PixelSampler.cpp
+
+${OBJECTDIR}/src/cpp/core/tools/svm/RowDeduplicator.o: src/cpp/core/tools/svm/RowDeduplicator.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/RowDeduplicator.o src/cpp/core/tools/svm/RowDeduplicator.cpp
+
+${OBJECTDIR}/src/cpp/core/tools/svm/SvmLightReader.o: src/cpp/core/tools/svm/SvmLightReader.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/SvmLightReader.o src/cpp/core/tools/svm/SvmLightReader.cpp
+
 ${OBJECTDIR}/src/cpp/core/tools/svm/TrainingSet.o: src/cpp/core/tools/svm/TrainingSet.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/TrainingSet.o src/cpp/core/tools/svm/TrainingSet.cpp
 
+${OBJECTDIR}/src/cpp/core/tools/svm/TrainingSetFile.o: src/cpp/core/tools/svm/TrainingSetFile.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/TrainingSetFile.o src/cpp/core/tools/svm/TrainingSetFile.cpp
+
 ${OBJECTDIR}/src/cpp/core/tools/svm/libsvmopenmp/svm-train.o: src/cpp/core/tools/svm/libsvmopenmp/svm-train.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/tools/svm/libsvmopenmp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/tools/svm/libsvmopenmp/svm-train.o src/cpp/core/tools/svm/libsvmopenmp/svm-train.cpp
 
+${OBJECTDIR}/src/cpp/core/util/Bytes.o: src/cpp/core/util/Bytes.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/Bytes.o src/cpp/core/util/Bytes.cpp
+
 ${OBJECTDIR}/src/cpp/core/util/Cofig.o: src/cpp/core/util/Cofig.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/Cofig.o src/cpp/core/util/Cofig.cpp
 
+${OBJECTDIR}/src/cpp/core/util/ConfigSnapshot.o: src/cpp/core/util/ConfigSnapshot.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/ConfigSnapshot.o src/cpp/core/util/ConfigSnapshot.cpp
+
 ${OBJECTDIR}/src/cpp/core/util/MemTracker.o: src/cpp/core/util/MemTracker.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/MemTracker.o src/cpp/core/util/MemTracker.cpp
 
+${OBJECTDIR}/src/cpp/core/util/StageDispatcher.o: src/cpp/core/util/StageDispatcher.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/StageDispatcher.o src/cpp/core/util/StageDispatcher.cpp
+
 ${OBJECTDIR}/src/cpp/core/util/TabParser.o: src/cpp/core/util/TabParser.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util
 	${RM} "$@.d"
@@ -163,6 +261,16 @@ ${OBJECTDIR}/src/cpp/core/util/Timer.o: src/cpp/core/util/Timer.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/Timer.o src/cpp/core/util/Timer.cpp
 
+${OBJECTDIR}/src/cpp/core/util/predicition/ModelRegistry.o: src/cpp/core/util/predicition/ModelRegistry.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util/predicition
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/predicition/ModelRegistry.o src/cpp/core/util/predicition/ModelRegistry.cpp
+
+${OBJECTDIR}/src/cpp/core/util/predicition/libsvm/SvmModelVersion.o: src/cpp/core/util/predicition/libsvm/SvmModelVersion.cpp 
+	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util/predicition/libsvm
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -I/usr/local/include/opencv -Isrc/cpp -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/src/cpp/core/util/predicition/libsvm/SvmModelVersion.o src/cpp/core/util/predicition/libsvm/SvmModelVersion.cpp
+
 ${OBJECTDIR}/src/cpp/core/util/predicition/libsvm/SvmPredict.o: src/cpp/core/util/predicition/libsvm/SvmPredict.cpp 
 	${MKDIR} -p ${OBJECTDIR}/src/cpp/core/util/predicition/libsvm
 	${RM} "$@.d"
@@ -0,0 +1,261 @@
+#ifdef _OPENCL
+#include "DevicePool.h"
+#include <iostream>
+#include <sstream>
+#include <exception>
+#include "DeviceSession.h"
+#include "WorkGroupTuner.h"
+#include "OpenCLProfiler.h"
+#include "core/util/raii/RAIIS.h"
+#include "core/util/Config.h"
+#include "core/util/Timer.h"
+#include "core/util/MemTracker.h"
+
+#define MAX_POOL_DEVICES 100
+#define MAX_POOL_PLATFORMS 100
+
+namespace core{
+    namespace opencl{
+
+        using namespace std;
+        using namespace core::util;
+        using namespace core::util::raii;
+
+        static pthread_mutex_t printMutex = PTHREAD_MUTEX_INITIALIZER;
+
+        DevicePool::DevicePool(){
+            pthread_mutex_init(&mutex, 0);
+            nextJob = 0;
+            jobCount = 0;
+        }
+
+        DevicePool::~DevicePool(){
+            for (size_t i = 0; i < sessions.size(); i++){
+                Delete(sessions[i]);
+            }
+            sessions.clear();
+#ifdef CL_VERSION_1_2
+            for (size_t i = 0; i < subDevices.size(); i++){
+                clReleaseDevice(subDevices[i]);
+            }
+#endif
+            subDevices.clear();
+            pthread_mutex_destroy(&mutex);
+        }
+
+        bool DevicePool::isEnabled(){
+            try{
+                string useStr = Config::getInstancePtr()->getPropertyValue("general.openCL.devicePool.UseDevicePool");
+                return useStr.compare("true") == 0;
+            }
+            catch (SDException& e){
+                //device pool is opt-in, older configs don't have this property
+                return false;
+            }
+        }
+
+        string DevicePool::getDeviceName(cl_device_id device) throw (SDException&){
+            char info[256];
+            cl_int err = clGetDeviceInfo(device, CL_DEVICE_NAME, 256, info, 0);
+            if (err != CL_SUCCESS){
+                SDException exc(SHADOW_NO_OPENCL_DEVICE, "DevicePool::getDeviceName clGetDeviceInfo");
+                throw exc;
+            }
+            string name = info;
+            return name;
+        }
+
+        cl_device_id DevicePool::getDevice(uint platformID, uint deviceID) throw (SDException&){
+            cl_platform_id platforms[MAX_POOL_PLATFORMS];
+            cl_uint numPlatforms = 0;
+            cl_int err = clGetPlatformIDs(MAX_POOL_PLATFORMS, platforms, &numPlatforms);
+            if (err != CL_SUCCESS || platformID >= numPlatforms){
+                SDException exc(SHADOW_NO_OPENCL_PLATFORM, "DevicePool::getDevice");
+                throw exc;
+            }
+            cl_device_id devices[MAX_POOL_DEVICES];
+            cl_uint numDevices = 0;
+            err = clGetDeviceIDs(platforms[platformID], OpenClBase::getDeviceType(), MAX_POOL_DEVICES, devices, &numDevices);
+            if (err != CL_SUCCESS || deviceID >= numDevices){
+                SDException exc(SHADOW_NO_OPENCL_DEVICE, "DevicePool::getDevice");
+                throw exc;
+            }
+            return devices[deviceID];
+        }
+
+        void DevicePool::print(const string& message){
+            DeviceSession* session = DeviceSession::current();
+            stringstream ss;
+            if (session != 0){
+                string prefix = "[" + session->getName() + "] ";
+                stringstream lines(message);
+                string line;
+                while (getline(lines, line)){
+                    ss << prefix << line << endl;
+                }
+            }
+            else{
+                ss << message;
+            }
+            MutexRaii autoLock(&printMutex);
+            cout << ss.str() << flush;
+        }
+
+        void DevicePool::init() throw (SDException&){
+            uint subDeviceNum = 0;
+            try{
+                string subStr = Config::getInstancePtr()->getPropertyValue("general.openCL.devicePool.subDevices");
+                int tmp = atoi(subStr.c_str());
+                if (tmp > 0)
+                    subDeviceNum = tmp;
+            }
+            catch (SDException& e){
+                subDeviceNum = 0;
+            }
+
+            cl_platform_id platforms[MAX_POOL_PLATFORMS];
+            cl_uint numPlatforms = 0;
+            cl_int err = clGetPlatformIDs(MAX_POOL_PLATFORMS, platforms, &numPlatforms);
+            if (err != CL_SUCCESS || numPlatforms == 0){
+                SDException exc(SHADOW_NO_OPENCL_PLATFORM, "DevicePool::init clGetPlatformIDs");
+                throw exc;
+            }
+            for (cl_uint i = 0; i < numPlatforms; i++){
+                cl_device_id devices[MAX_POOL_DEVICES];
+                cl_uint numDevices = 0;
+                err = clGetDeviceIDs(platforms[i], OpenClBase::getDeviceType(), MAX_POOL_DEVICES, devices, &numDevices);
+                if (err != CL_SUCCESS){
+                    //platform without devices usable by this build
+                    continue;
+                }
+                for (cl_uint j = 0; j < numDevices; j++){
+                    stringstream ss;
+                    ss << getDeviceName(devices[j]) << " (" << i << ":" << j << ")";
+                    addDevice(devices[j], ss.str(), subDeviceNum);
+                }
+            }
+            if (sessions.size() == 0){
+                SDException exc(SHADOW_NO_OPENCL_DEVICE, "DevicePool::init no devices");
+                throw exc;
+            }
+            cout << "Device pool size: " << sessions.size() << endl;
+        }
+
+        void DevicePool::addDevice(cl_device_id device, const string& name, uint subDeviceNum) throw (SDException&){
+#ifdef CL_VERSION_1_2
+            if (subDeviceNum > 1){
+                cl_uint computeUnits = 0;
+                cl_int err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &computeUnits, 0);
+                cl_uint unitsPerSub = computeUnits / subDeviceNum;
+                if (unitsPerSub < 1)
+                    unitsPerSub = 1;
+                cl_device_partition_property props[] = {CL_DEVICE_PARTITION_EQUALLY, (cl_device_partition_property)unitsPerSub, 0};
+                cl_device_id subs[MAX_POOL_DEVICES];
+                cl_uint numSubs = 0;
+                if (err == CL_SUCCESS)
+                    err = clCreateSubDevices(device, props, MAX_POOL_DEVICES, subs, &numSubs);
+                if (err == CL_SUCCESS && numSubs > 0){
+                    for (cl_uint i = 0; i < numSubs; i++){
+                        subDevices.push_back(subs[i]);
+                        stringstream ss;
+                        ss << name << " sub " << i;
+                        sessions.push_back(New DeviceSession(subs[i], ss.str()));
+                    }
+                    return;
+                }
+                cout << "Device " << name << " can't be partitioned (" << err << "), using whole device" << endl;
+            }
+#endif
+            sessions.push_back(New DeviceSession(device, name));
+        }
+
+        int DevicePool::takeJob(){
+            MutexRaii autoLock(&mutex);
+            if (nextJob >= jobCount)
+                return -1;
+            int ret = nextJob;
+            nextJob++;
+            return ret;
+        }
+
+        void DevicePool::work(DeviceSession* session){
+            DeviceSession::setCurrent(session);
+            int index;
+            while ((index = takeJob()) >= 0){
+                Timer timer;
+                uint64_t pixels = 0;
+                try{
+                    pixels = job(session, index);
+                }
+                catch (SDException& exception){
+                    print(exception.handleException() + "\n");
+                }
+                catch (std::exception& exception){
+                    //opencv and allocation errors, next jobs still run
+                    print(string("DevicePool job error: ") + exception.what() + "\n");
+                }
+                catch (...){
+                    print("DevicePool job error\n");
+                }
+                session->cleanWorkPart();
+                session->addProcessed(pixels, timer.sinceStart());
+            }
+            DeviceSession::setCurrent(0);
+        }
+
+        void* DevicePool::workerThread(void* arg){
+            WorkerArg* workerArg = (WorkerArg*)arg;
+            workerArg->pool->work(workerArg->session);
+            return 0;
+        }
+
+        void DevicePool::run(int count, DeviceJob deviceJob) throw (SDException&){
+            //create shared singletons before workers start
+            WorkGroupTuner::getInstancePtr();
+            OpenCLProfiler::getInstancePtr();
+            job = deviceJob;
+            jobCount = count;
+            nextJob = 0;
+
+            size_t workerNum = sessions.size();
+            vector<pthread_t> threads(workerNum);
+            vector<WorkerArg> args(workerNum);
+            size_t started = 0;
+            for (size_t i = 0; i < workerNum; i++){
+                args[i].pool = this;
+                args[i].session = sessions[i];
+                if (pthread_create(&threads[i], 0, DevicePool::workerThread, &args[i]) != 0){
+                    cout << "DevicePool::run can't start worker for " << sessions[i]->getName() << endl;
+                    break;
+                }
+                started++;
+            }
+            if (started == 0){
+                //no workers, process everything on first device from this thread
+                work(sessions[0]);
+            }
+            for (size_t i = 0; i < started; i++){
+                pthread_join(threads[i], 0);
+            }
+        }
+
+        void DevicePool::printThroughput(){
+            cout << "===========" << endl;
+            cout << "Device pool throughput:" << endl;
+            for (size_t i = 0; i < sessions.size(); i++){
+                DeviceSession* session = sessions[i];
+                double seconds = session->getBusyTime() / 1000.;
+                double imagesPerSec = seconds > 0. ? session->getProcessedImages() / seconds : 0.;
+                double mpixPerSec = seconds > 0. ? session->getProcessedPixels() / 1000000. / seconds : 0.;
+                cout << session->getName() << ": images " << session->getProcessedImages() << ", "
+                        << imagesPerSec << " images/s, " << mpixPerSec << " Mpix/s" << endl;
+            }
+        }
+
+        size_t DevicePool::size(){
+            return sessions.size();
+        }
+
+    }
+}
+#endif
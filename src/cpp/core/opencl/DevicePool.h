@@ -0,0 +1,105 @@
+#ifndef __DEVICE_POOL_H__
+#define __DEVICE_POOL_H__
+
+#ifdef _OPENCL
+
+#include <CL/cl.h>
+#include <vector>
+#include <functional>
+#include <pthread.h>
+#include "typedefs.h"
+
+namespace core{
+    namespace opencl{
+
+        class DeviceSession;
+
+        /**
+         * job processed on one device, returns number of processed pixels
+         * @param session
+         * session of device which processes job
+         * @param index
+         * index of job
+         */
+        typedef std::function<uint64_t(DeviceSession* session, int index)> DeviceJob;
+
+        /**
+         * Pool of all openCL devices (or sub-devices) visible to this build.
+         * Each device has own DeviceSession (context, command queue, kernels, buffers)
+         * and own worker thread. Worker which finishes image takes next one, so faster
+         * devices process more images.
+         * Enabled with general.openCL.devicePool.UseDevicePool, each device can be split
+         * in general.openCL.devicePool.subDevices equal sub-devices (0 for no split).
+         */
+        class DevicePool{
+        private:
+            std::vector<DeviceSession*> sessions;
+            std::vector<cl_device_id> subDevices;
+
+            //shared between workers during run
+            pthread_mutex_t mutex;
+            int nextJob;
+            int jobCount;
+            DeviceJob job;
+
+            struct WorkerArg{
+                DevicePool* pool;
+                DeviceSession* session;
+            };
+
+            void addDevice(cl_device_id device, const std::string& name, uint subDeviceNum) throw (SDException&);
+            std::string getDeviceName(cl_device_id device) throw (SDException&);
+            /**
+             * @return
+             * next job index, -1 if all jobs are taken
+             */
+            int takeJob();
+            void work(DeviceSession* session);
+            static void* workerThread(void* arg);
+        protected:
+        public:
+            DevicePool();
+            virtual ~DevicePool();
+
+            /**
+             * @return
+             * value of general.openCL.devicePool.UseDevicePool
+             */
+            static bool isEnabled();
+            /**
+             * @return
+             * device with given platform and device index, same selection as OpenClBase::init
+             * (devices of OpenClBase::getDeviceType)
+             */
+            static cl_device_id getDevice(uint platformID, uint deviceID) throw (SDException&);
+            /**
+             * write message to cout as one block, so messages of concurrent workers don't
+             * interleave. Each line is prefixed with name of current thread session, if any
+             */
+            static void print(const std::string& message);
+            /**
+             * enumerate devices of all platforms and create session for each of them
+             */
+            void init() throw (SDException&);
+            /**
+             * process jobs on all devices, returns when all jobs are processed.
+             * Exceptions thrown by job should be handled inside job
+             * @param count
+             * number of jobs
+             * @param deviceJob
+             * job function, called on device worker thread with device session set as current
+             */
+            void run(int count, DeviceJob deviceJob) throw (SDException&);
+            /**
+             * print images/s and Mpix/s for each device
+             */
+            void printThroughput();
+            size_t size();
+        };
+
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#ifdef _OPENCL
+#include "DeviceSession.h"
+#include "core/util/MemTracker.h"
+
+namespace core{
+    namespace opencl{
+
+        using namespace std;
+
+        thread_local DeviceSession* DeviceSession::currentSession = 0;
+
+        DeviceSession::DeviceSession(cl_device_id device, const string& name){
+            this->device = device;
+            this->name = name;
+            processedImages = 0;
+            processedPixels = 0;
+            busyTime = 0;
+        }
+
+        DeviceSession::~DeviceSession(){
+            unordered_map<string, OpenClBase*>::iterator iter;
+            for (iter = tools.begin(); iter != tools.end(); iter++){
+                OpenClBase* tool = iter->second;
+                //base destructor can't reach derived cleanUp
+                tool->cleanUp();
+                Delete(tool);
+            }
+            tools.clear();
+        }
+
+        void DeviceSession::setCurrent(DeviceSession* session){
+            currentSession = session;
+        }
+
+        DeviceSession* DeviceSession::current(){
+            return currentSession;
+        }
+
+        void DeviceSession::cleanWorkPart(){
+            unordered_map<string, OpenClBase*>::iterator iter;
+            for (iter = tools.begin(); iter != tools.end(); iter++){
+                iter->second->cleanWorkPart();
+            }
+        }
+
+        void DeviceSession::addProcessed(uint64_t pixels, int64_t time){
+            processedImages++;
+            processedPixels += pixels;
+            busyTime += time;
+        }
+
+        string DeviceSession::getName(){
+            return name;
+        }
+
+        uint64_t DeviceSession::getProcessedImages(){
+            return processedImages;
+        }
+
+        uint64_t DeviceSession::getProcessedPixels(){
+            return processedPixels;
+        }
+
+        int64_t DeviceSession::getBusyTime(){
+            return busyTime;
+        }
+
+    }
+}
+#endif
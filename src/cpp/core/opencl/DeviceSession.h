@@ -0,0 +1,111 @@
+#ifndef __DEVICE_SESSION_H__
+#define __DEVICE_SESSION_H__
+
+#ifdef _OPENCL
+
+#include <CL/cl.h>
+#include <unordered_map>
+#include <typeinfo>
+#include "OpenClToolsBase.h"
+#include "typedefs.h"
+
+namespace core{
+    namespace opencl{
+
+        /**
+         * Owns own instance of each OpenClBase derived class, initialized on one device.
+         * Worker thread which processes images on device marks session as current,
+         * so DeviceSession::tool<T>() returns instance of T bound to that device.
+         * Outside of device pool there is no current session and tool<T>() returns T singleton.
+         */
+        class DeviceSession{
+        private:
+            cl_device_id device;
+            std::string name;
+            /**
+             * key is typeid(T).name()
+             */
+            std::unordered_map<std::string, OpenClBase*> tools;
+
+            //throughput accounting
+            uint64_t processedImages;
+            uint64_t processedPixels;
+            int64_t busyTime;
+
+            static thread_local DeviceSession* currentSession;
+
+            DeviceSession();
+        protected:
+        public:
+            /**
+             * @param device
+             * device (or sub-device) used by all tools of session
+             * @param name
+             * name used in reports
+             */
+            DeviceSession(cl_device_id device, const std::string& name);
+            virtual ~DeviceSession();
+
+            /**
+             * @return
+             * instance of T for session device, created and initialized on first call
+             */
+            template<typename T> T* getTool() throw (SDException&){
+                std::string key = typeid(T).name();
+                std::unordered_map<std::string, OpenClBase*>::iterator iter = tools.find(key);
+                if (iter != tools.end()){
+                    return static_cast<T*>(iter->second);
+                }
+                T* tool = New T();
+                tools[key] = tool;
+                tool->init(device);
+                return tool;
+            }
+
+            /**
+             * @return
+             * instance of T from current thread session, or T singleton if thread has no session
+             */
+            template<typename T> static T* tool() throw (SDException&){
+                if (currentSession != 0){
+                    return currentSession->getTool<T>();
+                }
+                return T::getInstancePtr();
+            }
+
+            /**
+             * mark session as current for calling thread
+             * @param session
+             * session, 0 for none
+             */
+            static void setCurrent(DeviceSession* session);
+            /**
+             * @return
+             * current thread session, 0 if none
+             */
+            static DeviceSession* current();
+
+            /**
+             * clean per image variables of all created tools
+             */
+            void cleanWorkPart();
+            /**
+             * add one processed image to throughput accounting
+             * @param pixels
+             * number of pixels in image
+             * @param time
+             * processing time in milliseconds
+             */
+            void addProcessed(uint64_t pixels, int64_t time);
+            std::string getName();
+            uint64_t getProcessedImages();
+            uint64_t getProcessedPixels();
+            int64_t getBusyTime();
+        };
+
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,205 @@
+#ifdef _OPENCL
+#include "OpenCLProfiler.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include "core/util/raii/RAIIS.h"
+#include "core/util/Config.h"
+
+namespace core{
+    namespace opencl{
+
+        using namespace std;
+        using namespace core::util;
+        using namespace core::util::raii;
+
+        static const char* profileTypeNames[] = {"kernel", "read", "write"};
+
+        OpenCLProfiler::OpenCLProfiler() : Singleton<OpenCLProfiler>(){
+            pthread_mutex_init(&mutex, 0);
+            enabled = false;
+            timeOrigin = 0;
+            reportWritten = false;
+            reportFile = "opencl_profile.json";
+            try{
+                Config* conf = Config::getInstancePtr();
+                string profStr = conf->getPropertyValue("general.openCL.Profiling");
+                enabled = profStr.compare("true") == 0;
+                reportFile = conf->getPropertyValue("general.openCL.ProfilingReport");
+            }
+            catch (SDException& e){
+                //profiling is opt-in, older configs don't have these properties
+            }
+            if (enabled){
+                atexit(OpenCLProfiler::reportAtExit);
+            }
+        }
+
+        OpenCLProfiler::~OpenCLProfiler(){
+            pthread_mutex_destroy(&mutex);
+        }
+
+        bool OpenCLProfiler::isEnabled(){
+            return enabled;
+        }
+
+        void OpenCLProfiler::reportAtExit(){
+            OpenCLProfiler::getInstancePtr()->writeReport();
+        }
+
+        void OpenCLProfiler::addKernelEvent(cl_event event, const string& kernelName, const string& queueName){
+            addEvent(event, kernelName, queueName, PROFILE_KERNEL, 0);
+        }
+
+        void OpenCLProfiler::addTransferEvent(cl_event event, const string& queueName, PROFILE_EVENT_TYPE type, size_t bytes){
+            string name = queueName + " " + profileTypeNames[type];
+            addEvent(event, name, queueName, type, bytes);
+        }
+
+        void OpenCLProfiler::addEvent(cl_event event, const string& name, const string& queueName,
+                                        PROFILE_EVENT_TYPE type, size_t bytes){
+            if (event == 0)
+                return;
+            MutexRaii autoLock(&mutex);
+            PendingEvent pe;
+            pe.event = event;
+            pe.name = name;
+            pe.queueName = queueName;
+            pe.type = type;
+            pe.bytes = bytes;
+            pending.push_back(pe);
+            if (pending.size() >= MAX_PENDING_PROFILE_EVENTS){
+                resolvePendingLocked();
+            }
+        }
+
+        void OpenCLProfiler::resolvePending(){
+            MutexRaii autoLock(&mutex);
+            resolvePendingLocked();
+        }
+
+        void OpenCLProfiler::resolvePendingLocked(){
+            for (size_t i = 0; i < pending.size(); i++){
+                PendingEvent& pe = pending[i];
+                cl_ulong queued = 0, submit = 0, start = 0, end = 0;
+                cl_int err = clWaitForEvents(1, &pe.event);
+                err |= clGetEventProfilingInfo(pe.event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, 0);
+                err |= clGetEventProfilingInfo(pe.event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &submit, 0);
+                err |= clGetEventProfilingInfo(pe.event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, 0);
+                err |= clGetEventProfilingInfo(pe.event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, 0);
+                clReleaseEvent(pe.event);
+                if (err != CL_SUCCESS){
+                    cout << "OpenCLProfiler: can't read profiling info for " << pe.name << endl;
+                    continue;
+                }
+                if (timeOrigin == 0 || queued < timeOrigin)
+                    timeOrigin = queued;
+
+                unordered_map<string, ProfileAggregate>::iterator iter = aggregates.find(pe.name);
+                if (iter == aggregates.end()){
+                    ProfileAggregate agg;
+                    agg.type = pe.type;
+                    agg.count = 0;
+                    agg.bytes = 0;
+                    agg.queuedToStart = 0;
+                    agg.execution = 0;
+                    iter = aggregates.insert(make_pair(pe.name, agg)).first;
+                }
+                iter->second.count++;
+                iter->second.bytes += pe.bytes;
+                iter->second.queuedToStart += start - queued;
+                iter->second.execution += end - start;
+
+                if (traceEvents.size() < MAX_TRACE_PROFILE_EVENTS){
+                    unordered_map<string, int>::iterator qIter = queueIds.find(pe.queueName);
+                    if (qIter == queueIds.end()){
+                        int id = queueIds.size();
+                        qIter = queueIds.insert(make_pair(pe.queueName, id)).first;
+                    }
+                    ProfileTraceEvent te;
+                    te.name = pe.name;
+                    te.type = pe.type;
+                    te.tid = qIter->second;
+                    te.start = start;
+                    te.end = end;
+                    te.bytes = pe.bytes;
+                    traceEvents.push_back(te);
+                }
+            }
+            pending.clear();
+        }
+
+        void OpenCLProfiler::writeReport(){
+            if (enabled == false)
+                return;
+            MutexRaii autoLock(&mutex);
+            if (reportWritten)
+                return;
+            resolvePendingLocked();
+            reportWritten = true;
+
+            fstream report;
+            report.open(reportFile.c_str(), ofstream::out | ofstream::trunc);
+            if (report.is_open() == false){
+                SDException exc(SHADOW_WRITE_UNABLE, "OpenCLProfiler::writeReport " + reportFile);
+                cout << exc.what() << endl;
+                return;
+            }
+            FileRaii fRaii(&report);
+            report << fixed << setprecision(3);
+            report << "{" << endl;
+            report << "\"displayTimeUnit\": \"ns\"," << endl;
+            report << "\"aggregates\": [" << endl;
+            bool first = true;
+            uint64_t directionBytes[3] = {0, 0, 0};
+            uint64_t directionTime[3] = {0, 0, 0};
+            unordered_map<string, ProfileAggregate>::iterator iter;
+            for (iter = aggregates.begin(); iter != aggregates.end(); iter++){
+                const ProfileAggregate& agg = iter->second;
+                double totalUs = agg.execution / 1000.;
+                double avgUs = agg.count > 0 ? totalUs / agg.count : 0.;
+                double waitUs = agg.count > 0 ? agg.queuedToStart / 1000. / agg.count : 0.;
+                directionBytes[agg.type] += agg.bytes;
+                directionTime[agg.type] += agg.execution;
+                report << (first ? "" : ",\n") << "  {\"name\": \"" << iter->first << "\", \"type\": \"" << profileTypeNames[agg.type]
+                        << "\", \"count\": " << agg.count << ", \"totalUs\": " << totalUs << ", \"avgUs\": " << avgUs
+                        << ", \"avgQueuedToStartUs\": " << waitUs;
+                if (agg.type != PROFILE_KERNEL){
+                    //bytes per nanosecond is GB/s
+                    double gbs = agg.execution > 0 ? (double)agg.bytes / agg.execution : 0.;
+                    report << ", \"bytes\": " << agg.bytes << ", \"GBps\": " << gbs;
+                }
+                report << "}";
+                first = false;
+            }
+            for (int type = PROFILE_READ; type <= PROFILE_WRITE; type++){
+                double gbs = directionTime[type] > 0 ? (double)directionBytes[type] / directionTime[type] : 0.;
+                report << (first ? "" : ",\n") << "  {\"name\": \"all " << profileTypeNames[type] << "\", \"type\": \""
+                        << profileTypeNames[type] << "\", \"totalUs\": " << directionTime[type] / 1000.
+                        << ", \"bytes\": " << directionBytes[type] << ", \"GBps\": " << gbs << "}";
+                first = false;
+            }
+            report << endl << "]," << endl;
+            report << "\"traceEvents\": [" << endl;
+            unordered_map<string, int>::iterator qIter;
+            first = true;
+            for (qIter = queueIds.begin(); qIter != queueIds.end(); qIter++){
+                report << (first ? "" : ",\n") << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << qIter->second
+                        << ", \"args\": {\"name\": \"" << qIter->first << "\"}}";
+                first = false;
+            }
+            for (size_t i = 0; i < traceEvents.size(); i++){
+                const ProfileTraceEvent& te = traceEvents[i];
+                report << (first ? "" : ",\n") << "  {\"name\": \"" << te.name << "\", \"cat\": \"" << profileTypeNames[te.type]
+                        << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << te.tid << ", \"ts\": " << (te.start - timeOrigin) / 1000.
+                        << ", \"dur\": " << (te.end - te.start) / 1000. << ", \"args\": {\"bytes\": " << te.bytes << "}}";
+                first = false;
+            }
+            report << endl << "]" << endl;
+            report << "}" << endl;
+            cout << "OpenCL profiling report written to: " << reportFile << endl;
+        }
+
+    }
+}
+#endif
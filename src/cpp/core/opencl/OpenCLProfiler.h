@@ -0,0 +1,133 @@
+#ifndef __OPENCL_PROFILER_H__
+#define __OPENCL_PROFILER_H__
+
+#ifdef _OPENCL
+
+#include <CL/cl.h>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+#include "core/util/Singleton.h"
+#include "typedefs.h"
+
+#define MAX_PENDING_PROFILE_EVENTS 1024
+#define MAX_TRACE_PROFILE_EVENTS 100000
+
+namespace core{
+    namespace opencl{
+
+        enum PROFILE_EVENT_TYPE{
+            PROFILE_KERNEL,
+            PROFILE_READ,
+            PROFILE_WRITE,
+        };
+
+        /**
+         * aggregated times of one kernel or one transfer direction, in nanoseconds
+         */
+        struct ProfileAggregate{
+            PROFILE_EVENT_TYPE type;
+            uint64_t count;
+            uint64_t bytes;
+            uint64_t queuedToStart;
+            uint64_t execution;
+        };
+
+        /**
+         * one resolved command, used for Chrome trace output
+         */
+        struct ProfileTraceEvent{
+            std::string name;
+            PROFILE_EVENT_TYPE type;
+            int tid;
+            cl_ulong start;
+            cl_ulong end;
+            uint64_t bytes;
+        };
+
+        /**
+         * Collects OpenCL event profiling info (queued, submit, start, end) of all
+         * OpenClBase derived classes. Enabled with general.openCL.Profiling, command queues
+         * are then created with CL_QUEUE_PROFILING_ENABLE. At exit report is written to
+         * general.openCL.ProfilingReport in Chrome trace format (chrome://tracing), with
+         * per kernel and per transfer direction aggregates in "aggregates" section.
+         * Class is Singleton
+         */
+        class OpenCLProfiler : public core::util::Singleton<OpenCLProfiler>{
+            friend class core::util::Singleton<OpenCLProfiler>;
+        private:
+            struct PendingEvent{
+                cl_event event;
+                std::string name;
+                std::string queueName;
+                PROFILE_EVENT_TYPE type;
+                size_t bytes;
+            };
+
+            bool enabled;
+            std::string reportFile;
+            pthread_mutex_t mutex;
+            std::vector<PendingEvent> pending;
+            std::unordered_map<std::string, ProfileAggregate> aggregates;
+            std::vector<ProfileTraceEvent> traceEvents;
+            /**
+             * thread id in trace for each class (queue)
+             */
+            std::unordered_map<std::string, int> queueIds;
+            cl_ulong timeOrigin;
+            bool reportWritten;
+
+            /**
+             * wait for pending events, read profiling info and release them. Caller holds mutex
+             */
+            void resolvePendingLocked();
+            void addEvent(cl_event event, const std::string& name, const std::string& queueName,
+                            PROFILE_EVENT_TYPE type, size_t bytes);
+            static void reportAtExit();
+        protected:
+            OpenCLProfiler();
+            virtual ~OpenCLProfiler();
+        public:
+            /**
+             * @return
+             * value of general.openCL.Profiling
+             */
+            bool isEnabled();
+            /**
+             * take ownership of kernel launch event
+             * @param event
+             * event returned by clEnqueueNDRangeKernel
+             * @param kernelName
+             * unique kernel name (class name + kernel function name)
+             * @param queueName
+             * name of class which owns command queue
+             */
+            void addKernelEvent(cl_event event, const std::string& kernelName, const std::string& queueName);
+            /**
+             * take ownership of buffer transfer event
+             * @param event
+             * event returned by clEnqueueReadBuffer / clEnqueueWriteBuffer
+             * @param queueName
+             * name of class which owns command queue
+             * @param type
+             * PROFILE_READ or PROFILE_WRITE
+             * @param bytes
+             * transfered size
+             */
+            void addTransferEvent(cl_event event, const std::string& queueName, PROFILE_EVENT_TYPE type, size_t bytes);
+            /**
+             * resolve all pending events, should be called before command queue is released
+             */
+            void resolvePending();
+            /**
+             * write report file, called automatically at exit
+             */
+            void writeReport();
+        };
+
+    }
+}
+
+#endif
+
+#endif
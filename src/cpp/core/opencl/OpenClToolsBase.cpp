@@ -1,13 +1,18 @@
 #ifdef _OPENCL
 #include "OpenClToolsBase.h"
 #include <iostream>
+#include <sstream>
 #include "core/util/raii/RAIIS.h"
 #include "core/util/MemTracker.h"
 #include "core/util/Config.h"
+#include "WorkGroupTuner.h"
+#include "DevicePool.h"
+#include <chrono>
 
 #define MAX_DEVICES 100
 #define MAX_SRC_SIZE 5242800
 #define MAX_PLATFORMS 100
+#define TUNE_REPEAT_COUNT 5
 
 namespace core{
     namespace opencl{
@@ -27,13 +32,20 @@ namespace core{
             initialized     = false;
             kernel          = 0;
             workGroupSize   = 0;
+            workGroupTuned  = 0;
+            profiling       = false;
+            profEvent       = 0;
             kernelCount     = 0;
             program         = 0;
             context         = 0;
             command_queue   = 0;
         }
         
-        void OpenClBase::cleanUp(){            
+        void OpenClBase::cleanUp(){
+            if (profiling){
+                //pending events must be resolved while command queue is alive
+                OpenCLProfiler::getInstancePtr()->resolvePending();
+            }
             if (program)
                 clReleaseProgram(program);
             if (context)
@@ -53,6 +65,10 @@ namespace core{
             if (workGroupSize){
                 DeleteArr(workGroupSize);
             }
+            if (workGroupTuned){
+                DeleteArr(workGroupTuned);
+            }
+            kernelNames.clear();
         }
         
         bool OpenClBase::hasInitialized(){
@@ -88,6 +104,81 @@ namespace core{
             return ((coef + 1) * localSize);
         }
         
+        size_t OpenClBase::getLocalWorkSize(int kernelIndex, size_t allSize){
+            if (workGroupTuned[kernelIndex] == false && WorkGroupTuner::getInstancePtr()->isEnabled()){
+                tuneWorkGroupSize(kernelIndex, allSize);
+            }
+            return workGroupSize[kernelIndex];
+        }
+        
+        cl_event* OpenClBase::profilingEvent(){
+            if (profiling == false)
+                return 0;
+            profEvent = 0;
+            return &profEvent;
+        }
+        
+        void OpenClBase::profileKernel(int kernelIndex){
+            if (profEvent == 0)
+                return;
+            string className = getClassName();
+            OpenCLProfiler::getInstancePtr()->addKernelEvent(profEvent, className + "::" + kernelNames[kernelIndex], className);
+            profEvent = 0;
+        }
+        
+        void OpenClBase::profileTransfer(PROFILE_EVENT_TYPE type, size_t bytes){
+            if (profEvent == 0)
+                return;
+            OpenCLProfiler::getInstancePtr()->addTransferEvent(profEvent, getClassName(), type, bytes);
+            profEvent = 0;
+        }
+        
+        void OpenClBase::tuneWorkGroupSize(int kernelIndex, size_t allSize){
+            size_t maxSize = workGroupSize[kernelIndex];
+            size_t multiple = 1;
+            err = clGetKernelWorkGroupInfo(kernel[kernelIndex], device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(multiple), &multiple, NULL);
+            if (err != CL_SUCCESS || multiple == 0)
+                multiple = 1;
+            vector<size_t> candidates;
+            for (size_t candidate = multiple; candidate < maxSize; candidate *= 2){
+                candidates.push_back(candidate);
+            }
+            candidates.push_back(maxSize);
+            
+            size_t bestSize = maxSize;
+            int64_t bestTime = -1;
+            for (size_t i = 0; i < candidates.size(); i++){
+                size_t local_ws = candidates[i];
+                size_t global_ws = shrRoundUp(local_ws, allSize);
+                //warm up run, first launch can include lazy compilation / transfers
+                err = clEnqueueNDRangeKernel(command_queue, kernel[kernelIndex], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
+                err_check(err, "OpenClBase::tuneWorkGroupSize clEnqueueNDRangeKernel warm up");
+                err = clFinish(command_queue);
+                err_check(err, "OpenClBase::tuneWorkGroupSize clFinish warm up");
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int j = 0; j < TUNE_REPEAT_COUNT; j++){
+                    err = clEnqueueNDRangeKernel(command_queue, kernel[kernelIndex], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
+                    err_check(err, "OpenClBase::tuneWorkGroupSize clEnqueueNDRangeKernel");
+                }
+                err = clFinish(command_queue);
+                err_check(err, "OpenClBase::tuneWorkGroupSize clFinish");
+                int64_t durr = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+                if (bestTime < 0 || durr < bestTime){
+                    bestTime = durr;
+                    bestSize = local_ws;
+                }
+            }
+            
+            workGroupSize[kernelIndex] = bestSize;
+            workGroupTuned[kernelIndex] = true;
+            string kernelKey = getClassName() + "::" + kernelNames[kernelIndex];
+            WorkGroupTuner::getInstancePtr()->setLocalSize(getDeviceName(), kernelKey, bestSize);
+            //sessions tune concurrently, lines go through pool output with session prefix
+            stringstream message;
+            message << "Tuned " << kernelKey << " local work size: " << bestSize << " (max " << maxSize << ")" << endl;
+            DevicePool::print(message.str());
+        }
+        
         void OpenClBase::loadProgramFile(const string& programFileName){
             string usePrecompiledStr = Config::getInstancePtr()->getPropertyValue("general.openCL.UsePrecompiledKernels");
             bool usePrecompiled = usePrecompiledStr.compare("true") == 0;
@@ -137,13 +228,16 @@ namespace core{
             }
         }
         
-        string OpenClBase::getBinaryFile(const string& programFileName){
-            cl_device_type type;
-            clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &type, 0);
+        string OpenClBase::getDeviceName(){
             char deviceName[256];
             err = clGetDeviceInfo(device, CL_DEVICE_NAME, 256, deviceName, 0);            
-            err_check(err, programFileName + " Get device name, save binary kernel");            
-            string file = deviceName;
+            err_check(err, "OpenClBase::getDeviceName clGetDeviceInfo");
+            string name = deviceName;
+            return name;
+        }
+        
+        string OpenClBase::getBinaryFile(const string& programFileName){
+            string file = getDeviceName();
             file += "_" + programFileName + ".ptx";
             return file;
         }
@@ -263,10 +357,24 @@ namespace core{
         
         void OpenClBase::createWorkGroupSizes() {
             workGroupSize = New size_t[kernelCount];
+            workGroupTuned = New bool[kernelCount];
+            WorkGroupTuner* tuner = WorkGroupTuner::getInstancePtr();
+            string deviceName = "";
+            if (tuner->isEnabled())
+                deviceName = getDeviceName();
             for (int i = 0; i < kernelCount; i++) {
+                workGroupTuned[i] = false;
                 if (kernel[i]){
                     err = clGetKernelWorkGroupInfo(kernel[i], device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(workGroupSize[i]), &(workGroupSize[i]), NULL);
                     err_check(err, "penClBase::createWorkGroupSizes clGetKernelWorkGroupInfo");
+                    size_t tunedSize;
+                    if (tuner->isEnabled() && tuner->getLocalSize(deviceName, getClassName() + "::" + kernelNames[i], tunedSize)){
+                        //stored value can be stale if kernel or driver is changed
+                        if (tunedSize <= workGroupSize[i]){
+                            workGroupSize[i] = tunedSize;
+                            workGroupTuned[i] = true;
+                        }
+                    }
                 }
             }
         }
@@ -302,7 +410,7 @@ namespace core{
         }
         
         void OpenClBase::createKernels(){
-            vector<string> kernelNames = getKernelNamesForClass();
+            kernelNames = getKernelNamesForClass();
             kernelCount = kernelNames.size();
             kernel = New cl_kernel[kernelCount];
             for (int i = 0; i < kernelCount; i++){
@@ -311,6 +419,24 @@ namespace core{
             }            
         }
         
+        cl_device_type OpenClBase::getDeviceType(){
+            string typeStr;
+            try{
+                typeStr = Config::getInstancePtr()->getPropertyValue("general.openCL.deviceType");
+            }
+            catch (SDException& e){
+                //older configs don't have this property
+                return CL_DEVICE_TYPE_ALL;
+            }
+            if (typeStr.compare("gpu") == 0)
+                return CL_DEVICE_TYPE_GPU;
+            if (typeStr.compare("cpu") == 0)
+                return CL_DEVICE_TYPE_CPU;
+            if (typeStr.compare("accelerator") == 0)
+                return CL_DEVICE_TYPE_ACCELERATOR;
+            return CL_DEVICE_TYPE_ALL;
+        }
+        
         void OpenClBase::init(uint platformID, uint deviceID, bool listOnly) throw (SDException&) {
             char info[256];
             cl_platform_id platform[MAX_PLATFORMS];
@@ -327,11 +453,7 @@ namespace core{
                 err_check(err, "OpenclTools::init clGetPlatformInfo");
                 cout << "Platform name: " << info << endl;
                 try {
-#if defined _AMD
-                    err = clGetDeviceIDs(platform[i], CL_DEVICE_TYPE_ALL, MAX_DEVICES, devices, &num_devices);
-#else
-                    err = clGetDeviceIDs(platform[i], CL_DEVICE_TYPE_GPU, MAX_DEVICES, devices, &num_devices);
-#endif
+                    err = clGetDeviceIDs(platform[i], getDeviceType(), MAX_DEVICES, devices, &num_devices);
                     err_check(err, "OpenclTools::init clGetDeviceIDs");
                     cout << "Found " << num_devices << " devices" << endl;
 
@@ -369,21 +491,24 @@ namespace core{
             
             cl_device_id devices[MAX_DEVICES];
             cl_uint num_devices;
-#if defined _AMD
-                err = clGetDeviceIDs(platform[platformID], CL_DEVICE_TYPE_ALL, MAX_DEVICES, devices, &num_devices);
-#else
-                err = clGetDeviceIDs(platform[platformID], CL_DEVICE_TYPE_GPU, MAX_DEVICES, devices, &num_devices);
-#endif
+            err = clGetDeviceIDs(platform[platformID], getDeviceType(), MAX_DEVICES, devices, &num_devices);
             err_check(err, "OpenClBase::init clGetDeviceIDs2");
             if (deviceID >= num_devices){
                 SDException exc(SHADOW_NO_OPENCL_DEVICE, "OpenClBase::init Init devices");
                 throw exc;
             }
-            device = devices[deviceID];
-                        
+            init(devices[deviceID]);
+        }
+        
+        void OpenClBase::init(cl_device_id selectedDevice) throw (SDException&) {
+            device = selectedDevice;
             context = clCreateContext(0, 1, &device, NULL, NULL, &err);
             err_check(err, "OpenClBase::init clCreateContext");
-            command_queue = clCreateCommandQueue(context, device, 0, &err);
+            profiling = OpenCLProfiler::getInstancePtr()->isEnabled();
+            cl_command_queue_properties queueProperties = 0;
+            if (profiling)
+                queueProperties |= CL_QUEUE_PROFILING_ENABLE;
+            command_queue = clCreateCommandQueue(context, device, queueProperties, &err);
             err_check(err, "OpenClBase::init clCreateCommandQueue");            
 
             cl_bool sup;
@@ -5,11 +5,14 @@
 
 #include <CL/cl.h>
 #include "typedefs.h"
+#include "OpenCLProfiler.h"
 #include <vector>
 
 namespace core{
     namespace opencl{
         
+        class DeviceSession;
+        
         /**
          * helper struct, translation of libsvm structure
          */
@@ -32,6 +35,22 @@ namespace core{
         class OpenClBase{
         private:
             std::string dirToOpenclprogramFiles;
+            /**
+             * kernel function names, same order as kernel array
+             */
+            std::vector<std::string> kernelNames;
+            /**
+             * for each kernel tells if local work size is benchmarked (or loaded from tuning file)
+             */
+            bool* workGroupTuned;
+            /**
+             * if command queue is created with CL_QUEUE_PROFILING_ENABLE
+             */
+            bool profiling;
+            /**
+             * event of last enqueued command, when profiling
+             */
+            cl_event profEvent;
             
             /**
              * compiles program file
@@ -45,6 +64,20 @@ namespace core{
              * calculate work group sizes for each kernel
              */
             void createWorkGroupSizes();
+            /**
+             * benchmarks candidate local work sizes for kernel (kernel arguments must be already set),
+             * stores best one in workGroupSize and in device tuning file
+             * @param kernelIndex
+             * index of kernel in kernel array
+             * @param allSize
+             * number of all threads
+             */
+            void tuneWorkGroupSize(int kernelIndex, size_t allSize);
+            /**
+             * @return
+             * CL_DEVICE_NAME of used device
+             */
+            std::string getDeviceName();
             /**
              * create openCL kernels from program
              */
@@ -116,6 +149,37 @@ namespace core{
              * @return 
              */
             size_t shrRoundUp(size_t localSize, size_t allSize);
+            /**
+             * local work size which should be used for 1-D kernel launch. If general.openCL.TuneWorkGroupSizes
+             * is true and kernel is not tuned for device, benchmarks kernel first, so kernel arguments 
+             * must be set before call
+             * @param kernelIndex
+             * index of kernel in kernel array
+             * @param allSize
+             * number of all threads
+             * @return 
+             */
+            size_t getLocalWorkSize(int kernelIndex, size_t allSize);
+            /**
+             * event argument for clEnqueue* calls
+             * @return 
+             * pointer to event when general.openCL.Profiling is true, otherwise 0
+             */
+            cl_event* profilingEvent();
+            /**
+             * pass event of last kernel launch to profiler, call after clEnqueueNDRangeKernel(..., profilingEvent())
+             * @param kernelIndex
+             * index of launched kernel
+             */
+            void profileKernel(int kernelIndex);
+            /**
+             * pass event of last buffer transfer to profiler, call after clEnqueueRead/WriteBuffer(..., profilingEvent())
+             * @param type
+             * PROFILE_READ or PROFILE_WRITE
+             * @param bytes
+             * transfered size
+             */
+            void profileTransfer(PROFILE_EVENT_TYPE type, size_t bytes);
             /**
              * global function for load program
              * @param kernelFileName
@@ -190,6 +254,18 @@ namespace core{
              * if true then method will only list all possible platforms and devices
              */
             void init(uint platformID, uint deviceID, bool listOnly) throw (SDException&);
+            /**
+             * init variables for already selected device (for example sub-device or device from device pool)
+             * @param selectedDevice
+             * openCL device used for calculations
+             */
+            void init(cl_device_id selectedDevice) throw (SDException&);
+            /**
+             * @return
+             * type of enumerated devices, value of general.openCL.deviceType
+             * (gpu, cpu, accelerator or all; all if property is missing)
+             */
+            static cl_device_type getDeviceType();
         };
         
     }
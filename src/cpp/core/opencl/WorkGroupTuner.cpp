@@ -0,0 +1,97 @@
+#ifdef _OPENCL
+#include "WorkGroupTuner.h"
+#include <iostream>
+#include <fstream>
+#include "core/util/raii/RAIIS.h"
+#include "core/util/Config.h"
+
+namespace core{
+    namespace opencl{
+
+        using namespace std;
+        using namespace core::util;
+        using namespace core::util::raii;
+
+        WorkGroupTuner::WorkGroupTuner() : Singleton<WorkGroupTuner>(){
+            pthread_mutex_init(&mutex, 0);
+            enabled = false;
+            try{
+                string tuneStr = Config::getInstancePtr()->getPropertyValue("general.openCL.TuneWorkGroupSizes");
+                enabled = tuneStr.compare("true") == 0;
+            }
+            catch (SDException& e){
+                //tuning is opt-in, older configs don't have this property
+                enabled = false;
+            }
+        }
+
+        WorkGroupTuner::~WorkGroupTuner(){
+            pthread_mutex_destroy(&mutex);
+        }
+
+        bool WorkGroupTuner::isEnabled(){
+            return enabled;
+        }
+
+        string WorkGroupTuner::getTuningFile(const string& deviceName){
+            string file = deviceName + TUNING_FILE_SUFFIX;
+            return file;
+        }
+
+        void WorkGroupTuner::loadDevice(const string& deviceName){
+            if (loadedDevices.find(deviceName) != loadedDevices.end())
+                return;
+            loadedDevices.insert(deviceName);
+            fstream tuneFile;
+            string file = getTuningFile(deviceName);
+            tuneFile.open(file.c_str(), ifstream::in);
+            if (tuneFile.is_open() == false)
+                return;
+            FileRaii fRaii(&tuneFile);
+            string kernelKey;
+            size_t localSize;
+            while (tuneFile >> kernelKey >> localSize){
+                if (localSize > 0)
+                    tunedSizes[deviceName + "|" + kernelKey] = localSize;
+            }
+        }
+
+        void WorkGroupTuner::saveDevice(const string& deviceName){
+            fstream tuneFile;
+            string file = getTuningFile(deviceName);
+            tuneFile.open(file.c_str(), ofstream::out | ofstream::trunc);
+            if (tuneFile.is_open() == false){
+                SDException exc(SHADOW_WRITE_UNABLE, "WorkGroupTuner::saveDevice " + file);
+                cout << exc.what() << endl;
+                return;
+            }
+            FileRaii fRaii(&tuneFile);
+            string prefix = deviceName + "|";
+            unordered_map<string, size_t>::iterator iter;
+            for (iter = tunedSizes.begin(); iter != tunedSizes.end(); iter++){
+                if (iter->first.compare(0, prefix.size(), prefix) == 0){
+                    tuneFile << iter->first.substr(prefix.size()) << " " << iter->second << endl;
+                }
+            }
+        }
+
+        bool WorkGroupTuner::getLocalSize(const string& deviceName, const string& kernelKey, size_t& localSize){
+            MutexRaii autoLock(&mutex);
+            loadDevice(deviceName);
+            unordered_map<string, size_t>::iterator iter = tunedSizes.find(deviceName + "|" + kernelKey);
+            if (iter == tunedSizes.end())
+                return false;
+            localSize = iter->second;
+            return true;
+        }
+
+        void WorkGroupTuner::setLocalSize(const string& deviceName, const string& kernelKey, size_t localSize){
+            MutexRaii autoLock(&mutex);
+            loadDevice(deviceName);
+            tunedSizes[deviceName + "|" + kernelKey] = localSize;
+            saveDevice(deviceName);
+        }
+
+    }
+}
+#endif
@@ -0,0 +1,91 @@
+#ifndef __WORK_GROUP_TUNER_H__
+#define __WORK_GROUP_TUNER_H__
+
+#ifdef _OPENCL
+
+#include <unordered_map>
+#include <unordered_set>
+#include <pthread.h>
+#include "core/util/Singleton.h"
+#include "typedefs.h"
+
+#define TUNING_FILE_SUFFIX "_workgroups.tune"
+
+namespace core{
+    namespace opencl{
+
+        /**
+         * Keeps best local work sizes found by benchmarking, per device and kernel.
+         * Results are stored in file <deviceName>_workgroups.tune (one "kernelKey localSize"
+         * pair per line) and loaded on first request for device.
+         * Class is Singleton
+         */
+        class WorkGroupTuner : public core::util::Singleton<WorkGroupTuner>{
+            friend class core::util::Singleton<WorkGroupTuner>;
+        private:
+            /**
+             * key is deviceName + "|" + kernelKey, value is tuned local work size
+             */
+            std::unordered_map<std::string, size_t> tunedSizes;
+            /**
+             * devices for which tuning file is already read
+             */
+            std::unordered_set<std::string> loadedDevices;
+            pthread_mutex_t mutex;
+            bool enabled;
+
+            /**
+             * @param deviceName
+             * @return
+             * path to tuning file of device
+             */
+            std::string getTuningFile(const std::string& deviceName);
+            /**
+             * reads tuning file of device, if exists
+             * @param deviceName
+             */
+            void loadDevice(const std::string& deviceName);
+            /**
+             * writes all tuned sizes of device to tuning file
+             * @param deviceName
+             */
+            void saveDevice(const std::string& deviceName);
+        protected:
+            WorkGroupTuner();
+            virtual ~WorkGroupTuner();
+        public:
+            /**
+             * @return
+             * value of general.openCL.TuneWorkGroupSizes
+             */
+            bool isEnabled();
+            /**
+             * get previously tuned local work size
+             * @param deviceName
+             * CL_DEVICE_NAME of device
+             * @param kernelKey
+             * unique kernel name (class name + kernel function name)
+             * @param localSize
+             * output, tuned size
+             * @return
+             * true if kernel is tuned for device
+             */
+            bool getLocalSize(const std::string& deviceName, const std::string& kernelKey, size_t& localSize);
+            /**
+             * store tuned local work size and persist it to device tuning file
+             * @param deviceName
+             * CL_DEVICE_NAME of device
+             * @param kernelKey
+             * unique kernel name (class name + kernel function name)
+             * @param localSize
+             * best local work size
+             */
+            void setLocalSize(const std::string& deviceName, const std::string& kernelKey, size_t localSize);
+        };
+
+    }
+}
+
+#endif
+
+#endif
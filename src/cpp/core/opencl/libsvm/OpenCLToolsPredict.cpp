@@ -2,33 +2,48 @@
 #include "OpenCLToolsPredict.h"
 #include "thirdparty/lib_svm/svm.h"
 #include "core/util/Matrix.h"
+#include "core/util/raii/RAIIS.h"
+#include <algorithm>
+#include <iostream>
 
 namespace core {
     namespace opencl {
         namespace libsvm {
 
             using namespace core::util;
+            using namespace core::util::raii;
+            using namespace core::util::prediction::svm;
             using namespace std;
             
+            vector<OpenCLToolsPredict*> OpenCLToolsPredict::instances;
+            pthread_mutex_t OpenCLToolsPredict::instancesMutex = PTHREAD_MUTEX_INITIALIZER;
+            
             OpenCLToolsPredict::OpenCLToolsPredict(): Singleton<OpenCLToolsPredict>(){
+                pthread_mutex_init(&stagedMutex, 0);
+                registered = false;
                 initVars();
             }
             
-            OpenCLToolsPredict::~OpenCLToolsPredict(){                
+            OpenCLToolsPredict::~OpenCLToolsPredict(){
+                if (registered){
+                    //waits for prepareModel which may use this instance
+                    MutexRaii autoLock(&instancesMutex);
+                    instances.erase(find(instances.begin(), instances.end(), this));
+                }
+                releaseModelBuffers();
+                pthread_mutex_destroy(&stagedMutex);
             }
             
             void OpenCLToolsPredict::initVars(){
                 OpenClBase::initVars();
                 
-                modelSVs        = 0;
-                clModelSVs      = 0;
-                clModelRHO      = 0;
-                clModelSVCoefs  = 0;
-                clModelLabel    = 0;
-                svCoefs         = 0;
-                clModelNsv      = 0;
-                modelRHOs       = 0;
-                modelChanged    = true;
+                uploaded.model.reset();
+                uploaded.svs        = 0;
+                uploaded.rho        = 0;
+                uploaded.svCoefs    = 0;
+                uploaded.label      = 0;
+                uploaded.nsv        = 0;
+                staged = uploaded;
                 
                 initWorkVars();
             }
@@ -41,36 +56,47 @@ namespace core {
             void OpenCLToolsPredict::cleanUp(){
                 OpenClBase::cleanUp();
                 
-                if (modelSVs)
-                    Delete(modelSVs);
-                if (clModelSVs){
-                    err = clReleaseMemObject(clModelSVs);
-                    err_check(err, "OpenclTools::cleanUp clModelSVs");
+                releaseModelBuffers();
+                
+                cleanWorkPart();
+                initVars();
+            }
+            
+            void OpenCLToolsPredict::releaseModelBuffers(ModelBuffers& buffers){
+                cl_int error;
+                if (buffers.svs){
+                    error = clReleaseMemObject(buffers.svs);
+                    err_check(error, "OpenclTools::cleanUp clModelSVs");
+                    buffers.svs = 0;
                 }
-                if (clModelRHO){
-                    err = clReleaseMemObject(clModelRHO);
-                    err_check(err, "OpenclTools::cleanUp clModelRHO");
+                if (buffers.rho){
+                    error = clReleaseMemObject(buffers.rho);
+                    err_check(error, "OpenclTools::cleanUp clModelRHO");
+                    buffers.rho = 0;
                 }
-                if (clModelSVCoefs){
-                    err = clReleaseMemObject(clModelSVCoefs);
-                    err_check(err, "OpenclTools::cleanUp clModelSVCoefs");
+                if (buffers.svCoefs){
+                    error = clReleaseMemObject(buffers.svCoefs);
+                    err_check(error, "OpenclTools::cleanUp clModelSVCoefs");
+                    buffers.svCoefs = 0;
                 }            
-                if (clModelLabel){
-                    err = clReleaseMemObject(clModelLabel);
-                    err_check(err, "OpenclTools::cleanUp clModelLabel");
+                if (buffers.label){
+                    error = clReleaseMemObject(buffers.label);
+                    err_check(error, "OpenclTools::cleanUp clModelLabel");
+                    buffers.label = 0;
                 }
-                if (svCoefs)
-                    Delete(svCoefs);
-                if (clModelNsv){
-                    err = clReleaseMemObject(clModelNsv);
-                    err_check(err, "OpenclTools::cleanUp clModelNsv");
+                if (buffers.nsv){
+                    error = clReleaseMemObject(buffers.nsv);
+                    err_check(error, "OpenclTools::cleanUp clModelNsv");
+                    buffers.nsv = 0;
                 }
-                if (modelRHOs)
-                    Delete(modelRHOs);
-                modelChanged = true;
-                
-                cleanWorkPart();
-                initVars();
+                //buffers created with CL_MEM_USE_HOST_PTR are released, packed data can go
+                buffers.model.reset();
+            }
+            
+            void OpenCLToolsPredict::releaseModelBuffers(){
+                releaseModelBuffers(uploaded);
+                MutexRaii autoLock(&stagedMutex);
+                releaseModelBuffers(staged);
             }
             
             void OpenCLToolsPredict::cleanWorkPart(){
@@ -86,57 +112,6 @@ namespace core {
                 initWorkVars();
             }
             
-            size_t getSVsWidth(svm_model* model) {
-                size_t maxWidth = 0;
-                for (int i = 0; i < model->l; i++) {
-                    size_t currWidth = 1;
-                    svm_node* node = model->SV[i];
-                    while (node->index != -1) {
-                        currWidth++;
-                        node++;
-                    }
-                    if (maxWidth < currWidth)
-                        maxWidth = currWidth;
-                }
-                return maxWidth;
-            }
-
-            Matrix<float>* convertSVs(svm_model* model) {
-                int height = model->l;
-                int width = getSVsWidth(model);
-                Matrix<float>* matrix = New Matrix<float>(width, height);
-                for (int i = 0; i < height; i++) {
-                    for (int j = 0; j < width; j++) {
-                        //(*matrix)[i][j].index = model->SV[i][j].index;
-                        (*matrix)[i][j] = model->SV[i][j].value;
-                        if (model->SV[i][j].index == -1)
-                            break;
-                    }
-                }
-                return matrix;
-            }
-
-            Matrix<cl_float>* convertSVCoefs(svm_model* model) {
-                int width = model->l;
-                int height = model->nr_class - 1;
-                Matrix<cl_float>* matrix = New Matrix<cl_float>(width, height);
-                for (int i = 0; i < height; i++) {
-                    for (int j = 0; j < width; j++) {
-                        (*matrix)[i][j] = model->sv_coef[i][j];
-                    }
-                }
-                return matrix;
-            }
-
-            cl_float* convertRHO(svm_model* model) {
-                int count = model->nr_class * (model->nr_class - 1) / 2;
-                cl_float* retVec = New cl_float[count];
-                for (int i = 0; i < count; i++) {
-                    retVec[i] = model->rho[i];
-                }
-                return retVec;
-            }
-
             size_t getDecValuesSize(svm_model* model) {
                 if (model->param.svm_type == ONE_CLASS || model->param.svm_type == EPSILON_SVR ||
                         model->param.svm_type == NU_SVR)
@@ -146,89 +121,118 @@ namespace core {
                 }
             }
 
-            void OpenCLToolsPredict::createBuffers(const Matrix<float>* parameters,
-                    svm_model* model) {
+            cl_mem_flags OpenCLToolsPredict::getInputFlags() throw (SDException&){
                 cl_device_type type;
                 clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof (cl_device_type), &type, 0);
-                int flag1, flag2;
                 if (type == CL_DEVICE_TYPE_GPU) {
-                    flag1 = CL_MEM_WRITE_ONLY;
-                    flag2 = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+                    return CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
                 } else if (type == CL_DEVICE_TYPE_CPU) {
-                    flag1 = CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR;
-                    flag2 = CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR;
+                    return CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR;
                 } else {
                     SDException exc(SHADOW_NOT_SUPPORTED_DEVICE, "Init buffers, currently not supported device");
                     throw exc;
                 }
+            }
+            
+            void OpenCLToolsPredict::createModelBuffers(shared_ptr<const SvmModelVersion> modelVersion,
+                    ModelBuffers& buffers) throw (SDException&) {
+                //may run on loader thread, so err member isn't used
+                cl_int error;
+                cl_mem_flags flag2 = getInputFlags();
+                //model arrays are dense already (for binary models directly mapped file), no conversion
+                int nrClass = modelVersion->getNrClass();
+                int l = modelVersion->getL();
+                size_t size = modelVersion->getSVsWidth() * l * sizeof (cl_float);
+                buffers.svs = clCreateBuffer(context, flag2, size, 
+                                            const_cast<float*>(modelVersion->getSVs()), &error);
+                err_check(error, "OpenclTools::createBuffersPredict clModelSVs");
 
-                size_t size = parameters->getWidth() * parameters->getHeight() * sizeof (cl_float);
-                cl_float* pNodes = parameters->getVec();
-                clPixelParameters = clCreateBuffer(context, flag2, size,
-                        pNodes, &err);
-                err_check(err, "OpenclTools::createBuffersPredict clPixelParameters");
-
-                if (modelChanged) {
-                    if (modelSVs != 0)
-                        Delete(modelSVs);
-                    modelSVs = convertSVs(model);
-                    size = modelSVs->getWidth() * model->l * sizeof (cl_float);
-                    if (clModelSVs) {
-                        err = clReleaseMemObject(clModelSVs);
-                        err_check(err, "OpenclTools::createBuffersPredict delete clModelSVs");
-                    }
-                    clModelSVs = clCreateBuffer(context, flag2, size, modelSVs->getVec(), &err);
-                    err_check(err, "OpenclTools::createBuffersPredict clModelSVs");
+                size = (nrClass - 1) * l * sizeof (cl_float);
+                buffers.svCoefs = clCreateBuffer(context, flag2, size, 
+                                                const_cast<float*>(modelVersion->getCoefs()), &error);
+                err_check(error, "OpenclTools::createBuffersPredict clModelSVCoefs");
 
-                    if (svCoefs)
-                        Delete(svCoefs);
-                    svCoefs = convertSVCoefs(model);
-                    size = (model->nr_class - 1) * (model->l) * sizeof (cl_float);
-                    if (clModelSVCoefs) {
-                        err = clReleaseMemObject(clModelSVCoefs);
-                        err_check(err, "OpenclTools::createBuffersPredict delete clModelSVCoefs");
-                    }
-                    clModelSVCoefs = clCreateBuffer(context, flag2, size, svCoefs->getVec(), &err);
-                    err_check(err, "OpenclTools::createBuffersPredict clModelSVCoefs");
+                size = modelVersion->getRHOCount() * sizeof (cl_float);
+                buffers.rho = clCreateBuffer(context, flag2, size, 
+                                            const_cast<float*>(modelVersion->getRHOs()), &error);
+                err_check(error, "OpenclTools::createBuffersPredict clModelRHO");
 
-                    int count = model->nr_class * (model->nr_class - 1) / 2;
-                    size = count * sizeof (cl_float);
-                    if (modelRHOs)
-                        Delete(modelRHOs);
-                    modelRHOs = convertRHO(model);
-                    if (clModelRHO) {
-                        err = clReleaseMemObject(clModelRHO);
-                        err_check(err, "OpenclTools::createBuffersPredict delete clModelRHO");
-                    }
-                    clModelRHO = clCreateBuffer(context, flag2, size, modelRHOs, &err);
-                    err_check(err, "OpenclTools::createBuffersPredict clModelRHO");
+                size = nrClass * sizeof (cl_int);
+                if (modelVersion->getLabels()) {
+                    buffers.label = clCreateBuffer(context, flag2, size, 
+                                                const_cast<int*>(modelVersion->getLabels()), &error);
+                    err_check(error, "OpenclTools::createBuffersPredict clModelLabel");
+                } else {
+                    buffers.label = clCreateBuffer(context, flag2, sizeof (cl_int), &dummyInt, &error);
+                    err_check(error, "OpenclTools::createBuffersPredict clModelLabel");
+                }
 
-                    size = model->nr_class * sizeof (cl_int);
-                    if (clModelLabel) {
-                        err = clReleaseMemObject(clModelLabel);
-                        err_check(err, "OpenclTools::createBuffersPredict delete clModelLabel");
+                size = nrClass * sizeof (cl_int);
+                if (modelVersion->getNSVs()) {
+                    buffers.nsv = clCreateBuffer(context, flag2, size, 
+                                                const_cast<int*>(modelVersion->getNSVs()), &error);
+                    err_check(error, "OpenclTools::createBuffersPredict clModelNsv");
+                } else {
+                    buffers.nsv = clCreateBuffer(context, flag2, sizeof (cl_int), &dummyInt, &error);
+                    err_check(error, "OpenclTools::createBuffersPredict clModelLabel");
+                }
+                buffers.model = modelVersion;
+            }
+            
+            void OpenCLToolsPredict::stageModel(shared_ptr<const SvmModelVersion> modelVersion) throw (SDException&){
+                ModelBuffers buffers;
+                buffers.svs = buffers.rho = buffers.svCoefs = buffers.label = buffers.nsv = 0;
+                try{
+                    createModelBuffers(modelVersion, buffers);
+                }
+                catch (SDException& exception){
+                    releaseModelBuffers(buffers);
+                    throw exception;
+                }
+                MutexRaii autoLock(&stagedMutex);
+                //model staged before and never used by predict
+                releaseModelBuffers(staged);
+                staged = buffers;
+            }
+            
+            void OpenCLToolsPredict::prepareModel(shared_ptr<const SvmModelVersion> modelVersion){
+                MutexRaii autoLock(&instancesMutex);
+                for (size_t i = 0; i < instances.size(); i++){
+                    try{
+                        instances[i]->stageModel(modelVersion);
                     }
-                    if (model->label) {
-                        clModelLabel = clCreateBuffer(context, flag2, size, (cl_int*) model->label, &err);
-                        err_check(err, "OpenclTools::createBuffersPredict clModelLabel");
-                    } else {
-                        clModelLabel = clCreateBuffer(context, flag2, sizeof (cl_int), &dummyInt, &err);
-                        err_check(err, "OpenclTools::createBuffersPredict clModelLabel");
+                    catch (SDException& exception){
+                        cout << exception.handleException() << endl;
                     }
+                }
+            }
+            
+            void OpenCLToolsPredict::createBuffers(const Matrix<float>* parameters,
+                    shared_ptr<const SvmModelVersion> modelVersion) {
+                cl_mem_flags flag2 = getInputFlags();
+                cl_mem_flags flag1 = CL_MEM_WRITE_ONLY;
+                if ((flag2 & CL_MEM_USE_HOST_PTR) != 0)
+                    flag1 |= CL_MEM_ALLOC_HOST_PTR;
 
-                    size = model->nr_class * sizeof (cl_int);
-                    if (clModelNsv) {
-                        err = clReleaseMemObject(clModelNsv);
-                        err_check(err, "OpenclTools::createBuffersPredict delete clModelNsv");
-                    }
-                    if (model->nSV) {
-                        clModelNsv = clCreateBuffer(context, flag2, size, (cl_int*) model->nSV, &err);
-                        err_check(err, "OpenclTools::createBuffersPredict clModelNsv");
-                    } else {
-                        clModelNsv = clCreateBuffer(context, flag2, sizeof (cl_int), &dummyInt, &err);
-                        err_check(err, "OpenclTools::createBuffersPredict clModelLabel");
+                size_t size = parameters->getWidth() * parameters->getHeight() * sizeof (cl_float);
+                cl_float* pNodes = parameters->getVec();
+                clPixelParameters = clCreateBuffer(context, flag2, size,
+                        pNodes, &err);
+                err_check(err, "OpenclTools::createBuffersPredict clPixelParameters");
+
+                if (uploaded.model != modelVersion) {
+                    releaseModelBuffers(uploaded);
+                    {
+                        MutexRaii autoLock(&stagedMutex);
+                        if (staged.model == modelVersion){
+                            uploaded = staged;
+                            staged.model.reset();
+                            staged.svs = staged.rho = staged.svCoefs = staged.label = staged.nsv = 0;
+                        }
                     }
-                    modelChanged = false;
+                    //model wasn't staged (first model, or instance created after loader ran)
+                    if (uploaded.model != modelVersion)
+                        createModelBuffers(modelVersion, uploaded);
                 }
 
                 size = parameters->getHeight() * sizeof (cl_uchar);
@@ -237,89 +241,101 @@ namespace core {
             }
 
             void OpenCLToolsPredict::setKernelArgs(uint pixelCount, uint paramsPerPixel,
-                    svm_model* model) {
+                    const SvmModelVersion& modelVersion) {
+                cl_int nrClass = modelVersion.getNrClass();
+                cl_int l = modelVersion.getL();
+                //free_sv of libsvm model only tells svm_free_model_content whether SVs are owned,
+                //kernel doesn't read it. 1 as for models from svm_load_model
+                cl_int freeSV = 1;
+                cl_int svmType = modelVersion.getSvmType();
+                cl_int kernelType = modelVersion.getKernelType();
+                cl_int degree = modelVersion.getDegree();
                 err = clSetKernelArg(kernel[0], 0, sizeof (cl_mem), &clPixelParameters);
                 err_check(err, "OpenclTools::setKernelArgsPredict clPixelParameters");
                 err = clSetKernelArg(kernel[0], 1, sizeof (cl_uint), &pixelCount);
                 err_check(err, "OpenclTools::setKernelArgsPredict pixelCount");
                 err = clSetKernelArg(kernel[0], 2, sizeof (cl_uint), &paramsPerPixel);
                 err_check(err, "OpenclTools::setKernelArgsPredict paramsPerPixel");
-                err = clSetKernelArg(kernel[0], 3, sizeof (cl_int), &model->nr_class);
+                err = clSetKernelArg(kernel[0], 3, sizeof (cl_int), &nrClass);
                 err_check(err, "OpenclTools::setKernelArgsPredict nr_class");
-                err = clSetKernelArg(kernel[0], 4, sizeof (cl_int), &model->l);
+                err = clSetKernelArg(kernel[0], 4, sizeof (cl_int), &l);
                 err_check(err, "OpenclTools::setKernelArgsPredict l");
-                int modelSvsWidth = modelSVs->getWidth();
+                int modelSvsWidth = modelVersion.getSVsWidth();
                 err = clSetKernelArg(kernel[0], 5, sizeof (cl_int), &modelSvsWidth);
                 err_check(err, "OpenclTools::setKernelArgsPredict svsWidth");
-                err = clSetKernelArg(kernel[0], 6, sizeof (cl_mem), &clModelSVs);
+                err = clSetKernelArg(kernel[0], 6, sizeof (cl_mem), &uploaded.svs);
                 err_check(err, "OpenclTools::setKernelArgsPredict clModelSVs");
-                err = clSetKernelArg(kernel[0], 7, sizeof (cl_mem), &clModelSVCoefs);
+                err = clSetKernelArg(kernel[0], 7, sizeof (cl_mem), &uploaded.svCoefs);
                 err_check(err, "OpenclTools::setKernelArgsPredict clModelSVCoefs");
-                err = clSetKernelArg(kernel[0], 8, sizeof (cl_mem), &clModelRHO);
+                err = clSetKernelArg(kernel[0], 8, sizeof (cl_mem), &uploaded.rho);
                 err_check(err, "OpenclTools::setKernelArgsPredict clModelRHO");
-                if (clModelLabel) {
-                    err = clSetKernelArg(kernel[0], 9, sizeof (cl_mem), &clModelLabel);
+                if (uploaded.label) {
+                    err = clSetKernelArg(kernel[0], 9, sizeof (cl_mem), &uploaded.label);
                     err_check(err, "OpenclTools::setKernelArgsPredict clModelLabel");
                 } else {
                     //                err = clSetKernelArg(kernel[0], 9, 0, 0);
                     //                err_check(err, "OpenclTools::setKernelArgsPredict clModelLabel", -1);
                 }
-                if (clModelNsv) {
-                    err = clSetKernelArg(kernel[0], 10, sizeof (cl_mem), &clModelNsv);
+                if (uploaded.nsv) {
+                    err = clSetKernelArg(kernel[0], 10, sizeof (cl_mem), &uploaded.nsv);
                     err_check(err, "OpenclTools::setKernelArgsPredict clModelNsv");
                 } else {
                     //                err = clSetKernelArg(kernel[0], 10, 0, 0);
                     //                err_check(err, "OpenclTools::setKernelArgsPredict clModelNsv", -1);
                 }
-                err = clSetKernelArg(kernel[0], 11, sizeof (cl_int), &model->free_sv);
+                err = clSetKernelArg(kernel[0], 11, sizeof (cl_int), &freeSV);
                 err_check(err, "OpenclTools::setKernelArgsPredict free_sv");
-                err = clSetKernelArg(kernel[0], 12, sizeof (cl_int), &model->param.svm_type);
+                err = clSetKernelArg(kernel[0], 12, sizeof (cl_int), &svmType);
                 err_check(err, "OpenclTools::setKernelArgsPredict param.svm_type");
-                err = clSetKernelArg(kernel[0], 13, sizeof (cl_int), &model->param.kernel_type);
+                err = clSetKernelArg(kernel[0], 13, sizeof (cl_int), &kernelType);
                 err_check(err, "OpenclTools::setKernelArgsPredict param.kernel_type");
-                err = clSetKernelArg(kernel[0], 14, sizeof (cl_int), &model->param.degree);
+                err = clSetKernelArg(kernel[0], 14, sizeof (cl_int), &degree);
                 err_check(err, "OpenclTools::setKernelArgsPredict param.degree");
-                cl_float gamma = model->param.gamma;
+                cl_float gamma = modelVersion.getGamma();
                 err = clSetKernelArg(kernel[0], 15, sizeof (cl_float), &gamma);
                 err_check(err, "OpenclTools::setKernelArgsPredict param.gamma");
-                cl_float coef0 = model->param.coef0;
+                cl_float coef0 = modelVersion.getCoef0();
                 err = clSetKernelArg(kernel[0], 16, sizeof (cl_float), &coef0);
                 err_check(err, "OpenclTools::setKernelArgsPredict param.coef0");
                 //====
                 err = clSetKernelArg(kernel[0], 17, sizeof (cl_mem), &clPredictResults);
                 err_check(err, "OpenclTools::setKernelArgsPredict clPredictResults");
                 //====
-                size_t size = model->nr_class * sizeof (cl_int) * workGroupSize[0];
+                size_t size = nrClass * sizeof (cl_int) * workGroupSize[0];
                 err = clSetKernelArg(kernel[0], 18, size, 0);
                 err_check(err, "OpenclTools::setKernelArgsPredict start");
 
-                size = model->nr_class * sizeof (cl_int) * workGroupSize[0];
+                size = nrClass * sizeof (cl_int) * workGroupSize[0];
                 err = clSetKernelArg(kernel[0], 19, size, 0);
                 err_check(err, "OpenclTools::setKernelArgsPredict vote");
             }
 
-            uchar* OpenCLToolsPredict::predict(svm_model* model, const Matrix<float>* parameters) {
+            uchar* OpenCLToolsPredict::predict(shared_ptr<const SvmModelVersion> model, const Matrix<float>* parameters) {
+                if (registered == false){
+                    //initialized now, so loader thread can upload next models
+                    MutexRaii autoLock(&instancesMutex);
+                    instances.push_back(this);
+                    registered = true;
+                }
                 createBuffers(parameters, model);
-                setKernelArgs(parameters->getHeight(), parameters->getWidth(), model);
+                setKernelArgs(parameters->getHeight(), parameters->getWidth(), *model);
 
-                size_t local_ws = workGroupSize[0];
                 int numValues = parameters->getHeight() * parameters->getWidth();
+                size_t local_ws = getLocalWorkSize(0, numValues);
                 size_t global_ws = shrRoundUp(local_ws, numValues);
-                err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
+                err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
                 err_check(err, "OpenclTools::predict clEnqueueNDRangeKernel");
+                profileKernel(0);
                 size_t size = parameters->getHeight() * sizeof(cl_uchar);
                 uchar* retVec = New uchar[parameters->getHeight()];
-                err = clEnqueueReadBuffer(command_queue, clPredictResults, CL_TRUE, 0, size, retVec, 0, NULL, NULL);
+                err = clEnqueueReadBuffer(command_queue, clPredictResults, CL_TRUE, 0, size, retVec, 0, NULL, profilingEvent());
                 err_check(err, "OpenclTools::predict clEnqueueReadBuffer");
+                profileTransfer(PROFILE_READ, size);
                 clFlush(command_queue);
                 clFinish(command_queue);
                 return retVec;
             }
 
-            void OpenCLToolsPredict::markModelChanged() {
-                modelChanged = true;
-            }
-            
             string OpenCLToolsPredict::getClassName(){
                 return string("core::opencl::libsvm::OpenCLToolsPredict");
             }
@@ -3,10 +3,12 @@
 
 #ifdef _OPENCL
 
+#include <memory>
+#include <vector>
+#include <pthread.h>
 #include "core/opencl/OpenClToolsBase.h"
 #include "core/util/Singleton.h"
-
-struct svm_model;
+#include "core/util/predicition/libsvm/SvmModelVersion.h"
 
 namespace core{
     
@@ -21,28 +23,71 @@ namespace core{
              */
             class OpenCLToolsPredict : public core::opencl::OpenClBase, public core::util::Singleton<OpenCLToolsPredict>{
                 friend class core::util::Singleton<OpenCLToolsPredict>;
+                friend class core::opencl::DeviceSession;
             private:
+                /**
+                 * model arrays of one model version on device
+                 */
+                struct ModelBuffers{
+                    /**
+                     * keeps packed host data alive while buffers may use it
+                     */
+                    std::shared_ptr<const core::util::prediction::svm::SvmModelVersion> model;
+                    cl_mem      svs;
+                    cl_mem      rho;
+                    cl_mem      svCoefs;
+                    cl_mem      label;
+                    cl_mem      nsv;
+                };
+                
                 cl_int          dummyInt;
                 
-                bool            modelChanged;            
+                /**
+                 * buffers of model used by predict
+                 */
+                ModelBuffers    uploaded;
+                /**
+                 * buffers of newer model uploaded by model loader thread (prepareModel),
+                 * taken by predict when it gets that model. Guarded by stagedMutex
+                 */
+                ModelBuffers    staged;
+                pthread_mutex_t stagedMutex;
+                bool            registered;
                 cl_mem          clPixelParameters;
-                core::util::Matrix<cl_float>*    modelSVs;
-                cl_mem          clModelSVs;
-                cl_mem          clModelRHO;
-                cl_mem          clModelSVCoefs;
-                cl_mem          clModelLabel;
-                core::util::Matrix<cl_float>*       svCoefs;
-                cl_mem          clModelNsv;
                 cl_mem          clPredictResults;
-                cl_float*       modelRHOs;
+                
                 /**
-                 * Creates OpenCL memory structures needs for overall process
+                 * instances which predicted at least once, model is uploaded to them in advance
+                 */
+                static std::vector<OpenCLToolsPredict*> instances;
+                static pthread_mutex_t instancesMutex;
+                
+                /**
+                 * Creates OpenCL memory structures needs for overall process,
+                 * model buffers are created again only when model version changes
                  * @param parameters
                  * Parameters for each pixel of image
                  * @param model
                  * Precalculated SVM prediction model
                  */
-                void createBuffers(const core::util::Matrix<float>* parameters, svm_model* model);
+                void createBuffers( const core::util::Matrix<float>* parameters, 
+                                    std::shared_ptr<const core::util::prediction::svm::SvmModelVersion> model);
+                /**
+                 * @return
+                 * memory flags of read only buffers with host data for device of this instance
+                 */
+                cl_mem_flags getInputFlags() throw (SDException&);
+                /**
+                 * create model buffers, safe to call from other thread than one using instance
+                 */
+                void createModelBuffers(std::shared_ptr<const core::util::prediction::svm::SvmModelVersion> model,
+                                        ModelBuffers& buffers) throw (SDException&);
+                void releaseModelBuffers(ModelBuffers& buffers);
+                void releaseModelBuffers();
+                /**
+                 * upload model to staged buffers, called on model loader thread
+                 */
+                void stageModel(std::shared_ptr<const core::util::prediction::svm::SvmModelVersion> model) throw (SDException&);
                 /**
                  * Passes parameters to OpenCL kernel function
                  * @param pixelCount
@@ -52,7 +97,8 @@ namespace core{
                  * @param model
                  * precalculated libsvm model
                  */
-                void setKernelArgs(uint pixelCount, uint paramsPerPixel, svm_model* model);                
+                void setKernelArgs(uint pixelCount, uint paramsPerPixel, 
+                                    const core::util::prediction::svm::SvmModelVersion& model);                
             protected:
                 /**
                  * constructor, please see base class constructor
@@ -93,11 +139,16 @@ namespace core{
                  * @return 
                  * predicted values for each pixel
                  */
-                uchar* predict( svm_model* model, const core::util::Matrix<float>* parameters);
+                uchar* predict( std::shared_ptr<const core::util::prediction::svm::SvmModelVersion> model, 
+                                const core::util::Matrix<float>* parameters);
                 /**
-                 * call when libsvm model is changed
+                 * upload model to devices of all instances used for prediction, called by
+                 * model loader thread before model is published, so first image on new model
+                 * doesn't wait for upload. Instance which can't stage model uploads it on first use
+                 * @param model
+                 * model version which will be published
                  */
-                void markModelChanged();
+                static void prepareModel(std::shared_ptr<const core::util::prediction::svm::SvmModelVersion> model);
             };
             
         }
@@ -2,6 +2,9 @@
 #include "thirdparty/lib_svm/svm.h"
 #include "core/util/Timer.h"
 #include "core/util/Matrix.h"
+#include "core/util/Config.h"
+#include <cstring>
+#include <cstdlib>
 
 #ifdef _OPENCL
 
@@ -27,13 +30,8 @@ namespace core {
             void OpenCLToolsTrain::initVars(){
                 OpenClBase::initVars();
                 
-                clY                 = 0;
-                clX                 = 0;            
-                clData              = 0;
-                newTask             = true;
-                newSelectWorkingSet = true;
-                clXSquared          = 0;
-                xMatrix             = 0;
+                deviceType          = 0;
+                prefetchRows        = -1;
 
                 durrData        = 0l;
                 durrBuff        = 0l;
@@ -41,442 +39,528 @@ namespace core {
                 durrReadBuff    = 0l;
                 durrSetSrgs     = 0l;            
 
-                clQD                = 0;
-                clAlphaStatus       = 0;
-                clYSelectWorkingSet = 0;
-                clG                 = 0;
-                                        
                 initWorkVars();
             }
             
             void OpenCLToolsTrain::initWorkVars(){
-                clGradDiff = 0;
-                clObjDiff = 0;                        
-                clQI = 0;
+                clQD                = 0;
+                clAlphaStatus       = 0;
+                clYSelectWorkingSet = 0;
+                clG                 = 0;
+                clQIJ               = 0;
+                clPartialValue      = 0;
+                clPartialIndex      = 0;
+                clPartialGmax2      = 0;
+                clSelectResult      = 0;
+                solverLen           = 0;
+
+                clY                 = 0;
+                clX                 = 0;            
+                clData              = 0;
+                clXSquared          = 0;
+                clRows              = 0;
+                clOrder             = 0;
+                xMatrix             = 0;
+                problemOwner        = 0;
+                problemLen          = 0;
+                activeKernelIndex   = 0;
+                rowCapacity         = 0;
+                rowsHost            = 0;
+                rowsIndex           = 0;
+                orderHost           = 0;
+                for (int i = 0; i < OCL_TRAIN_BATCHES; i++){
+                    batchEvent[i] = 0;
+                    batchSlot[i] = 0;
+                }
             }
             
             void OpenCLToolsTrain::cleanUp(){
+                //launched batches are waited for while command queue is alive
+                cleanWorkPart();
                 OpenClBase::cleanUp();
-                                
+
+                durrData = 0l;
+                durrBuff = 0l;
+                durrExec = 0l;
+                durrReadBuff = 0l;
+                durrSetSrgs = 0l;                   
+                
+                initVars();
+            }
+            
+            void OpenCLToolsTrain::cleanWorkPart(){
+                releaseSolverState();
+                releaseProblem();
+                
+                initWorkVars();
+            }
+
+            void OpenCLToolsTrain::releaseProblem(){
+                for (int i = 0; i < OCL_TRAIN_BATCHES; i++){
+                    if (batchEvent[i]){
+                        clWaitForEvents(1, &batchEvent[i]);
+                        clReleaseEvent(batchEvent[i]);
+                        batchEvent[i] = 0;
+                    }
+                }
+                if (clData){
+                    err = clReleaseMemObject(clData);
+                    err_check(err, "OpenCLToolsTrain::releaseProblem clReleaseMemObject clData");
+                }
                 if (clY){
                     err = clReleaseMemObject(clY);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clReleaseMemObject2");
+                    err_check(err, "OpenCLToolsTrain::releaseProblem clReleaseMemObject clY");
                 }
-
                 if (clX){
                     err = clReleaseMemObject(clX);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clReleaseMemObject3");
-                }
-
-                if (clData){
-                    err = clReleaseMemObject(clData);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clReleaseMemObject1");
+                    err_check(err, "OpenCLToolsTrain::releaseProblem clReleaseMemObject clX");
                 }
-
                 if (clXSquared){
                     err = clReleaseMemObject(clXSquared);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clReleaseMemObjectXSquared");
+                    err_check(err, "OpenCLToolsTrain::releaseProblem clReleaseMemObject clXSquared");
+                }
+                if (clRows){
+                    err = clReleaseMemObject(clRows);
+                    err_check(err, "OpenCLToolsTrain::releaseProblem clReleaseMemObject clRows");
+                }
+                if (clOrder){
+                    err = clReleaseMemObject(clOrder);
+                    err_check(err, "OpenCLToolsTrain::releaseProblem clReleaseMemObject clOrder");
                 }
-
                 if (xMatrix){
                     Delete(xMatrix);
-                }                        
-
-                if (clQD){
-                    clReleaseMemObject(clQD);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clQD");
                 }
-
-                if (clAlphaStatus){
-                    clReleaseMemObject(clAlphaStatus);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clAlphaStatus");
+                if (rowsHost){
+                    DeleteArr(rowsHost);
                 }
-
-                if (clYSelectWorkingSet){
-                    clReleaseMemObject(clYSelectWorkingSet);
-                    err_check(err, "OpenCLToolsTrain::cleanUp clYSelectWorkingSet");
+                if (rowsIndex){
+                    DeleteArr(rowsIndex);
                 }
-
-                if (clG){
-                    clReleaseMemObject(clG);
-                    err_check(err, "OpenCLToolsTrain::cleanWorkPart clG");
-                } 
-
-                durrData = 0l;
-                durrBuff = 0l;
-                durrExec = 0l;
-                durrReadBuff = 0l;
-                durrSetSrgs = 0l;                   
-                
-                cleanWorkPart();
-                initVars();
-            }
-            
-            void OpenCLToolsTrain::cleanWorkPart(){
-                if (clGradDiff){
-                    clReleaseMemObject(clGradDiff);
-                    err_check(err, "OpenCLToolsTrain::cleanWorkPart clGradDiff");
+                if (orderHost){
+                    DeleteArr(orderHost);
                 }
-                if (clObjDiff){
-                    clReleaseMemObject(clObjDiff);
-                    err_check(err, "OpenCLToolsTrain::cleanWorkPart clObjDiff");
+                clData = clY = clX = clXSquared = clRows = clOrder = 0;
+                problemOwner = 0;
+                problemLen = 0;
+            }
+
+            cl_device_type OpenCLToolsTrain::getDeviceType() throw (SDException&){
+                if (deviceType == 0){
+                    err = clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof (cl_device_type), &deviceType, 0);
+                    err_check(err, "OpenCLToolsTrain::getDeviceType clGetDeviceInfo");
+                    if ((deviceType & (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)) == 0){
+                        deviceType = 0;
+                        SDException exc(SHADOW_NOT_SUPPORTED_DEVICE, "Init buffers, currently not supported device");
+                        throw exc;
+                    }
                 }
-                if (clQI){
-                    clReleaseMemObject(clQI);
-                    err_check(err, "OpenCLToolsTrain::cleanWorkPart clQI");
+                return deviceType;
+            }
+
+            int OpenCLToolsTrain::getPrefetchRows(){
+                if (prefetchRows < 0){
+                    prefetchRows = OCL_DEFAULT_PREFETCH_ROWS;
+                    const string* val = Config::getInstancePtr()->getSnapshot()->find("general.Training.svm.openCLPrefetchRows");
+                    if (val != 0 && *val != "")
+                        prefetchRows = max(0, atoi(val->c_str()));
                 }
-                
-                initWorkVars();
+                return prefetchRows;
             }
             
-            
-            void OpenCLToolsTrain::get_Q(float* data, int dataLen, int start, int len, int i, int kernel_type,
-                    char* y, int yLen, Matrix<svm_node>* x, LIBSVM_CLASS_TYPE classType,
-                    double gamma, double coef0, int degree, double *xSquared) throw (SDException) {
+            bool OpenCLToolsTrain::hasProblem(const void* owner){
+                return owner != 0 && problemOwner == owner;
+            }
+
+            void OpenCLToolsTrain::setProblem(const void* owner, Matrix<svm_node>* x, const int* order,
+                    const double* xSquared, const char* y, LIBSVM_CLASS_TYPE classType,
+                    int kernel_type, double gamma, double coef0, int degree) throw (SDException&){
                 Timer time;
+                releaseProblem();
+                problemLen = x->getHeight();
+                rowCapacity = 1 + getPrefetchRows();
+                activeKernelIndex = classType == SVC_Q_TYPE ? 0 : 1;
+                createBuffersSVM(x, order, xSquared, y);
+                durrBuff += time.sinceLastCheck();
+                setKernelArgsSVM(kernel_type, x->getWidth(), gamma, coef0, degree);
+                problemOwner = owner;
+                durrSetSrgs += time.sinceLastCheck();
+            }
 
-                //bool diffX = xDif(x, xX, xY);
-                durrData += time.sinceLastCheck();
-                int steps = len - start;
-                bool clDataChaned = false;
-                createBuffersSVM(data, dataLen, i, y, yLen, x, start, steps,
-                        clDataChaned, xSquared);
+            void OpenCLToolsTrain::setOrder(const int* order) throw (SDException&){
+                Timer time;
+                //blocking, solver swaps order while previous batches may still run
+                size_t size = sizeof (cl_int) * problemLen;
+                memcpy(orderHost, order, size);
+                err = clEnqueueWriteBuffer(command_queue, clOrder, CL_TRUE, 0, size, orderHost, 0, 0, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::setOrder clEnqueueWriteBuffer clOrder");
+                profileTransfer(PROFILE_WRITE, size);
                 durrBuff += time.sinceLastCheck();
-                size_t local_ws;
-                cl_kernel activeKernel;
-                if (classType == SVC_Q_TYPE) {
-                    setKernelArgsSVC(start, len, i, kernel_type, x->getWidth(), dataLen, gamma,
-                            coef0, degree, clDataChaned);
-                    local_ws = workGroupSize[0];
-                    activeKernel = kernel[0];
-                } else {
-                    setKernelArgsSVR(start, len, i, kernel_type, x->getWidth(), dataLen, gamma,
-                            coef0, degree, clDataChaned);
-                    local_ws = workGroupSize[1];
-                    activeKernel = kernel[1];
+            }
+
+            void OpenCLToolsTrain::enqueueRows(int batch, const int* rows, int rowNum, int start, int len) throw (SDException&){
+                Timer time;
+                int slot = batch == OCL_DEMAND_BATCH ? 0 : 1;
+                if (batchEvent[batch] != 0 || rowNum <= 0 || slot + rowNum > rowCapacity || start >= len){
+                    SDException exc(SHADOW_OUT_OF_BOUNDS, "OpenCLToolsTrain::enqueueRows");
+                    throw exc;
                 }
+                batchSlot[batch] = slot;
+                memcpy(rowsIndex + slot, rows, sizeof (cl_int) * rowNum);
+                durrData += time.sinceLastCheck();
+                err = clEnqueueWriteBuffer(command_queue, clRows, CL_FALSE, sizeof (cl_int) * slot,
+                        sizeof (cl_int) * rowNum, rowsIndex + slot, 0, 0, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::enqueueRows clEnqueueWriteBuffer clRows");
+                profileTransfer(PROFILE_WRITE, sizeof (cl_int) * rowNum);
+                durrBuff += time.sinceLastCheck();
+
+                cl_kernel activeKernel = kernel[activeKernelIndex];
+                cl_int clStart = start;
+                cl_int clLen = len;
+                cl_int clSlot = slot;
+                err = clSetKernelArg(activeKernel, 2, sizeof (cl_int), &clStart);
+                err_check(err, "OpenCLToolsTrain::enqueueRows clSetKernelArgSTART");
+                err = clSetKernelArg(activeKernel, 3, sizeof (cl_int), &clLen);
+                err_check(err, "OpenCLToolsTrain::enqueueRows clSetKernelArgLEN");
+                err = clSetKernelArg(activeKernel, 5, sizeof (cl_int), &clSlot);
+                err_check(err, "OpenCLToolsTrain::enqueueRows clSetKernelArgROWOFFSET");
+                int steps = len - start;
+                size_t local_ws[2] = {getLocalWorkSize(activeKernelIndex, steps), 1};
+                size_t global_ws[2] = {shrRoundUp(local_ws[0], steps), (size_t)rowNum};
                 durrSetSrgs += time.sinceLastCheck();
-                size_t global_ws = shrRoundUp(local_ws, steps);
-                err = clEnqueueNDRangeKernel(command_queue, activeKernel, 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
-                err_check(err, "OpenCLToolsTrain::get_Q clEnqueueNDRangeKernelSVM1");
-                durrExec += time.sinceLastCheck();
-                size_t size = steps * sizeof (float); //dataLen
-                cl_device_type type;
-                err = clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof (cl_device_type), &type, 0);
-                err_check(err, "OpenCLToolsTrain::get_Q clGetDeviceInfo");
-                if (type == CL_DEVICE_TYPE_GPU) {
-                    err = clEnqueueReadBuffer(command_queue, clData, CL_FALSE, start * sizeof (cl_float), size, data + start, 0, NULL, NULL);
-                    err_check(err, "OpenCLToolsTrain::get_Q clEnqueueReadBuffer");
+
+                err = clEnqueueNDRangeKernel(command_queue, activeKernel, 2, NULL, global_ws, local_ws, 0, NULL, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::enqueueRows clEnqueueNDRangeKernel");
+                profileKernel(activeKernelIndex);
+                if (getDeviceType() == CL_DEVICE_TYPE_GPU) {
+                    for (int r = 0; r < rowNum; r++){
+                        size_t offset = (size_t)(slot + r) * problemLen + start;
+                        err = clEnqueueReadBuffer(command_queue, clData, CL_FALSE, sizeof (cl_float) * offset,
+                                sizeof (cl_float) * steps, rowsHost + offset, 0, NULL, profilingEvent());
+                        err_check(err, "OpenCLToolsTrain::enqueueRows clEnqueueReadBuffer");
+                        profileTransfer(PROFILE_READ, sizeof (cl_float) * steps);
+                    }
                 }
+                err = clEnqueueMarkerWithWaitList(command_queue, 0, NULL, &batchEvent[batch]);
+                err_check(err, "OpenCLToolsTrain::enqueueRows clEnqueueMarkerWithWaitList");
                 err = clFlush(command_queue);
-                err |= clFinish(command_queue);
-                err_check(err, "OpenCLToolsTrain::get_Q clFlush clFinish");
-                newTask = false;
+                err_check(err, "OpenCLToolsTrain::enqueueRows clFlush");
+                durrExec += time.sinceLastCheck();
+            }
+
+            bool OpenCLToolsTrain::isLaunched(int batch){
+                return batchEvent[batch] != 0;
+            }
+
+            const float* OpenCLToolsTrain::waitRows(int batch) throw (SDException&){
+                Timer time;
+                if (batchEvent[batch] == 0){
+                    SDException exc(SHADOW_OUT_OF_BOUNDS, "OpenCLToolsTrain::waitRows");
+                    throw exc;
+                }
+                err = clWaitForEvents(1, &batchEvent[batch]);
+                err |= clReleaseEvent(batchEvent[batch]);
+                batchEvent[batch] = 0;
+                err_check(err, "OpenCLToolsTrain::waitRows clWaitForEvents");
                 durrReadBuff += time.sinceLastCheck();
+                return rowsHost + (size_t)batchSlot[batch] * problemLen;
             }
 
-            Matrix<double>* getValuesFromNodes(Matrix<svm_node>& nodes) {
+            Matrix<double>* getValuesFromNodes(Matrix<svm_node>& nodes, const int* order) {
                 Matrix<double>* retMat = New Matrix<double>(nodes.getWidth(), nodes.getHeight());
                 for (int i = 0; i < nodes.getHeight(); i++) {
                     for (int j = 0; j < nodes.getWidth(); j++) {
-                        (*retMat)[i][j] = nodes[i][j].value;
+                        (*retMat)[order[i]][j] = nodes[i][j].value;
                     }
                 }
                 return retMat;
             }
 
-            void OpenCLToolsTrain::createBuffersSVM(float* data, int dataLen, int i,
-                    char* y, int yLen, Matrix<svm_node>* x,
-                    int start, int steps, bool& clDataChanged,
-                    double* xSquared) {
-                bool xChanged = x->changedValues();
-                int flag1, flag2;
-                cl_device_type type;
-                err = clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof (cl_device_type), &type, 0);
-                err_check(err, "OpenCLToolsTrain::createBuffersSVM clGetDeviceInfo");
-                if (type == CL_DEVICE_TYPE_GPU) {
-                    flag1 = CL_MEM_WRITE_ONLY;
-                    flag2 = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
-                } else if (type == CL_DEVICE_TYPE_CPU) {
-                    flag1 = CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR;
-                    flag2 = CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR;
-                } else {
-                    SDException exc(SHADOW_NOT_SUPPORTED_DEVICE, "Init buffers, currently not supported device");
-                    throw exc;
-                }
-                //====DATA section
-                clDataChanged = false;
-                if (type == CL_DEVICE_TYPE_GPU) {
-                    if (clData == 0 || (clData != 0 && clDataLen < dataLen)) {
-                        if (clData != 0) {
-                            err = clReleaseMemObject(clData);
-                            err_check(err, "OpenCLToolsTrain::createBuffersSVM clReleaseMemObjectCLDATA");
-                        }
-                        clData = clCreateBuffer(context, flag1, sizeof (cl_float) * dataLen, 0, &err);
-                        err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLDATA");
-                        clDataChanged = true;
-                    } else {
-                        err = clEnqueueWriteBuffer(command_queue, clData, CL_FALSE,
-                                start, sizeof (cl_float) * steps,
-                                (cl_float*) (data + start), 0, 0, 0);
-                        err_check(err, "OpenCLToolsTrain::createBuffersSVM clWriteBufferCLDATA");
-                    }
+            void OpenCLToolsTrain::createBuffersSVM(Matrix<svm_node>* x, const int* order,
+                    const double* xSquared, const char* y) throw (SDException&) {
+                int outFlag, inFlag = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+                size_t rowsSize = (size_t)rowCapacity * problemLen;
+                rowsHost = New float[rowsSize];
+                rowsIndex = New int[rowCapacity];
+                orderHost = New int[problemLen];
+                memcpy(orderHost, order, sizeof (int) * problemLen);
+                //on cpu device kernel writes directly to host rows
+                if (getDeviceType() == CL_DEVICE_TYPE_GPU) {
+                    outFlag = CL_MEM_WRITE_ONLY;
+                    clData = clCreateBuffer(context, outFlag, sizeof (cl_float) * rowsSize, 0, &err);
                 } else {
-                    if (clData != 0) {
-                        err = clReleaseMemObject(clData);
-                        err_check(err, "OpenCLToolsTrain::createBuffersSVM clReleaseMemObjectCLDATA");
-                    }
-                    clData = clCreateBuffer(context, flag1, sizeof (cl_float) * dataLen, data, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLDATA");
-                    clDataChanged = true;
+                    outFlag = CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR;
+                    clData = clCreateBuffer(context, outFlag, sizeof (cl_float) * rowsSize, rowsHost, &err);
                 }
-                clDataLen = dataLen;
-                //====
-                //====Y section
-                //dimension and pointer of y never changes for one task, so can do like this
-                if (clY == 0 && y != 0) {
-                    clY = clCreateBuffer(context, flag2, sizeof (cl_char) * yLen, (cl_char*) y, &err);
+                err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLDATA");
+                clRows = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof (cl_int) * rowCapacity, 0, &err);
+                err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLROWS");
+                clOrder = clCreateBuffer(context, inFlag, sizeof (cl_int) * problemLen, orderHost, &err);
+                err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLORDER");
+                //device keeps original order, so swaps of solver don't touch these buffers
+                xMatrix = getValuesFromNodes(*x, order);
+                size_t size = sizeof (cl_double) * x->getWidth() * x->getHeight();
+                clX = clCreateBuffer(context, inFlag, size, (cl_double*) xMatrix->getVec(), &err);
+                err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLX");
+                if (y != 0) {
+                    char* yOriginal = New char[problemLen];
+                    for (int i = 0; i < problemLen; i++)
+                        yOriginal[order[i]] = y[i];
+                    clY = clCreateBuffer(context, inFlag, sizeof (cl_char) * problemLen, yOriginal, &err);
+                    DeleteArr(yOriginal);
                     err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLY");
-                } else if (y != 0) {
-                    if (xChanged) {
-                        if (type == CL_DEVICE_TYPE_GPU) {
-                            err = clEnqueueWriteBuffer(command_queue, clY, CL_FALSE, 0,
-                                    sizeof (cl_char) * yLen, (cl_char*) y, 0, 0, 0);
-                            err_check(err, "OpenCLToolsTrain::createBuffersSVM clEnqueueWriteBufferCLY");
-                        }
-                    }
-                } else {
-                    clY = 0;
                 }
-                //====
-                //====X section
-                //dimensions of x never changes for one task, so can do like this
-                if (clX == 0 && x != 0) {
-                    size_t size = sizeof (cl_double) * x->getWidth() * x->getHeight();
-                    if (xMatrix)
-                        Delete(xMatrix);
-                    xMatrix = getValuesFromNodes(*x);
-                    clX = clCreateBuffer(context, flag2, size, (cl_double*) xMatrix->getVec(), &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLX");
-                } else if (x != 0) {
-                    if (xChanged) {
-                        if (xMatrix)
-                            Delete(xMatrix);
-                        xMatrix = getValuesFromNodes(*x);
-                        size_t size = sizeof (cl_double) * x->getWidth() * x->getHeight();
-                        err = clEnqueueWriteBuffer(command_queue, clX, CL_FALSE,
-                                0, size, (cl_double*) xMatrix->getVec(), 0, 0, 0);
-                        err_check(err, "OpenCLToolsTrain::createBuffersSVM clEnqueueWriteBufferCLX");
-                    }
-                } else {
-                    clX = 0;
-                }
-                //====
-                //==== x squared section
-                if (clXSquared == 0 && xSquared != 0) {
-                    size_t size = sizeof (cl_double) * x->getHeight();
-                    clXSquared = clCreateBuffer(context, flag2, size, (cl_double*) xSquared, &err);
+                if (xSquared != 0) {
+                    double* xSquaredOriginal = New double[problemLen];
+                    for (int i = 0; i < problemLen; i++)
+                        xSquaredOriginal[order[i]] = xSquared[i];
+                    clXSquared = clCreateBuffer(context, inFlag, sizeof (cl_double) * problemLen, xSquaredOriginal, &err);
+                    DeleteArr(xSquaredOriginal);
                     err_check(err, "OpenCLToolsTrain::createBuffersSVM clCreateBufferCLXSQUARED");
-                } else if (xSquared != 0) {
-                    if (type == CL_DEVICE_TYPE_GPU) {
-                        //if x changed then xsquared is changed too
-                        if (xChanged) {
-                            size_t size = sizeof (cl_double) * x->getHeight();
-                            err = clEnqueueWriteBuffer(command_queue, clXSquared, CL_FALSE,
-                                    0, size, (cl_double*) xSquared, 0, 0, 0);
-                            err_check(err, "OpenCLToolsTrain::createBuffersSVM clEnqueueWriteBufferCLXSQUARED");
-                        }
-                    }
-                } else {
-                    clXSquared = 0;
                 }
-                //====            
             }
 
-            void OpenCLToolsTrain::setKernelArgsSVC(cl_int start, cl_int len, cl_int i,
-                    cl_int kernel_type, cl_int xW, cl_int dataLen,
-                    cl_double gamma, cl_double coef0, cl_int degree,
-                    bool clDataChanged) {
-                if (clDataChanged) {
-                    err = clSetKernelArg(kernel[0], 0, sizeof (cl_mem), &clData);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVC setKernelArgsCLDATA");
+            void OpenCLToolsTrain::setKernelArgsSVM(cl_int kernel_type, cl_int xW, cl_double gamma,
+                    cl_double coef0, cl_int degree) {
+                cl_kernel activeKernel = kernel[activeKernelIndex];
+                //svrQgetQ has no y argument
+                int shift = activeKernelIndex == 0 ? 0 : -1;
+                cl_int dataLen = problemLen;
+                err = clSetKernelArg(activeKernel, 0, sizeof (cl_mem), &clData);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM setKernelArgCLDATA");
+                err = clSetKernelArg(activeKernel, 1, sizeof (cl_int), &dataLen);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgDATALEN");
+                err = clSetKernelArg(activeKernel, 4, sizeof (cl_mem), &clRows);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgROWS");
+                err = clSetKernelArg(activeKernel, 6, sizeof (cl_int), &kernel_type);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgKERNEL_TYPE");
+                if (activeKernelIndex == 0) {
+                    err = clSetKernelArg(activeKernel, 7, sizeof (cl_mem), &clY);
+                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVM setKernelArgCLY");
                 }
-                err = clSetKernelArg(kernel[0], 1, sizeof (cl_int), &dataLen);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgDATALEN");
-                err = clSetKernelArg(kernel[0], 2, sizeof (cl_int), &start);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgSTART");
-                err = clSetKernelArg(kernel[0], 3, sizeof (cl_int), &len);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgLEN");
-                err = clSetKernelArg(kernel[0], 4, sizeof (cl_int), &i);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgI");
-                err = clSetKernelArg(kernel[0], 5, sizeof (cl_int), &kernel_type);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgKERNEL_TYPE");
-                if (newTask) {
-                    err = clSetKernelArg(kernel[0], 6, sizeof (cl_mem), &clY);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVC setKernelArgCLY");
-                    err = clSetKernelArg(kernel[0], 7, sizeof (cl_mem), &clX);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVC setKernelArgCLX");
-                    err = clSetKernelArg(kernel[0], 12, sizeof (cl_mem), &clXSquared);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgCLXSQUARED");
-                }
-                err = clSetKernelArg(kernel[0], 8, sizeof (cl_int), &xW);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgXW");
-                err = clSetKernelArg(kernel[0], 9, sizeof (cl_double), &gamma);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgGAMMA");
-                err = clSetKernelArg(kernel[0], 10, sizeof (cl_double), &coef0);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgCOEF0");
-                err = clSetKernelArg(kernel[0], 11, sizeof (cl_int), &degree);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVC clSetKernelArgDEGREE");
+                err = clSetKernelArg(activeKernel, 8 + shift, sizeof (cl_mem), &clX);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM setKernelArgCLX");
+                err = clSetKernelArg(activeKernel, 9 + shift, sizeof (cl_int), &xW);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgXW");
+                err = clSetKernelArg(activeKernel, 10 + shift, sizeof (cl_double), &gamma);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgGAMMA");
+                err = clSetKernelArg(activeKernel, 11 + shift, sizeof (cl_double), &coef0);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgCOEF0");
+                err = clSetKernelArg(activeKernel, 12 + shift, sizeof (cl_int), &degree);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgDEGREE");
+                err = clSetKernelArg(activeKernel, 13 + shift, sizeof (cl_mem), &clXSquared);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgCLXSQUARED");
+                err = clSetKernelArg(activeKernel, 14 + shift, sizeof (cl_mem), &clOrder);
+                err_check(err, "OpenCLToolsTrain::setKernelArgsSVM clSetKernelArgCLORDER");
             }
 
-            void OpenCLToolsTrain::setKernelArgsSVR(cl_int start, cl_int len, cl_int i,
-                    cl_int kernel_type, cl_int xW, cl_int dataLen,
-                    cl_double gamma, cl_double coef0, cl_int degree,
-                    bool clDataChanged) {
-                if (clDataChanged) {
-                    err = clSetKernelArg(kernel[1], 0, sizeof (cl_mem), &clData);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVR setKernelArgCLDATA");
-                }
-                err = clSetKernelArg(kernel[1], 1, sizeof (cl_int), &dataLen);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgDATALEN");
-                err = clSetKernelArg(kernel[1], 2, sizeof (cl_int), &start);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgSTART");
-                err = clSetKernelArg(kernel[1], 3, sizeof (cl_int), &len);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgLEN");
-                err = clSetKernelArg(kernel[1], 4, sizeof (cl_int), &i);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgI");
-                err = clSetKernelArg(kernel[1], 5, sizeof (cl_int), &kernel_type);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgKERNEL_TYPE");
-                if (newTask) {
-                    err = clSetKernelArg(kernel[1], 6, sizeof (cl_mem), &clX);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVR setKernelArgCLX");
-                    err = clSetKernelArg(kernel[1], 11, sizeof (cl_mem), &clXSquared);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgCLXSQUARED");
+            bool OpenCLToolsTrain::useDeviceSolver(int l){
+                if (l < OCL_DEVICE_SOLVER_MIN_SIZE)
+                    return false;
+                const string* val = Config::getInstancePtr()->getSnapshot()->find("general.Training.svm.openCLWorkingSet");
+                return val == 0 || val->compare("false") != 0;
+            }
+
+            void OpenCLToolsTrain::releaseSolverState(){
+                cl_mem* buffers[] = {&clAlphaStatus, &clYSelectWorkingSet, &clG, &clQD, &clQIJ,
+                                    &clPartialValue, &clPartialIndex, &clPartialGmax2, &clSelectResult};
+                for (size_t i = 0; i < sizeof (buffers) / sizeof (cl_mem*); i++){
+                    if (*buffers[i]){
+                        err = clReleaseMemObject(*buffers[i]);
+                        err_check(err, "OpenCLToolsTrain::releaseSolverState clReleaseMemObject");
+                        *buffers[i] = 0;
+                    }
                 }
-                err = clSetKernelArg(kernel[1], 7, sizeof (cl_int), &xW);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgXW");
-                err = clSetKernelArg(kernel[1], 8, sizeof (cl_double), &gamma);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgGAMMA");
-                err = clSetKernelArg(kernel[1], 9, sizeof (cl_double), &coef0);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgCOEF0");
-                err = clSetKernelArg(kernel[1], 10, sizeof (cl_int), &degree);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsSVR clSetKernelArgDEGREE");
+                solverLen = 0;
             }
 
-            void OpenCLToolsTrain::selectWorkingSet(const int& activeSize, const int& i, const char* y,
-                    const char* alpha_status, const int& l, double* grad_diff,
-                    const double& Gmax, const double* G, const double* QD,
-                    const float* Q_i, double* obj_diff) throw (SDException) {
-                createBuffersWorkingSet(activeSize, grad_diff, obj_diff, alpha_status,
-                        l, y, G, QD, Q_i);
-                setKernelArgsWorkingSet(activeSize, i, Gmax);
+            void OpenCLToolsTrain::setSelectionArgs(int kernelIndex, int firstPartialArg, size_t localSize) throw (SDException&){
+                cl_kernel selectKernel = kernel[kernelIndex];
+                err = clSetKernelArg(selectKernel, firstPartialArg, sizeof (cl_mem), &clPartialValue);
+                err_check(err, "OpenCLToolsTrain::setSelectionArgs clSetKernelArg partialValue");
+                err = clSetKernelArg(selectKernel, firstPartialArg + 1, sizeof (cl_mem), &clPartialIndex);
+                err_check(err, "OpenCLToolsTrain::setSelectionArgs clSetKernelArg partialIndex");
+                err = clSetKernelArg(selectKernel, firstPartialArg + 2, sizeof (cl_mem), &clPartialGmax2);
+                err_check(err, "OpenCLToolsTrain::setSelectionArgs clSetKernelArg partialGmax2");
+                err = clSetKernelArg(selectKernel, firstPartialArg + 3, sizeof (cl_double) * localSize, NULL);
+                err_check(err, "OpenCLToolsTrain::setSelectionArgs clSetKernelArg localValue");
+                err = clSetKernelArg(selectKernel, firstPartialArg + 4, sizeof (cl_int) * localSize, NULL);
+                err_check(err, "OpenCLToolsTrain::setSelectionArgs clSetKernelArg localIndex");
+                err = clSetKernelArg(selectKernel, firstPartialArg + 5, sizeof (cl_double) * localSize, NULL);
+                err_check(err, "OpenCLToolsTrain::setSelectionArgs clSetKernelArg localGmax2");
+            }
 
-                size_t local_ws = workGroupSize[2];
-                size_t global_ws = shrRoundUp(local_ws, activeSize);
-                err = clEnqueueNDRangeKernel(command_queue, kernel[2], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
-                err_check(err, "clEnqueueNDRangeKernelSELECTWORKINGSET");
-
-                cl_device_type type;
-                err = clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof (cl_device_type), &type, 0);
-                err_check(err, "OpenCLToolsTrain::selectWorkingSet clGetDeviceInfo");
-                if (type == CL_DEVICE_TYPE_GPU) {
-                    size_t size = sizeof (cl_double) * activeSize;
-                    err = clEnqueueReadBuffer(command_queue, clGradDiff, CL_FALSE, 0, size, grad_diff, 0, NULL, NULL);
-                    err_check(err, "OpenCLToolsTrain::selectWorkingSet clEnqueueReadBufferclGradDiff");
-                    err = clEnqueueReadBuffer(command_queue, clObjDiff, CL_FALSE, 0, size, obj_diff, 0, NULL, NULL);
-                    err_check(err, "OpenCLToolsTrain::selectWorkingSet clEnqueueReadBufferclObjDiff");
+            void OpenCLToolsTrain::setSolverState(int l, const char* y, const char* alpha_status,
+                    const double* G, const double* QD) throw (SDException&){
+                Timer time;
+                //blocking writes, solver changes host arrays right after
+                if (clG != 0 && solverLen == l){
+                    err = clEnqueueWriteBuffer(command_queue, clYSelectWorkingSet, CL_TRUE, 0, sizeof (cl_char) * l, y, 0, 0, profilingEvent());
+                    err_check(err, "OpenCLToolsTrain::setSolverState clEnqueueWriteBuffer clYSelectWorkingSet");
+                    profileTransfer(PROFILE_WRITE, sizeof (cl_char) * l);
+                    err = clEnqueueWriteBuffer(command_queue, clAlphaStatus, CL_TRUE, 0, sizeof (cl_char) * l, alpha_status, 0, 0, profilingEvent());
+                    err_check(err, "OpenCLToolsTrain::setSolverState clEnqueueWriteBuffer clAlphaStatus");
+                    profileTransfer(PROFILE_WRITE, sizeof (cl_char) * l);
+                    err = clEnqueueWriteBuffer(command_queue, clG, CL_TRUE, 0, sizeof (cl_double) * l, G, 0, 0, profilingEvent());
+                    err_check(err, "OpenCLToolsTrain::setSolverState clEnqueueWriteBuffer clG");
+                    profileTransfer(PROFILE_WRITE, sizeof (cl_double) * l);
+                    err = clEnqueueWriteBuffer(command_queue, clQD, CL_TRUE, 0, sizeof (cl_double) * l, QD, 0, 0, profilingEvent());
+                    err_check(err, "OpenCLToolsTrain::setSolverState clEnqueueWriteBuffer clQD");
+                    profileTransfer(PROFILE_WRITE, sizeof (cl_double) * l);
+                    durrBuff += time.sinceLastCheck();
+                    return;
                 }
-                err = clFlush(command_queue);
-                err |= clFinish(command_queue);
-                err_check(err, "OpenCLToolsTrain::get_Q clFlush clFinish");
-                newSelectWorkingSet = false;
+                
+                releaseSolverState();
+                int flag = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+                clYSelectWorkingSet = clCreateBuffer(context, flag, sizeof (cl_char) * l, (cl_char*) y, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clYSelectWorkingSet");
+                clQD = clCreateBuffer(context, flag, sizeof (cl_double) * l, (cl_double*) QD, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clQD");
+                flag = CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR;
+                clAlphaStatus = clCreateBuffer(context, flag, sizeof (cl_char) * l, (cl_char*) alpha_status, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clAlphaStatus");
+                clG = clCreateBuffer(context, flag, sizeof (cl_double) * l, (cl_double*) G, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clG");
+                clQIJ = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof (cl_float) * 2 * l, 0, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clQIJ");
+                //one partial result per work group, work group has at least one item
+                clPartialValue = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof (cl_double) * l, 0, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clPartialValue");
+                clPartialIndex = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof (cl_int) * l, 0, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clPartialIndex");
+                clPartialGmax2 = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof (cl_double) * l, 0, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clPartialGmax2");
+                clSelectResult = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof (cl_double) * 4, 0, &err);
+                err_check(err, "OpenCLToolsTrain::setSolverState clSelectResult");
+                solverLen = l;
+                durrBuff += time.sinceLastCheck();
+
+                //kernel 2 selectWorkingSet, 3 selectMaxViolating, 4 reduceSelectionGroups, 5 updateGradient
+                err = clSetKernelArg(kernel[3], 1, sizeof (cl_mem), &clYSelectWorkingSet);
+                err |= clSetKernelArg(kernel[3], 2, sizeof (cl_mem), &clAlphaStatus);
+                err |= clSetKernelArg(kernel[3], 3, sizeof (cl_mem), &clG);
+                err_check(err, "OpenCLToolsTrain::setSolverState clSetKernelArg selectMaxViolating");
+                err = clSetKernelArg(kernel[2], 3, sizeof (cl_mem), &clYSelectWorkingSet);
+                err |= clSetKernelArg(kernel[2], 4, sizeof (cl_mem), &clAlphaStatus);
+                err |= clSetKernelArg(kernel[2], 5, sizeof (cl_mem), &clG);
+                err |= clSetKernelArg(kernel[2], 6, sizeof (cl_mem), &clQD);
+                err |= clSetKernelArg(kernel[2], 7, sizeof (cl_mem), &clQIJ);
+                err_check(err, "OpenCLToolsTrain::setSolverState clSetKernelArg selectWorkingSet");
+                err = clSetKernelArg(kernel[4], 1, sizeof (cl_mem), &clG);
+                err |= clSetKernelArg(kernel[4], 2, sizeof (cl_mem), &clSelectResult);
+                err_check(err, "OpenCLToolsTrain::setSolverState clSetKernelArg reduceSelectionGroups");
+                cl_int qLen = l;
+                err = clSetKernelArg(kernel[5], 1, sizeof (cl_mem), &clG);
+                err |= clSetKernelArg(kernel[5], 2, sizeof (cl_mem), &clQIJ);
+                err |= clSetKernelArg(kernel[5], 3, sizeof (cl_int), &qLen);
+                err |= clSetKernelArg(kernel[5], 6, sizeof (cl_mem), &clAlphaStatus);
+                err_check(err, "OpenCLToolsTrain::setSolverState clSetKernelArg updateGradient");
+                //local memory for largest work group, tuning can launch kernels with it
+                setSelectionArgs(2, 8, workGroupSize[2]);
+                setSelectionArgs(3, 4, workGroupSize[3]);
+                setSelectionArgs(4, 3, workGroupSize[4]);
+                durrSetSrgs += time.sinceLastCheck();
             }
 
-            void OpenCLToolsTrain::createBuffersWorkingSet(const int& activeSize, double* grad_diff,
-                    double* obj_diff, const char* alpha_status,
-                    const int& l, const char* y, const double* G,
-                    const double* QD, const float* Q_i) {
-                int flag1, flag2;
-                cl_device_type type;
-                err = clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof (cl_device_type), &type, 0);
-                err_check(err, "OpenCLToolsTrain::createBuffersSVM clGetDeviceInfo");
-                if (type == CL_DEVICE_TYPE_GPU) {
-                    flag1 = CL_MEM_WRITE_ONLY;
-                    flag2 = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
-                } else if (type == CL_DEVICE_TYPE_CPU) {
-                    flag1 = CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR;
-                    flag2 = CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR;
-                } else {
-                    SDException exc(SHADOW_NOT_SUPPORTED_DEVICE, "Init buffers, currently not supported device");
-                    throw exc;
-                }
+            void OpenCLToolsTrain::getGradient(double* G, int activeSize) throw (SDException&){
+                Timer time;
                 size_t size = sizeof (cl_double) * activeSize;
-                if (type == CL_DEVICE_TYPE_GPU) {
-                    clGradDiff = clCreateBuffer(context, flag1, size, 0, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clGradDiff");
-                    clObjDiff = clCreateBuffer(context, flag1, size, 0, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clGradDiff");
-                } else if (type == CL_DEVICE_TYPE_CPU) {
-                    clGradDiff = clCreateBuffer(context, flag1, size, grad_diff, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clGradDiff");
-                    clObjDiff = clCreateBuffer(context, flag1, size, obj_diff, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clGradDiff");
-                }
-                size = sizeof (cl_char) * l;
-                if (clAlphaStatus == 0) {
-                    clAlphaStatus = clCreateBuffer(context, flag2, size, (cl_char*) alpha_status, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clAlphaStatus");
-                    clYSelectWorkingSet = clCreateBuffer(context, flag2, size, (cl_char*) y, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clYSelectWorkingSet");
-                    size = sizeof (cl_double) * l;
-                    clG = clCreateBuffer(context, flag2, size, (cl_double*) G, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clG");
-                } else {
-                    err = clEnqueueWriteBuffer(command_queue, clAlphaStatus, CL_FALSE, 0, size, alpha_status, 0, 0, 0);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clEnqueueWriteBuffer clAlphaStatus");
-                    err = clEnqueueWriteBuffer(command_queue, clYSelectWorkingSet, CL_FALSE, 0, size, y, 0, 0, 0);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clEnqueueWriteBuffer clYSelectWorkingSet");
-                    size = sizeof (cl_double) * l;
-                    err = clEnqueueWriteBuffer(command_queue, clG, CL_FALSE, 0, size, G, 0, 0, 0);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clEnqueueWriteBuffer clG");
-                }
+                err = clEnqueueReadBuffer(command_queue, clG, CL_TRUE, 0, size, G, 0, NULL, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::getGradient clEnqueueReadBuffer clG");
+                profileTransfer(PROFILE_READ, size);
+                durrReadBuff += time.sinceLastCheck();
+            }
 
-                size = sizeof (cl_float) * activeSize;
-                clQI = clCreateBuffer(context, flag2, size, (cl_float*) Q_i, &err);
-                err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clQI");
-                if (newSelectWorkingSet) {
-                    size = sizeof (cl_double) * l;
-                    clQD = clCreateBuffer(context, flag2, size, (cl_double*) QD, &err);
-                    err_check(err, "OpenCLToolsTrain::createBuffersWorkingSet clQD");
-                }
+            void OpenCLToolsTrain::runSelection(int kernelIndex, int firstPartialArg, int activeSize, double* result) throw (SDException&){
+                Timer time;
+                size_t local_ws = getLocalWorkSize(kernelIndex, activeSize);
+                setSelectionArgs(kernelIndex, firstPartialArg, local_ws);
+                size_t global_ws = shrRoundUp(local_ws, activeSize);
+                cl_int groups = global_ws / local_ws;
+                //second stage isn't tuned, it is one work group of maximal size
+                size_t reduce_ws = workGroupSize[4];
+                setSelectionArgs(4, 3, reduce_ws);
+                err = clSetKernelArg(kernel[4], 0, sizeof (cl_int), &groups);
+                err_check(err, "OpenCLToolsTrain::runSelection clSetKernelArg groups");
+                durrSetSrgs += time.sinceLastCheck();
+                
+                err = clEnqueueNDRangeKernel(command_queue, kernel[kernelIndex], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::runSelection clEnqueueNDRangeKernel first stage");
+                profileKernel(kernelIndex);
+                err = clEnqueueNDRangeKernel(command_queue, kernel[4], 1, NULL, &reduce_ws, &reduce_ws, 0, NULL, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::runSelection clEnqueueNDRangeKernel second stage");
+                profileKernel(4);
+                durrExec += time.sinceLastCheck();
+                err = clEnqueueReadBuffer(command_queue, clSelectResult, CL_TRUE, 0, sizeof (cl_double) * 4, result, 0, NULL, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::runSelection clEnqueueReadBuffer");
+                profileTransfer(PROFILE_READ, sizeof (cl_double) * 4);
+                durrReadBuff += time.sinceLastCheck();
             }
 
-            void OpenCLToolsTrain::setKernelArgsWorkingSet(const int& activeSize, const int& i,
-                    const double& Gmax) {
-                err = clSetKernelArg(kernel[2], 0, sizeof (cl_int), &activeSize);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgACTIVESIZE");
-                err = clSetKernelArg(kernel[2], 1, sizeof (cl_int), &i);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgI");
-                if (newSelectWorkingSet) {
-                    err = clSetKernelArg(kernel[2], 2, sizeof (cl_mem), &clYSelectWorkingSet);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClYSelectWorkingSet");
-                    err = clSetKernelArg(kernel[2], 3, sizeof (cl_mem), &clAlphaStatus);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClAlphaStatus");
-                }
-                err = clSetKernelArg(kernel[2], 4, sizeof (cl_mem), &clGradDiff);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClGradDiff");
-                err = clSetKernelArg(kernel[2], 5, sizeof (cl_double), &Gmax);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgGmax");
-                if (newSelectWorkingSet) {
-                    err = clSetKernelArg(kernel[2], 6, sizeof (cl_mem), &clG);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClG");
-                    err = clSetKernelArg(kernel[2], 7, sizeof (cl_mem), &clQD);
-                    err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClQD");
-                }
-                err = clSetKernelArg(kernel[2], 8, sizeof (cl_mem), &clQI);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClQI");
-                err = clSetKernelArg(kernel[2], 9, sizeof (cl_mem), &clObjDiff);
-                err_check(err, "OpenCLToolsTrain::setKernelArgsWorkingSet setKernelArgClObjDiff");
+            void OpenCLToolsTrain::selectMaxViolating(int activeSize, int& i, double& Gmax, double& G_i) throw (SDException&){
+                cl_int size = activeSize;
+                err = clSetKernelArg(kernel[3], 0, sizeof (cl_int), &size);
+                err_check(err, "OpenCLToolsTrain::selectMaxViolating clSetKernelArg activeSize");
+                double result[4];
+                runSelection(3, 4, activeSize, result);
+                Gmax = result[0];
+                i = (int) result[1];
+                G_i = result[3];
+            }
+
+            void OpenCLToolsTrain::selectWorkingSet(int activeSize, int i, double Gmax, const float* Q_i,
+                    int& j, double& Gmax2, double& G_j) throw (SDException&){
+                Timer time;
+                //blocking, cache can move row in next get_Q
+                size_t size = sizeof (cl_float) * activeSize;
+                err = clEnqueueWriteBuffer(command_queue, clQIJ, CL_TRUE, 0, size, Q_i, 0, 0, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::selectWorkingSet clEnqueueWriteBuffer Q_i");
+                profileTransfer(PROFILE_WRITE, size);
+                durrBuff += time.sinceLastCheck();
+                cl_int clActiveSize = activeSize;
+                cl_int clI = i;
+                cl_double clGmax = Gmax;
+                err = clSetKernelArg(kernel[2], 0, sizeof (cl_int), &clActiveSize);
+                err |= clSetKernelArg(kernel[2], 1, sizeof (cl_int), &clI);
+                err |= clSetKernelArg(kernel[2], 2, sizeof (cl_double), &clGmax);
+                err_check(err, "OpenCLToolsTrain::selectWorkingSet clSetKernelArg");
+                double result[4];
+                runSelection(2, 8, activeSize, result);
+                j = (int) result[1];
+                Gmax2 = result[2];
+                G_j = result[3];
+            }
+
+            void OpenCLToolsTrain::updateGradient(int activeSize, int i, int j, const float* Q_j,
+                    double deltaI, double deltaJ, char statusI, char statusJ) throw (SDException&){
+                Timer time;
+                size_t size = sizeof (cl_float) * activeSize;
+                err = clEnqueueWriteBuffer(command_queue, clQIJ, CL_TRUE, sizeof (cl_float) * solverLen, size, Q_j, 0, 0, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::updateGradient clEnqueueWriteBuffer Q_j");
+                profileTransfer(PROFILE_WRITE, size);
+                durrBuff += time.sinceLastCheck();
+                cl_int clActiveSize = activeSize, clI = i, clJ = j;
+                cl_double clDeltaI = deltaI, clDeltaJ = deltaJ;
+                cl_char clStatusI = statusI, clStatusJ = statusJ;
+                err = clSetKernelArg(kernel[5], 0, sizeof (cl_int), &clActiveSize);
+                err |= clSetKernelArg(kernel[5], 4, sizeof (cl_double), &clDeltaI);
+                err |= clSetKernelArg(kernel[5], 5, sizeof (cl_double), &clDeltaJ);
+                err |= clSetKernelArg(kernel[5], 7, sizeof (cl_int), &clI);
+                err |= clSetKernelArg(kernel[5], 8, sizeof (cl_int), &clJ);
+                err |= clSetKernelArg(kernel[5], 9, sizeof (cl_char), &clStatusI);
+                err |= clSetKernelArg(kernel[5], 10, sizeof (cl_char), &clStatusJ);
+                err_check(err, "OpenCLToolsTrain::updateGradient clSetKernelArg");
+                //not tuned, repeated launches of benchmark would change G
+                size_t local_ws = workGroupSize[5];
+                size_t global_ws = shrRoundUp(local_ws, activeSize);
+                durrSetSrgs += time.sinceLastCheck();
+                //next selection is queued after update, no wait needed
+                err = clEnqueueNDRangeKernel(command_queue, kernel[5], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
+                err_check(err, "OpenCLToolsTrain::updateGradient clEnqueueNDRangeKernel");
+                profileKernel(5);
+                err = clFlush(command_queue);
+                err_check(err, "OpenCLToolsTrain::updateGradient clFlush");
+                durrExec += time.sinceLastCheck();
             }
 
         }
@@ -8,6 +8,24 @@
 
 struct svm_node;
 
+/**
+ * rows needed by solver now, launched one at a time
+ */
+#define OCL_DEMAND_BATCH 0
+/**
+ * rows solver will probably need, computed while solver works
+ */
+#define OCL_PREFETCH_BATCH 1
+#define OCL_TRAIN_BATCHES 2
+/**
+ * prefetch batch size when general.Training.svm.openCLPrefetchRows isn't set
+ */
+#define OCL_DEFAULT_PREFETCH_ROWS 8
+/**
+ * smaller problems select working set on host, device round trips cost more than scans
+ */
+#define OCL_DEVICE_SOLVER_MIN_SIZE 4096
+
 namespace core{
     
     namespace util{
@@ -17,104 +35,122 @@ namespace core{
     namespace opencl{
         namespace libsvm{
             /**
-             * Class for parallelized libsvm calculations
+             * Class for parallelized libsvm calculations.
+             * Training matrix, labels and squared norms are uploaded once per problem in
+             * original order and stay on device, solver swaps only change order buffer
+             * which maps solver index to original row. Q rows are computed in batches,
+             * one launch per batch, and read back asynchronously, so prefetch batch can be
+             * computed while solver updates gradient.
+             * Solver state (G, alpha_status, y, QD) can be kept on device too, working set
+             * is then selected by two stage reductions and G is updated on device, only
+             * selected indices and scalars are read back
              */
             class OpenCLToolsTrain : public core::opencl::OpenClBase, public core::util::Singleton<OpenCLToolsTrain>{
                 friend class core::util::Singleton<OpenCLToolsTrain>;
             private:
+                /**
+                 * rowCapacity rows of problemLen floats, demand row is in slot 0,
+                 * prefetch rows follow it
+                 */
                 cl_mem clData;
-                int clDataLen;
                 cl_mem clY;
                 cl_mem clX;
-                cl_mem clXSquared;            
-                bool newTask;
-                bool newSelectWorkingSet;
+                cl_mem clXSquared;
+                cl_mem clRows;
+                cl_mem clOrder;
                 core::util::Matrix<double>* xMatrix;
+                /**
+                 * queried once, 0 until first use
+                 */
+                cl_device_type deviceType;
+                /**
+                 * kernel matrix which uploaded current problem
+                 */
+                const void* problemOwner;
+                int problemLen;
+                int activeKernelIndex;
+                /**
+                 * general.Training.svm.openCLPrefetchRows, -1 until read
+                 */
+                int prefetchRows;
+                int rowCapacity;
+                /**
+                 * host copy of clData and clRows
+                 */
+                float* rowsHost;
+                int* rowsIndex;
+                int* orderHost;
+                /**
+                 * completion of batch, 0 if batch isn't launched
+                 */
+                cl_event batchEvent[OCL_TRAIN_BATCHES];
+                int batchSlot[OCL_TRAIN_BATCHES];
 
-                cl_mem clGradDiff;
-                cl_mem clObjDiff;
+                //solver state
                 cl_mem clAlphaStatus;
                 cl_mem clYSelectWorkingSet;
                 cl_mem clG;
                 cl_mem clQD;
-                cl_mem clQI;
+                /**
+                 * Q_i and Q_j of selected pair, Q_j at solverLen
+                 */
+                cl_mem clQIJ;
+                /**
+                 * results of work groups of first selection stage
+                 */
+                cl_mem clPartialValue;
+                cl_mem clPartialIndex;
+                cl_mem clPartialGmax2;
+                /**
+                 * value, index, Gmax2, G[index] of selection
+                 */
+                cl_mem clSelectResult;
+                int solverLen;
                 
                 /**
-                 * Creates openCL memory structures used in process
-                 * @param data
-                 * @param dataLen
-                 * @param i
-                 * @param y
-                 * @param yLen
+                 * @return
+                 * type of used device, queried on first call
+                 */
+                cl_device_type getDeviceType() throw (SDException&);
+                /**
+                 * Creates openCL memory structures of problem, x, y and xSquared are
+                 * scattered to original order first
                  * @param x
-                 * @param start
-                 * @param steps
-                 * @param clDataChanged
+                 * @param order
                  * @param xSquared
+                 * @param y
                  */
-                void createBuffersSVM(  float* data, int dataLen, int i,
-                                    char* y, int yLen,
-                                    core::util::Matrix<svm_node>* x,
-                                    int start, int steps, bool& clDataChanged,
-                                    double* xSquared);
+                void createBuffersSVM(core::util::Matrix<svm_node>* x, const int* order,
+                                    const double* xSquared, const char* y) throw (SDException&);
                 /**
-                 * Passes parameters to OpenCL kernel function, for svc calculations
-                 * @param start
-                 * @param len
-                 * @param i
+                 * Passes parameters which don't change during problem to OpenCL kernel function
                  * @param kernel_type
                  * @param xW
-                 * @param dataLen
                  * @param gamma
                  * @param coef0
                  * @param degree
-                 * @param clDataChanged
                  */
-                void setKernelArgsSVC( cl_int start, cl_int len, cl_int i, 
-                                        cl_int kernel_type, cl_int xW, cl_int dataLen,
-                                        cl_double gamma, cl_double coef0, cl_int degree,
-                                        bool clDataChanged);
+                void setKernelArgsSVM(  cl_int kernel_type, cl_int xW, cl_double gamma,
+                                        cl_double coef0, cl_int degree);
                 /**
-                 * passes parameters to OpenCL kernel function for svr calculations
-                 * @param start
-                 * @param len
-                 * @param i
-                 * @param kernel_type
-                 * @param xW
-                 * @param dataLen
-                 * @param gamma
-                 * @param coef0
-                 * @param degree
-                 * @param clDataChanged
+                 * release problem buffers and wait for launched batches
                  */
-                void setKernelArgsSVR(  cl_int start, cl_int len, cl_int i, 
-                                        cl_int kernel_type, cl_int xW, cl_int dataLen,
-                                        cl_double gamma, cl_double coef0, cl_int degree,
-                                        bool clDataChanged); 
+                void releaseProblem();
                 /**
-                 * creates openCL memory structures used in working set part parallelization
-                 * @param activeSize
-                 * @param grad_diff
-                 * @param obj_diff
-                 * @param alpha_status
-                 * @param l
-                 * @param y
-                 * @param G
-                 * @param QD
-                 * @param Q_i
+                 * launch first stage kernel (arguments up to partial results must be set)
+                 * over activeSize instances and second stage over its work groups
+                 * @param kernelIndex
+                 * first stage kernel
+                 * @param firstPartialArg
+                 * index of partialValue argument, partial results and local memory follow it
+                 * @param result
+                 * 4 values, see clSelectResult
                  */
-                void createBuffersWorkingSet(const int& activeSize, double* grad_diff,
-                                            double* obj_diff, const char* alpha_status, 
-                                            const int& l, const char* y, const double* G,
-                                            const double* QD, const float* Q_i);
+                void runSelection(int kernelIndex, int firstPartialArg, int activeSize, double* result) throw (SDException&);
                 /**
-                 * Passes parameters to OpenCL kernel function
-                 * @param activeSize
-                 * @param i
-                 * @param Gmax
+                 * set partial result and local memory arguments of selection kernel
                  */
-                void setKernelArgsWorkingSet(const int& activeSize, const int& i,
-                                            const double& Gmax);
+                void setSelectionArgs(int kernelIndex, int firstPartialArg, size_t localSize) throw (SDException&);
                 
             protected:
                 /**
@@ -145,47 +181,134 @@ namespace core{
                  */
                 virtual void cleanUp();
                 /**
-                 * Clean variables needed for one iteration
+                 * Clean variables needed for one iteration, releases uploaded problem
                  */
                 virtual void cleanWorkPart();
                 /**
-                 * parallel get_Q libsvm function
-                 * @param data
-                 * @param dataLen
-                 * @param start
-                 * @param len
-                 * @param i
-                 * @param kernel_type
-                 * @param y
-                 * @param yLen
+                 * Uploads problem, replaces problem of other owner
+                 * @param owner
+                 * kernel matrix which computes rows of problem
                  * @param x
+                 * instances in solver order
+                 * @param order
+                 * original row of each instance
+                 * @param xSquared
+                 * squared norms in solver order, 0 if not RBF kernel
+                 * @param y
+                 * labels in solver order, 0 for SVR_Q_TYPE
                  * @param classType
+                 * @param kernel_type
                  * @param gamma
                  * @param coef0
                  * @param degree
-                 * @param xSquared
                  */
-                void get_Q( float* data, int dataLen, int start, int len, int i, int kernel_type, 
-                        char* y, int yLen, core::util::Matrix<svm_node>* x, LIBSVM_CLASS_TYPE classType,
-                        double gamma, double coef0, int degree, double *xSquared) throw (SDException);
+                void setProblem(const void* owner, core::util::Matrix<svm_node>* x, const int* order,
+                                const double* xSquared, const char* y, LIBSVM_CLASS_TYPE classType,
+                                int kernel_type, double gamma, double coef0, int degree) throw (SDException&);
                 /**
-                 * parallel working set part function
-                 * @param activeSize
-                 * @param i
+                 * @return
+                 * true if problem of owner is on device
+                 */
+                bool hasProblem(const void* owner);
+                /**
+                 * upload order after solver swapped instances
+                 */
+                void setOrder(const int* order) throw (SDException&);
+                /**
+                 * @return
+                 * maximal number of rows in prefetch batch, 0 disables prefetch
+                 */
+                int getPrefetchRows();
+                /**
+                 * launch computation of Q rows, batch must not be launched already
+                 * @param batch
+                 * OCL_DEMAND_BATCH (one row) or OCL_PREFETCH_BATCH (up to getPrefetchRows() rows)
+                 * @param rows
+                 * solver indices of rows
+                 * @param rowNum
+                 * @param start
+                 * first computed column
+                 * @param len
+                 * end of computed columns
+                 */
+                void enqueueRows(int batch, const int* rows, int rowNum, int start, int len) throw (SDException&);
+                /**
+                 * @return
+                 * true if batch was launched and its rows weren't taken by waitRows
+                 */
+                bool isLaunched(int batch);
+                /**
+                 * wait for batch
+                 * @return
+                 * rows of batch, row r of batch at r * problem size, valid until batch is launched again
+                 */
+                const float* waitRows(int batch) throw (SDException&);
+                /**
+                 * @param l
+                 * problem size
+                 * @return
+                 * true if solver should keep its state on device,
+                 * general.Training.svm.openCLWorkingSet and size not smaller than OCL_DEVICE_SOLVER_MIN_SIZE
+                 */
+                bool useDeviceSolver(int l);
+                /**
+                 * upload whole solver state, creates buffers on first call for solver
+                 * @param l
                  * @param y
                  * @param alpha_status
-                 * @param l
-                 * @param grad_diff
-                 * @param Gmax
                  * @param G
                  * @param QD
+                 */
+                void setSolverState(int l, const char* y, const char* alpha_status,
+                                    const double* G, const double* QD) throw (SDException&);
+                /**
+                 * read G of active instances
+                 * @param G
+                 * @param activeSize
+                 */
+                void getGradient(double* G, int activeSize) throw (SDException&);
+                /**
+                 * select i: maximal -y_i G_i in I_up
+                 * @param activeSize
+                 * @param i
+                 * -1 if I_up is empty
+                 * @param Gmax
+                 * @param G_i
+                 */
+                void selectMaxViolating(int activeSize, int& i, double& Gmax, double& G_i) throw (SDException&);
+                /**
+                 * select j for i, second order working set selection
+                 * @param activeSize
+                 * @param i
+                 * @param Gmax
                  * @param Q_i
-                 * @param obj_diff
+                 * activeSize values of Q row i
+                 * @param j
+                 * -1 if no j decreases objective
+                 * @param Gmax2
+                 * maximal y_j G_j in I_low, for stopping condition
+                 * @param G_j
+                 */
+                void selectWorkingSet(int activeSize, int i, double Gmax, const float* Q_i,
+                                    int& j, double& Gmax2, double& G_j) throw (SDException&);
+                /**
+                 * G += Q_i deltaI + Q_j deltaJ on device and set alpha status of pair,
+                 * Q_i is one passed to selectWorkingSet
+                 * @param activeSize
+                 * @param i
+                 * @param j
+                 * @param Q_j
+                 * @param deltaI
+                 * @param deltaJ
+                 * @param statusI
+                 * @param statusJ
+                 */
+                void updateGradient(int activeSize, int i, int j, const float* Q_j,
+                                    double deltaI, double deltaJ, char statusI, char statusJ) throw (SDException&);
+                /**
+                 * release solver state buffers
                  */
-                void selectWorkingSet(  const int& activeSize, const int& i, const char* y,
-                                        const char* alpha_status, const int& l, double* grad_diff,
-                                        const double& Gmax, const double* G, const double* QD, 
-                                        const float* Q_i, double* obj_diff) throw (SDException);
+                void releaseSolverState();
 
                 int64_t durrData;
                 int64_t durrSetSrgs;
@@ -1,4 +1,5 @@
-//!!!!!STILL NOT FUNCTIONAL DON"T USE IT !!!!!\\
+//kernels of libsvm training (OpenCLToolsTrain): rows of Q matrix for SVC and SVR
+//problems and, for device resident solver, working set selection and gradient update
 
 #pragma OPENCL EXTENSION cl_khr_fp64: enable
 
@@ -68,7 +69,7 @@ double kernel_precomputed(const int i, const int j, __global const double* x, co
     return x[i * xW + jIndex];
 }
 
-float svrQgetQ_f(const int len, const int i, const int kernel_type,
+float svrQgetQ_f(const int i, const int kernel_type,
                 __global const double* x, const int xW, const double gamma,
                 const double coef0, const int degree, __global double* x_square, 
                 const int index){
@@ -93,7 +94,7 @@ float svrQgetQ_f(const int len, const int i, const int kernel_type,
     return retVal;
 }
 
-float svcQgetQ_f(const int len, const int i, const int kernel_type, 
+float svcQgetQ_f(const int i, const int kernel_type, 
                 __global const char* y, __global const double* x, const int xW,
                 double gamma, double coef0, int degree, __global double* x_square,
                 const int index){
@@ -118,30 +119,35 @@ float svcQgetQ_f(const int len, const int i, const int kernel_type,
     return res;
 }
 
+//x, y and x_square stay in order of training set, order maps solver index to it.
+//dimension 0 is column in [start, len), dimension 1 is row rows[rowOffset + r],
+//which is written to data[(rowOffset + r) * dataLen]
 __kernel void svcQgetQ( __global float* data, const int dataLen, const int start, 
-                        const int len, const int i, const int kernel_type, 
-                        __global const char* y, __global const double* x, const int xW,
-                        double gamma, double coef0, int degree, __global double* x_square)
+                        const int len, __global const int* rows, const int rowOffset,
+                        const int kernel_type, __global const char* y,
+                        __global const double* x, const int xW, double gamma,
+                        double coef0, int degree, __global double* x_square,
+                        __global const int* order)
 {  
-    
-    const int index = get_global_id(0);
-    const int realIndex = index + start;    
-    if (realIndex < dataLen){        
-        data[realIndex] = svcQgetQ_f(len, i, kernel_type, y, x, xW, gamma, 
-                                    coef0, degree, x_square, realIndex);
+    const int realIndex = get_global_id(0) + start;
+    const int row = rowOffset + get_global_id(1);
+    if (realIndex < len){
+        data[row * dataLen + realIndex] = svcQgetQ_f(order[rows[row]], kernel_type, y, x, xW, 
+                                                    gamma, coef0, degree, x_square, order[realIndex]);
     }
 }
 
 __kernel void svrQgetQ (__global float* data, const int dataLen, const int start, 
-                        const int len, const int i, const int kernel_type,
-                         __global const double* x, const int xW, const double gamma,
-                        const double coef0, const int degree, __global double* x_square)
+                        const int len, __global const int* rows, const int rowOffset,
+                        const int kernel_type, __global const double* x, const int xW,
+                        const double gamma, const double coef0, const int degree,
+                        __global double* x_square, __global const int* order)
 {    
-    const int index = get_global_id(0);
-    const int realIndex = index + start;    
-    if (realIndex < dataLen){
-        data[realIndex] = svrQgetQ_f(len, i, kernel_type, x, xW, gamma,
-                                    coef0, degree, x_square, realIndex);
+    const int realIndex = get_global_id(0) + start;
+    const int row = rowOffset + get_global_id(1);
+    if (realIndex < len){
+        data[row * dataLen + realIndex] = svrQgetQ_f(order[rows[row]], kernel_type, x, xW, gamma,
+                                                    coef0, degree, x_square, order[realIndex]);
     }
 }
 
@@ -153,37 +159,144 @@ bool is_upper_bound(int i, __global const char* alpha_status) {
     return alpha_status[i] == UPPER_BOUND;
 }
 
-__kernel void selectWorkingSet( const int activeSize, const int i, __global const char* y,
-                                __global const char* alpha_status, __global double* grad_diff,
-                                const double Gmax, __global const double* G,
-                                __global const double* QD, __global const float *Q_i,
-                                __global double* obj_diff){
-    const int index = get_global_id(0);
-    if (index < activeSize){
-        if (y[index] == 1.) {
-            if (!is_lower_bound(index, alpha_status)) {
-                grad_diff[index] = Gmax + G[index];                
-                if (grad_diff[index] > 0) {                    
-                    double quad_coef = QD[i] + QD[index] - 2.0 * y[i] * Q_i[index];
-                    if (quad_coef > 0)
-                        obj_diff[index] = -(grad_diff[index] * grad_diff[index]) / quad_coef;
-                    else
-                        obj_diff[index] = -(grad_diff[index] * grad_diff[index]) / TAU;                    
-                }
+//reduction of (value, index, Gmax2) of work group into element 0 of local arrays.
+//Larger value wins, ties go to larger index like in serial libsvm loops. Works for
+//any work group size
+void reduceSelection(const double value, const int index, const double gmax2,
+                    __local double* localValue, __local int* localIndex,
+                    __local double* localGmax2){
+    const int lid = get_local_id(0);
+    const int size = get_local_size(0);
+    localValue[lid] = value;
+    localIndex[lid] = index;
+    localGmax2[lid] = gmax2;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int s = 1; s < size; s <<= 1){
+        if ((lid & (2 * s - 1)) == 0 && lid + s < size){
+            const int other = lid + s;
+            if (localValue[other] > localValue[lid] || 
+                (localValue[other] == localValue[lid] && localIndex[other] > localIndex[lid])){
+                localValue[lid] = localValue[other];
+                localIndex[lid] = localIndex[other];
+            }
+            localGmax2[lid] = fmax(localGmax2[lid], localGmax2[other]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+void writePartial(__global double* partialValue, __global int* partialIndex,
+                __global double* partialGmax2, __local double* localValue, 
+                __local int* localIndex, __local double* localGmax2){
+    if (get_local_id(0) == 0){
+        const int group = get_group_id(0);
+        partialValue[group] = localValue[0];
+        partialIndex[group] = localIndex[0];
+        partialGmax2[group] = localGmax2[0];
+    }
+}
+
+//first stage of i selection: maximal -y G in I_up of each work group
+__kernel void selectMaxViolating(const int activeSize, __global const char* y,
+                                __global const char* alpha_status, __global const double* G,
+                                __global double* partialValue, __global int* partialIndex,
+                                __global double* partialGmax2, __local double* localValue,
+                                __local int* localIndex, __local double* localGmax2){
+    const int t = get_global_id(0);
+    double value = -INFINITY;
+    int index = -1;
+    if (t < activeSize){
+        if (y[t] == 1){
+            if (!is_upper_bound(t, alpha_status)){
+                value = -G[t];
+                index = t;
+            }
+        }
+        else if (!is_lower_bound(t, alpha_status)){
+            value = G[t];
+            index = t;
+        }
+    }
+    reduceSelection(value, index, -INFINITY, localValue, localIndex, localGmax2);
+    writePartial(partialValue, partialIndex, partialGmax2, localValue, localIndex, localGmax2);
+}
+
+//first stage of j selection: minimal obj_diff (kept negated) and maximal Gmax2 in
+//I_low of each work group
+__kernel void selectWorkingSet( const int activeSize, const int i, const double Gmax,
+                                __global const char* y, __global const char* alpha_status,
+                                __global const double* G, __global const double* QD,
+                                __global const float* Q_i, __global double* partialValue,
+                                __global int* partialIndex, __global double* partialGmax2,
+                                __local double* localValue, __local int* localIndex,
+                                __local double* localGmax2){
+    const int t = get_global_id(0);
+    double value = -INFINITY;
+    int index = -1;
+    double gmax2 = -INFINITY;
+    if (t < activeSize){
+        double grad_diff = 0.;
+        double quad_coef = 0.;
+        if (y[t] == 1) {
+            if (!is_lower_bound(t, alpha_status)) {
+                gmax2 = G[t];
+                grad_diff = Gmax + G[t];
+                quad_coef = QD[i] + QD[t] - 2.0 * y[i] * Q_i[t];
             }
         } else {
-            if (!is_upper_bound(index, alpha_status)) {
-                grad_diff[index] = Gmax - G[index];
-                if (grad_diff[index] > 0) {                    
-                    double quad_coef = QD[i] + QD[index] + 2.0 * y[i] * Q_i[index];
-                    if (quad_coef > 0)
-                        obj_diff[index] = -(grad_diff[index] * grad_diff[index]) / quad_coef;
-                    else
-                        obj_diff[index] = -(grad_diff[index] * grad_diff[index]) / TAU;
-                }
+            if (!is_upper_bound(t, alpha_status)) {
+                gmax2 = -G[t];
+                grad_diff = Gmax - G[t];
+                quad_coef = QD[i] + QD[t] + 2.0 * y[i] * Q_i[t];
             }
         }
+        if (grad_diff > 0){
+            value = (grad_diff * grad_diff) / (quad_coef > 0 ? quad_coef : TAU);
+            index = t;
+        }
     }
+    reduceSelection(value, index, gmax2, localValue, localIndex, localGmax2);
+    writePartial(partialValue, partialIndex, partialGmax2, localValue, localIndex, localGmax2);
 }
 
+//second stage of selection, one work group reduces partial results of groups.
+//result is value, index, Gmax2, G[index]
+__kernel void reduceSelectionGroups(const int groups, __global const double* G,
+                                    __global double* result, __global const double* partialValue,
+                                    __global const int* partialIndex, __global const double* partialGmax2,
+                                    __local double* localValue, __local int* localIndex,
+                                    __local double* localGmax2){
+    double value = -INFINITY;
+    int index = -1;
+    double gmax2 = -INFINITY;
+    for (int g = get_local_id(0); g < groups; g += get_local_size(0)){
+        if (partialValue[g] > value || (partialValue[g] == value && partialIndex[g] > index)){
+            value = partialValue[g];
+            index = partialIndex[g];
+        }
+        gmax2 = fmax(gmax2, partialGmax2[g]);
+    }
+    reduceSelection(value, index, gmax2, localValue, localIndex, localGmax2);
+    if (get_local_id(0) == 0){
+        result[0] = localValue[0];
+        result[1] = localIndex[0];
+        result[2] = localGmax2[0];
+        result[3] = localIndex[0] >= 0 ? G[localIndex[0]] : 0.;
+    }
+}
 
+//G += Q_i delta_i + Q_j delta_j after alpha step, Q_j is at Q_ij + qLen
+__kernel void updateGradient(const int activeSize, __global double* G,
+                            __global const float* Q_ij, const int qLen,
+                            const double deltaI, const double deltaJ,
+                            __global char* alpha_status, const int i, const int j,
+                            const char statusI, const char statusJ){
+    const int t = get_global_id(0);
+    if (t < activeSize){
+        G[t] += Q_ij[t] * deltaI + Q_ij[qLen + t] * deltaJ;
+    }
+    if (t == 0){
+        alpha_status[i] = statusI;
+        alpha_status[j] = statusJ;
+    }
+}
@@ -73,15 +73,17 @@ namespace core{
                 createBuffers();
                 setKernelArgs();
                 
-                size_t local_ws = workGroupSize[0];                
+                size_t local_ws = getLocalWorkSize(0, pixelCount);                
                 size_t global_ws = shrRoundUp(local_ws, pixelCount);
-                err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
+                err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
                 err_check(err, "OpenCLRegressionPredict::predict clEnqueueNDRangeKernel");
+                profileKernel(0);
                 
                 size_t size = pixelCount * sizeof(cl_uchar);
                 uchar* retVec = New uchar[pixelCount];
-                err = clEnqueueReadBuffer(command_queue, predictedBuff, CL_TRUE, 0, size, retVec, 0, NULL, NULL);
+                err = clEnqueueReadBuffer(command_queue, predictedBuff, CL_TRUE, 0, size, retVec, 0, NULL, profilingEvent());
                 err_check(err, "OpenclTools::predict clEnqueueReadBuffer");
+                profileTransfer(PROFILE_READ, size);
                 clFlush(command_queue);
                 clFinish(command_queue);
                 return retVec;
@@ -16,6 +16,7 @@ namespace core{
              */
             class OpenCLRegressionPredict : public OpenClBase, public core::util::Singleton<OpenCLRegressionPredict>{
                 friend class core::util::Singleton<OpenCLRegressionPredict>;
+                friend class core::opencl::DeviceSession;
             private:
                 /**
                  * constructor, please see documents of base class constructor
@@ -0,0 +1,89 @@
+#include "ProcessingContext.h"
+#include "core/util/Config.h"
+#include "core/util/MemTracker.h"
+#ifdef _OPENCL
+#include "core/opencl/DevicePool.h"
+#endif
+
+namespace core{
+    namespace process{
+
+        using namespace std;
+        using namespace core::util;
+#ifdef _OPENCL
+        using namespace core::opencl;
+#endif
+
+        thread_local ProcessingContext* ProcessingContext::currentContext = 0;
+
+        ProcessingContext::ProcessingContext() throw (SDException&){
+#ifdef _OPENCL
+            const Settings& settings = Config::getInstancePtr()->getSettings();
+            cl_device_id device = DevicePool::getDevice(settings.platformID, settings.deviceID);
+            session = New DeviceSession(device, "default");
+            ownsSession = true;
+#endif
+        }
+
+#ifdef _OPENCL
+        ProcessingContext::ProcessingContext(DeviceSession* deviceSession){
+            session = deviceSession;
+            ownsSession = false;
+        }
+#endif
+
+        ProcessingContext::~ProcessingContext(){
+            if (currentContext == this)
+                unbind();
+#ifdef _OPENCL
+            if (ownsSession){
+                Delete(session);
+            }
+#endif
+        }
+
+#ifdef _OPENCL
+        DeviceSession* ProcessingContext::getSession(){
+            return session;
+        }
+#endif
+
+        ProcessingContext* ProcessingContext::current(){
+            return currentContext;
+        }
+
+        void ProcessingContext::bind(){
+            currentContext = this;
+#ifdef _OPENCL
+            DeviceSession::setCurrent(session);
+#endif
+        }
+
+        void ProcessingContext::unbind(){
+            currentContext = 0;
+#ifdef _OPENCL
+            DeviceSession::setCurrent(0);
+#endif
+        }
+
+        void ProcessingContext::cleanWorkPart(){
+#ifdef _OPENCL
+            session->cleanWorkPart();
+#endif
+        }
+
+        ContextBinding::ContextBinding(ProcessingContext& processingContext){
+            context = &processingContext;
+            previous = ProcessingContext::current();
+            context->bind();
+        }
+
+        ContextBinding::~ContextBinding(){
+            if (previous != 0)
+                previous->bind();
+            else
+                context->unbind();
+        }
+
+    }
+}
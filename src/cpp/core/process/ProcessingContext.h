@@ -0,0 +1,88 @@
+#ifndef __PROCESSING_CONTEXT_H__
+#define __PROCESSING_CONTEXT_H__
+
+#include "typedefs.h"
+#ifdef _OPENCL
+#include "core/opencl/DeviceSession.h"
+#endif
+
+namespace core{
+    namespace process{
+
+        /**
+         * Owns all mutable per image state of one worker. In openCL builds that are
+         * instances of openCL tool classes (buffers, kernels, command queue) inside
+         * DeviceSession, so two contexts never share per image buffers and can process
+         * images concurrently. Immutable state (configuration, loaded models) stays global.
+         * Components reached through interfaces (image parameters, predictors) get tools of
+         * context bound to calling thread, see ContextBinding.
+         */
+        class ProcessingContext{
+        private:
+#ifdef _OPENCL
+            core::opencl::DeviceSession* session;
+            bool ownsSession;
+#endif
+            static thread_local ProcessingContext* currentContext;
+        protected:
+        public:
+            /**
+             * context on device from general.openCL.platformid and general.openCL.deviceid
+             */
+            ProcessingContext() throw (SDException&);
+#ifdef _OPENCL
+            /**
+             * context using existing device session (for example from DevicePool),
+             * session is not deleted with context
+             */
+            ProcessingContext(core::opencl::DeviceSession* deviceSession);
+#endif
+            virtual ~ProcessingContext();
+
+#ifdef _OPENCL
+            /**
+             * @return
+             * instance of T owned by this context, created and initialized on first call
+             */
+            template<typename T> T* getTool() throw (SDException&){
+                return session->getTool<T>();
+            }
+            core::opencl::DeviceSession* getSession();
+#endif
+            /**
+             * @return
+             * context bound to calling thread, 0 if none
+             */
+            static ProcessingContext* current();
+            /**
+             * bind context to calling thread
+             */
+            void bind();
+            /**
+             * unbind context from calling thread
+             */
+            void unbind();
+            /**
+             * clean per image state, called after each image
+             */
+            void cleanWorkPart();
+        };
+
+        /**
+         * binds context to calling thread for lifetime of object, previously bound context is restored
+         */
+        class ContextBinding{
+        private:
+            ProcessingContext* context;
+            ProcessingContext* previous;
+            ContextBinding();
+        protected:
+        public:
+            ContextBinding(ProcessingContext& processingContext);
+            ~ContextBinding();
+        };
+
+    }
+}
+
+#endif
@@ -22,6 +22,15 @@ namespace core{
                 virtual core::util::Matrix<float>* getImageParameters(  const std::vector<const cv::Mat*>& images,
                                                                         const cv::Mat& maskImage,
                                                                         int& rowDimension, int& pixelNum) throw (SDException&) = 0;
+                /**
+                 * parameters of chosen pixels only, label from mask is in first column
+                 * @param pixels
+                 * pixel indices (row * width + column), result rows are in same order
+                 */
+                virtual core::util::Matrix<float>* getImageParameters(  const std::vector<const cv::Mat*>& images,
+                                                                        const cv::Mat& maskImage,
+                                                                        const std::vector<uint>& pixels,
+                                                                        int& rowDimension, int& pixelNum) throw (SDException&) = 0;
                 virtual void reset() = 0;                
             };
             
@@ -0,0 +1,78 @@
+#include "ImageAtlas.h"
+#include <cstring>
+#include "core/util/MemTracker.h"
+
+namespace core{
+    namespace tools{
+        namespace image{
+
+            using namespace std;
+            using namespace cv;
+
+            ImageAtlas::ImageAtlas(){
+                pixelCount = 0;
+            }
+
+            ImageAtlas::~ImageAtlas(){
+            }
+
+            int ImageAtlas::add(int width, int height){
+                AtlasEntry entry;
+                entry.offset = pixelCount;
+                entry.width = width;
+                entry.height = height;
+                entries.push_back(entry);
+                pixelCount += (size_t)width * height;
+                return entries.size() - 1;
+            }
+
+            size_t ImageAtlas::size(){
+                return entries.size();
+            }
+
+            size_t ImageAtlas::getPixelCount(){
+                return pixelCount;
+            }
+
+            const AtlasEntry& ImageAtlas::get(int index){
+                return entries[index];
+            }
+
+            Mat* ImageAtlas::pack(const vector<const Mat*>& images) throw (SDException&){
+                if (images.size() != entries.size() || images.size() == 0){
+                    SDException exc(SHADOW_OUT_OF_BOUNDS, "ImageAtlas::pack");
+                    throw exc;
+                }
+                Mat* atlas = New Mat(1, pixelCount, images[0]->type());
+                if (atlas == 0){
+                    SDException exc(SHADOW_NO_MEM, "ImageAtlas::pack");
+                    throw exc;
+                }
+                size_t elemSize = atlas->elemSize();
+                for (size_t i = 0; i < images.size(); i++){
+                    const Mat& image = *images[i];
+                    const AtlasEntry& entry = entries[i];
+                    if (image.size().width != entry.width || image.size().height != entry.height ||
+                        image.type() != atlas->type()){
+                        Delete(atlas);
+                        SDException exc(SHADOW_DIFFERENT_IMAGES_SIZES, "ImageAtlas::pack");
+                        throw exc;
+                    }
+                    size_t rowSize = entry.width * elemSize;
+                    for (int row = 0; row < entry.height; row++){
+                        uchar* dst = atlas->data + (entry.offset + (size_t)row * entry.width) * elemSize;
+                        memcpy(dst, image.ptr(row), rowSize);
+                    }
+                }
+                return atlas;
+            }
+
+            Mat ImageAtlas::view(const Mat& atlas, int index){
+                const AtlasEntry& entry = entries[index];
+                Mat image(entry.height, entry.width, atlas.type(), atlas.data + entry.offset * atlas.elemSize());
+                return image;
+            }
+
+        }
+    }
+}
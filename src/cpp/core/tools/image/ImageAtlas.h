@@ -0,0 +1,82 @@
+#ifndef __IMAGE_ATLAS_H__
+#define __IMAGE_ATLAS_H__
+
+#include <vector>
+#include "opencv2/core/core.hpp"
+#include "typedefs.h"
+
+namespace core{
+    namespace tools{
+        namespace image{
+
+            /**
+             * position of one image inside atlas
+             */
+            struct AtlasEntry{
+                /**
+                 * index of first pixel of image in atlas
+                 */
+                size_t offset;
+                int width;
+                int height;
+            };
+
+            /**
+             * Packs many small images into single row image (atlas), one after another.
+             * All per pixel processing (color conversion, tsai kernels, image parameters,
+             * prediction) can then be done once for whole atlas, and per image results are
+             * taken back with offset / size table.
+             */
+            class ImageAtlas{
+            private:
+                std::vector<AtlasEntry> entries;
+                size_t pixelCount;
+            protected:
+            public:
+                ImageAtlas();
+                virtual ~ImageAtlas();
+
+                /**
+                 * add image to offset / size table
+                 * @return
+                 * index of image in atlas
+                 */
+                int add(int width, int height);
+                /**
+                 * @return
+                 * number of images in atlas
+                 */
+                size_t size();
+                /**
+                 * @return
+                 * number of pixels of all images in atlas
+                 */
+                size_t getPixelCount();
+                const AtlasEntry& get(int index);
+                /**
+                 * copy images into single row image
+                 * @param images
+                 * images of the same type, in order they were added
+                 * @return
+                 * atlas image
+                 */
+                cv::Mat* pack(const std::vector<const cv::Mat*>& images) throw (SDException&);
+                /**
+                 * @return
+                 * image at index inside packed atlas, shares data with atlas
+                 */
+                cv::Mat view(const cv::Mat& atlas, int index);
+                /**
+                 * @return
+                 * first element of image at index inside per pixel array of atlas
+                 */
+                template<typename T> T* view(T* atlasArray, int index){
+                    return atlasArray + entries[index].offset;
+                }
+            };
+
+        }
+    }
+}
+
+#endif
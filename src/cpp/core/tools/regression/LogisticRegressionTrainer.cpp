@@ -0,0 +1,489 @@
+#include "LogisticRegressionTrainer.h"
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include "core/util/raii/RAIIS.h"
+#include "core/util/MemTracker.h"
+#include "core/util/Config.h"
+#include "core/tools/svm/SvmLightReader.h"
+#if defined _OPENMP_MY
+#include <omp.h>
+#endif
+
+namespace core{
+    namespace tools{
+        namespace regression{
+
+            using namespace std;
+            using namespace core::util;
+            using namespace core::util::raii;
+            using namespace core::tools::svm;
+
+            static const string* findRegressionProperty(const string& key){
+                return Config::getInstancePtr()->getSnapshot()->find("general.Training.regression." + key);
+            }
+
+            static double getRegressionProperty(const string& key, double defaultValue){
+                const string* val = findRegressionProperty(key);
+                if (val == 0 || *val == "")
+                    return defaultValue;
+                return atof(val->c_str());
+            }
+
+            static uint64_t splitMix64(uint64_t value){
+                value += 0x9e3779b97f4a7c15ULL;
+                value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+                return value ^ (value >> 31);
+            }
+
+            static double dot(const vector<double>& first, const vector<double>& second){
+                double sum = 0.;
+                for (size_t i = 0; i < first.size(); i++){
+                    sum += first[i] * second[i];
+                }
+                return sum;
+            }
+
+            LogisticRegressionTrainer::LogisticRegressionTrainer(const string& setFile) throw (SDException&){
+                file = setFile;
+                binarySet = 0;
+                data = 0;
+                labels = 0;
+                weights = 0;
+                rows = 0;
+                dims = 0;
+                stride = 0;
+                weightSum = 0.;
+                borderValue = 0.5f;
+                validationScore = 0.;
+                validationRows = 0;
+                iterations = 0;
+                readConfig();
+                readSet();
+            }
+
+            LogisticRegressionTrainer::~LogisticRegressionTrainer(){
+                if (binarySet != 0){
+                    Delete(binarySet);
+                }
+            }
+
+            void LogisticRegressionTrainer::readConfig(){
+                threadNum = (int)getRegressionProperty("threadNum", 0);
+                if (threadNum <= 0)
+                    threadNum = Config::getInstancePtr()->getSettings().openMPThreadNum;
+                if (threadNum <= 0)
+                    threadNum = 1;
+                lambda = getRegressionProperty("lambda", 1e-4);
+                maxIterations = (int)getRegressionProperty("maxIterations", 200);
+                tolerance = getRegressionProperty("tolerance", 1e-6);
+                const string* metricStr = findRegressionProperty("borderMetric");
+                borderMetric = metricStr != 0 && metricStr->compare("f1") == 0 ? "f1" : "accuracy";
+            }
+
+            void LogisticRegressionTrainer::readSet() throw (SDException&){
+                if (TrainingSetFile::isBinary(file)){
+                    binarySet = New TrainingSetFile(file);
+                    rows = binarySet->getRows();
+                    dims = binarySet->getDims();
+                    stride = binarySet->getRowWidth();
+                    data = binarySet->getData();
+                    labels = binarySet->getLabels();
+                    weights = binarySet->getWeights();
+                }
+                else{
+                    SvmLightReader reader(file);
+                    svm_problem prob;
+                    svm_node* xSpace;
+                    int maxIndex;
+                    int errorLine = reader.read(prob, xSpace, maxIndex);
+                    if (errorLine != 0){
+                        stringstream stream;
+                        stream << "LogisticRegressionTrainer: wrong input format at line " << errorLine << " of " << file;
+                        SDException exc(SHADOW_READ_UNABLE, stream.str());
+                        throw exc;
+                    }
+                    rows = prob.l;
+                    dims = maxIndex;
+                    stride = dims;
+                    textData.assign(rows * dims, 0.f);
+                    textLabels.resize(rows);
+                    for (uint64_t i = 0; i < rows; i++){
+                        textLabels[i] = (float)prob.y[i];
+                        for (const svm_node* node = prob.x[i]; node->index != -1; node++){
+                            if (node->index > 0)
+                                textData[i * dims + node->index - 1] = (float)node->value;
+                        }
+                    }
+                    free(prob.y);
+                    free(prob.x);
+                    free(xSpace);
+                    if (TrainingSetFile::readWeights(file, textWeights) && textWeights.size() != rows){
+                        SDException exc(SHADOW_READ_UNABLE, "LogisticRegressionTrainer::readSet weights count");
+                        throw exc;
+                    }
+                    data = textData.data();
+                    labels = textLabels.data();
+                    weights = textWeights.empty() ? 0 : textWeights.data();
+                }
+                if (rows == 0 || dims == 0){
+                    SDException exc(SHADOW_READ_UNABLE, "LogisticRegressionTrainer::readSet empty set: " + file);
+                    throw exc;
+                }
+            }
+
+            void LogisticRegressionTrainer::split(double fraction, uint64_t seed){
+                validation.assign(rows, 0);
+                validationRows = 0;
+                if (fraction <= 0.)
+                    return;
+                //depends only on seed and row, not on number of threads
+                for (uint64_t i = 0; i < rows; i++){
+                    double random = (splitMix64(seed ^ splitMix64(i)) >> 11) * (1. / 9007199254740992.);
+                    if (random < fraction){
+                        validation[i] = 1;
+                        validationRows++;
+                    }
+                }
+                if (validationRows == rows){
+                    validation.assign(rows, 0);
+                    validationRows = 0;
+                }
+            }
+
+            void LogisticRegressionTrainer::computeScales(){
+                means.assign(dims, 0.);
+                scales.assign(dims, 0.);
+                vector<double> squares(dims, 0.);
+                weightSum = 0.;
+                for (uint64_t i = 0; i < rows; i++){
+                    if (validation[i])
+                        continue;
+                    double weight = weights != 0 ? weights[i] : 1.;
+                    const float* row = data + i * stride;
+                    for (int j = 0; j < dims; j++){
+                        means[j] += weight * row[j];
+                        squares[j] += weight * row[j] * row[j];
+                    }
+                    weightSum += weight;
+                }
+                for (int j = 0; j < dims; j++){
+                    means[j] /= weightSum;
+                    double variance = squares[j] / weightSum - means[j] * means[j];
+                    //constant parameter gets coefficient 0
+                    scales[j] = variance > 1e-12 ? 1. / sqrt(variance) : 0.;
+                }
+            }
+
+            void LogisticRegressionTrainer::toRaw(const vector<double>& w, vector<double>& raw) const{
+                raw.resize(dims + 1);
+                raw[dims] = w[dims];
+                for (int j = 0; j < dims; j++){
+                    raw[j] = w[j] * scales[j];
+                    raw[dims] -= raw[j] * means[j];
+                }
+            }
+
+            double LogisticRegressionTrainer::evaluate(const vector<double>& w, vector<double>& grad){
+                //z of standardized row is same as z of raw row with raw coefficients
+                vector<double> raw;
+                toRaw(w, raw);
+                int n = dims + 1;
+                //per thread sums of c (p - y) x, c (p - y) and loss, added in thread order
+                vector<double> partial(threadNum * (n + 1), 0.);
+                int64_t size = (int64_t)rows;
+#if defined _OPENMP_MY
+#pragma omp parallel num_threads(threadNum)
+#endif
+                {
+                    int thread = 0;
+#if defined _OPENMP_MY
+                    thread = omp_get_thread_num();
+#endif
+                    double* local = partial.data() + thread * (n + 1);
+                    int64_t i;
+#if defined _OPENMP_MY
+#pragma omp for schedule(static)
+#endif
+                    for (i = 0; i < size; i++){
+                        if (validation[i])
+                            continue;
+                        const float* row = data + i * stride;
+                        double z = raw[dims];
+                        for (int j = 0; j < dims; j++){
+                            z += raw[j] * row[j];
+                        }
+                        double weight = weights != 0 ? weights[i] : 1.;
+                        double y = labels[i] != 0.f ? 1. : 0.;
+                        //log(1 + exp(z)) without overflow
+                        double softPlus = z > 0. ? z + log1p(exp(-z)) : log1p(exp(z));
+                        local[n] += weight * (softPlus - y * z);
+                        double residual = weight * (1. / (1. + exp(-z)) - y);
+                        for (int j = 0; j < dims; j++){
+                            local[j] += residual * row[j];
+                        }
+                        local[dims] += residual;
+                    }
+                }
+                vector<double> sums(n + 1, 0.);
+                for (int t = 0; t < threadNum; t++){
+                    for (int j = 0; j <= n; j++){
+                        sums[j] += partial[t * (n + 1) + j];
+                    }
+                }
+                grad.resize(n);
+                double penalty = 0.;
+                for (int j = 0; j < dims; j++){
+                    grad[j] = scales[j] * (sums[j] - means[j] * sums[dims]) / weightSum + lambda * w[j];
+                    penalty += w[j] * w[j];
+                }
+                grad[dims] = sums[dims] / weightSum;
+                return sums[n] / weightSum + 0.5 * lambda * penalty;
+            }
+
+            void LogisticRegressionTrainer::optimize(){
+                int n = dims + 1;
+                vector<double> w(n, 0.);
+                //intercept starts at log odds of shadow
+                double positive = 0.;
+                for (uint64_t i = 0; i < rows; i++){
+                    if (validation[i] == 0 && labels[i] != 0.f)
+                        positive += weights != 0 ? weights[i] : 1.;
+                }
+                if (positive > 0. && positive < weightSum)
+                    w[dims] = log(positive / (weightSum - positive));
+
+                vector<double> grad, newW(n), newGrad, direction(n), alphas;
+                vector< vector<double> > sHistory, yHistory;
+                vector<double> rhoHistory;
+                double value = evaluate(w, grad);
+                for (iterations = 0; iterations < maxIterations; iterations++){
+                    double gradMax = 0.;
+                    for (int j = 0; j < n; j++){
+                        gradMax = max(gradMax, fabs(grad[j]));
+                    }
+                    if (gradMax < tolerance)
+                        break;
+
+                    //two loop recursion
+                    int history = (int)sHistory.size();
+                    alphas.assign(history, 0.);
+                    direction = grad;
+                    for (int k = history - 1; k >= 0; k--){
+                        alphas[k] = rhoHistory[k] * dot(sHistory[k], direction);
+                        for (int j = 0; j < n; j++){
+                            direction[j] -= alphas[k] * yHistory[k][j];
+                        }
+                    }
+                    double gamma = history > 0 ? 1. / (rhoHistory[history - 1] * dot(yHistory[history - 1], yHistory[history - 1]))
+                                               : 1. / max(1., sqrt(dot(grad, grad)));
+                    for (int j = 0; j < n; j++){
+                        direction[j] *= gamma;
+                    }
+                    for (int k = 0; k < history; k++){
+                        double beta = rhoHistory[k] * dot(yHistory[k], direction);
+                        for (int j = 0; j < n; j++){
+                            direction[j] += sHistory[k][j] * (alphas[k] - beta);
+                        }
+                    }
+                    for (int j = 0; j < n; j++){
+                        direction[j] = -direction[j];
+                    }
+                    double slope = dot(grad, direction);
+                    if (slope >= 0.){
+                        //not descent direction, restart from gradient
+                        sHistory.clear();
+                        yHistory.clear();
+                        rhoHistory.clear();
+                        double scale = 1. / max(1., sqrt(dot(grad, grad)));
+                        for (int j = 0; j < n; j++){
+                            direction[j] = -grad[j] * scale;
+                        }
+                        slope = dot(grad, direction);
+                    }
+
+                    //backtracking line search with Armijo condition
+                    double step = 1.;
+                    double newValue = value;
+                    bool accepted = false;
+                    for (int k = 0; k < LOGREG_MAX_LINE_SEARCH; k++){
+                        for (int j = 0; j < n; j++){
+                            newW[j] = w[j] + step * direction[j];
+                        }
+                        newValue = evaluate(newW, newGrad);
+                        if (newValue <= value + 1e-4 * step * slope){
+                            accepted = true;
+                            break;
+                        }
+                        step *= 0.5;
+                    }
+                    if (accepted == false)
+                        break;
+
+                    vector<double> s(n), y(n);
+                    for (int j = 0; j < n; j++){
+                        s[j] = newW[j] - w[j];
+                        y[j] = newGrad[j] - grad[j];
+                    }
+                    double sy = dot(s, y);
+                    if (sy > 1e-12){
+                        if ((int)sHistory.size() == LOGREG_HISTORY){
+                            sHistory.erase(sHistory.begin());
+                            yHistory.erase(yHistory.begin());
+                            rhoHistory.erase(rhoHistory.begin());
+                        }
+                        sHistory.push_back(s);
+                        yHistory.push_back(y);
+                        rhoHistory.push_back(1. / sy);
+                    }
+                    bool converged = value - newValue <= tolerance * max(1., fabs(newValue));
+                    w = newW;
+                    grad = newGrad;
+                    value = newValue;
+                    if (converged){
+                        iterations++;
+                        break;
+                    }
+                }
+
+                vector<double> raw;
+                toRaw(w, raw);
+                coefs.resize(n);
+                for (int j = 0; j < n; j++){
+                    coefs[j] = (float)raw[j];
+                }
+            }
+
+            void LogisticRegressionTrainer::chooseBorder(){
+                //probabilities computed as in RegressionPredict::predictCPU
+                vector<uint64_t> used;
+                for (uint64_t i = 0; i < rows; i++){
+                    if (validationRows == 0 || validation[i])
+                        used.push_back(i);
+                }
+                int64_t size = (int64_t)used.size();
+                vector<float> probabilities(size);
+                int64_t i;
+#if defined _OPENMP_MY
+#pragma omp parallel for num_threads(threadNum) schedule(static)
+#endif
+                for (i = 0; i < size; i++){
+                    const float* row = data + used[i] * stride;
+                    float result = coefs[dims];
+                    for (int j = 0; j < dims; j++){
+                        result += row[j] * coefs[j];
+                    }
+                    probabilities[i] = 1.f / (1.f + exp(-result));
+                }
+                vector<int64_t> order(size);
+                for (i = 0; i < size; i++){
+                    order[i] = i;
+                }
+                sort(order.begin(), order.end(), [&probabilities](int64_t first, int64_t second){
+                    return probabilities[first] > probabilities[second];
+                });
+
+                double positives = 0., total = 0.;
+                for (i = 0; i < size; i++){
+                    double weight = weights != 0 ? weights[used[i]] : 1.;
+                    total += weight;
+                    if (labels[used[i]] != 0.f)
+                        positives += weight;
+                }
+                //k most probable rows are predicted as shadow (result > border)
+                double truePositives = 0., falsePositives = 0.;
+                bool first = true;
+                for (int64_t k = 0; k <= size; k++){
+                    if (k > 0){
+                        int64_t index = order[k - 1];
+                        double weight = weights != 0 ? weights[used[index]] : 1.;
+                        if (labels[used[index]] != 0.f)
+                            truePositives += weight;
+                        else
+                            falsePositives += weight;
+                    }
+                    if (k > 0 && k < size && probabilities[order[k]] == probabilities[order[k - 1]])
+                        continue;
+                    double score;
+                    if (borderMetric == "f1"){
+                        double denominator = truePositives + positives + falsePositives;
+                        score = denominator > 0. ? 2. * truePositives / denominator : 0.;
+                    }
+                    else{
+                        double trueNegatives = total - positives - falsePositives;
+                        score = (truePositives + trueNegatives) / total;
+                    }
+                    if (first || score > validationScore){
+                        first = false;
+                        validationScore = score;
+                        if (k == 0)
+                            borderValue = size > 0 ? probabilities[order[0]] : 0.5f;
+                        else if (k == size)
+                            borderValue = probabilities[order[size - 1]] * 0.5f;
+                        else
+                            borderValue = 0.5f * (probabilities[order[k - 1]] + probabilities[order[k]]);
+                    }
+                }
+            }
+
+            void LogisticRegressionTrainer::train() throw (SDException&){
+                double fraction = getRegressionProperty("validationFraction", 0.2);
+                uint64_t seed = (uint64_t)getRegressionProperty("seed", 1);
+                split(fraction, seed);
+                computeScales();
+                if (weightSum <= 0.){
+                    SDException exc(SHADOW_READ_UNABLE, "LogisticRegressionTrainer::train no training rows");
+                    throw exc;
+                }
+                optimize();
+                chooseBorder();
+            }
+
+            void LogisticRegressionTrainer::writeConfig(const string& output) throw (SDException&){
+                fstream out;
+                out.open(output.c_str(), fstream::out | fstream::trunc);
+                FileRaii fRaii(&out);
+                if (out.is_open() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "LogisticRegressionTrainer::writeConfig: " + output);
+                    throw exc;
+                }
+                string indent = "            ";
+                out << setprecision(7);
+                out << indent << "<regression>" << endl;
+                out << indent << "    <!-- number of coefficients used in regression classification, do not involve intercept -->" << endl;
+                out << indent << "    <coefNum>" << endl << indent << "        " << dims << endl << indent << "    </coefNum>" << endl;
+                for (int j = 0; j < dims; j++){
+                    out << indent << "    <coefNo" << j + 1 << ">" << endl;
+                    out << indent << "        " << coefs[j] << endl;
+                    out << indent << "    </coefNo" << j + 1 << ">" << endl;
+                }
+                out << indent << "    <Intercept>" << endl << indent << "        " << coefs[dims] << endl << indent << "    </Intercept>" << endl;
+                out << indent << "    <!-- " << borderMetric << " " << validationScore << " on " << validationRows
+                    << " validation rows -->" << endl;
+                out << indent << "    <borderValue>" << endl << indent << "        " << borderValue << endl << indent << "    </borderValue>" << endl;
+                out << indent << "</regression>" << endl;
+            }
+
+            const vector<float>& LogisticRegressionTrainer::getCoefs() const{
+                return coefs;
+            }
+
+            float LogisticRegressionTrainer::getBorderValue() const{
+                return borderValue;
+            }
+
+            double LogisticRegressionTrainer::getValidationScore() const{
+                return validationScore;
+            }
+
+            int LogisticRegressionTrainer::getIterations() const{
+                return iterations;
+            }
+
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef __LOGISTIC_REGRESSION_TRAINER_H__
+#define __LOGISTIC_REGRESSION_TRAINER_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "typedefs.h"
+#include "core/tools/svm/TrainingSetFile.h"
+
+/**
+ * number of correction pairs kept by L-BFGS
+ */
+#define LOGREG_HISTORY 10
+/**
+ * maximal number of step halvings in line search
+ */
+#define LOGREG_MAX_LINE_SEARCH 30
+
+namespace core{
+    namespace tools{
+        namespace regression{
+
+            /**
+             * Fits coefficients of RegressionPredict from makeset output (text or binary set).
+             * L2 regularized logistic regression is minimized with L-BFGS, loss and gradient
+             * are summed over rows by general.Training.regression.threadNum openMP threads.
+             * Parameters are standardized only inside of optimization (penalty is on standardized
+             * coefficients), returned coefficients are for raw parameters. Rows with label other
+             * than 0 are shadow. Deterministic part of rows (validationFraction) isn't used for
+             * fitting, borderValue is chosen on it by borderMetric (accuracy or f1 of shadow class)
+             */
+            class LogisticRegressionTrainer{
+            private:
+                std::string file;
+                core::tools::svm::TrainingSetFile* binarySet;
+                //rows of text set, binary set is used in place
+                std::vector<float> textData;
+                std::vector<float> textLabels;
+                std::vector<float> textWeights;
+                const float* data;
+                const float* labels;
+                const float* weights;
+                uint64_t rows;
+                int dims;
+                int stride;
+
+                std::vector<char> validation;
+                std::vector<double> means;
+                std::vector<double> scales;
+                double weightSum;
+                int threadNum;
+                double lambda;
+                int maxIterations;
+                double tolerance;
+                std::string borderMetric;
+
+                std::vector<float> coefs;
+                float borderValue;
+                double validationScore;
+                uint64_t validationRows;
+                int iterations;
+
+                void readSet() throw (SDException&);
+                void readConfig();
+                void split(double fraction, uint64_t seed);
+                void computeScales();
+                /**
+                 * @param w
+                 * dims standardized coefficients and intercept
+                 * @param grad
+                 * gradient of objective in w
+                 * @return
+                 * weighted mean loss of training rows plus penalty
+                 */
+                double evaluate(const std::vector<double>& w, std::vector<double>& grad);
+                /**
+                 * raw coefficients and intercept from standardized ones
+                 */
+                void toRaw(const std::vector<double>& w, std::vector<double>& raw) const;
+                void optimize();
+                void chooseBorder();
+            protected:
+            public:
+                /**
+                 * @param setFile
+                 * training set made by -makeset, text or binary
+                 */
+                LogisticRegressionTrainer(const std::string& setFile) throw (SDException&);
+                virtual ~LogisticRegressionTrainer();
+
+                /**
+                 * fit coefficients and choose border value
+                 */
+                void train() throw (SDException&);
+                /**
+                 * write regression block of ShadowDetectionConfig.xml
+                 */
+                void writeConfig(const std::string& output) throw (SDException&);
+                /**
+                 * @return
+                 * dims coefficients and intercept, same order as general.Prediction.regression
+                 */
+                const std::vector<float>& getCoefs() const;
+                float getBorderValue() const;
+                /**
+                 * @return
+                 * borderMetric on validation rows (training rows if validation part is empty)
+                 */
+                double getValidationScore() const;
+                int getIterations() const;
+            };
+
+        }
+    }
+}
+
+#endif
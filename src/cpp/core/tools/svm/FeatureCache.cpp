@@ -0,0 +1,119 @@
+#include "FeatureCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "core/util/MemTracker.h"
+#include "core/util/Bytes.h"
+#include "TrainingSetFile.h"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            using namespace std;
+            using namespace core::util;
+
+            FeatureCache::FeatureCache(const string& cacheDirectory, const string& extractor){
+                directory = cacheDirectory;
+                extractorId = extractor;
+                //existing directory is used as is
+                mkdir(directory.c_str(), 0755);
+            }
+
+            FeatureCache::~FeatureCache(){
+            }
+
+            bool FeatureCache::readFile(const string& file, vector<unsigned char>& bytes){
+                ifstream input(file.c_str(), ifstream::in | ifstream::binary);
+                if (input.is_open() == false)
+                    return false;
+                input.seekg(0, ifstream::end);
+                streamoff size = input.tellg();
+                input.seekg(0, ifstream::beg);
+                if (size <= 0)
+                    return false;
+                bytes.resize(size);
+                input.read((char*)bytes.data(), size);
+                return input.good();
+            }
+
+            uint64_t FeatureCache::hashContent(const vector<unsigned char>& image, const vector<unsigned char>& mask){
+                //sizes separate sections, so bytes moved between them change hash
+                uint64_t size = image.size();
+                uint64_t hash = hashBytes(FNV_OFFSET_BASIS, &size, sizeof(size));
+                hash = hashBytes(hash, image.data(), image.size());
+                size = mask.size();
+                hash = hashBytes(hash, &size, sizeof(size));
+                return hashBytes(hash, mask.data(), mask.size());
+            }
+
+            uint64_t FeatureCache::getKey(uint64_t content) const{
+                uint64_t key = hashBytes(FNV_OFFSET_BASIS, extractorId.c_str(), extractorId.size() + 1);
+                return hashBytes(key, &content, sizeof(content));
+            }
+
+            string FeatureCache::getShardFile(uint64_t key) const{
+                stringstream name;
+                name << directory << "/" << FEATURE_CACHE_PREFIX << hex << setw(16) << setfill('0') << key << FEATURE_CACHE_SUFFIX;
+                return name.str();
+            }
+
+            Matrix<float>* FeatureCache::read(uint64_t key, int& rowDimension, int& pixelNum) const{
+                string file = getShardFile(key);
+                if (access(file.c_str(), R_OK) != 0)
+                    return 0;
+                try{
+                    TrainingSetFile shard(file);
+                    if (shard.getLabelType() != TRAINING_LABEL_CLASS || shard.getRows() == 0)
+                        return 0;
+                    int dims = shard.getDims();
+                    int rows = (int)shard.getRows();
+                    const float* labels = shard.getLabels();
+                    Matrix<float>* retVec = New Matrix<float>(dims + 1, rows);
+                    for (int i = 0; i < rows; i++){
+                        float* row = retVec->getVec() + (size_t)i * (dims + 1);
+                        row[0] = labels[i];
+                        memcpy(row + 1, shard.getRow(i), dims * sizeof(float));
+                    }
+                    rowDimension = dims + 1;
+                    pixelNum = rows;
+                    return retVec;
+                }
+                catch (SDException& exception){
+                    //damaged shard is computed and written again
+                    return 0;
+                }
+            }
+
+            bool FeatureCache::write(uint64_t key, const Matrix<float>& rows, int rowDimension, int pixelNum) const{
+                string file = getShardFile(key);
+                stringstream tmpName;
+                tmpName << file << ".tmp" << getpid() << "_" << (unsigned long)pthread_self();
+                string tmpFile = tmpName.str();
+                try{
+                    TrainingSetWriter writer(tmpFile, rowDimension - 1, TRAINING_LABEL_CLASS);
+                    for (int i = 0; i < pixelNum; i++){
+                        const float* row = rows[i];
+                        writer.addRow(row[0], row + 1);
+                    }
+                    writer.close();
+                }
+                catch (SDException& exception){
+                    remove(tmpFile.c_str());
+                    return false;
+                }
+                if (rename(tmpFile.c_str(), file.c_str()) != 0){
+                    remove(tmpFile.c_str());
+                    return false;
+                }
+                return true;
+            }
+
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef __FEATURE_CACHE_H__
+#define __FEATURE_CACHE_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "typedefs.h"
+#include "core/util/Matrix.h"
+
+/**
+ * shard file of cache directory is FEATURE_CACHE_PREFIX, 16 hex digits of key and FEATURE_CACHE_SUFFIX
+ */
+#define FEATURE_CACHE_PREFIX "features_"
+#define FEATURE_CACHE_SUFFIX ".bin"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            enum FEATURE_CACHE_RESULT{
+                /**
+                 * cache isn't enabled
+                 */
+                FEATURE_CACHE_UNUSED = 0,
+                /**
+                 * rows were read from shard
+                 */
+                FEATURE_CACHE_HIT,
+                /**
+                 * rows were computed and written to new shard
+                 */
+                FEATURE_CACHE_STORED,
+                /**
+                 * rows were computed, shard couldn't be written
+                 */
+                FEATURE_CACHE_NOT_STORED
+            };
+
+            /**
+             * Content addressed cache of makeset rows. Shard of one image is binary training
+             * set (TrainingSetFile) of rows of all its pixels, in pixel order. Key is hash of
+             * image and mask file contents and feature extractor id (parameters class and
+             * featureVersion), so changed image, mask or extractor give new shard. Sampling
+             * isn't part of key, chosen rows are taken from shard, so rows of unchanged images
+             * are read instead of computed for any sampling. Shards are written under temporary
+             * name and renamed, so concurrent makesets can share directory
+             */
+            class FeatureCache{
+            private:
+                std::string directory;
+                std::string extractorId;
+            protected:
+            public:
+                /**
+                 * @param cacheDirectory
+                 * directory of shards, created if it doesn't exist
+                 * @param extractor
+                 * id of feature extractor, shards of other ids aren't used
+                 */
+                FeatureCache(const std::string& cacheDirectory, const std::string& extractor);
+                virtual ~FeatureCache();
+
+                /**
+                 * read whole file
+                 * @return
+                 * false if file can't be read
+                 */
+                static bool readFile(const std::string& file, std::vector<unsigned char>& bytes);
+                /**
+                 * hash of image and mask file contents
+                 */
+                static uint64_t hashContent(const std::vector<unsigned char>& image, const std::vector<unsigned char>& mask);
+                /**
+                 * @param content
+                 * hashContent of image and mask
+                 */
+                uint64_t getKey(uint64_t content) const;
+                std::string getShardFile(uint64_t key) const;
+                /**
+                 * @return
+                 * rows of shard (label in first column), 0 if there is no valid shard
+                 */
+                core::util::Matrix<float>* read(uint64_t key, int& rowDimension, int& pixelNum) const;
+                /**
+                 * @param rows
+                 * pixelNum rows of rowDimension values, label in first column
+                 * @return
+                 * false if shard couldn't be written
+                 */
+                bool write(uint64_t key, const core::util::Matrix<float>& rows, int rowDimension, int pixelNum) const;
+            };
+
+        }
+    }
+}
+
+#endif
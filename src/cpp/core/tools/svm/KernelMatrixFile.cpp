@@ -0,0 +1,205 @@
+#include "KernelMatrixFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "core/util/Bytes.h"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            using namespace std;
+            using namespace core::util;
+
+            KernelMatrixFile::KernelMatrixFile(const string& directory, const svm_problem& prob, const svm_parameter& param) throw (SDException&){
+                if (param.kernel_type == PRECOMPUTED){
+                    SDException exc(SHADOW_INVALID_KERNEL_TYPE, "KernelMatrixFile: precomputed kernel");
+                    throw exc;
+                }
+                mapped = 0;
+                mappedSize = 0;
+                created = false;
+                KernelMatrixHeader header;
+                fillHeader(header, prob, param);
+
+                //name is hash of whole header, so every kernel parameter has its own file
+                uint64_t hash = hashBytes(FNV_OFFSET_BASIS, &header, sizeof(KernelMatrixHeader));
+                stringstream name;
+                name << directory << "/kernel_" << hex << setw(16) << setfill('0') << hash << KERNEL_MATRIX_SUFFIX;
+                file = name.str();
+
+                if (mapFile(header) == false){
+                    create(header, prob, param);
+                    created = true;
+                    if (mapFile(header) == false){
+                        SDException exc(SHADOW_READ_UNABLE, "KernelMatrixFile: " + file);
+                        throw exc;
+                    }
+                }
+
+                vector< pair<const svm_node*, int> > order(prob.l);
+                for (int i = 0; i < prob.l; i++){
+                    order[i] = make_pair((const svm_node*)prob.x[i], i);
+                }
+                less<const svm_node*> before;
+                sort(order.begin(), order.end(), [&before](const pair<const svm_node*, int>& first, const pair<const svm_node*, int>& second){
+                    return before(first.first, second.first);
+                });
+                sortedX.resize(prob.l);
+                rows.resize(prob.l);
+                for (int i = 0; i < prob.l; i++){
+                    sortedX[i] = order[i].first;
+                    rows[i] = order[i].second;
+                }
+                matrix.l = prob.l;
+                matrix.data = (const unsigned short*)((const char*)mapped + header.dataOffset);
+                matrix.x_sorted = sortedX.data();
+                matrix.rows = rows.data();
+            }
+
+            KernelMatrixFile::~KernelMatrixFile(){
+                if (mapped != 0)
+                    munmap(mapped, mappedSize);
+            }
+
+            uint64_t KernelMatrixFile::hashProblem(const svm_problem& prob){
+                uint64_t hash = hashBytes(FNV_OFFSET_BASIS, &prob.l, sizeof(prob.l));
+                for (int i = 0; i < prob.l; i++){
+                    const svm_node* node = prob.x[i];
+                    for (; node->index != -1; node++){
+                        hash = hashBytes(hash, &node->index, sizeof(node->index));
+                        hash = hashBytes(hash, &node->value, sizeof(node->value));
+                    }
+                    //end of instance, so same values split differently don't collide
+                    hash = hashBytes(hash, &node->index, sizeof(node->index));
+                }
+                return hash;
+            }
+
+            uint64_t KernelMatrixFile::getFileSize(int rows){
+                uint64_t dataSize = (uint64_t)rows * rows * sizeof(unsigned short);
+                return alignOffset(alignOffset(sizeof(KernelMatrixHeader), KERNEL_MATRIX_ALIGN) + dataSize, KERNEL_MATRIX_ALIGN);
+            }
+
+            void KernelMatrixFile::fillHeader(KernelMatrixHeader& header, const svm_problem& prob, const svm_parameter& param) const{
+                memset(&header, 0, sizeof(KernelMatrixHeader));
+                memcpy(header.magic, KERNEL_MATRIX_MAGIC, 8);
+                header.formatVersion = KERNEL_MATRIX_VERSION;
+                header.kernelType = param.kernel_type;
+                switch (param.kernel_type){
+                    case POLY:
+                        header.degree = param.degree;
+                        header.gamma = param.gamma;
+                        header.coef0 = param.coef0;
+                        break;
+                    case RBF:
+                        header.gamma = param.gamma;
+                        break;
+                    case SIGMOID:
+                        header.gamma = param.gamma;
+                        header.coef0 = param.coef0;
+                        break;
+                }
+                header.rows = prob.l;
+                header.datasetHash = hashProblem(prob);
+                header.dataOffset = alignOffset(sizeof(KernelMatrixHeader), KERNEL_MATRIX_ALIGN);
+                header.fileSize = getFileSize(prob.l);
+            }
+
+            bool KernelMatrixFile::mapFile(const KernelMatrixHeader& expected) throw (SDException&){
+                int fd = open(file.c_str(), O_RDONLY);
+                if (fd < 0)
+                    return false;
+                struct stat fileStat;
+                if (fstat(fd, &fileStat) != 0 || (uint64_t)fileStat.st_size != expected.fileSize){
+                    ::close(fd);
+                    return false;
+                }
+                size_t size = fileStat.st_size;
+                void* data = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (data == MAP_FAILED){
+                    SDException exc(SHADOW_READ_UNABLE, "KernelMatrixFile mmap: " + file);
+                    throw exc;
+                }
+                //same name but other matrix (hash collision)
+                if (memcmp(data, &expected, sizeof(KernelMatrixHeader)) != 0){
+                    munmap(data, size);
+                    return false;
+                }
+                //rows are read in order of solver working sets
+                madvise(data, size, MADV_RANDOM);
+                mapped = data;
+                mappedSize = size;
+                return true;
+            }
+
+            void KernelMatrixFile::create(const KernelMatrixHeader& header, const svm_problem& prob, const svm_parameter& param) throw (SDException&){
+                //written under temporary name, so other processes never map partial matrix
+                stringstream tmpName;
+                tmpName << file << ".tmp" << getpid();
+                string tmpFile = tmpName.str();
+                fstream output(tmpFile.c_str(), fstream::out | fstream::binary | fstream::trunc);
+                if (output.is_open() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "KernelMatrixFile: " + tmpFile);
+                    throw exc;
+                }
+                static const char padding[KERNEL_MATRIX_ALIGN] = {0};
+                output.write((const char*)&header, sizeof(KernelMatrixHeader));
+                output.write(padding, header.dataOffset - sizeof(KernelMatrixHeader));
+                //target of blocks written by svm_kernel_matrix_blocks
+                struct BlockOutput{
+                    fstream* output;
+                    int columns;
+                } blockOutput;
+                blockOutput.output = &output;
+                blockOutput.columns = prob.l;
+
+                int result = svm_kernel_matrix_blocks(&prob, &param, KERNEL_MATRIX_BLOCK_ROWS,
+                    [](const unsigned short* block, int rows, void* user){
+                        BlockOutput* out = (BlockOutput*)user;
+                        out->output->write((const char*)block, (size_t)rows * out->columns * sizeof(unsigned short));
+                        return out->output->good() ? 0 : -1;
+                    }, &blockOutput);
+                bool inRange = result != -1;
+                if (result == 0){
+                    uint64_t written = header.dataOffset + (uint64_t)prob.l * prob.l * sizeof(unsigned short);
+                    output.write(padding, header.fileSize - written);
+                }
+                bool good = result == 0 && output.good();
+                output.close();
+                if (inRange == false){
+                    remove(tmpFile.c_str());
+                    SDException exc(SHADOW_OUT_OF_BOUNDS, "KernelMatrixFile: kernel values out of fp16 range");
+                    throw exc;
+                }
+                if (good == false || rename(tmpFile.c_str(), file.c_str()) != 0){
+                    remove(tmpFile.c_str());
+                    SDException exc(SHADOW_WRITE_UNABLE, "KernelMatrixFile: " + file);
+                    throw exc;
+                }
+            }
+
+            const svm_kernel_matrix* KernelMatrixFile::getMatrix() const{
+                return &matrix;
+            }
+
+            const string& KernelMatrixFile::getFile() const{
+                return file;
+            }
+
+            bool KernelMatrixFile::wasCreated() const{
+                return created;
+            }
+
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef __KERNEL_MATRIX_FILE_H__
+#define __KERNEL_MATRIX_FILE_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "typedefs.h"
+#include "thirdparty/lib_svm/svm.h"
+
+/**
+ * first bytes of kernel matrix file
+ */
+#define KERNEL_MATRIX_MAGIC "SDKERMAT"
+#define KERNEL_MATRIX_VERSION 1
+/**
+ * alignment of matrix data in file, in bytes
+ */
+#define KERNEL_MATRIX_ALIGN 64
+/**
+ * number of rows computed and written at once
+ */
+#define KERNEL_MATRIX_BLOCK_ROWS 256
+#define KERNEL_MATRIX_SUFFIX ".kmat"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            /**
+             * header of kernel matrix file, followed at dataOffset by rows * rows fp16 values
+             * (row major). Kernel parameters which kernel type doesn't use are 0.
+             * Values are in host byte order
+             */
+            struct KernelMatrixHeader{
+                char magic[8];
+                uint32_t formatVersion;
+                int32_t kernelType;
+                int32_t degree;
+                int32_t rows;
+                double gamma;
+                double coef0;
+                uint64_t datasetHash;
+                uint64_t dataOffset;
+                uint64_t fileSize;
+            };
+
+            /**
+             * Precomputed kernel matrix of training problem, shared by trainings on same
+             * instances with same kernel parameters (C, folds and one-vs-one subproblems
+             * may differ). File name is made of hash of instances and kernel parameters,
+             * existing file of directory is mapped, otherwise matrix is computed, written
+             * and then mapped. Pages of mapped file are shared by all processes using it
+             */
+            class KernelMatrixFile{
+            private:
+                std::string file;
+                void* mapped;
+                size_t mappedSize;
+                bool created;
+                //svm_node arrays of problem ordered by address and their rows
+                std::vector<const svm_node*> sortedX;
+                std::vector<int> rows;
+                svm_kernel_matrix matrix;
+
+                void fillHeader(KernelMatrixHeader& header, const svm_problem& prob, const svm_parameter& param) const;
+                /**
+                 * @return
+                 * false if file doesn't exist or doesn't match expected header
+                 */
+                bool mapFile(const KernelMatrixHeader& expected) throw (SDException&);
+                void create(const KernelMatrixHeader& header, const svm_problem& prob, const svm_parameter& param) throw (SDException&);
+            protected:
+            public:
+                /**
+                 * @param directory
+                 * directory of matrix files
+                 * @param prob
+                 * svm_node arrays of problem must stay valid while matrix is used
+                 */
+                KernelMatrixFile(const std::string& directory, const svm_problem& prob, const svm_parameter& param) throw (SDException&);
+                virtual ~KernelMatrixFile();
+
+                /**
+                 * FNV-1a hash of instances (indices and values, in problem order)
+                 */
+                static uint64_t hashProblem(const svm_problem& prob);
+                /**
+                 * @return
+                 * size of matrix file of problem with rows instances, in bytes
+                 */
+                static uint64_t getFileSize(int rows);
+                /**
+                 * @return
+                 * matrix for svm_parameter::kernel_matrix
+                 */
+                const svm_kernel_matrix* getMatrix() const;
+                const std::string& getFile() const;
+                /**
+                 * @return
+                 * true if matrix was computed by this object, false if existing file was used
+                 */
+                bool wasCreated() const;
+            };
+
+        }
+    }
+}
+
+#endif
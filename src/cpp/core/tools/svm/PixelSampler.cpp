@@ -0,0 +1,132 @@
+#include "PixelSampler.h"
+#include <random>
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            using namespace std;
+            using namespace cv;
+
+            PixelSampler::PixelSampler(uint64_t samplerSeed, uint64_t classSamples, uint64_t imageSamples, bool balanceClasses){
+                seed = samplerSeed;
+                samplesPerClass = classSamples;
+                maxPerImage = imageSamples;
+                balance = balanceClasses;
+                all = balance == false && samplesPerClass == 0 && maxPerImage == 0;
+            }
+
+            PixelSampler::~PixelSampler(){
+            }
+
+            int PixelSampler::getClass(uchar maskValue){
+                return maskValue != 0 ? 1 : 0;
+            }
+
+            void PixelSampler::countClasses(const Mat& mask, uint64_t* counts){
+                for (int i = 0; i < SAMPLER_CLASSES; i++){
+                    counts[i] = 0;
+                }
+                for (int y = 0; y < mask.rows; y++){
+                    const uchar* row = mask.ptr(y);
+                    for (int x = 0; x < mask.cols; x++){
+                        counts[getClass(row[x])]++;
+                    }
+                }
+            }
+
+            void PixelSampler::plan(const vector< vector<uint64_t> >& counts){
+                size_t imageNum = counts.size();
+                quotas = counts;
+                if (all)
+                    return;
+
+                vector< vector<uint64_t> > capacities = counts;
+                uint64_t available[SAMPLER_CLASSES] = {0};
+                for (size_t i = 0; i < imageNum; i++){
+                    for (int c = 0; c < SAMPLER_CLASSES; c++){
+                        if (maxPerImage > 0 && capacities[i][c] > maxPerImage)
+                            capacities[i][c] = maxPerImage;
+                        available[c] += capacities[i][c];
+                    }
+                }
+                uint64_t targets[SAMPLER_CLASSES];
+                uint64_t minAvailable = available[0];
+                for (int c = 0; c < SAMPLER_CLASSES; c++){
+                    if (available[c] < minAvailable)
+                        minAvailable = available[c];
+                }
+                for (int c = 0; c < SAMPLER_CLASSES; c++){
+                    targets[c] = balance ? minAvailable : available[c];
+                    if (samplesPerClass > 0 && targets[c] > samplesPerClass)
+                        targets[c] = samplesPerClass;
+                }
+
+                for (int c = 0; c < SAMPLER_CLASSES; c++){
+                    uint64_t assigned = 0;
+                    for (size_t i = 0; i < imageNum; i++){
+                        uint64_t quota = 0;
+                        if (available[c] > 0)
+                            quota = (uint64_t)((long double)targets[c] * capacities[i][c] / available[c]);
+                        if (quota > capacities[i][c])
+                            quota = capacities[i][c];
+                        quotas[i][c] = quota;
+                        assigned += quota;
+                    }
+                    //rest from rounding down goes to images with free capacity, in list order
+                    bool added = true;
+                    while (assigned < targets[c] && added){
+                        added = false;
+                        for (size_t i = 0; i < imageNum && assigned < targets[c]; i++){
+                            if (quotas[i][c] < capacities[i][c]){
+                                quotas[i][c]++;
+                                assigned++;
+                                added = true;
+                            }
+                        }
+                    }
+                }
+            }
+
+            bool PixelSampler::keepsAll() const{
+                return all;
+            }
+
+            uint64_t PixelSampler::getQuota(int image, int pixelClass) const{
+                return quotas[image][pixelClass];
+            }
+
+            void PixelSampler::select(int image, uint64_t content, const Mat& mask, vector<uint>& pixels) const{
+                pixels.clear();
+                uint64_t seen[SAMPLER_CLASSES];
+                countClasses(mask, seen);
+                uint64_t needed[SAMPLER_CLASSES];
+                uint64_t total = 0;
+                for (int c = 0; c < SAMPLER_CLASSES; c++){
+                    needed[c] = quotas[image][c] < seen[c] ? quotas[image][c] : seen[c];
+                    total += needed[c];
+                }
+                pixels.reserve(total);
+
+                seed_seq seq = {(uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)content, (uint32_t)(content >> 32)};
+                mt19937_64 generator(seq);
+                //pixel is kept with probability needed / seen of its class (selection sampling)
+                for (int y = 0; y < mask.rows; y++){
+                    const uchar* row = mask.ptr(y);
+                    for (int x = 0; x < mask.cols; x++){
+                        int c = getClass(row[x]);
+                        if (needed[c] == 0)
+                            continue;
+                        double random = (generator() >> 11) * (1. / 9007199254740992.);
+                        if (random * seen[c] < needed[c]){
+                            pixels.push_back((uint)(y * mask.cols + x));
+                            needed[c]--;
+                        }
+                        seen[c]--;
+                    }
+                }
+            }
+
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef __PIXEL_SAMPLER_H__
+#define __PIXEL_SAMPLER_H__
+
+#include <vector>
+#include <stdint.h>
+#include "core/opencv/OpenCV2Tools.h"
+#include "typedefs.h"
+
+/**
+ * pixels with mask value 0 are class 0 (not shadow), others are class 1
+ */
+#define SAMPLER_CLASSES 2
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            /**
+             * Chooses training pixels before their parameters are computed.
+             * Stratified by class and image: plan gets number of pixels of each class in
+             * each mask and splits quota of each class between images proportionally to
+             * their pixel counts, limited by per image cap. select then chooses pixels of
+             * one image uniformly (selection sampling) with generator seeded by seed and
+             * hash of image and mask contents, so result doesn't depend on thread which
+             * processes images and image keeps its pixels when it is moved in list
+             */
+            class PixelSampler{
+            private:
+                uint64_t seed;
+                uint64_t samplesPerClass;
+                uint64_t maxPerImage;
+                bool balance;
+                bool all;
+                /**
+                 * [image][class] number of pixels to keep
+                 */
+                std::vector< std::vector<uint64_t> > quotas;
+            protected:
+            public:
+                /**
+                 * @param samplerSeed
+                 * seed of random generator
+                 * @param classSamples
+                 * maximal number of pixels of each class in set, 0 for no limit
+                 * @param imageSamples
+                 * maximal number of pixels of each class from one image, 0 for no limit
+                 * @param balanceClasses
+                 * keep same number of pixels of each class
+                 */
+                PixelSampler(uint64_t samplerSeed, uint64_t classSamples, uint64_t imageSamples, bool balanceClasses);
+                virtual ~PixelSampler();
+
+                /**
+                 * @return
+                 * class of mask value
+                 */
+                static int getClass(uchar maskValue);
+                /**
+                 * count pixels of each class in mask
+                 * @param counts
+                 * SAMPLER_CLASSES values
+                 */
+                static void countClasses(const cv::Mat& mask, uint64_t* counts);
+                /**
+                 * split class quotas between images
+                 * @param counts
+                 * [image][class] number of pixels in masks
+                 */
+                void plan(const std::vector< std::vector<uint64_t> >& counts);
+                /**
+                 * @return
+                 * true if every pixel is kept, images don't need to be sampled
+                 */
+                bool keepsAll() const;
+                uint64_t getQuota(int image, int pixelClass) const;
+                /**
+                 * choose pixels of image, plan must be called before
+                 * @param content
+                 * hash of image and mask contents (FeatureCache::hashContent)
+                 * @param pixels
+                 * filled with pixel indices (row * width + column) in ascending order
+                 */
+                void select(int image, uint64_t content, const cv::Mat& mask, std::vector<uint>& pixels) const;
+            };
+
+        }
+    }
+}
+
+#endif
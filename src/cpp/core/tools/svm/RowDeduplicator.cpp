@@ -0,0 +1,96 @@
+#include "RowDeduplicator.h"
+#include <cmath>
+#include <cstring>
+#include "core/util/MemTracker.h"
+#include "core/util/Bytes.h"
+
+/**
+ * initial number of buckets of unique rows set
+ */
+#define DEDUP_INITIAL_BUCKETS 1024
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            using namespace std;
+            using namespace core::util;
+
+            size_t RowDeduplicator::KeyHash::operator()(uint64_t row) const{
+                //FNV-1a over quantized values
+                const int64_t* key = owner->getKey(row);
+                return (size_t)hashBytes(FNV_OFFSET_BASIS, key, (owner->dims + 1) * sizeof(int64_t));
+            }
+
+            bool RowDeduplicator::KeyEqual::operator()(uint64_t first, uint64_t second) const{
+                return memcmp(owner->getKey(first), owner->getKey(second), (owner->dims + 1) * sizeof(int64_t)) == 0;
+            }
+
+            RowDeduplicator::RowDeduplicator(int dimension, int quantizationLevels){
+                dims = dimension;
+                levels = quantizationLevels;
+                added = 0;
+                KeyHash hash;
+                hash.owner = this;
+                KeyEqual equal;
+                equal.owner = this;
+                index = New unordered_set<uint64_t, KeyHash, KeyEqual>(DEDUP_INITIAL_BUCKETS, hash, equal);
+            }
+
+            RowDeduplicator::~RowDeduplicator(){
+                if (index != 0){
+                    Delete(index);
+                }
+            }
+
+            const int64_t* RowDeduplicator::getKey(uint64_t row) const{
+                return keys.data() + row * (dims + 1);
+            }
+
+            void RowDeduplicator::add(float label, const float* values){
+                added++;
+                uint64_t candidate = counts.size();
+                //label isn't quantized, only same labels are merged
+                keys.push_back((int64_t)llround(label * 1e6));
+                for (int i = 0; i < dims; i++){
+                    keys.push_back((int64_t)llround(values[i] * levels));
+                }
+                unordered_set<uint64_t, KeyHash, KeyEqual>::iterator found = index->find(candidate);
+                if (found != index->end()){
+                    counts[*found]++;
+                    keys.resize(candidate * (dims + 1));
+                    return;
+                }
+                rows.insert(rows.end(), values, values + dims);
+                labels.push_back(label);
+                counts.push_back(1);
+                index->insert(candidate);
+            }
+
+            uint64_t RowDeduplicator::getRows() const{
+                return counts.size();
+            }
+
+            uint64_t RowDeduplicator::getAdded() const{
+                return added;
+            }
+
+            int RowDeduplicator::getDims() const{
+                return dims;
+            }
+
+            float RowDeduplicator::getLabel(uint64_t row) const{
+                return labels[row];
+            }
+
+            const float* RowDeduplicator::getRow(uint64_t row) const{
+                return rows.data() + row * dims;
+            }
+
+            uint64_t RowDeduplicator::getCount(uint64_t row) const{
+                return counts[row];
+            }
+
+        }
+    }
+}
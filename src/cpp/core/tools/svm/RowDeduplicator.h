@@ -0,0 +1,88 @@
+#ifndef __ROW_DEDUPLICATOR_H__
+#define __ROW_DEDUPLICATOR_H__
+
+#include <cstddef>
+#include <vector>
+#include <unordered_set>
+#include <stdint.h>
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            /**
+             * Collapses training rows which are same after quantization.
+             * Every value is rounded to multiple of 1 / levels, rows with same label and same
+             * quantized values are counted as one unique row. First added row of each group is
+             * kept, so unique rows are in order of their first occurrence and count of each
+             * one is used as instance weight in training
+             */
+            class RowDeduplicator{
+            private:
+                /**
+                 * hash and compare rows by index in keys, so no key copy is stored in set
+                 */
+                struct KeyHash{
+                    const RowDeduplicator* owner;
+                    size_t operator()(uint64_t row) const;
+                };
+                struct KeyEqual{
+                    const RowDeduplicator* owner;
+                    bool operator()(uint64_t first, uint64_t second) const;
+                };
+
+                int dims;
+                double levels;
+                /**
+                 * label and dims quantized values of each unique row, last one is candidate
+                 * of add which is removed if row is duplicate
+                 */
+                std::vector<int64_t> keys;
+                std::vector<float> rows;
+                std::vector<float> labels;
+                std::vector<uint64_t> counts;
+                uint64_t added;
+                std::unordered_set<uint64_t, KeyHash, KeyEqual>* index;
+
+                const int64_t* getKey(uint64_t row) const;
+            protected:
+            public:
+                /**
+                 * @param dimension
+                 * number of values in row, without label
+                 * @param quantizationLevels
+                 * values are quantized to multiple of 1 / quantizationLevels
+                 */
+                RowDeduplicator(int dimension, int quantizationLevels);
+                virtual ~RowDeduplicator();
+
+                /**
+                 * @param values
+                 * dims values
+                 */
+                void add(float label, const float* values);
+                /**
+                 * @return
+                 * number of unique rows
+                 */
+                uint64_t getRows() const;
+                /**
+                 * @return
+                 * number of added rows
+                 */
+                uint64_t getAdded() const;
+                int getDims() const;
+                float getLabel(uint64_t row) const;
+                const float* getRow(uint64_t row) const;
+                /**
+                 * @return
+                 * number of added rows collapsed into unique row
+                 */
+                uint64_t getCount(uint64_t row) const;
+            };
+
+        }
+    }
+}
+
+#endif
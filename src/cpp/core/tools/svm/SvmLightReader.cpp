@@ -0,0 +1,348 @@
+#include "SvmLightReader.h"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined _OPENMP_MY
+#include <omp.h>
+#endif
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+/**
+ * longest number passed to strtod when fast parse can't be used
+ */
+#define MAX_NUMBER_LENGTH 64
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            using namespace std;
+
+            static const double powersOf10[] = {   1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+            static inline bool isBlank(char c){
+                return c == ' ' || c == '\t' || c == '\r';
+            }
+
+            static inline bool isDigit(char c){
+                return c >= '0' && c <= '9';
+            }
+
+            /**
+             * number which fast parse can't handle exactly (many digits, large exponent, inf, nan)
+             * is copied and parsed with strtod
+             */
+            static const char* parseNumberSlow(const char* start, const char* end, double& value){
+                char buff[MAX_NUMBER_LENGTH];
+                int len = 0;
+                while (start + len < end && len < MAX_NUMBER_LENGTH - 1 && isBlank(start[len]) == false &&
+                        start[len] != ':' && start[len] != '\n'){
+                    buff[len] = start[len];
+                    len++;
+                }
+                buff[len] = '\0';
+                char* endPtr;
+                errno = 0;
+                value = strtod(buff, &endPtr);
+                if (endPtr == buff || errno != 0)
+                    return 0;
+                return start + (endPtr - buff);
+            }
+
+            /**
+             * parse decimal number, result is same as of strtod.
+             * Exact when mantissa fits in 53 bits and power of 10 is exact double
+             * @return
+             * first character after number, 0 if there is no number
+             */
+            static const char* parseNumber(const char* start, const char* end, double& value){
+                const char* curr = start;
+                bool negative = false;
+                if (curr < end && (*curr == '-' || *curr == '+')){
+                    negative = *curr == '-';
+                    curr++;
+                }
+                uint64_t mantissa = 0;
+                int significant = 0;
+                int exponent = 0;
+                bool anyDigit = false;
+                while (curr < end && isDigit(*curr)){
+                    int digit = *curr - '0';
+                    if (mantissa != 0 || digit != 0){
+                        if (significant == 19)
+                            return parseNumberSlow(start, end, value);
+                        mantissa = mantissa * 10 + digit;
+                        significant++;
+                    }
+                    anyDigit = true;
+                    curr++;
+                }
+                if (curr < end && *curr == '.'){
+                    curr++;
+                    while (curr < end && isDigit(*curr)){
+                        int digit = *curr - '0';
+                        if (mantissa != 0 || digit != 0){
+                            if (significant == 19)
+                                return parseNumberSlow(start, end, value);
+                            mantissa = mantissa * 10 + digit;
+                            significant++;
+                        }
+                        exponent--;
+                        anyDigit = true;
+                        curr++;
+                    }
+                }
+                if (anyDigit == false)
+                    return parseNumberSlow(start, end, value);
+                if (curr < end && (*curr == 'e' || *curr == 'E')){
+                    const char* expCurr = curr + 1;
+                    bool expNegative = false;
+                    if (expCurr < end && (*expCurr == '-' || *expCurr == '+')){
+                        expNegative = *expCurr == '-';
+                        expCurr++;
+                    }
+                    if (expCurr >= end || isDigit(*expCurr) == false)
+                        return parseNumberSlow(start, end, value);
+                    int expValue = 0;
+                    while (expCurr < end && isDigit(*expCurr)){
+                        if (expValue > 10000)
+                            return parseNumberSlow(start, end, value);
+                        expValue = expValue * 10 + (*expCurr - '0');
+                        expCurr++;
+                    }
+                    exponent += expNegative ? -expValue : expValue;
+                    curr = expCurr;
+                }
+                if (mantissa == 0){
+                    value = negative ? -0. : 0.;
+                    return curr;
+                }
+                if (mantissa > (1ULL << 53) || exponent > 22 || exponent < -22)
+                    return parseNumberSlow(start, end, value);
+                value = (double)mantissa;
+                if (exponent < 0)
+                    value /= powersOf10[-exponent];
+                else
+                    value *= powersOf10[exponent];
+                if (negative)
+                    value = -value;
+                return curr;
+            }
+
+            /**
+             * parse one line "label index:value index:value ..." into nodes, terminated with index -1
+             * @param nodes
+             * moved after terminating node
+             * @return
+             * false if line is wrong
+             */
+            static bool parseLine(const char* curr, const char* lineEnd, double& label, svm_node*& nodes, int& maxIndex){
+                while (curr < lineEnd && isBlank(*curr))
+                    curr++;
+                if (curr == lineEnd)
+                    return false;
+                curr = parseNumber(curr, lineEnd, label);
+                if (curr == 0 || (curr < lineEnd && isBlank(*curr) == false))
+                    return false;
+                //precomputed kernel has index starting from 0
+                int instMaxIndex = -1;
+                while (true){
+                    while (curr < lineEnd && isBlank(*curr))
+                        curr++;
+                    if (curr == lineEnd)
+                        break;
+                    long index = 0;
+                    const char* indexStart = curr;
+                    while (curr < lineEnd && isDigit(*curr)){
+                        index = index * 10 + (*curr - '0');
+                        if (index > INT_MAX)
+                            return false;
+                        curr++;
+                    }
+                    if (curr == indexStart || curr == lineEnd || *curr != ':' || index <= instMaxIndex)
+                        return false;
+                    curr++;
+                    double value;
+                    curr = parseNumber(curr, lineEnd, value);
+                    if (curr == 0 || (curr < lineEnd && isBlank(*curr) == false))
+                        return false;
+                    nodes->index = (int)index;
+                    nodes->value = value;
+                    nodes++;
+                    instMaxIndex = (int)index;
+                }
+                nodes->index = -1;
+                nodes++;
+                if (instMaxIndex > maxIndex)
+                    maxIndex = instMaxIndex;
+                return true;
+            }
+
+            SvmLightReader::SvmLightReader(const string& setFile) throw (SDException&){
+                file = setFile;
+                mapped = 0;
+                mappedSize = 0;
+                int fd = open(file.c_str(), O_RDONLY);
+                if (fd < 0){
+                    SDException exc(SHADOW_READ_UNABLE, "SvmLightReader: " + file);
+                    throw exc;
+                }
+                struct stat fileStat;
+                if (fstat(fd, &fileStat) != 0){
+                    close(fd);
+                    SDException exc(SHADOW_READ_UNABLE, "SvmLightReader size: " + file);
+                    throw exc;
+                }
+                mappedSize = fileStat.st_size;
+                if (mappedSize > 0){
+                    mapped = mmap(0, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (mapped == MAP_FAILED){
+                        mapped = 0;
+                        close(fd);
+                        SDException exc(SHADOW_READ_UNABLE, "SvmLightReader mmap: " + file);
+                        throw exc;
+                    }
+                    madvise(mapped, mappedSize, MADV_WILLNEED);
+                }
+                close(fd);
+            }
+
+            SvmLightReader::~SvmLightReader(){
+                if (mapped != 0)
+                    munmap(mapped, mappedSize);
+            }
+
+            void SvmLightReader::split(int chunkNum){
+                chunks.clear();
+                const char* data = (const char*)mapped;
+                const char* dataEnd = data + mappedSize;
+                size_t chunkSize = mappedSize / chunkNum + 1;
+                const char* start = data;
+                while (start < dataEnd){
+                    const char* end = start + chunkSize < dataEnd ? start + chunkSize : dataEnd;
+                    //chunk ends after new line
+                    if (end < dataEnd){
+                        const char* newLine = (const char*)memchr(end - 1, '\n', dataEnd - end + 1);
+                        end = newLine != 0 ? newLine + 1 : dataEnd;
+                    }
+                    Chunk chunk;
+                    chunk.start = start;
+                    chunk.end = end;
+                    chunk.lines = 0;
+                    chunk.elements = 0;
+                    chunk.errorLine = 0;
+                    chunk.maxIndex = 0;
+                    chunks.push_back(chunk);
+                    start = end;
+                }
+            }
+
+            void SvmLightReader::count(Chunk& chunk){
+                uint64_t lines = 0;
+                uint64_t colons = 0;
+                for (const char* curr = chunk.start; curr < chunk.end; curr++){
+                    lines += *curr == '\n';
+                    colons += *curr == ':';
+                }
+                //last line of file without new line
+                if (chunk.end > chunk.start && chunk.end[-1] != '\n')
+                    lines++;
+                chunk.lines = (int)lines;
+                //every index:value has colon, plus terminating node
+                chunk.elements = colons + lines;
+            }
+
+            void SvmLightReader::parse(Chunk& chunk, int firstRow, uint64_t firstElement, svm_problem& prob, svm_node* xSpace){
+                const char* curr = chunk.start;
+                svm_node* nodes = xSpace + firstElement;
+                for (int i = 0; i < chunk.lines; i++){
+                    const char* lineEnd = (const char*)memchr(curr, '\n', chunk.end - curr);
+                    if (lineEnd == 0)
+                        lineEnd = chunk.end;
+                    int row = firstRow + i;
+                    prob.x[row] = nodes;
+                    if (parseLine(curr, lineEnd, prob.y[row], nodes, chunk.maxIndex) == false){
+                        chunk.errorLine = row + 1;
+                        return;
+                    }
+                    curr = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+                }
+            }
+
+            int SvmLightReader::read(svm_problem& prob, svm_node*& xSpace, int& maxIndex) throw (SDException&){
+                int chunkNum = 1;
+#if defined _OPENMP_MY
+                //more chunks than threads, lines are not same length
+                chunkNum = omp_get_max_threads() * 4;
+#endif
+                split(chunkNum);
+                int size = (int)chunks.size();
+                int i;
+#if defined _OPENMP_MY
+#pragma omp parallel for private(i)
+#endif
+                for (i = 0; i < size; i++){
+                    count(chunks[i]);
+                }
+
+                vector<int> firstRows(size);
+                vector<uint64_t> firstElements(size);
+                uint64_t rows = 0;
+                uint64_t elements = 0;
+                for (i = 0; i < size; i++){
+                    firstRows[i] = (int)rows;
+                    firstElements[i] = elements;
+                    rows += chunks[i].lines;
+                    elements += chunks[i].elements;
+                    if (rows > INT_MAX){
+                        SDException exc(SHADOW_OUT_OF_BOUNDS, "SvmLightReader::read rows: " + file);
+                        throw exc;
+                    }
+                }
+
+                prob.l = (int)rows;
+                prob.y = Malloc(double, prob.l);
+                prob.x = Malloc(struct svm_node *, prob.l);
+                xSpace = Malloc(struct svm_node, elements);
+                if ((prob.l > 0 && (prob.y == 0 || prob.x == 0)) || (elements > 0 && xSpace == 0)){
+                    free(prob.y);
+                    free(prob.x);
+                    free(xSpace);
+                    SDException exc(SHADOW_NO_MEM, "SvmLightReader::read: " + file);
+                    throw exc;
+                }
+
+#if defined _OPENMP_MY
+#pragma omp parallel for private(i) schedule(dynamic)
+#endif
+                for (i = 0; i < size; i++){
+                    parse(chunks[i], firstRows[i], firstElements[i], prob, xSpace);
+                }
+
+                maxIndex = 0;
+                for (i = 0; i < size; i++){
+                    //chunks are in file order, so first error is first wrong line
+                    if (chunks[i].errorLine != 0){
+                        free(prob.y);
+                        free(prob.x);
+                        free(xSpace);
+                        prob.y = 0;
+                        prob.x = 0;
+                        xSpace = 0;
+                        return chunks[i].errorLine;
+                    }
+                    if (chunks[i].maxIndex > maxIndex)
+                        maxIndex = chunks[i].maxIndex;
+                }
+                return 0;
+            }
+
+        }
+    }
+}
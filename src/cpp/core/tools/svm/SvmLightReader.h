@@ -0,0 +1,70 @@
+#ifndef __SVM_LIGHT_READER_H__
+#define __SVM_LIGHT_READER_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "thirdparty/lib_svm/svm.h"
+#include "typedefs.h"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            /**
+             * Reads svmlight text training set into libsvm problem.
+             * File is mapped with mmap and split into line aligned chunks, chunks are
+             * counted and then parsed in parallel (openMP) directly into preallocated x_space.
+             * Result is same as of svm-train read_problem, including number of first wrong line
+             */
+            class SvmLightReader{
+            private:
+                /**
+                 * part of file made of whole lines
+                 */
+                struct Chunk{
+                    const char* start;
+                    const char* end;
+                    //filled by count
+                    int lines;
+                    uint64_t elements;
+                    //filled by parse
+                    int errorLine;
+                    int maxIndex;
+                };
+
+                std::string file;
+                void* mapped;
+                size_t mappedSize;
+                std::vector<Chunk> chunks;
+
+                void split(int chunkNum);
+                static void count(Chunk& chunk);
+                /**
+                 * @param firstRow
+                 * index of first row of chunk in problem
+                 * @param firstElement
+                 * index of first node of chunk in x_space
+                 */
+                static void parse(Chunk& chunk, int firstRow, uint64_t firstElement, svm_problem& prob, svm_node* xSpace);
+            protected:
+            public:
+                SvmLightReader(const std::string& setFile) throw (SDException&);
+                virtual ~SvmLightReader();
+
+                /**
+                 * parse whole file. prob.y, prob.x and xSpace are allocated with malloc,
+                 * same as in svm-train, and are valid only if 0 is returned
+                 * @param maxIndex
+                 * largest parameter index in file
+                 * @return
+                 * 0 on success, otherwise number of first wrong line
+                 */
+                int read(svm_problem& prob, svm_node*& xSpace, int& maxIndex) throw (SDException&);
+            };
+
+        }
+    }
+}
+
+#endif
@@ -1,4 +1,6 @@
 #include "TrainingSet.h"
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include "core/util/raii/RAIIS.h"
@@ -6,6 +8,11 @@
 #include "core/opencv/OpenCV2Tools.h"
 #include "core/util/rtti/ObjectFactory.h"
 #include "core/tools/image/IImageParameters.h"
+#include "core/util/MemTracker.h"
+#include "core/util/Config.h"
+#include "core/util/Timer.h"
+#include "TrainingSetFile.h"
+#include "RowDeduplicator.h"
 
 namespace core{
     namespace tools{
@@ -38,100 +45,430 @@ namespace core{
                 }
             }
 
-            string getStr(const float* arr, int dimension) {
-                stringstream stream;
-                for (int i = 0; i < dimension; i++) {
-                    if (i == 0) {
-                        stream << arr[i];
-                    } else {
-                        stream << " " << i << ":" << arr[i];
+            void TrainingSet::init(){
+                pthread_mutex_init(&mutex, 0);
+                pthread_cond_init(&resultReady, 0);
+                pthread_cond_init(&slotFree, 0);
+#ifdef _OPENCL
+                pthread_mutex_init(&openCLMutex, 0);
+#endif
+                nextImage = 0;
+                nextToWrite = 0;
+                maxInFlight = 1;
+                aborted = false;
+                sampler = 0;
+                cache = 0;
+            }
+
+            static int getTrainingProperty(const string& key, int defaultValue){
+                const string* val = Config::getInstancePtr()->getSnapshot()->find(key);
+                if (val == 0 || atoi(val->c_str()) <= 0)
+                    return defaultValue;
+                return atoi(val->c_str());
+            }
+
+            void* TrainingSet::workerThread(void* arg){
+                TrainingSet* trainingSet = (TrainingSet*)arg;
+                trainingSet->work();
+                return 0;
+            }
+
+            void TrainingSet::work(){
+                int count = (int)images.size();
+                while (true){
+                    int index;
+                    {
+                        MutexRaii autoLock(&mutex);
+                        while (aborted == false && nextImage < count && nextImage >= nextToWrite + maxInFlight)
+                            pthread_cond_wait(&slotFree, &mutex);
+                        if (aborted || nextImage >= count)
+                            break;
+                        index = nextImage;
+                        nextImage++;
+                    }
+                    ImageResult result;
+                    result.parameters = 0;
+                    result.dimension = 0;
+                    result.pixelNum = 0;
+                    result.done = true;
+                    result.error = 0;
+                    result.cacheResult = FEATURE_CACHE_UNUSED;
+                    try{
+                        result.parameters = processImage(index, result.dimension, result.pixelNum, result.cacheResult);
+                        if (result.parameters == 0){
+                            result.error = New SDException(SHADOW_READ_UNABLE, "TrainingSet::processImages " + images[index].getFirst());
+                        }
+                    }
+                    catch (SDException& exception){
+                        result.error = New SDException(exception);
+                    }
+                    catch (std::exception& exception){
+                        //opencv and allocation errors, writer reports them as image error
+                        result.error = New SDException(SHADOW_OTHER, "TrainingSet::processImages " + images[index].getFirst() + ": " + exception.what());
+                    }
+                    catch (...){
+                        result.error = New SDException(SHADOW_OTHER, "TrainingSet::processImages " + images[index].getFirst());
                     }
+                    MutexRaii autoLock(&mutex);
+                    results[index] = result;
+                    pthread_cond_broadcast(&resultReady);
                 }
-                string retStr = stream.str();
-                return retStr;
             }
 
-            void TrainingSet::processImages(string output, bool outputAll) throw (SDException&) {
+            void TrainingSet::abortWorkers(vector<pthread_t>& workers){
+                {
+                    MutexRaii autoLock(&mutex);
+                    aborted = true;
+                    pthread_cond_broadcast(&slotFree);
+                }
+                for (size_t i = 0; i < workers.size(); i++){
+                    pthread_join(workers[i], 0);
+                }
+                workers.clear();
+                for (size_t i = nextToWrite; i < results.size(); i++){
+                    if (results[i].parameters != 0){
+                        Delete(results[i].parameters);
+                    }
+                    if (results[i].error != 0){
+                        Delete(results[i].error);
+                    }
+                }
+                results.clear();
+            }
+
+            void TrainingSet::planSampling(int threadNum) throw (SDException&){
+                int size = (int)images.size();
+                vector< vector<uint64_t> > counts(size, vector<uint64_t>(SAMPLER_CLASSES, 0));
+                if (sampler->keepsAll() == false){
+                    //only masks are read, parameters are computed later for kept pixels
+                    vector<char> readable(size, 1);
+                    int i;
+#if defined _OPENMP_MY
+#pragma omp parallel for private(i) num_threads(threadNum) schedule(dynamic)
+#endif
+                    for (i = 0; i < size; i++){
+                        Mat maskImage = cv::imread(images[i].getSecond(), CV_LOAD_IMAGE_GRAYSCALE);
+                        if (maskImage.data == 0){
+                            readable[i] = 0;
+                            continue;
+                        }
+                        PixelSampler::countClasses(maskImage, counts[i].data());
+                    }
+                    for (i = 0; i < size; i++){
+                        if (readable[i] == 0){
+                            SDException exc(SHADOW_READ_UNABLE, "TrainingSet::planSampling " + images[i].getSecond());
+                            throw exc;
+                        }
+                    }
+                }
+                sampler->plan(counts);
+                if (sampler->keepsAll() == false){
+                    uint64_t kept[SAMPLER_CLASSES] = {0};
+                    for (int i = 0; i < size; i++){
+                        for (int c = 0; c < SAMPLER_CLASSES; c++){
+                            kept[c] += sampler->getQuota(i, c);
+                        }
+                    }
+                    cout << "Sampling: " << kept[0] << " pixels of class 0, " << kept[1] << " pixels of class 1" << endl;
+                }
+            }
+
+            void TrainingSet::processImages(string output, bool binary) throw (SDException&) {
                 fstream file;
-                file.open(output.c_str(), fstream::out | fstream::trunc);
+                if (binary == false)
+                    file.open(output.c_str(), fstream::out | fstream::trunc);
                 FileRaii fRaii(&file);
-                if (file.is_open()) {
-                    size_t size = images.size();
-                    bool first = true;
-                    for (uint i = 0; i < size; i++) {
-                        Pair<string> pair = images[i];
-                        cout << "processing: " << pair.getFirst() << endl;
-                        int dimension = 0;
-                        int pixelNum = 0;
-                        const Matrix<float>* processed = processImage(pair.getFirst(), pair.getSecond(), dimension, pixelNum);
-                        cout << "Size: " << pixelNum;
-                        if (processed != 0) {
-                            //to have same number of 1s and 0s
-                            bool write0 = true;
-                            for (int j = 0; j < pixelNum; j++) {                                
-                                bool succ = false;
-                                if (outputAll == false){                                
-                                    if (write0){
-                                        if ((*processed)[j][0] == 0.f)
-                                            succ = true;
-                                    }
-                                    else{
-                                        if ((*processed)[j][0] != 0.f)
-                                            succ = true;
-                                    }
-                                }
-                                else
-                                    succ = true;
-                                if (succ){
-                                    string str = getStr((*processed)[j], dimension);
-                                    string tmp = str.substr(0, 2);
-                                    if (tmp.compare("1 ") != 0 && tmp.compare("0 ") != 0){
-                                        cout << "Error create train set, label value: " << tmp << endl;
-                                    }
-                                    
-                                    if (first == false) {
-                                        file << endl;
-                                    }
-                                    file << str;
-                                    first = false;
-                                    write0 = !write0;
-                                }                                
-                            }
-                            Delete(processed);
+                if (binary == false && file.is_open() == false) {
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSet::processImages");
+                    throw exc;
+                }
+                //created with first image, when dimension is known
+                UNIQUE_PTR(TrainingSetWriter) writer;
+                UNIQUE_PTR(RowDeduplicator) dedup;
+                const string* dedupStr = Config::getInstancePtr()->getSnapshot()->find("general.Training.dedup.enabled");
+                bool dedupEnabled = dedupStr != 0 && dedupStr->compare("true") == 0;
+                int dedupLevels = getTrainingProperty("general.Training.dedup.levels", 256);
+                string weightsFile = output + TRAINING_SET_WEIGHTS_SUFFIX;
+                //weights of previous set with same name don't belong to this one
+                remove(weightsFile.c_str());
+
+                int size = (int)images.size();
+                int threadNum = getTrainingProperty("general.Training.makeset.threadNum",
+                                                    Config::getInstancePtr()->getSettings().openMPThreadNum);
+                if (threadNum > size)
+                    threadNum = size;
+                //at least one worker, writer waits for results of workers
+                if (threadNum < 1)
+                    threadNum = 1;
+                maxInFlight = getTrainingProperty("general.Training.makeset.maxInFlight", 2 * threadNum);
+                if (maxInFlight < threadNum)
+                    maxInFlight = threadNum;
+                planSampling(threadNum);
+
+                ImageResult empty;
+                empty.parameters = 0;
+                empty.dimension = 0;
+                empty.pixelNum = 0;
+                empty.done = false;
+                empty.error = 0;
+                empty.cacheResult = FEATURE_CACHE_UNUSED;
+                results.assign(size, empty);
+                nextImage = 0;
+                nextToWrite = 0;
+                aborted = false;
+
+                vector<pthread_t> workers;
+                for (int i = 0; i < threadNum; i++){
+                    pthread_t worker;
+                    if (pthread_create(&worker, 0, TrainingSet::workerThread, this) != 0){
+                        abortWorkers(workers);
+                        SDException exc(SHADOW_OTHER, "TrainingSet::processImages pthread_create");
+                        throw exc;
+                    }
+                    workers.push_back(worker);
+                }
+                cout << "Makeset workers: " << threadNum << ", images in flight: " << maxInFlight << endl;
+
+                Timer timer;
+                uint64_t totalPixels = 0;
+                int cacheCounts[FEATURE_CACHE_NOT_STORED + 1] = {0};
+                bool first = true;
+                auto writeRow = [&](float label, const float* values, int dims, float weight){
+                    if (binary){
+                        writer->addRow(label, values, weight);
+                        return;
+                    }
+                    if (first == false) {
+                        file << '\n';
+                    }
+                    file << label;
+                    for (int k = 0; k < dims; k++) {
+                        file << " " << (k + 1) << ":" << values[k];
+                    }
+                    first = false;
+                };
+                try{
+                    for (int i = 0; i < size; i++) {
+                        ImageResult result;
+                        {
+                            MutexRaii autoLock(&mutex);
+                            while (results[i].done == false)
+                                pthread_cond_wait(&resultReady, &mutex);
+                            result = results[i];
+                            nextToWrite = i + 1;
+                            pthread_cond_broadcast(&slotFree);
                         }
-                        else{
-                            SDException exc(SHADOW_READ_UNABLE, "TrainingSet::processImages");
+                        UNIQUE_PTR(const Matrix<float>) processedPtr(result.parameters);
+                        UNIQUE_PTR(SDException) errorPtr(result.error);
+                        cacheCounts[result.cacheResult]++;
+                        cout << "processing: " << images[i].getFirst() << endl;
+                        if (errorPtr.get() != 0){
+                            SDException exc(*errorPtr);
                             throw exc;
                         }
+                        const Matrix<float>* processed = processedPtr.get();
+                        int dimension = result.dimension;
+                        int pixelNum = result.pixelNum;
+                        cout << "Size: " << pixelNum << endl;
+                        if (pixelNum == 0)
+                            continue;
+                        if (binary){
+                            if (writer.get() == 0){
+                                writer.reset(New TrainingSetWriter(output, dimension - 1, TRAINING_LABEL_CLASS));
+                            }
+                            else if (writer->getDims() != dimension - 1){
+                                SDException exc(SHADOW_DIFFERENT_IMAGES_SIZES, "TrainingSet::processImages dimension");
+                                throw exc;
+                            }
+                        }
+                        if (dedupEnabled){
+                            if (dedup.get() == 0){
+                                dedup.reset(New RowDeduplicator(dimension - 1, dedupLevels));
+                            }
+                            else if (dedup->getDims() != dimension - 1){
+                                SDException exc(SHADOW_DIFFERENT_IMAGES_SIZES, "TrainingSet::processImages dimension");
+                                throw exc;
+                            }
+                        }
+                        //rows are already chosen by sampler
+                        for (int j = 0; j < pixelNum; j++) {
+                            const float* row = (*processed)[j];
+                            if (row[0] != 0.f && row[0] != 1.f){
+                                cout << "Error create train set, label value: " << row[0] << endl;
+                            }
+                            if (dedupEnabled)
+                                dedup->add(row[0], row + 1);
+                            else
+                                writeRow(row[0], row + 1, dimension - 1, 1.f);
+                        }
+                        totalPixels += pixelNum;
                     }
-                } else {
-                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSet::processImages");
+                }
+                catch (...){
+                    //workers use results and this object, they must finish before unwinding
+                    abortWorkers(workers);
+                    throw;
+                }
+                for (size_t i = 0; i < workers.size(); i++){
+                    pthread_join(workers[i], 0);
+                }
+                results.clear();
+
+                if (dedup.get() != 0){
+                    //unique rows with number of collapsed rows as instance weight
+                    fstream weights;
+                    if (binary == false)
+                        weights.open(weightsFile.c_str(), fstream::out | fstream::trunc);
+                    FileRaii wRaii(&weights);
+                    if (binary == false && weights.is_open() == false){
+                        SDException exc(SHADOW_WRITE_UNABLE, "TrainingSet::processImages weights");
+                        throw exc;
+                    }
+                    for (uint64_t i = 0; i < dedup->getRows(); i++){
+                        float weight = (float)dedup->getCount(i);
+                        writeRow(dedup->getLabel(i), dedup->getRow(i), dedup->getDims(), weight);
+                        if (binary == false)
+                            //counts are written exactly, default stream precision rounds them from 1e6
+                            weights << dedup->getCount(i) << '\n';
+                    }
+                    if (binary == false && weights.good() == false){
+                        SDException exc(SHADOW_WRITE_UNABLE, "TrainingSet::processImages weights write");
+                        throw exc;
+                    }
+                    cout << "Dedup: " << dedup->getAdded() << " rows collapsed to " << dedup->getRows() << " unique rows" << endl;
+                }
+
+                if (writer.get() != 0){
+                    writer->close();
+                    cout << "Binary set: " << writer->getRows() << " rows, " << writer->getDims() << " parameters" << endl;
+                }
+                else if (file.good() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSet::processImages write");
                     throw exc;
                 }
+                if (cache != 0){
+                    cout << "Feature cache: " << cacheCounts[FEATURE_CACHE_HIT] << " images read, " << cacheCounts[FEATURE_CACHE_STORED]
+                            << " stored, " << cacheCounts[FEATURE_CACHE_NOT_STORED] << " not stored" << endl;
+                }
+                double seconds = timer.sinceStart() / 1000.;
+                double pixelsPerSec = seconds > 0. ? totalPixels / seconds : 0.;
+                cout << "Makeset: " << size << " images, " << totalPixels << " pixels in " << seconds << " s, "
+                        << pixelsPerSec << " pixels/s" << endl;
             }
 
-            Matrix<float>* TrainingSet::processImage(std::string orImage, std::string maskImg, int& rowDimesion, int& pixelNum) {
-                Mat originalImage = cv::imread(orImage, CV_LOAD_IMAGE_COLOR);
-                Mat maskImage = cv::imread(maskImg, CV_LOAD_IMAGE_GRAYSCALE);
-
-                if (originalImage.data == 0 || maskImage.data == 0) {
+            Matrix<float>* TrainingSet::processImage(int index, int& rowDimesion, int& pixelNum, int& cacheResult) throw (SDException&) {
+                //files are read once, for content hash and for decoding
+                vector<unsigned char> imageBytes;
+                vector<unsigned char> maskBytes;
+                if (FeatureCache::readFile(images[index].getFirst(), imageBytes) == false ||
+                    FeatureCache::readFile(images[index].getSecond(), maskBytes) == false){
+                    return 0;
+                }
+                Mat maskImage = cv::imdecode(maskBytes, CV_LOAD_IMAGE_GRAYSCALE);
+                if (maskImage.data == 0)
                     return 0;
-                }                
+                uint64_t content = FeatureCache::hashContent(imageBytes, maskBytes);
+                bool all = sampler->keepsAll();
+                vector<uint> pixels;
+                if (all == false)
+                    sampler->select(index, content, maskImage, pixels);
+                if (cache == 0){
+                    Mat originalImage = cv::imdecode(imageBytes, CV_LOAD_IMAGE_COLOR);
+                    if (originalImage.data == 0)
+                        return 0;
+                    return computeParameters(originalImage, maskImage, all, pixels, rowDimesion, pixelNum);
+                }
+
+                //shard has rows of all pixels, so it is used by any sampling
+                uint64_t key = cache->getKey(content);
+                Matrix<float>* allRows = cache->read(key, rowDimesion, pixelNum);
+                if (allRows != 0 && (uint64_t)pixelNum != (uint64_t)maskImage.rows * maskImage.cols){
+                    Delete(allRows);
+                    allRows = 0;
+                }
+                if (allRows != 0)
+                    cacheResult = FEATURE_CACHE_HIT;
+                else{
+                    Mat originalImage = cv::imdecode(imageBytes, CV_LOAD_IMAGE_COLOR);
+                    if (originalImage.data == 0)
+                        return 0;
+                    allRows = computeParameters(originalImage, maskImage, true, pixels, rowDimesion, pixelNum);
+                    if (allRows == 0)
+                        return 0;
+                    if (pixelNum > 0)
+                        cacheResult = cache->write(key, *allRows, rowDimesion, pixelNum) ? FEATURE_CACHE_STORED : FEATURE_CACHE_NOT_STORED;
+                }
+                if (all)
+                    return allRows;
+                return selectRows(allRows, rowDimesion, pixels, pixelNum);
+            }
+
+            Matrix<float>* TrainingSet::selectRows(Matrix<float>* allRows, int rowDimesion, const vector<uint>& pixels, int& pixelNum){
+                UNIQUE_PTR(Matrix<float>) allPtr(allRows);
+                pixelNum = (int)pixels.size();
+                Matrix<float>* retVec = New Matrix<float>(rowDimesion, pixelNum);
+                for (int i = 0; i < pixelNum; i++){
+                    memcpy(retVec->getVec() + (size_t)i * rowDimesion, allRows->getVec() + (size_t)pixels[i] * rowDimesion, rowDimesion * sizeof(float));
+                }
+                return retVec;
+            }
+
+            Matrix<float>* TrainingSet::computeParameters(  const Mat& originalImage, const Mat& maskImage,
+                                                            bool all, const vector<uint>& pixels,
+                                                            int& rowDimesion, int& pixelNum) throw (SDException&) {
                 UNIQUE_PTR(IImageParameteres) ipPtr(ObjectFactory::getInstancePtr()->createImageParameters());
-                Matrix<float>* retVec = ipPtr->getImageParameters( originalImage, maskImage, 
-                                                                rowDimesion, pixelNum);                
+                vector<const Mat*> imagesVec;
+                imagesVec.push_back(&originalImage);
+                if (all){
+#ifdef _OPENCL
+                    MutexRaii autoLock(&openCLMutex);
+#endif
+                    Matrix<float>* retVec = ipPtr->getImageParameters(  imagesVec, maskImage,
+                                                                        rowDimesion, pixelNum);
+                    return retVec;
+                }
+                Matrix<float>* retVec = ipPtr->getImageParameters(imagesVec, maskImage, pixels, rowDimesion, pixelNum);
                 return retVec;
             }
 
-            TrainingSet::TrainingSet() {
+            void TrainingSet::openCache(){
+                if (cache != 0){
+                    Delete(cache);
+                    cache = 0;
+                }
+                const string* dirStr = Config::getInstancePtr()->getSnapshot()->find("general.Training.makeset.cacheDir");
+                if (dirStr == 0 || *dirStr == "")
+                    return;
+                //shards of other extractor or its other version are never used
+                const string* versionStr = Config::getInstancePtr()->getSnapshot()->find("general.Training.makeset.featureVersion");
+                string extractor = Config::getInstancePtr()->getPropertyValue("general.Prediction.parametersClass");
+                extractor += ":" + (versionStr != 0 ? *versionStr : string("1"));
+                cache = New FeatureCache(*dirStr, extractor);
+                cout << "Feature cache: " << *dirStr << ", extractor " << extractor << endl;
+            }
 
+            TrainingSet::TrainingSet() {
+                init();
             }
 
             TrainingSet::~TrainingSet() {
                 clear();
+                if (sampler != 0){
+                    Delete(sampler);
+                }
+                if (cache != 0){
+                    Delete(cache);
+                }
+                pthread_mutex_destroy(&mutex);
+                pthread_cond_destroy(&resultReady);
+                pthread_cond_destroy(&slotFree);
+#ifdef _OPENCL
+                pthread_mutex_destroy(&openCLMutex);
+#endif
             }
 
             TrainingSet::TrainingSet(std::string filePath) {
+                init();
                 setFilePath(filePath);
             }
 
@@ -139,9 +476,20 @@ namespace core{
                 this->filePath = filePath;
             }
 
-            void TrainingSet::process(string output, bool processAll) throw (SDException&) {
+            void TrainingSet::process(string output, bool processAll, bool binary) throw (SDException&) {
                 readFile();
-                processImages(output, processAll);
+                uint64_t seed = 1;
+                const string* seedStr = Config::getInstancePtr()->getSnapshot()->find("general.Training.sampling.seed");
+                if (seedStr != 0 && *seedStr != "")
+                    seed = strtoull(seedStr->c_str(), 0, 10);
+                uint64_t samplesPerClass = getTrainingProperty("general.Training.sampling.samplesPerClass", 0);
+                uint64_t maxPerImage = getTrainingProperty("general.Training.sampling.maxPerImage", 0);
+                if (sampler != 0){
+                    Delete(sampler);
+                }
+                sampler = New PixelSampler(seed, samplesPerClass, maxPerImage, !processAll);
+                openCache();
+                processImages(output, binary);
             }
 
             void TrainingSet::clear() {
@@ -1,28 +1,118 @@
-#ifndef __TRAINING_SET_H__ 
+#ifndef __TRAINING_SET_H__
 #define __TRAINING_SET_H__
 
 #include <fstream>
+#include <pthread.h>
 #include "typedefs.h"
 #include "core/util/Matrix.h"
+#include "PixelSampler.h"
+#include "FeatureCache.h"
 
 namespace core{
     namespace tools{
         namespace svm{
+            /**
+             * Makes training set from list of image, mask pairs.
+             * Pixels are chosen by PixelSampler (general.Training.sampling) from masks before
+             * parameters are computed, so only kept pixels are processed.
+             * Pairs are processed concurrently by general.Training.makeset.threadNum workers,
+             * results are written by calling thread in order of list, so output doesn't depend
+             * on number of workers. At most general.Training.makeset.maxInFlight processed
+             * images wait for writer. With general.Training.dedup.enabled rows are collapsed
+             * by RowDeduplicator and unique rows are written with counts as instance weights
+             * (binary set weights section or TRAINING_SET_WEIGHTS_SUFFIX file of text set).
+             * With general.Training.makeset.cacheDir rows of each image are kept in FeatureCache
+             * and images whose shard exists aren't decoded or processed
+             */
             class TrainingSet{
             private:
+                /**
+                 * parameters of one image, filled by worker and consumed by writer
+                 */
+                struct ImageResult{
+                    core::util::Matrix<float>* parameters;
+                    int dimension;
+                    int pixelNum;
+                    bool done;
+                    SDException* error;
+                    /**
+                     * FEATURE_CACHE_RESULT
+                     */
+                    int cacheResult;
+                };
+
                 std::string filePath;
                 std::vector< Pair<std::string> > images;
+                PixelSampler* sampler;
+                FeatureCache* cache;
+
+                //shared between workers and writer during processImages
+                pthread_mutex_t mutex;
+                pthread_cond_t resultReady;
+                pthread_cond_t slotFree;
+#ifdef _OPENCL
+                /**
+                 * without device session openCL tools are shared singletons
+                 */
+                pthread_mutex_t openCLMutex;
+#endif
+                std::vector<ImageResult> results;
+                int nextImage;
+                int nextToWrite;
+                int maxInFlight;
+                bool aborted;
 
                 void readFile() throw (SDException&);
-                void processImages(std::string output, bool outputAll) throw (SDException&);
-                core::util::Matrix<float>* processImage(std::string orImage, std::string maskImage, int& rowDimesion, int& pixelNum);
+                void processImages(std::string output, bool binary) throw (SDException&);
+                core::util::Matrix<float>* processImage(int index, int& rowDimesion, int& pixelNum, int& cacheResult) throw (SDException&);
+                /**
+                 * parameters of decoded image and mask
+                 * @param all
+                 * rows of every pixel, pixels are ignored
+                 * @param pixels
+                 * chosen pixels
+                 */
+                core::util::Matrix<float>* computeParameters(const cv::Mat& originalImage, const cv::Mat& maskImage,
+                                                             bool all, const std::vector<uint>& pixels,
+                                                             int& rowDimesion, int& pixelNum) throw (SDException&);
+                /**
+                 * rows of chosen pixels, rows of all pixels are deleted
+                 */
+                static core::util::Matrix<float>* selectRows(core::util::Matrix<float>* allRows, int rowDimesion,
+                                                             const std::vector<uint>& pixels, int& pixelNum);
+                /**
+                 * FeatureCache of general.Training.makeset.cacheDir, 0 if it isn't set
+                 */
+                void openCache();
+                /**
+                 * count classes in all masks and plan sampling
+                 */
+                void planSampling(int threadNum) throw (SDException&);
+                /**
+                 * worker loop, takes next image while writer is less than maxInFlight images behind
+                 */
+                void work();
+                static void* workerThread(void* arg);
+                /**
+                 * stop workers and free results which weren't written
+                 */
+                void abortWorkers(std::vector<pthread_t>& workers);
+                void init();
             protected:
             public:
                 TrainingSet();
                 ~TrainingSet();
                 TrainingSet(std::string filePath);
                 void setFilePath(std::string filePath);
-                void process(std::string output, bool processAll) throw (SDException&);
+                /**
+                 * @param output
+                 * training set file
+                 * @param processAll
+                 * don't balance number of 0s and 1s
+                 * @param binary
+                 * write binary set (TrainingSetFile) instead of svmlight text
+                 */
+                void process(std::string output, bool processAll, bool binary) throw (SDException&);
                 void clear();
             };
         }
@@ -0,0 +1,402 @@
+#include "TrainingSetFile.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "core/util/raii/RAIIS.h"
+#include "core/util/Bytes.h"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            using namespace std;
+            using namespace core::util;
+            using namespace core::util::raii;
+
+            static uint64_t alignSetOffset(uint64_t offset){
+                return alignOffset(offset, TRAINING_SET_ALIGN);
+            }
+
+            static SDException lineException(const string& file, uint64_t lineNum){
+                stringstream stream;
+                stream << "TrainingSetFile: wrong input format at line " << lineNum << " of " << file;
+                SDException exc(SHADOW_READ_UNABLE, stream.str());
+                return exc;
+            }
+
+            /**
+             * parse one svmlight line, calls setValue for every index:value pair
+             * @param maxIndex
+             * largest valid index
+             * @return
+             * false if line is empty or malformed or some index is above maxIndex
+             */
+            template<typename F> static bool parseTextLine(const string& line, int maxIndex, double& label, F setValue){
+                const char* curr = line.c_str();
+                char* end;
+                label = strtod(curr, &end);
+                if (end == curr)
+                    return false;
+                curr = end;
+                int lastIndex = 0;
+                while (true){
+                    while (*curr == ' ' || *curr == '\t' || *curr == '\r')
+                        curr++;
+                    if (*curr == '\0')
+                        break;
+                    errno = 0;
+                    long index = strtol(curr, &end, 10);
+                    if (end == curr || *end != ':' || errno != 0 || index <= lastIndex || index > maxIndex)
+                        return false;
+                    curr = end + 1;
+                    double value = strtod(curr, &end);
+                    if (end == curr || errno != 0)
+                        return false;
+                    curr = end;
+                    lastIndex = (int)index;
+                    setValue(lastIndex, value);
+                }
+                return true;
+            }
+
+            TrainingSetWriter::TrainingSetWriter(const string& outFile, int dimension, int labelKind) throw (SDException&){
+                file = outFile;
+                dims = dimension;
+                labelType = labelKind;
+                rowWidth = (dims + TRAINING_SET_ROW_ALIGN - 1) / TRAINING_SET_ROW_ALIGN * TRAINING_SET_ROW_ALIGN;
+                rowBuffer.assign(rowWidth, 0.f);
+                output.open(file.c_str(), fstream::out | fstream::binary | fstream::trunc);
+                if (output.is_open() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSetWriter: " + file);
+                    throw exc;
+                }
+                //header is rewritten on close, when number of rows is known
+                written = 0;
+                writePadding(alignSetOffset(sizeof(TrainingSetHeader)));
+            }
+
+            TrainingSetWriter::~TrainingSetWriter(){
+                if (output.is_open())
+                    output.close();
+            }
+
+            void TrainingSetWriter::writePadding(uint64_t toOffset){
+                static const char padding[TRAINING_SET_ALIGN] = {0};
+                while (written < toOffset){
+                    uint64_t count = toOffset - written;
+                    if (count > TRAINING_SET_ALIGN)
+                        count = TRAINING_SET_ALIGN;
+                    output.write(padding, count);
+                    written += count;
+                }
+            }
+
+            void TrainingSetWriter::addRow(float label, const float* values, float weight){
+                memcpy(rowBuffer.data(), values, dims * sizeof(float));
+                output.write((const char*)rowBuffer.data(), rowWidth * sizeof(float));
+                written += rowWidth * sizeof(float);
+                labels.push_back(label);
+                weights.push_back(weight);
+            }
+
+            void TrainingSetWriter::close() throw (SDException&){
+                TrainingSetHeader header;
+                memset(&header, 0, sizeof(TrainingSetHeader));
+                memcpy(header.magic, TRAINING_SET_MAGIC, 8);
+                header.formatVersion = TRAINING_SET_VERSION;
+                header.labelType = labelType;
+                header.rows = labels.size();
+                header.dims = dims;
+                header.rowWidth = rowWidth;
+                header.dataOffset = alignSetOffset(sizeof(TrainingSetHeader));
+
+                header.labelsOffset = alignSetOffset(written);
+                writePadding(header.labelsOffset);
+                output.write((const char*)labels.data(), labels.size() * sizeof(float));
+                written += labels.size() * sizeof(float);
+
+                bool weighted = false;
+                for (size_t i = 0; i < weights.size() && weighted == false; i++){
+                    weighted = weights[i] != 1.f;
+                }
+                if (weighted){
+                    header.weightsOffset = alignSetOffset(written);
+                    writePadding(header.weightsOffset);
+                    output.write((const char*)weights.data(), weights.size() * sizeof(float));
+                    written += weights.size() * sizeof(float);
+                }
+                header.fileSize = alignSetOffset(written);
+                writePadding(header.fileSize);
+
+                output.seekp(0);
+                output.write((const char*)&header, sizeof(TrainingSetHeader));
+                bool good = output.good();
+                output.close();
+                if (good == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSetWriter::close: " + file);
+                    throw exc;
+                }
+            }
+
+            uint64_t TrainingSetWriter::getRows() const{
+                return labels.size();
+            }
+
+            int TrainingSetWriter::getDims() const{
+                return dims;
+            }
+
+            TrainingSetFile::TrainingSetFile(const string& setFile) throw (SDException&){
+                file = setFile;
+                mapped = 0;
+                mappedSize = 0;
+                int fd = open(file.c_str(), O_RDONLY);
+                if (fd < 0){
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile: " + file);
+                    throw exc;
+                }
+                struct stat fileStat;
+                if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(TrainingSetHeader)){
+                    ::close(fd);
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile size: " + file);
+                    throw exc;
+                }
+                mappedSize = fileStat.st_size;
+                mapped = mmap(0, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (mapped == MAP_FAILED){
+                    mapped = 0;
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile mmap: " + file);
+                    throw exc;
+                }
+                //rows are read once, from start to end
+                madvise(mapped, mappedSize, MADV_SEQUENTIAL);
+
+                const char* base = (const char*)mapped;
+                header = (const TrainingSetHeader*)base;
+                bool valid = memcmp(header->magic, TRAINING_SET_MAGIC, 8) == 0 &&
+                            (header->formatVersion == 1 || header->formatVersion == TRAINING_SET_VERSION) &&
+                            header->fileSize == mappedSize &&
+                            (header->labelType == TRAINING_LABEL_CLASS || header->labelType == TRAINING_LABEL_REAL) &&
+                            header->dims > 0 && header->rowWidth >= header->dims &&
+                            header->rowWidth % TRAINING_SET_ROW_ALIGN == 0;
+                //each section must lie inside of file
+                if (valid){
+                    uint64_t rowSize = (uint64_t)header->rowWidth * sizeof(float);
+                    valid = header->rows <= mappedSize / rowSize &&
+                            header->dataOffset >= sizeof(TrainingSetHeader) && header->dataOffset % sizeof(float) == 0 &&
+                            header->labelsOffset >= sizeof(TrainingSetHeader) && header->labelsOffset % sizeof(float) == 0 &&
+                            header->dataOffset + header->rows * rowSize <= mappedSize &&
+                            header->labelsOffset + header->rows * sizeof(float) <= mappedSize;
+                }
+                //version 1 has no weights, field is in header padding
+                uint64_t weightsOffset = header->formatVersion == 1 ? 0 : header->weightsOffset;
+                if (valid && weightsOffset != 0){
+                    valid = weightsOffset >= sizeof(TrainingSetHeader) && weightsOffset % sizeof(float) == 0 &&
+                            weightsOffset + header->rows * sizeof(float) <= mappedSize;
+                }
+                if (valid == false){
+                    munmap(mapped, mappedSize);
+                    mapped = 0;
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile invalid header: " + file);
+                    throw exc;
+                }
+                data = (const float*)(base + header->dataOffset);
+                labels = (const float*)(base + header->labelsOffset);
+                weights = weightsOffset != 0 ? (const float*)(base + weightsOffset) : 0;
+            }
+
+            TrainingSetFile::~TrainingSetFile(){
+                if (mapped != 0)
+                    munmap(mapped, mappedSize);
+            }
+
+            bool TrainingSetFile::isBinary(const string& setFile){
+                char magic[8];
+                ifstream input(setFile.c_str(), ifstream::in | ifstream::binary);
+                if (input.is_open() == false)
+                    return false;
+                input.read(magic, 8);
+                return input.gcount() == 8 && memcmp(magic, TRAINING_SET_MAGIC, 8) == 0;
+            }
+
+            void TrainingSetFile::convert(const string& input, const string& output) throw (SDException&){
+                if (isBinary(input))
+                    binaryToText(input, output);
+                else
+                    textToBinary(input, output);
+            }
+
+            bool TrainingSetFile::readWeights(const string& setFile, vector<float>& weights) throw (SDException&){
+                weights.clear();
+                string weightsFile = setFile + TRAINING_SET_WEIGHTS_SUFFIX;
+                fstream file;
+                file.open(weightsFile.c_str(), fstream::in);
+                FileRaii fRaii(&file);
+                if (file.is_open() == false)
+                    return false;
+                string line;
+                uint64_t lineNum = 0;
+                while (getline(file, line)){
+                    lineNum++;
+                    if (line.find_first_not_of(" \t\r") == string::npos)
+                        continue;
+                    char* end;
+                    double weight = strtod(line.c_str(), &end);
+                    if (end == line.c_str() || weight <= 0.)
+                        throw lineException(weightsFile, lineNum);
+                    weights.push_back((float)weight);
+                }
+                return true;
+            }
+
+            void TrainingSetFile::textToBinary(const string& input, const string& output) throw (SDException&){
+                fstream file;
+                file.open(input.c_str(), fstream::in);
+                FileRaii fRaii(&file);
+                if (file.is_open() == false){
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile::textToBinary: " + input);
+                    throw exc;
+                }
+                //first pass finds dimension and type of labels
+                string line;
+                uint64_t lineNum = 0;
+                int dims = 0;
+                bool integerLabels = true;
+                double label;
+                while (getline(file, line)){
+                    lineNum++;
+                    if (line.find_first_not_of(" \t\r") == string::npos)
+                        continue;
+                    bool succ = parseTextLine(line, INT_MAX, label, [&dims](int index, double value){
+                        if (index > dims)
+                            dims = index;
+                    });
+                    if (succ == false)
+                        throw lineException(input, lineNum);
+                    if (label != floor(label))
+                        integerLabels = false;
+                }
+                if (dims == 0){
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile::textToBinary empty set: " + input);
+                    throw exc;
+                }
+
+                vector<float> weights;
+                readWeights(input, weights);
+                file.clear();
+                file.seekg(0);
+                TrainingSetWriter writer(output, dims, integerLabels ? TRAINING_LABEL_CLASS : TRAINING_LABEL_REAL);
+                vector<float> row(dims);
+                size_t rowNum = 0;
+                lineNum = 0;
+                while (getline(file, line)){
+                    lineNum++;
+                    if (line.find_first_not_of(" \t\r") == string::npos)
+                        continue;
+                    row.assign(dims, 0.f);
+                    //file can change between passes
+                    bool succ = parseTextLine(line, dims, label, [&row](int index, double value){
+                        row[index - 1] = (float)value;
+                    });
+                    if (succ == false)
+                        throw lineException(input, lineNum);
+                    if (weights.empty() == false && rowNum >= weights.size()){
+                        SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile::textToBinary weights count: " + input);
+                        throw exc;
+                    }
+                    writer.addRow((float)label, row.data(), weights.empty() ? 1.f : weights[rowNum]);
+                    rowNum++;
+                }
+                if (weights.empty() == false && rowNum != weights.size()){
+                    SDException exc(SHADOW_READ_UNABLE, "TrainingSetFile::textToBinary weights count: " + input);
+                    throw exc;
+                }
+                writer.close();
+            }
+
+            void TrainingSetFile::binaryToText(const string& input, const string& output) throw (SDException&){
+                TrainingSetFile set(input);
+                fstream file;
+                file.open(output.c_str(), fstream::out | fstream::trunc);
+                FileRaii fRaii(&file);
+                if (file.is_open() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSetFile::binaryToText: " + output);
+                    throw exc;
+                }
+                //same layout as makeset text output
+                for (uint64_t i = 0; i < set.getRows(); i++){
+                    if (i > 0)
+                        file << '\n';
+                    file << set.getLabels()[i];
+                    const float* row = set.getRow(i);
+                    for (int j = 0; j < set.getDims(); j++){
+                        file << " " << (j + 1) << ":" << row[j];
+                    }
+                }
+                if (file.good() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSetFile::binaryToText write: " + output);
+                    throw exc;
+                }
+
+                string weightsFile = output + TRAINING_SET_WEIGHTS_SUFFIX;
+                if (set.getWeights() == 0){
+                    //weights of previous set with same name don't belong to this one
+                    remove(weightsFile.c_str());
+                    return;
+                }
+                fstream weights;
+                weights.open(weightsFile.c_str(), fstream::out | fstream::trunc);
+                FileRaii wRaii(&weights);
+                for (uint64_t i = 0; i < set.getRows(); i++){
+                    weights << set.getWeights()[i] << '\n';
+                }
+                if (weights.good() == false){
+                    SDException exc(SHADOW_WRITE_UNABLE, "TrainingSetFile::binaryToText weights: " + weightsFile);
+                    throw exc;
+                }
+            }
+
+            uint64_t TrainingSetFile::getRows() const{
+                return header->rows;
+            }
+
+            int TrainingSetFile::getDims() const{
+                return header->dims;
+            }
+
+            int TrainingSetFile::getRowWidth() const{
+                return header->rowWidth;
+            }
+
+            int TrainingSetFile::getLabelType() const{
+                return header->labelType;
+            }
+
+            const float* TrainingSetFile::getData() const{
+                return data;
+            }
+
+            const float* TrainingSetFile::getRow(uint64_t row) const{
+                return data + row * header->rowWidth;
+            }
+
+            const float* TrainingSetFile::getLabels() const{
+                return labels;
+            }
+
+            const float* TrainingSetFile::getWeights() const{
+                return weights;
+            }
+
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef __TRAINING_SET_FILE_H__
+#define __TRAINING_SET_FILE_H__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include "typedefs.h"
+
+/**
+ * first bytes of binary training set file
+ */
+#define TRAINING_SET_MAGIC "SDSETBIN"
+#define TRAINING_SET_VERSION 2
+/**
+ * alignment of sections in binary training set file, in bytes
+ */
+#define TRAINING_SET_ALIGN 64
+/**
+ * rows are padded to multiple of this number of floats
+ */
+#define TRAINING_SET_ROW_ALIGN 4
+/**
+ * instance weights of text set are in file with this suffix, one weight per line
+ */
+#define TRAINING_SET_WEIGHTS_SUFFIX ".weights"
+
+namespace core{
+    namespace tools{
+        namespace svm{
+
+            enum TRAINING_LABEL_TYPE{
+                /**
+                 * integer class labels (0 and 1 from makeset)
+                 */
+                TRAINING_LABEL_CLASS = 0,
+                /**
+                 * real target values
+                 */
+                TRAINING_LABEL_REAL
+            };
+
+            /**
+             * header of binary training set file. Sections follow at header offsets:
+             * data (rows of rowWidth floats, first dims used, rest are 0),
+             * labels (rows floats) and, from version 2, optional instance weights
+             * (rows floats, weightsOffset is 0 if set isn't weighted). Values are in host byte order
+             */
+            struct TrainingSetHeader{
+                char magic[8];
+                uint32_t formatVersion;
+                int32_t labelType;
+                uint64_t rows;
+                int32_t dims;
+                int32_t rowWidth;
+                uint64_t dataOffset;
+                uint64_t labelsOffset;
+                uint64_t fileSize;
+                uint64_t weightsOffset;
+            };
+
+            /**
+             * Streams rows into binary training set file. Rows are written as they come,
+             * labels are kept in memory and written with header on close
+             */
+            class TrainingSetWriter{
+            private:
+                std::string file;
+                std::fstream output;
+                int dims;
+                int rowWidth;
+                int labelType;
+                std::vector<float> labels;
+                std::vector<float> weights;
+                std::vector<float> rowBuffer;
+                uint64_t written;
+
+                void writePadding(uint64_t toOffset);
+            protected:
+            public:
+                /**
+                 * @param outFile
+                 * output file, truncated
+                 * @param dimension
+                 * number of parameters in row, without label
+                 * @param labelKind
+                 * TRAINING_LABEL_TYPE
+                 */
+                TrainingSetWriter(const std::string& outFile, int dimension, int labelKind) throw (SDException&);
+                virtual ~TrainingSetWriter();
+
+                /**
+                 * @param label
+                 * @param values
+                 * dims values
+                 * @param weight
+                 * instance weight, weights are written only if some of them isn't 1
+                 */
+                void addRow(float label, const float* values, float weight = 1.f);
+                /**
+                 * write labels and header, writer can't be used after close
+                 */
+                void close() throw (SDException&);
+                uint64_t getRows() const;
+                int getDims() const;
+            };
+
+            /**
+             * Binary training set mapped with mmap. Rows and labels are used in place,
+             * without parsing or copying
+             */
+            class TrainingSetFile{
+            private:
+                std::string file;
+                void* mapped;
+                size_t mappedSize;
+                const TrainingSetHeader* header;
+                const float* data;
+                const float* labels;
+                const float* weights;
+
+                static void textToBinary(const std::string& input, const std::string& output) throw (SDException&);
+                static void binaryToText(const std::string& input, const std::string& output) throw (SDException&);
+            protected:
+            public:
+                /**
+                 * map and validate binary training set
+                 */
+                TrainingSetFile(const std::string& setFile) throw (SDException&);
+                virtual ~TrainingSetFile();
+
+                /**
+                 * @return
+                 * true if file starts with TRAINING_SET_MAGIC
+                 */
+                static bool isBinary(const std::string& setFile);
+                /**
+                 * convert svmlight text set to binary set or binary set to text,
+                 * direction is detected from input file content
+                 */
+                static void convert(const std::string& input, const std::string& output) throw (SDException&);
+                /**
+                 * read instance weights of text set from file with TRAINING_SET_WEIGHTS_SUFFIX
+                 * @return
+                 * false if set has no weights file
+                 */
+                static bool readWeights(const std::string& setFile, std::vector<float>& weights) throw (SDException&);
+
+                uint64_t getRows() const;
+                /**
+                 * @return
+                 * number of parameters in row, without label
+                 */
+                int getDims() const;
+                /**
+                 * @return
+                 * row stride in floats
+                 */
+                int getRowWidth() const;
+                int getLabelType() const;
+                /**
+                 * @return
+                 * getRows() rows of getRowWidth() floats
+                 */
+                const float* getData() const;
+                const float* getRow(uint64_t row) const;
+                const float* getLabels() const;
+                /**
+                 * @return
+                 * getRows() instance weights, 0 if set isn't weighted
+                 */
+                const float* getWeights() const;
+            };
+
+        }
+    }
+}
+
+#endif
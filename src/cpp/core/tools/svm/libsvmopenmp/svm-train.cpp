@@ -3,10 +3,29 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
 #include "svm-train.h"
 #include "core/util/Config.h"
 #include "core/opencl/libsvm/OpenCLToolsTrain.h"
+#include "core/tools/svm/TrainingSetFile.h"
+#include "core/tools/svm/SvmLightReader.h"
+#include "core/tools/svm/KernelMatrixFile.h"
+#include "core/util/raii/RAIIS.h"
+#if defined _OPENMP_MY
+#include <omp.h>
+#endif
 
 
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
@@ -18,6 +37,7 @@ namespace core{
 
                 using namespace std;
                 using namespace core::util;                
+                using namespace core::util::raii;
 #ifdef _OPENCL                
                 using namespace core::opencl::libsvm;
 #endif
@@ -31,34 +51,19 @@ namespace core{
                 }
 
                 void parse_command_line(int argc, char **argv, char *input_file_name, char *model_file_name);
-                void read_problem(const char *filename);
-                void do_cross_validation();
-
-                struct svm_parameter param; // set by parse_command_line
+                void read_param(Config* conf) throw (SDException&);
+                void read_cache_config(Config* conf) throw (SDException&);
+                void load_problem(const char *filename) throw (SDException&);
+                void free_problem();
+                void read_problem(const char *filename) throw (SDException&);
+                void read_problem_binary(const char *filename) throw (SDException&);
+                KernelMatrixFile* open_kernel_matrix(Config* conf);
+                int read_warm_start(const string& model_file_name, vector<double>& alpha) throw (SDException&);
+
+                struct svm_parameter param; // set by read_param
                 struct svm_problem prob; // set by read_problem
                 struct svm_model *model;
                 struct svm_node *x_space;
-                int cross_validation;
-                int nr_fold;
-
-                static char *line = NULL;
-                static int max_line_len;
-
-                static char* readline(FILE *input) {
-                    int len;
-
-                    if (fgets(line, max_line_len, input) == NULL)
-                        return NULL;
-
-                    while (strrchr(line, '\n') == NULL) {
-                        max_line_len *= 2;
-                        line = (char *) realloc(line, max_line_len);
-                        len = (int) strlen(line);
-                        if (fgets(line + len, max_line_len - len, input) == NULL)
-                            break;
-                    }
-                    return line;
-                }
 
                 int train(char* input_file_name, char* model_file_name) throw(SDException&){
                     cout << "Start training" << endl;
@@ -69,8 +74,57 @@ namespace core{
                         throw exc;
                     }
 #endif
-                    Config* conf = Config::getInstancePtr();
+                    read_param(Config::getInstancePtr());
                     
+                    void (*print_func)(const char*) = NULL;	// default printing to stdout
+                    svm_set_print_string_function(print_func);
+                                        
+                    cout << "Start read problem" << endl;
+                    load_problem(input_file_name);
+                    cout << "Finished read problem" << endl;
+                    const char* error_msg = svm_check_parameter(&prob, &param);
+                    if (error_msg) {
+                        fprintf(stderr, "ERROR: %s\n", error_msg);
+                        exit(1);
+                    }
+                    KernelMatrixFile* matrix = open_kernel_matrix(Config::getInstancePtr());
+                    if (matrix != 0)
+                        param.kernel_matrix = matrix->getMatrix();
+                    const string* warmStr = Config::getInstancePtr()->getSnapshot()->find("general.Training.svm.warmStartModel");
+                    vector<double> warm_alpha;
+                    if (warmStr != 0 && *warmStr != "" && read_warm_start(*warmStr, warm_alpha) > 0)
+                        param.init_alpha = warm_alpha.data();
+                    model = svm_train(&prob, &param);
+                    param.kernel_matrix = NULL;
+                    param.init_alpha = NULL;
+                    if (matrix != 0){
+                        Delete(matrix);
+                    }
+                    if (svm_save_model(model_file_name, model)) {
+                        fprintf(stderr, "can't save model to file %s\n", model_file_name);
+                        exit(1);
+                    }
+                    svm_free_and_destroy_model(&model);
+
+                    struct svm_cache_stats stats;
+                    svm_get_cache_stats(&stats);
+                    long requests = stats.hits + stats.misses;
+                    cout << "Kernel cache: " << param.cache_size << " MB, hits: " << stats.hits << " misses: " << stats.misses;
+                    cout << " evictions: " << stats.evictions << " hit rate: " << (requests > 0 ? 100. * stats.hits / requests : 0.) << "%" << endl;
+
+                    svm_destroy_param(&param);
+                    free_problem();
+
+#ifdef _OPENCL                                        
+                    cout << "data durr: " << oclt->durrData << " buff durr: " << oclt->durrBuff << " durr exec: " << oclt->durrExec;
+                    cout << " durr set args: " << oclt->durrSetSrgs << " durr readbuff: " << oclt->durrReadBuff << endl;
+#endif
+                    
+                    return 0;
+                }
+
+                // svm type, kernel, C, gamma and cache from general.Training.svm
+                void read_param(Config* conf) throw (SDException&) {
                     param.svm_type = C_SVC;
                     param.kernel_type = RBF;
                     param.degree = 3;
@@ -78,6 +132,7 @@ namespace core{
                     param.coef0 = 0;
                     param.nu = 0.5;
                     param.cache_size = 100;
+                    param.cache_storage = CACHE_FLOAT;
                     param.C = 1;
                     param.eps = 1e-3;
                     param.p = 0.1;
@@ -86,9 +141,10 @@ namespace core{
                     param.nr_weight = 0;
                     param.weight_label = NULL;
                     param.weight = NULL;
-                    cross_validation = 0;
+                    param.kernel_matrix = NULL;
+                    param.init_alpha = NULL;
                     
-                    string strVal = conf->getPropertyValue("settings.svm.svm_type");
+                    string strVal = conf->getPropertyValue("general.Training.svm.svm_type");
                     int val = atoi(strVal.c_str());
                     if (val >= 0 && val < 5)
                         param.svm_type = val;
@@ -96,7 +152,7 @@ namespace core{
                         SDException e(SHADOW_INALID_SVM_TYPE, "train");
                         throw e;
                     }
-                    strVal = conf->getPropertyValue("settings.svm.kernel_type");
+                    strVal = conf->getPropertyValue("general.Training.svm.kernel_type");
                     val = atoi(strVal.c_str());
                     if (val >= 0 && val < 4)
                         param.kernel_type = val;
@@ -105,142 +161,552 @@ namespace core{
                         throw e;
                     }
                     
-                    void (*print_func)(const char*) = NULL;	// default printing to stdout
-                    svm_set_print_string_function(print_func);
-                                        
-                    cout << "Start read problem" << endl;
-                    read_problem(input_file_name);
-                    cout << "Finished read problem" << endl;
-                    model = svm_train(&prob, &param);
-                    if (svm_save_model(model_file_name, model)) {
-                        fprintf(stderr, "can't save model to file %s\n", model_file_name);
-                        exit(1);
+                    const ConfigSnapshot* snapshot = conf->getSnapshot();
+                    const string* cStr = snapshot->find("general.Training.svm.C");
+                    if (cStr != 0 && *cStr != "") {
+                        param.C = atof(cStr->c_str());
+                        if (param.C <= 0) {
+                            SDException exc(SHADOW_OUT_OF_BOUNDS, "svm-train C: " + *cStr);
+                            throw exc;
+                        }
                     }
-                    svm_free_and_destroy_model(&model);
+                    const string* gammaStr = snapshot->find("general.Training.svm.gamma");
+                    if (gammaStr != 0 && *gammaStr != "") {
+                        param.gamma = atof(gammaStr->c_str());
+                        if (param.gamma < 0) {
+                            SDException exc(SHADOW_OUT_OF_BOUNDS, "svm-train gamma: " + *gammaStr);
+                            throw exc;
+                        }
+                    }
+                    
+                    read_cache_config(conf);
+                }
 
-                    svm_destroy_param(&param);
+                void load_problem(const char *filename) throw (SDException&) {
+                    if (TrainingSetFile::isBinary(filename))
+                        read_problem_binary(filename);
+                    else
+                        read_problem(filename);
+                }
+
+                // precomputed kernel matrix of prob for param from general.Training.svm.kernelMatrixDir,
+                // 0 if directory isn't set or matrix is bigger than kernelMatrixMaxSize MB.
+                // Matrix which can't be made is reported and rows are computed by training
+                KernelMatrixFile* open_kernel_matrix(Config* conf) {
+                    const ConfigSnapshot* snapshot = conf->getSnapshot();
+                    const string* dirStr = snapshot->find("general.Training.svm.kernelMatrixDir");
+                    if (dirStr == 0 || *dirStr == "" || param.kernel_type == PRECOMPUTED)
+                        return 0;
+                    const string* maxStr = snapshot->find("general.Training.svm.kernelMatrixMaxSize");
+                    double maxSize = maxStr != 0 && *maxStr != "" ? atof(maxStr->c_str()) : 4096.;
+                    double size = (double) KernelMatrixFile::getFileSize(prob.l) / (1 << 20);
+                    if (size > maxSize) {
+                        cout << "Kernel matrix of " << size << " MB is bigger than kernelMatrixMaxSize, rows are computed" << endl;
+                        return 0;
+                    }
+                    try {
+                        KernelMatrixFile* matrix = New KernelMatrixFile(*dirStr, prob, param);
+                        cout << (matrix->wasCreated() ? "Kernel matrix written to " : "Kernel matrix read from ") << matrix->getFile() << endl;
+                        return matrix;
+                    } catch (SDException& exc) {
+                        cout << "Kernel matrix not used: " << exc.handleException() << endl;
+                        return 0;
+                    }
+                }
+
+                // key of instance for matching with support vectors of earlier model: label and
+                // nonzero values printed as svm_save_model prints them, so loaded support vector
+                // has same key as instance it was made from
+                string warm_start_key(int label, const svm_node* node) {
+                    string key;
+                    char buffer[64];
+                    snprintf(buffer, sizeof(buffer), "%d", label);
+                    key += buffer;
+                    for (; node->index != -1; node++) {
+                        if (node->value == 0)
+                            continue;
+                        snprintf(buffer, sizeof(buffer), " %d:%.8g", node->index, node->value);
+                        key += buffer;
+                    }
+                    return key;
+                }
+
+                // alpha of instances of prob which are support vectors of two class C-SVC model,
+                // other instances start from 0. Returns number of matched support vectors
+                int read_warm_start(const string& model_file_name, vector<double>& alpha) throw (SDException&) {
+                    struct svm_model* previous = svm_load_model(model_file_name.c_str());
+                    if (previous == NULL) {
+                        SDException exc(SHADOW_READ_UNABLE, "svm-train warmStartModel: " + model_file_name);
+                        throw exc;
+                    }
+                    if (previous->param.svm_type != C_SVC || previous->nr_class != 2) {
+                        cout << "Warm start model isn't two class C-SVC, training starts from 0" << endl;
+                        svm_free_and_destroy_model(&previous);
+                        return 0;
+                    }
+                    // equal instances may be in set more times, every one takes one coefficient
+                    unordered_map<string, vector<double> > coefs;
+                    for (int k = 0; k < previous->l; k++) {
+                        int label = k < previous->nSV[0] ? previous->label[0] : previous->label[1];
+                        coefs[warm_start_key(label, previous->SV[k])].push_back(fabs(previous->sv_coef[0][k]));
+                    }
+                    alpha.assign(prob.l, 0.);
+                    int matched = 0;
+                    for (int i = 0; i < prob.l; i++) {
+                        unordered_map<string, vector<double> >::iterator found = coefs.find(warm_start_key((int) prob.y[i], prob.x[i]));
+                        if (found == coefs.end() || found->second.empty())
+                            continue;
+                        alpha[i] = found->second.back();
+                        found->second.pop_back();
+                        matched++;
+                    }
+                    cout << "Warm start: " << matched << " of " << previous->l << " support vectors matched" << endl;
+                    svm_free_and_destroy_model(&previous);
+                    return matched;
+                }
+
+                void free_problem() {
                     free(prob.y);
                     free(prob.x);
+                    free(prob.W);
                     free(x_space);
-                    free(line);
+                }
 
-#ifdef _OPENCL                                        
-                    cout << "data durr: " << oclt->durrData << " buff durr: " << oclt->durrBuff << " durr exec: " << oclt->durrExec;
-                    cout << " durr set args: " << oclt->durrSetSrgs << " durr readbuff: " << oclt->durrReadBuff << endl;
-#endif
-                    
-                    return 0;
+                // cache size is in MB or percent of physical memory ("25%"), rows are
+                // stored as float or, for twice as many rows, as fp16 or bf16
+                void read_cache_config(Config* conf) throw (SDException&) {
+                    const ConfigSnapshot* snapshot = conf->getSnapshot();
+                    const string* sizeStr = snapshot->find("general.Training.svm.cacheSize");
+                    if (sizeStr != 0 && *sizeStr != "") {
+                        double size = atof(sizeStr->c_str());
+                        if ((*sizeStr)[sizeStr->size() - 1] == '%') {
+                            double memory = (double) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
+                            size = memory * size / 100. / (1 << 20);
+                        }
+                        if (size <= 0) {
+                            SDException exc(SHADOW_OUT_OF_BOUNDS, "svm-train cacheSize: " + *sizeStr);
+                            throw exc;
+                        }
+                        param.cache_size = size;
+                    }
+                    const string* storageStr = snapshot->find("general.Training.svm.cacheStorage");
+                    if (storageStr != 0 && *storageStr != "" && *storageStr != "float") {
+                        if (*storageStr == "fp16")
+                            param.cache_storage = CACHE_FP16;
+                        else if (*storageStr == "bf16")
+                            param.cache_storage = CACHE_BF16;
+                        else {
+                            SDException exc(SHADOW_OUT_OF_BOUNDS, "svm-train cacheStorage: " + *storageStr);
+                            throw exc;
+                        }
+                    }
                 }
 
-                void do_cross_validation() {
-                    int i;
-                    int total_correct = 0;
-                    double total_error = 0;
-                    double sumv = 0, sumy = 0, sumvv = 0, sumyy = 0, sumvy = 0;
-                    double *target = Malloc(double, prob.l);
-
-                    svm_cross_validation(&prob, &param, nr_fold, target);
-                    if (param.svm_type == EPSILON_SVR ||
-                            param.svm_type == NU_SVR) {
-                        for (i = 0; i < prob.l; i++) {
-                            double y = prob.y[i];
-                            double v = target[i];
-                            total_error += (v - y)*(v - y);
-                            sumv += v;
-                            sumy += y;
-                            sumvv += v*v;
-                            sumyy += y*y;
-                            sumvy += v*y;
+                // grid search: every (C, gamma) point is trained on k - 1 folds and tested on
+                // remaining one. Jobs (point, fold) run concurrently on shared read-only problem
+                struct grid_point {
+                    double log2c;
+                    double log2g;
+                    // weighted correct predictions, for regression weighted squared error
+                    double score_sum;
+                    double weight_sum;
+                    int folds_done;
+                    bool stopped;
+                    // some fold job threw, point isn't ranked
+                    bool failed;
+                };
+
+                struct grid_job {
+                    int point;
+                    int fold;
+                };
+
+                struct grid_state {
+                    vector<grid_point> points;
+                    vector<grid_job> jobs;
+                    vector<int> fold_of;
+                    int nr_fold;
+                    bool regression;
+                    bool uses_gamma;
+                    double cache_size;
+                    int inner_threads;
+                    double stop_margin;
+                    size_t next_job;
+                    SDException* error;
+                    pthread_mutex_t mutex;
+                };
+
+                // values of "begin end step" range, e.g. "-5 15 2"
+                void read_grid_range(const ConfigSnapshot* snapshot, const string& key, const string& defaultRange,
+                        vector<double>& values) throw (SDException&) {
+                    const string* rangeStr = snapshot->find(key);
+                    string range = rangeStr != 0 && *rangeStr != "" ? *rangeStr : defaultRange;
+                    istringstream stream(range);
+                    double begin, end, step;
+                    if (!(stream >> begin >> end >> step) || step == 0 || (end - begin) * step < 0) {
+                        SDException exc(SHADOW_OUT_OF_BOUNDS, "svm-train grid range " + key + ": " + range);
+                        throw exc;
+                    }
+                    values.clear();
+                    int count = (int) floor((end - begin) / step + 1e-9) + 1;
+                    for (int i = 0; i < count; i++)
+                        values.push_back(begin + i * step);
+                }
+
+                // accuracy, or negated mean squared error for regression, so larger is better
+                double grid_score(const grid_point& point, bool regression) {
+                    if (point.weight_sum <= 0)
+                        return -INFINITY;
+                    double mean = point.score_sum / point.weight_sum;
+                    return regression ? -mean : mean;
+                }
+
+                // point whose folds so far are worse than best point (on its folds so far)
+                // by more than margin, absolute for accuracy and relative for mse
+                bool grid_hopeless(const grid_state& state, const grid_point& point) {
+                    if (state.stop_margin < 0 || point.folds_done == 0)
+                        return false;
+                    double best = -INFINITY;
+                    for (size_t p = 0; p < state.points.size(); p++)
+                        if (state.points[p].folds_done > 0 && state.points[p].failed == false)
+                            best = max(best, grid_score(state.points[p], state.regression));
+                    double margin = state.regression ? state.stop_margin * fabs(best) : state.stop_margin;
+                    return grid_score(point, state.regression) < best - margin;
+                }
+
+                // stratified by label for classification, folds depend only on seed
+                void assign_folds(grid_state& state, unsigned int seed) {
+                    mt19937 generator(seed);
+                    state.fold_of.assign(prob.l, 0);
+                    map<double, vector<int> > groups;
+                    for (int i = 0; i < prob.l; i++)
+                        groups[state.regression ? 0. : prob.y[i]].push_back(i);
+                    int next = 0;
+                    for (map<double, vector<int> >::iterator it = groups.begin(); it != groups.end(); it++) {
+                        shuffle(it->second.begin(), it->second.end(), generator);
+                        for (size_t i = 0; i < it->second.size(); i++) {
+                            state.fold_of[it->second[i]] = next;
+                            next = (next + 1) % state.nr_fold;
                         }
-                        printf("Cross Validation Mean squared error = %g\n", total_error / prob.l);
-                        printf("Cross Validation Squared correlation coefficient = %g\n",
-                                ((prob.l * sumvy - sumv * sumy)*(prob.l * sumvy - sumv * sumy)) /
-                                ((prob.l * sumvv - sumv * sumv)*(prob.l * sumyy - sumy * sumy))
-                                );
-                    } else {
-                        for (i = 0; i < prob.l; i++)
-                            if (target[i] == prob.y[i])
-                                ++total_correct;
-                        printf("Cross Validation Accuracy = %g%%\n", 100.0 * total_correct / prob.l);
                     }
-                    free(target);
-                }                
+                }
 
-                // read in a problem (in svmlight format)
-                void read_problem(const char *filename) {
-                    int elements, max_index, inst_max_index, i, j;
-                    FILE *fp = fopen(filename, "r");
-                    char *endptr;
-                    char *idx, *val, *label;
+                void run_grid_job(const grid_state& state, const grid_job& job, double& score, double& weight) {
+                    const grid_point& point = state.points[job.point];
+                    svm_parameter job_param = param;
+                    job_param.C = pow(2., point.log2c);
+                    if (state.uses_gamma)
+                        job_param.gamma = pow(2., point.log2g);
+                    job_param.cache_size = state.cache_size;
+
+                    // instances are shared, only pointers of training part are copied
+                    svm_problem sub;
+                    sub.l = 0;
+                    for (int i = 0; i < prob.l; i++)
+                        if (state.fold_of[i] != job.fold)
+                            sub.l++;
+                    sub.x = Malloc(struct svm_node *, sub.l);
+                    sub.y = Malloc(double, sub.l);
+                    sub.W = prob.W != NULL ? Malloc(double, sub.l) : NULL;
+                    int k = 0;
+                    for (int i = 0; i < prob.l; i++) {
+                        if (state.fold_of[i] == job.fold)
+                            continue;
+                        sub.x[k] = prob.x[i];
+                        sub.y[k] = prob.y[i];
+                        if (sub.W != NULL)
+                            sub.W[k] = prob.W[i];
+                        k++;
+                    }
 
-                    if (fp == NULL) {
-                        fprintf(stderr, "can't open input file %s\n", filename);
-                        exit(1);
+                    struct svm_model *job_model = svm_train(&sub, &job_param);
+                    score = 0;
+                    weight = 0;
+                    for (int i = 0; i < prob.l; i++) {
+                        if (state.fold_of[i] != job.fold)
+                            continue;
+                        double w = prob.W != NULL ? prob.W[i] : 1.;
+                        double v = svm_predict(job_model, prob.x[i]);
+                        if (state.regression)
+                            score += w * (v - prob.y[i]) * (v - prob.y[i]);
+                        else if (v == prob.y[i])
+                            score += w;
+                        weight += w;
                     }
+                    svm_free_and_destroy_model(&job_model);
+                    free(sub.x);
+                    free(sub.y);
+                    free(sub.W);
+                }
 
-                    prob.l = 0;
-                    elements = 0;
+                void* grid_worker(void* arg) {
+                    grid_state* state = (grid_state*) arg;
+#if defined _OPENMP_MY
+                    // number of threads is per thread setting, jobs share openMP threads
+                    omp_set_num_threads(state->inner_threads);
+#endif
+                    pthread_mutex_lock(&state->mutex);
+                    while (state->next_job < state->jobs.size()) {
+                        grid_job job = state->jobs[state->next_job++];
+                        grid_point& point = state->points[job.point];
+                        if (point.stopped || grid_hopeless(*state, point)) {
+                            point.stopped = true;
+                            continue;
+                        }
+                        pthread_mutex_unlock(&state->mutex);
+                        double score = 0, weight = 0;
+                        SDException* error = 0;
+                        string failure;
+                        try {
+                            run_grid_job(*state, job, score, weight);
+                        } catch (SDException& exc) {
+                            error = New SDException(exc);
+                        } catch (std::exception& exc) {
+                            // allocation errors of one training, other points still run
+                            failure = exc.what();
+                        } catch (...) {
+                            failure = "unknown error";
+                        }
+                        pthread_mutex_lock(&state->mutex);
+                        if (failure != "") {
+                            cout << "Grid point log2C " << point.log2c << " log2gamma " << point.log2g << " fold " << job.fold
+                                    << " failed: " << failure << endl;
+                            point.failed = true;
+                            point.stopped = true;
+                            continue;
+                        }
+                        if (error != 0) {
+                            if (state->error == 0)
+                                state->error = error;
+                            else {
+                                Delete(error);
+                            }
+                            state->next_job = state->jobs.size();
+                            break;
+                        }
+                        point.score_sum += score;
+                        point.weight_sum += weight;
+                        point.folds_done++;
+                        if (point.folds_done < state->nr_fold && grid_hopeless(*state, point))
+                            point.stopped = true;
+                    }
+                    pthread_mutex_unlock(&state->mutex);
+                    return 0;
+                }
 
-                    max_line_len = 1024;
-                    line = Malloc(char, max_line_len);
-                    while (readline(fp) != NULL) {
-                        char *p = strtok(line, " \t"); // label
+                bool grid_rank(const grid_point& first, const grid_point& second, int nr_fold, bool regression) {
+                    bool firstDone = first.folds_done == nr_fold;
+                    bool secondDone = second.folds_done == nr_fold;
+                    if (firstDone != secondDone)
+                        return firstDone;
+                    return grid_score(first, regression) > grid_score(second, regression);
+                }
 
-                        // features
-                        while (1) {
-                            p = strtok(NULL, " \t");
-                            if (p == NULL || *p == '\n') // check '\n' as ' ' may be after the last feature
-                                break;
-                            ++elements;
+                int grid_search(char* input_file_name, char* report_file_name) throw(SDException&){
+                    cout << "Start grid search" << endl;
+                    Config* conf = Config::getInstancePtr();
+                    read_param(conf);
+                    svm_set_print_string_function(&print_null);
+                    const ConfigSnapshot* snapshot = conf->getSnapshot();
+
+                    grid_state state;
+                    vector<double> log2c, log2g;
+                    read_grid_range(snapshot, "general.Training.gridSearch.log2C", "-5 15 2", log2c);
+                    state.uses_gamma = param.kernel_type != LINEAR;
+                    if (state.uses_gamma)
+                        read_grid_range(snapshot, "general.Training.gridSearch.log2Gamma", "3 -15 -2", log2g);
+                    else
+                        log2g.assign(1, 0.);
+                    const string* foldsStr = snapshot->find("general.Training.gridSearch.folds");
+                    state.nr_fold = foldsStr != 0 && *foldsStr != "" ? atoi(foldsStr->c_str()) : 5;
+                    const string* marginStr = snapshot->find("general.Training.gridSearch.earlyStopMargin");
+                    state.stop_margin = marginStr != 0 && *marginStr != "" ? atof(marginStr->c_str()) : 0.02;
+                    const string* seedStr = snapshot->find("general.Training.gridSearch.seed");
+                    unsigned int seed = seedStr != 0 && *seedStr != "" ? (unsigned int) atol(seedStr->c_str()) : 1;
+                    const string* threadsStr = snapshot->find("general.Training.gridSearch.threadNum");
+                    int threads = threadsStr != 0 ? atoi(threadsStr->c_str()) : 0;
+                    int ompThreads = conf->getSettings().openMPThreadNum;
+                    if (threads <= 0)
+                        threads = ompThreads;
+#ifdef _OPENCL
+                    // kernel rows of all jobs are computed on one device
+                    threads = 1;
+                    if (OpenCLToolsTrain::getInstancePtr()->hasInitialized() == false){
+                        SDException exc(SHADOW_OPENCL_TOOLS_NOT_INITIALIZED, "libsvm grid search");
+                        throw exc;
+                    }
+#endif
+                    if (threads <= 0)
+                        threads = 1;
+
+                    cout << "Start read problem" << endl;
+                    load_problem(input_file_name);
+                    cout << "Finished read problem" << endl;
+                    if (state.nr_fold < 2 || state.nr_fold > prob.l) {
+                        free_problem();
+                        SDException exc(SHADOW_OUT_OF_BOUNDS, "svm-train gridSearch.folds");
+                        throw exc;
+                    }
+                    const char* error_msg = svm_check_parameter(&prob, &param);
+                    if (error_msg) {
+                        fprintf(stderr, "ERROR: %s\n", error_msg);
+                        exit(1);
+                    }
+
+                    state.regression = param.svm_type == EPSILON_SVR || param.svm_type == NU_SVR;
+                    for (size_t c = 0; c < log2c.size(); c++) {
+                        for (size_t g = 0; g < log2g.size(); g++) {
+                            grid_point point = {log2c[c], log2g[g], 0., 0., 0, false, false};
+                            state.points.push_back(point);
+                        }
+                    }
+                    // fold by fold, so every point is compared after its first folds and
+                    // remaining folds of hopeless points aren't trained
+                    for (int f = 0; f < state.nr_fold; f++) {
+                        for (size_t p = 0; p < state.points.size(); p++) {
+                            grid_job job = {(int) p, f};
+                            state.jobs.push_back(job);
                         }
-                        ++elements;
-                        ++prob.l;
                     }
-                    rewind(fp);
+                    if ((size_t) threads > state.jobs.size())
+                        threads = (int) state.jobs.size();
+                    assign_folds(state, seed);
+                    // configured cache is split between concurrent trainings
+                    state.cache_size = param.cache_size / threads;
+                    state.inner_threads = ompThreads / threads > 0 ? ompThreads / threads : 1;
+                    state.next_job = 0;
+                    state.error = 0;
+                    pthread_mutex_init(&state.mutex, 0);
+                    // with one gamma every job reads rows of whole problem matrix, folds are its subsets
+                    KernelMatrixFile* matrix = 0;
+                    if (log2g.size() == 1) {
+                        if (state.uses_gamma)
+                            param.gamma = pow(2., log2g[0]);
+                        matrix = open_kernel_matrix(conf);
+                        if (matrix != 0)
+                            param.kernel_matrix = matrix->getMatrix();
+                    }
+
+                    cout << state.points.size() << " grid points, " << state.nr_fold << " folds, " << threads << " concurrent trainings" << endl;
+                    vector<pthread_t> workers(threads);
+                    for (int t = 0; t < threads; t++)
+                        pthread_create(&workers[t], 0, &grid_worker, &state);
+                    for (int t = 0; t < threads; t++)
+                        pthread_join(workers[t], 0);
+                    pthread_mutex_destroy(&state.mutex);
+                    param.kernel_matrix = NULL;
+                    if (matrix != 0) {
+                        Delete(matrix);
+                    }
+                    svm_set_print_string_function(NULL);
+                    free_problem();
+                    if (state.error != 0) {
+                        SDException exc(*state.error);
+                        Delete(state.error);
+                        throw exc;
+                    }
+
+                    // failed points have no valid score, they aren't reported
+                    vector<grid_point> ranked;
+                    for (size_t p = 0; p < state.points.size(); p++)
+                        if (state.points[p].failed == false)
+                            ranked.push_back(state.points[p]);
+                    if (ranked.size() < state.points.size())
+                        cout << state.points.size() - ranked.size() << " grid points failed" << endl;
+                    int nr_fold = state.nr_fold;
+                    bool regression = state.regression;
+                    stable_sort(ranked.begin(), ranked.end(), [nr_fold, regression](const grid_point& first, const grid_point& second){
+                        return grid_rank(first, second, nr_fold, regression);
+                    });
+                    fstream report;
+                    report.open(report_file_name, fstream::out | fstream::trunc);
+                    FileRaii fRaii(&report);
+                    if (report.is_open() == false) {
+                        SDException exc(SHADOW_WRITE_UNABLE, string("svm-train grid search report: ") + report_file_name);
+                        throw exc;
+                    }
+                    report << "rank\tlog2C\tlog2gamma\tC\tgamma\t" << (regression ? "mse" : "accuracy") << "\tfolds\tstatus" << endl;
+                    for (size_t r = 0; r < ranked.size(); r++) {
+                        const grid_point& point = ranked[r];
+                        double value = grid_score(point, regression);
+                        report << r + 1 << "\t" << point.log2c << "\t";
+                        if (state.uses_gamma)
+                            report << point.log2g << "\t" << pow(2., point.log2c) << "\t" << pow(2., point.log2g);
+                        else
+                            report << "-\t" << pow(2., point.log2c) << "\t-";
+                        report << "\t" << setprecision(6) << (regression ? -value : value) << "\t" << point.folds_done << "/" << nr_fold;
+                        report << "\t" << (point.folds_done == nr_fold ? "done" : "stopped") << endl;
+                    }
+                    if (ranked.empty() == false && ranked[0].folds_done == nr_fold) {
+                        cout << "Best C: " << pow(2., ranked[0].log2c);
+                        if (state.uses_gamma)
+                            cout << " gamma: " << pow(2., ranked[0].log2g);
+                        double best = grid_score(ranked[0], regression);
+                        cout << (regression ? " mse: " : " accuracy: ") << (regression ? -best : best) << endl;
+                    }
+                    cout << "Grid search report written to " << report_file_name << endl;
+                    svm_destroy_param(&param);
+                    return 0;
+                }
 
+                // read in a problem from binary training set, rows are taken from mapped file without parsing
+                void read_problem_binary(const char *filename) throw (SDException&) {
+                    TrainingSetFile set(filename);
+                    if (set.getRows() > (uint64_t)(INT_MAX / (set.getDims() + 1))) {
+                        SDException exc(SHADOW_OUT_OF_BOUNDS, "read_problem_binary");
+                        throw exc;
+                    }
+                    int rows = (int) set.getRows();
+                    int width = set.getDims() + 1;
+                    prob.l = rows;
                     prob.y = Malloc(double, prob.l);
                     prob.x = Malloc(struct svm_node *, prob.l);
-                    x_space = Malloc(struct svm_node, elements);
-
-                    max_index = 0;
-                    j = 0;
-                    for (i = 0; i < prob.l; i++) {
-                        inst_max_index = -1; // strtol gives 0 if wrong format, and precomputed kernel has <index> start from 0
-                        readline(fp);
-                        prob.x[i] = &x_space[j];
-                        label = strtok(line, " \t\n");
-                        if (label == NULL) // empty line
-                            exit_input_error(i + 1);
-
-                        prob.y[i] = strtod(label, &endptr);
-                        if (endptr == label || *endptr != '\0')
-                            exit_input_error(i + 1);
-
-                        while (1) {
-                            idx = strtok(NULL, ":");
-                            val = strtok(NULL, " \t");
-
-                            if (val == NULL)
-                                break;
-
-                            errno = 0;
-                            x_space[j].index = (int) strtol(idx, &endptr, 10);
-                            if (endptr == idx || errno != 0 || *endptr != '\0' || x_space[j].index <= inst_max_index)
-                                exit_input_error(i + 1);
-                            else
-                                inst_max_index = x_space[j].index;
-
-                            errno = 0;
-                            x_space[j].value = strtod(val, &endptr);
-                            if (endptr == val || errno != 0 || (*endptr != '\0' && !isspace(*endptr)))
-                                exit_input_error(i + 1);
-
-                            ++j;
+                    x_space = Malloc(struct svm_node, (size_t) rows * width);
+                    const float* labels = set.getLabels();
+                    const float* weights = set.getWeights();
+                    prob.W = weights != 0 ? Malloc(double, prob.l) : NULL;
+
+                    int i;
+#if defined _OPENMP_MY
+#pragma omp parallel for private(i)
+#endif
+                    for (i = 0; i < rows; i++) {
+                        const float* row = set.getRow(i);
+                        svm_node* nodes = &x_space[(size_t) i * width];
+                        for (int j = 0; j < width - 1; j++) {
+                            nodes[j].index = j + 1;
+                            nodes[j].value = row[j];
                         }
+                        nodes[width - 1].index = -1;
+                        prob.x[i] = nodes;
+                        prob.y[i] = labels[i];
+                        if (weights != 0)
+                            prob.W[i] = weights[i];
+                    }
 
-                        if (inst_max_index > max_index)
-                            max_index = inst_max_index;
-                        x_space[j++].index = -1;
+                    if (param.gamma == 0)
+                        param.gamma = 1.0 / set.getDims();
+                }
+
+                // read in a problem (in svmlight format), file is parsed in parallel by SvmLightReader
+                void read_problem(const char *filename) throw (SDException&) {
+                    int max_index, i;
+                    SvmLightReader reader(filename);
+                    int errorLine = reader.read(prob, x_space, max_index);
+                    if (errorLine != 0)
+                        exit_input_error(errorLine);
+
+                    // instance weights from deduplicated set
+                    prob.W = NULL;
+                    vector<float> weights;
+                    if (TrainingSetFile::readWeights(filename, weights)) {
+                        if ((int) weights.size() != prob.l) {
+                            SDException exc(SHADOW_READ_UNABLE, "read_problem weights count");
+                            throw exc;
+                        }
+                        prob.W = Malloc(double, prob.l);
+                        for (i = 0; i < prob.l; i++)
+                            prob.W[i] = weights[i];
                     }
 
                     if (param.gamma == 0 && max_index > 0)
@@ -257,8 +723,6 @@ namespace core{
                                 exit(1);
                             }
                         }
-
-                    fclose(fp);
                 }
 
             }
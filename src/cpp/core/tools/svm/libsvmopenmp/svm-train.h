@@ -9,6 +9,11 @@ namespace core{
             namespace svm {
                 namespace libsvmopenmp {
                     int train(char* input_file_name, char* model_file_name) throw(SDException&);
+                    /**
+                     * cross validate (C, gamma) grid of general.Training.gridSearch concurrently,
+                     * ranked results are written to report file
+                     */
+                    int grid_search(char* input_file_name, char* report_file_name) throw(SDException&);
                 }
             }
         }
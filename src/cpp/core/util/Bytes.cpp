@@ -0,0 +1,20 @@
+#include "Bytes.h"
+
+namespace core{
+    namespace util{
+        
+        uint64_t hashBytes(uint64_t hash, const void* bytes, size_t size){
+            const unsigned char* curr = (const unsigned char*)bytes;
+            for (size_t i = 0; i < size; i++){
+                hash ^= curr[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+        
+        uint64_t alignOffset(uint64_t offset, uint64_t alignment){
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+        
+    }
+}
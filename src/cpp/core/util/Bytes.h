@@ -0,0 +1,28 @@
+#ifndef __BYTES_H__
+#define __BYTES_H__
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * initial value of FNV-1a hash
+ */
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+
+namespace core{
+    namespace util{
+        
+        /**
+         * FNV-1a of bytes, continued from hash (FNV_OFFSET_BASIS for new hash)
+         */
+        uint64_t hashBytes(uint64_t hash, const void* bytes, size_t size);
+        /**
+         * @return
+         * offset rounded up to multiple of alignment
+         */
+        uint64_t alignOffset(uint64_t offset, uint64_t alignment);
+        
+    }
+}
+
+#endif
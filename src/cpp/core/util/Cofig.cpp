@@ -1,5 +1,6 @@
 #include "Config.h"
 #include <fstream>
+#include <iostream>
 #include "core/util/raii/RAIIS.h"
 
 //#define ARRAY_KEY_TAG "array"
@@ -12,25 +13,79 @@ namespace core{
         using namespace rapidxml;
         using namespace core::util::raii;
         
+        std::atomic<bool> Config::reloadRequested(false);
+        
+        /**
+         * snapshot used by this thread, keeps it alive after newer one is published
+         */
+        static thread_local shared_ptr<const ConfigSnapshot> pinned;
+        
         Config::Config() : Singleton<Config>(){
             rootNodeProcessing = true;
+            version = 0;
+            pthread_mutex_init(&mutex, 0);
             init();            
         }
         
         Config::~Config(){
-            
+            //other threads have finished, snapshot is deleted here
+            pinned.reset();
+            current.reset();
+            pthread_mutex_destroy(&mutex);
         }
         
         string Config::getPropertyValue(const string& key) throw(SDException&){
-            unordered_map<string, string>::iterator iter = mappedValues.find(key);
-            if (iter != mappedValues.end()){
-                return iter->second;
+            const string* val = getSnapshot()->find(key);
+            if (val != 0){
+                return *val;
             }
             else{ 
                 SDException exc(SHADOW_NOT_FOUND_PROPERTY, "Config::getPropertyValue: " + key);
                 throw exc;
             }
         }
+        
+        const Settings& Config::getSettings(){
+            return getSnapshot()->getSettings();
+        }
+        
+        const ConfigSnapshot* Config::getSnapshot(){
+            if (pinned.get() == 0)
+                pinned = std::atomic_load(&current);
+            return pinned.get();
+        }
+        
+        void Config::publish(unordered_map<string, string>& mappedValues){
+            version++;
+            shared_ptr<const ConfigSnapshot> newSnapshot(New ConfigSnapshot(mappedValues, version),
+                                                        MemTrackerDeleter<ConfigSnapshot>());
+            std::atomic_store(&current, newSnapshot);
+        }
+        
+        void Config::reload() throw(SDException&){
+            init();
+            cout << "Config reloaded, version " << version << endl;
+        }
+        
+        void Config::requestReload(){
+            reloadRequested.store(true, memory_order_release);
+        }
+        
+        void Config::reloadIfRequested(){
+            //workers call this concurrently, exactly one of them takes request and reloads
+            if (reloadRequested.exchange(false, memory_order_acq_rel)){
+                try{
+                    reload();
+                }
+                catch (SDException& exception){
+                    cout << exception.handleException() << endl;
+                    cout << "Keeping previous config" << endl;
+                }
+            }
+            //snapshot published by this or other thread, previous one is released
+            pinned = std::atomic_load(&current);
+        }
+        
         void Config::init() {            
             string path = CONFIG_FILE;
             ifstream inputFile;
@@ -43,13 +98,16 @@ namespace core{
                 }
                 inputFile.close();
                 string xmlContent = stream.str();
-                fillMap(xmlContent);
+                unordered_map<string, string> mappedValues;
+                MutexRaii autoLock(&mutex);
+                fillMap(xmlContent, mappedValues);
+                publish(mappedValues);
             } else {
                 SDException exc(SHADOW_READ_UNABLE, "Config init");
                 throw exc;
             }
         }
-        void Config::fillMap(string xmlFileContent) {
+        void Config::fillMap(string xmlFileContent, unordered_map<string, string>& mappedValues) {
             try {
                 xml_document<> doc;
                 const char* constContent = xmlFileContent.c_str();
@@ -58,8 +116,9 @@ namespace core{
                 strcpy(content, constContent);
                 doc.parse<0>(content);
                 string currName = "";
+                rootNodeProcessing = true;
                 for (xml_node<>* root = doc.first_node(); root; root = root->next_sibling()) {                    
-                    processNode(root, currName);
+                    processNode(root, currName, mappedValues);
                 }
             } catch (exception e) {
                 SDException exc(SHADOW_INVALID_XML, "Config init");
@@ -72,7 +131,7 @@ namespace core{
             return retString;
         }        
         
-        void Config::processNode(xml_node<>* node, string currName) {
+        void Config::processNode(xml_node<>* node, string currName, unordered_map<string, string>& mappedValues) {
             string refName = currName;
             if (refName != "") {
                 refName += ".";
@@ -88,7 +147,7 @@ namespace core{
             bool hasChildren = false;            
             for (xml_node<>* child = node->first_node(); child; child = child->next_sibling()) {
                 hasChildren = true;                                
-                processNode(child, refName);
+                processNode(child, refName, mappedValues);
             }
 
             if (hasChildren == false) {
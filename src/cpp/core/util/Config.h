@@ -9,7 +9,10 @@
 #define	CONFIG_H
 
 #include "Singleton.h"
+#include <atomic>
+#include <memory>
 #include <unordered_map>
+#include "ConfigSnapshot.h"
 #include "typedefs.h"
 #include "thirdparty/rapidxml-1.13/rapidxml.hpp"
 
@@ -20,29 +23,46 @@ namespace core{
         
         /**
          * Simple config class, parses XML file and stored mapped values in hahs map
-         * Class is Singleton
+         * Class is Singleton.
+         * Parsed values live in immutable ConfigSnapshot. Each thread reads snapshot it
+         * pinned, reading settings doesn't lock. Reload publishes new snapshot, thread
+         * moves to it in reloadIfRequested (between images), so in flight image keeps
+         * config it started with. Snapshot is deleted when last thread leaves it
          */
         class Config : public Singleton<Config>{
             friend class Singleton<Config>;            
         private:
             /**
-             * container
-             * format is key=xml_node_name.xml_node_name....
-             * val = xml_node_value
+             * latest snapshot, accessed with std::atomic_load / std::atomic_store
+             */
+            std::shared_ptr<const ConfigSnapshot> current;
+            uint version;
+            /**
+             * guards reload
              */
-            std::unordered_map<std::string, std::string> mappedValues;            
+            pthread_mutex_t mutex;
+            static std::atomic<bool> reloadRequested;
             /**
              * process xml file content
              * @param xmlFileContent
+             * @param mappedValues
+             * container
+             * format is key=xml_node_name.xml_node_name....
+             * val = xml_node_value
              */
-            void fillMap(std::string xmlFileContent);
+            void fillMap(std::string xmlFileContent, std::unordered_map<std::string, std::string>& mappedValues);
             /**
              * processing in depth from specified xml_node
              * @param node
              * @param currName
              */
-            void processNode(rapidxml::xml_node<>* node, std::string currName);                        
+            void processNode(rapidxml::xml_node<>* node, std::string currName, 
+                            std::unordered_map<std::string, std::string>& mappedValues);
             bool rootNodeProcessing;
+            /**
+             * publish new snapshot, called with mutex locked
+             */
+            void publish(std::unordered_map<std::string, std::string>& mappedValues);
         protected:
             Config();
             virtual ~Config();
@@ -57,6 +77,32 @@ namespace core{
              * @return 
              */
             virtual std::string getPropertyValue(const std::string& key) throw(SDException&);
+            /**
+             * @return
+             * typed settings of snapshot pinned by calling thread
+             */
+            const Settings& getSettings();
+            /**
+             * @return
+             * snapshot pinned by calling thread (latest one on first call), valid until
+             * thread calls reloadIfRequested. Use it when several values must come from
+             * same config version
+             */
+            const ConfigSnapshot* getSnapshot();
+            /**
+             * read config file again and publish it. On error current config is kept
+             * and exception is thrown
+             */
+            void reload() throw(SDException&);
+            /**
+             * mark config for reload, safe to call from signal handler
+             */
+            static void requestReload();
+            /**
+             * reload if requestReload was called and pin latest snapshot for calling thread,
+             * called between images. Values of previously pinned snapshot must not be used after it
+             */
+            void reloadIfRequested();
         };
 
     }
@@ -0,0 +1,140 @@
+#include "ConfigSnapshot.h"
+#include <cstdlib>
+#include <cstdio>
+
+namespace core{
+    namespace util{
+
+        using namespace std;
+
+        Settings::Settings(){
+            useBatch = true;
+            usePrediction = false;
+            openMPThreadNum = 4;
+            platformID = 0;
+            deviceID = 0;
+            useAtlas = false;
+            maxImagePixels = 0;
+            maxAtlasPixels = 0;
+            parametersClass = "";
+            predictionClass = "";
+            svmModelFile = "";
+            modelCheckInterval = 0;
+            numSegments = 16;
+            hasRegression = false;
+            regressionBorder = 0.f;
+            useThresholds = true;
+            useSkyDetection = true;
+            shadowLThresh = 0;
+            skyRThresh = 0;
+            skyBThresh = 0;
+            skyLThresh = 0;
+        }
+
+        ConfigSnapshot::ConfigSnapshot(unordered_map<string, string>& values, uint snapshotVersion){
+            mappedValues.swap(values);
+            version = snapshotVersion;
+            parseSettings();
+        }
+
+        ConfigSnapshot::~ConfigSnapshot(){
+        }
+
+        const string* ConfigSnapshot::find(const string& key) const{
+            unordered_map<string, string>::const_iterator iter = mappedValues.find(key);
+            if (iter != mappedValues.end())
+                return &iter->second;
+            return 0;
+        }
+
+        const Settings& ConfigSnapshot::getSettings() const{
+            return settings;
+        }
+
+        uint ConfigSnapshot::getVersion() const{
+            return version;
+        }
+
+        bool ConfigSnapshot::getBool(const string& key, bool defaultValue){
+            const string* val = find(key);
+            if (val == 0)
+                return defaultValue;
+            return val->compare("true") == 0;
+        }
+
+        long ConfigSnapshot::getLong(const string& key, long defaultValue){
+            const string* val = find(key);
+            if (val == 0 || *val == "")
+                return defaultValue;
+            return atol(val->c_str());
+        }
+
+        void ConfigSnapshot::parseSettings(){
+            //batch unless explicitly disabled
+            const string* useBatchStr = find("general.UseBatch");
+            settings.useBatch = useBatchStr == 0 || *useBatchStr != "false";
+            settings.usePrediction = getBool("general.Prediction.usePrediction", false);
+            long tmp = getLong("general.openMP.threadNum", 0);
+            if (tmp != 0)
+                settings.openMPThreadNum = tmp;
+            settings.platformID = getLong("general.openCL.platformid", 0);
+            settings.deviceID = getLong("general.openCL.deviceid", 0);
+
+            settings.useAtlas = getBool("general.atlas.UseAtlas", false);
+            settings.maxImagePixels = getLong("general.atlas.maxImagePixels", 0);
+            settings.maxAtlasPixels = getLong("general.atlas.maxAtlasPixels", 0);
+            if (settings.maxImagePixels == 0 || settings.maxAtlasPixels < settings.maxImagePixels)
+                settings.useAtlas = false;
+
+            const string* parametersClassStr = find("general.Prediction.parametersClass");
+            if (parametersClassStr != 0)
+                settings.parametersClass = *parametersClassStr;
+            const string* predictionClassStr = find("general.Prediction.predictionClass");
+            if (predictionClassStr != 0)
+                settings.predictionClass = *predictionClassStr;
+
+            const string* modelFile = find("general.Prediction.svm.modelFile");
+            if (modelFile != 0)
+                settings.svmModelFile = *modelFile;
+            settings.modelCheckInterval = getLong("general.Prediction.svm.modelCheckInterval", 0);
+
+            settings.numSegments = getLong("settings.Parameters.numSegments", 16);
+
+            //regression is valid only if all coefficients are present
+            const string* numOfCoefsStr = find("general.Prediction.regression.coefNum");
+            const string* interceptStr = find("general.Prediction.regression.Intercept");
+            const string* borderStr = find("general.Prediction.regression.borderValue");
+            settings.hasRegression = numOfCoefsStr != 0 && interceptStr != 0 && borderStr != 0;
+            if (settings.hasRegression){
+                int numOfCoefs = atoi(numOfCoefsStr->c_str());
+                for (int i = 0; i < numOfCoefs; i++){
+                    char key[64];
+                    sprintf(key, "general.Prediction.regression.coefNo%d", (i + 1));
+                    const string* coefStr = find(key);
+                    if (coefStr == 0){
+                        settings.hasRegression = false;
+                        settings.regressionCoefs.clear();
+                        break;
+                    }
+                    settings.regressionCoefs.push_back(atof(coefStr->c_str()));
+                }
+            }
+            if (settings.hasRegression){
+                settings.regressionCoefs.push_back(atof(interceptStr->c_str()));
+                settings.regressionBorder = atof(borderStr->c_str());
+            }
+
+            //anything except false enables them
+            const string* useThreshStr = find("shadowDetection.useThresholds");
+            settings.useThresholds = useThreshStr == 0 || *useThreshStr != "false";
+            const string* useSkyStr = find("shadowDetection.useSkyDetection");
+            settings.useSkyDetection = useSkyStr == 0 || *useSkyStr != "false";
+            settings.shadowLThresh = (unsigned char)getLong("shadowDetection.Thresholds.lValue", 0);
+
+            settings.skyRThresh = (unsigned char)getLong("skyDetection.Thresholds.rValue", 0);
+            settings.skyBThresh = (unsigned char)getLong("skyDetection.Thresholds.bValue", 0);
+            settings.skyLThresh = (unsigned char)getLong("skyDetection.Thresholds.lValue", 0);
+        }
+
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef __CONFIG_SNAPSHOT_H__
+#define __CONFIG_SNAPSHOT_H__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "typedefs.h"
+
+namespace core{
+    namespace util{
+
+        /**
+         * typed values of settings read while images are processed.
+         * Parsed once when config is loaded, missing optional keys get defaults
+         */
+        struct Settings{
+            //general
+            bool useBatch;
+            bool usePrediction;
+            int openMPThreadNum;
+            uint platformID;
+            uint deviceID;
+            bool useAtlas;
+            size_t maxImagePixels;
+            size_t maxAtlasPixels;
+            //general.Prediction, class names for ObjectFactory, empty if not set
+            std::string parametersClass;
+            std::string predictionClass;
+            //general.Prediction.svm
+            std::string svmModelFile;
+            int modelCheckInterval;
+            //settings.Parameters
+            int numSegments;
+            //general.Prediction.regression, valid if hasRegression
+            bool hasRegression;
+            /**
+             * coefficients followed by intercept
+             */
+            std::vector<float> regressionCoefs;
+            float regressionBorder;
+            //shadowDetection
+            bool useThresholds;
+            bool useSkyDetection;
+            unsigned char shadowLThresh;
+            //skyDetection
+            unsigned char skyRThresh;
+            unsigned char skyBThresh;
+            unsigned char skyLThresh;
+
+            Settings();
+        };
+
+        /**
+         * Immutable state of one loaded config file: raw key/value map and typed
+         * Settings parsed from it. Config publishes new snapshot on reload,
+         * readers holding old one are not affected
+         */
+        class ConfigSnapshot{
+        private:
+            std::unordered_map<std::string, std::string> mappedValues;
+            Settings settings;
+            uint version;
+
+            ConfigSnapshot();
+            void parseSettings();
+            bool getBool(const std::string& key, bool defaultValue);
+            long getLong(const std::string& key, long defaultValue);
+        protected:
+        public:
+            /**
+             * @param values
+             * parsed key/value pairs, moved into snapshot
+             * @param snapshotVersion
+             * increased on each reload
+             */
+            ConfigSnapshot(std::unordered_map<std::string, std::string>& values, uint snapshotVersion);
+            virtual ~ConfigSnapshot();
+
+            /**
+             * @return
+             * 0 if key is not mapped
+             */
+            const std::string* find(const std::string& key) const;
+            const Settings& getSettings() const;
+            uint getVersion() const;
+        };
+
+    }
+}
+
+#endif
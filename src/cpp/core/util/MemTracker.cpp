@@ -41,9 +41,12 @@ namespace core{
         }
         
         set<MemTrackerStruct> MemTracker::allocatedByManager;
+        pthread_mutex_t MemTracker::mutex = PTHREAD_MUTEX_INITIALIZER;
         
         void MemTracker::add(MemTrackerStruct ptr) throw(SDException&){
+            pthread_mutex_lock(&mutex);
             pair< set<MemTrackerStruct>::iterator, bool > succ = allocatedByManager.insert(ptr);
+            pthread_mutex_unlock(&mutex);
             if (succ.second == false){
                 SDException exc(SHADOW_CANT_ADD_TO_MEM_MENAGER, "MemTracker::add");
                 throw exc;
@@ -53,11 +56,14 @@ namespace core{
         void MemTracker::remove(void* ptr) throw(SDException&){
             MemTrackerStruct tmp;
             tmp.ptr = ptr;
+            pthread_mutex_lock(&mutex);
             set<MemTrackerStruct>::iterator iter = allocatedByManager.find(tmp);
             if (iter != allocatedByManager.end()){
                 allocatedByManager.erase(iter);
+                pthread_mutex_unlock(&mutex);
                 return;
             }
+            pthread_mutex_unlock(&mutex);
             SDException exc(SHADOW_NOT_INITIALIZED_BY_MENAGER_OR_DELETED, "MemTracker::remove");
             throw exc;
         }
@@ -69,12 +75,14 @@ namespace core{
         
         string MemTracker::getUnfreed(){
             string retString = "Unfreed:\n";
+            pthread_mutex_lock(&mutex);
             set<MemTrackerStruct>::iterator iter = allocatedByManager.begin();
             while (iter != allocatedByManager.end()){
                 MemTrackerStruct mtStruct = *iter;
                 retString += mtStruct.toString() + "\n";
                 iter++;
             }
+            pthread_mutex_unlock(&mutex);
             return retString;
         }
     }
@@ -5,6 +5,7 @@
 
 #include <set>
 #include <string>
+#include <pthread.h>
 #include "typedefs.h"
 
 namespace core{
@@ -36,6 +37,10 @@ namespace core{
         class MemTracker{            
         private:
             static std::set<MemTrackerStruct> allocatedByManager;
+            /**
+             * allocations can come from device pool worker threads
+             */
+            static pthread_mutex_t mutex;
         protected:
         public:            
             static void add(MemTrackerStruct ptr) throw(SDException&);
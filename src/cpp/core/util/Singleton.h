@@ -8,6 +8,7 @@
 #ifndef SINGLETON_H
 #define	SINGLETON_H
 
+#include <atomic>
 #include "core/util/raii/RAIIS.h"
 #include "typedefs.h"
 
@@ -15,11 +16,15 @@ namespace core{
     namespace util{
         
         /**
-         * template singleton class
+         * template singleton class.
+         * Instance is created once on first getInstancePtr call. After that getInstancePtr
+         * is single acquire load without locking, so it is cheap to call from hot paths and
+         * from multiple worker threads
          */
         template <class T> class Singleton{
         private:
-            static T* instancePtr;            
+            static std::atomic<T*> instancePtr;
+            static pthread_mutex_t mutex;
         protected:
             Singleton();            
             virtual ~Singleton();
@@ -30,12 +35,15 @@ namespace core{
              */
             static T* getInstancePtr();
             /**
-             * maybe someone will call it sometime !!??
+             * delete instance, next getInstancePtr call creates new one.
+             * Must not be called while other threads still use instance
+             * (for example before device pool workers are joined)
              */
             static void destroy();
         };
         
-        template<class T> T* Singleton<T>::instancePtr = 0;
+        template<class T> std::atomic<T*> Singleton<T>::instancePtr(0);
+        template<class T> pthread_mutex_t Singleton<T>::mutex = PTHREAD_MUTEX_INITIALIZER;
         
         template<class T> Singleton<T>::Singleton(){            
         }
@@ -43,30 +51,30 @@ namespace core{
         template<class T> Singleton<T>::~Singleton(){            
         }
         
-        template<class T> T* Singleton<T>::getInstancePtr(){            
-            pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        template<class T> T* Singleton<T>::getInstancePtr(){
+            T* ptr = instancePtr.load(std::memory_order_acquire);
+            if (ptr != 0)
+                return ptr;
             raii::MutexRaii autoLock(&mutex);
-            static T* instancePtrTmp = 0;
-            if (instancePtrTmp == 0 || instancePtr == 0){
-                instancePtrTmp = New T();
-                if (instancePtrTmp == 0){
+            //other thread could create instance while this one waited for lock
+            ptr = instancePtr.load(std::memory_order_relaxed);
+            if (ptr == 0){
+                ptr = New T();
+                if (ptr == 0){
                     SDException exc(SHADOW_NO_MEM, "Init singleton");
                     throw exc;
                 }
-                else{
-                    instancePtr = instancePtrTmp;
-                }
+                instancePtr.store(ptr, std::memory_order_release);
             }
-            return instancePtr;
+            return ptr;
         }
         
         template<class T> void Singleton<T>::destroy(){           
-            pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
             raii::MutexRaii autoLock(&mutex);
-            if (instancePtr != 0){
-                Delete(instancePtr);                
+            T* ptr = instancePtr.exchange(0, std::memory_order_acq_rel);
+            if (ptr != 0){
+                Delete(ptr);
             }
-            instancePtr = 0;
         }
 
     }
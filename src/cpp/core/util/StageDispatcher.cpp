@@ -0,0 +1,142 @@
+#include "StageDispatcher.h"
+#include <iostream>
+#include <cmath>
+#include "core/util/raii/RAIIS.h"
+#include "core/util/Config.h"
+
+namespace core{
+    namespace util{
+
+        using namespace std;
+        using namespace core::util::raii;
+
+        static const char* stageNames[] = {"tsai", "parameters", "predict"};
+        static const char* backendNames[] = {"CPU", "OpenCL"};
+
+        StageCostModel::StageCostModel(){
+            samples = 0.;
+            sumX = 0.;
+            sumY = 0.;
+            sumXX = 0.;
+            sumXY = 0.;
+            count = 0;
+        }
+
+        void StageCostModel::add(double pixels, double millis){
+            samples = samples * STAGE_COST_DECAY + 1.;
+            sumX    = sumX * STAGE_COST_DECAY + pixels;
+            sumY    = sumY * STAGE_COST_DECAY + millis;
+            sumXX   = sumXX * STAGE_COST_DECAY + pixels * pixels;
+            sumXY   = sumXY * STAGE_COST_DECAY + pixels * millis;
+            count++;
+        }
+
+        double StageCostModel::predict(double pixels) const{
+            if (count == 0 || sumX <= 0.)
+                return 0.;
+            double perPixel = sumY / sumX;
+            double variance = samples * sumXX - sumX * sumX;
+            //all measurements on (almost) same image size, fixed part can't be separated
+            if (count < 2 || variance <= 1e-9 * sumXX * samples)
+                return perPixel * pixels;
+            double slope = (samples * sumXY - sumX * sumY) / variance;
+            double fixed = (sumY - slope * sumX) / samples;
+            if (slope < 0. || fixed < 0.)
+                return perPixel * pixels;
+            return fixed + slope * pixels;
+        }
+
+        StageDispatcher::StageDispatcher() : Singleton<StageDispatcher>(){
+            pthread_mutex_init(&mutex, 0);
+            Config* conf = Config::getInstancePtr();
+            for (int i = 0; i < STAGE_COUNT; i++){
+                routed[i] = 0;
+#ifdef _OPENCL
+                modes[i] = DISPATCH_OPENCL;
+#else
+                modes[i] = DISPATCH_CPU;
+#endif
+                try{
+                    string modeStr = conf->getPropertyValue(string("general.dispatch.") + stageNames[i]);
+                    modes[i] = parseMode(modeStr);
+                }
+                catch (SDException& e){
+                    //older configs don't have dispatch section, keep build default
+                }
+            }
+        }
+
+        StageDispatcher::~StageDispatcher(){
+            pthread_mutex_destroy(&mutex);
+        }
+
+        DISPATCH_MODE StageDispatcher::parseMode(const string& modeStr){
+            if (modeStr.compare("auto") == 0)
+                return DISPATCH_AUTO;
+            if (modeStr.compare("cpu") == 0)
+                return DISPATCH_CPU;
+            return DISPATCH_OPENCL;
+        }
+
+        PROCESSING_BACKEND StageDispatcher::select(PROCESSING_STAGE stage, uint64_t pixels){
+#ifndef _OPENCL
+            return BACKEND_CPU;
+#else
+            if (modes[stage] == DISPATCH_CPU)
+                return BACKEND_CPU;
+            if (modes[stage] == DISPATCH_OPENCL)
+                return BACKEND_OPENCL;
+            MutexRaii autoLock(&mutex);
+            //measure each backend few times before trusting models
+            if (models[stage][BACKEND_OPENCL].count < MIN_STAGE_SAMPLES)
+                return BACKEND_OPENCL;
+            if (models[stage][BACKEND_CPU].count < MIN_STAGE_SAMPLES)
+                return BACKEND_CPU;
+            double cpuTime = models[stage][BACKEND_CPU].predict(pixels);
+            double oclTime = models[stage][BACKEND_OPENCL].predict(pixels);
+            PROCESSING_BACKEND faster = cpuTime < oclTime ? BACKEND_CPU : BACKEND_OPENCL;
+            routed[stage]++;
+            //slower backend is measured again, otherwise its model never sees it getting faster
+            if (routed[stage] % STAGE_EXPLORE_INTERVAL == 0)
+                return faster == BACKEND_CPU ? BACKEND_OPENCL : BACKEND_CPU;
+            return faster;
+#endif
+        }
+
+        StageRun StageDispatcher::begin(PROCESSING_STAGE stage, uint64_t pixels){
+            StageRun run;
+            run.stage = stage;
+            run.pixels = pixels;
+            run.backend = select(stage, pixels);
+            run.start = chrono::steady_clock::now();
+            return run;
+        }
+
+        void StageDispatcher::end(const StageRun& run){
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - run.start;
+            MutexRaii autoLock(&mutex);
+            models[run.stage][run.backend].add((double)run.pixels, elapsed.count());
+        }
+
+        string StageDispatcher::getStageName(PROCESSING_STAGE stage){
+            string name = stageNames[stage];
+            return name;
+        }
+
+        void StageDispatcher::printModels(){
+            MutexRaii autoLock(&mutex);
+            cout << "===========" << endl;
+            cout << "Stage cost models (predicted ms of 1 Mpix image):" << endl;
+            for (int i = 0; i < STAGE_COUNT; i++){
+                for (int j = 0; j < BACKEND_COUNT; j++){
+                    const StageCostModel& model = models[i][j];
+                    if (model.count == 0)
+                        continue;
+                    cout << stageNames[i] << " " << backendNames[j] << ": runs " << model.count
+                            << ", " << model.predict(1000000.) << endl;
+                }
+            }
+        }
+
+    }
+}
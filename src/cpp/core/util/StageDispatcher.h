@@ -0,0 +1,125 @@
+#ifndef __STAGE_DISPATCHER_H__
+#define __STAGE_DISPATCHER_H__
+
+#include <chrono>
+#include <string>
+#include <pthread.h>
+#include "core/util/Singleton.h"
+#include "typedefs.h"
+
+/**
+ * minimal number of measurements of each backend before stage is routed by cost model
+ */
+#define MIN_STAGE_SAMPLES 2
+/**
+ * weight of older measurements, lower adapts faster
+ */
+#define STAGE_COST_DECAY 0.95
+/**
+ * every STAGE_EXPLORE_INTERVAL-th routed run goes to backend predicted as slower,
+ * so its model follows changes too
+ */
+#define STAGE_EXPLORE_INTERVAL 32
+
+namespace core{
+    namespace util{
+
+        enum PROCESSING_STAGE{
+            STAGE_TSAI,
+            STAGE_PARAMETERS,
+            STAGE_PREDICT,
+            STAGE_COUNT,
+        };
+
+        enum PROCESSING_BACKEND{
+            BACKEND_CPU,
+            BACKEND_OPENCL,
+            BACKEND_COUNT,
+        };
+
+        enum DISPATCH_MODE{
+            DISPATCH_AUTO,
+            DISPATCH_CPU,
+            DISPATCH_OPENCL,
+        };
+
+        /**
+         * online least squares model time = fixed + perPixel * pixels,
+         * with exponentially decayed sums so model follows changes (thermal, other load)
+         */
+        struct StageCostModel{
+            double samples;
+            double sumX;
+            double sumY;
+            double sumXX;
+            double sumXY;
+            uint64_t count;
+
+            StageCostModel();
+            void add(double pixels, double millis);
+            /**
+             * @return
+             * predicted time in milliseconds
+             */
+            double predict(double pixels) const;
+        };
+
+        /**
+         * one stage execution, returned by StageDispatcher::begin and passed back to end
+         */
+        struct StageRun{
+            PROCESSING_STAGE stage;
+            PROCESSING_BACKEND backend;
+            uint64_t pixels;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        /**
+         * Routes processing stages (tsai, image parameters, prediction) to CPU or OpenCL
+         * implementation. In auto mode each stage keeps cost model per backend by pixel count
+         * and image is routed to backend predicted as faster, except every
+         * STAGE_EXPLORE_INTERVAL-th image which measures slower one. Mode of each stage is set in
+         * general.dispatch section of config. Builds without OpenCL always use CPU.
+         * Class is Singleton
+         */
+        class StageDispatcher : public Singleton<StageDispatcher>{
+            friend class Singleton<StageDispatcher>;
+        private:
+            pthread_mutex_t mutex;
+            DISPATCH_MODE modes[STAGE_COUNT];
+            StageCostModel models[STAGE_COUNT][BACKEND_COUNT];
+            /**
+             * number of runs of stage routed by cost models
+             */
+            uint64_t routed[STAGE_COUNT];
+
+            static DISPATCH_MODE parseMode(const std::string& modeStr);
+        protected:
+            StageDispatcher();
+            virtual ~StageDispatcher();
+        public:
+            /**
+             * choose backend for stage
+             * @param stage
+             * @param pixels
+             * number of pixels in processed image
+             * @return
+             * backend which should run stage
+             */
+            PROCESSING_BACKEND select(PROCESSING_STAGE stage, uint64_t pixels);
+            /**
+             * choose backend and start measuring
+             */
+            StageRun begin(PROCESSING_STAGE stage, uint64_t pixels);
+            /**
+             * add measured time of finished stage to cost model
+             */
+            void end(const StageRun& run);
+            static std::string getStageName(PROCESSING_STAGE stage);
+            void printModels();
+        };
+
+    }
+}
+
+#endif
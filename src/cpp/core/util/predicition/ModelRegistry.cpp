@@ -0,0 +1,155 @@
+#include "ModelRegistry.h"
+#include <iostream>
+#include <sys/stat.h>
+#include "core/util/Config.h"
+#include "core/util/raii/RAIIS.h"
+#include "core/util/MemTracker.h"
+#ifdef _OPENCL
+#include "core/opencl/libsvm/OpenCLToolsPredict.h"
+#endif
+
+namespace core{
+    namespace util{
+        namespace prediction{
+
+            using namespace std;
+            using namespace core::util;
+            using namespace core::util::raii;
+            using namespace core::util::prediction::svm;
+
+            ModelRegistry::ModelRegistry() : Singleton<ModelRegistry>(), loaderBusy(false){
+                lastVersion = 0;
+                loaderStarted = false;
+                checkedConfigVersion = 0;
+                lastCheck = 0;
+                loadedModifyTime = 0;
+                pthread_mutex_init(&mutex, 0);
+            }
+
+            ModelRegistry::~ModelRegistry(){
+                joinLoader();
+                std::atomic_store(&current, shared_ptr<const SvmModelVersion>());
+                pthread_mutex_destroy(&mutex);
+            }
+
+            time_t ModelRegistry::getModifyTime(const string& file){
+                struct stat fileStat;
+                if (stat(file.c_str(), &fileStat) != 0)
+                    return 0;
+                return fileStat.st_mtime;
+            }
+
+            shared_ptr<const SvmModelVersion> ModelRegistry::acquire(){
+                return std::atomic_load(&current);
+            }
+
+            bool ModelRegistry::hasModel(){
+                return acquire().get() != 0;
+            }
+
+            void ModelRegistry::publish(shared_ptr<const SvmModelVersion> version, time_t modifyTime){
+                std::atomic_store(&current, version);
+                loadedModifyTime = modifyTime;
+                cout << "SVM model version " << version->getVersion() << " loaded from " << version->getFile() << endl;
+            }
+
+            void ModelRegistry::load() throw (SDException&){
+                const Settings& settings = Config::getInstancePtr()->getSettings();
+                string file = settings.svmModelFile;
+                time_t modifyTime = getModifyTime(file);
+                MutexRaii autoLock(&mutex);
+                lastVersion++;
+                shared_ptr<const SvmModelVersion> version(New SvmModelVersion(file, lastVersion),
+                                                        MemTrackerDeleter<SvmModelVersion>());
+                checkedConfigVersion = Config::getInstancePtr()->getSnapshot()->getVersion();
+                publish(version, modifyTime);
+            }
+
+            void ModelRegistry::refresh(){
+                if (hasModel() == false || loaderBusy.load(memory_order_acquire))
+                    return;
+                //other worker is already checking
+                if (pthread_mutex_trylock(&mutex) != 0)
+                    return;
+                checkAndStartLoader();
+                pthread_mutex_unlock(&mutex);
+            }
+
+            void ModelRegistry::checkAndStartLoader(){
+                const ConfigSnapshot* snapshot = Config::getInstancePtr()->getSnapshot();
+                const Settings& settings = snapshot->getSettings();
+                bool configChanged = snapshot->getVersion() != checkedConfigVersion;
+                bool checkFile = false;
+                if (settings.modelCheckInterval > 0){
+                    time_t now = time(0);
+                    if (now - lastCheck >= settings.modelCheckInterval){
+                        lastCheck = now;
+                        checkFile = true;
+                    }
+                }
+                if (configChanged == false && checkFile == false)
+                    return;
+                checkedConfigVersion = snapshot->getVersion();
+                shared_ptr<const SvmModelVersion> version = acquire();
+                if (version->getFile() == settings.svmModelFile &&
+                    getModifyTime(settings.svmModelFile) == loadedModifyTime)
+                    return;
+
+                //loader is not busy, so join returns immediately
+                joinLoader();
+                pendingFile = settings.svmModelFile;
+                loaderBusy.store(true, memory_order_release);
+                if (pthread_create(&loaderThread, 0, ModelRegistry::loaderMain, this) != 0){
+                    loaderBusy.store(false, memory_order_release);
+                    cout << "ModelRegistry::refresh can't start loader" << endl;
+                    return;
+                }
+                loaderStarted = true;
+            }
+
+            void* ModelRegistry::loaderMain(void* arg){
+                ModelRegistry* registry = (ModelRegistry*)arg;
+                registry->loadPending();
+                return 0;
+            }
+
+            void ModelRegistry::loadPending(){
+                string file;
+                uint versionNum;
+                {
+                    MutexRaii autoLock(&mutex);
+                    file = pendingFile;
+                    versionNum = lastVersion + 1;
+                }
+                time_t modifyTime = getModifyTime(file);
+                try{
+                    shared_ptr<const SvmModelVersion> version(New SvmModelVersion(file, versionNum),
+                                                            MemTrackerDeleter<SvmModelVersion>());
+#ifdef _OPENCL
+                    //devices get model before images do
+                    core::opencl::libsvm::OpenCLToolsPredict::prepareModel(version);
+#endif
+                    MutexRaii autoLock(&mutex);
+                    lastVersion = versionNum;
+                    publish(version, modifyTime);
+                }
+                catch (SDException& exception){
+                    cout << exception.handleException() << endl;
+                    cout << "Keeping SVM model version " << lastVersion << endl;
+                    //don't retry same broken file on every check
+                    MutexRaii autoLock(&mutex);
+                    loadedModifyTime = modifyTime;
+                }
+                loaderBusy.store(false, memory_order_release);
+            }
+
+            void ModelRegistry::joinLoader(){
+                if (loaderStarted){
+                    pthread_join(loaderThread, 0);
+                    loaderStarted = false;
+                }
+            }
+
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef __MODEL_REGISTRY_H__
+#define __MODEL_REGISTRY_H__
+
+#include <memory>
+#include <string>
+#include <atomic>
+#include <ctime>
+#include <pthread.h>
+#include "core/util/Singleton.h"
+#include "core/util/predicition/libsvm/SvmModelVersion.h"
+#include "typedefs.h"
+
+namespace core{
+    namespace util{
+        namespace prediction{
+
+            /**
+             * Holds current version of SVM model used by SvmPredict.
+             * New versions are loaded, validated and packed on background thread and then
+             * published with atomic pointer swap (RCU). With openCL, model is uploaded to
+             * prediction devices before it is published. Predictor takes reference to current
+             * version at start of each image, so images in flight finish on version they started
+             * with and old version is freed when last of them ends.
+             * Load is started between images by refresh when general.Prediction.svm.modelFile
+             * changes after config reload, or when model file is modified (checked every
+             * general.Prediction.svm.modelCheckInterval seconds, 0 disables check).
+             * Regression coefficients don't need registry, they are swapped with config snapshot.
+             */
+            class ModelRegistry : public core::util::Singleton<ModelRegistry>{
+                friend class core::util::Singleton<ModelRegistry>;
+            private:
+                /**
+                 * accessed only with std::atomic_load / std::atomic_store
+                 */
+                std::shared_ptr<const svm::SvmModelVersion> current;
+                uint lastVersion;
+
+                //background loader
+                pthread_mutex_t mutex;
+                pthread_t loaderThread;
+                bool loaderStarted;
+                std::atomic<bool> loaderBusy;
+                std::string pendingFile;
+
+                //change detection, used only from thread calling refresh
+                uint checkedConfigVersion;
+                time_t lastCheck;
+                time_t loadedModifyTime;
+
+                static void* loaderMain(void* arg);
+                /**
+                 * load, validate, pack and publish, called on loader thread
+                 */
+                void loadPending();
+                /**
+                 * start loader if model file changed, called with mutex locked
+                 */
+                void checkAndStartLoader();
+                void publish(std::shared_ptr<const svm::SvmModelVersion> version, time_t modifyTime);
+                void joinLoader();
+                static time_t getModifyTime(const std::string& file);
+            protected:
+                ModelRegistry();
+            public:
+                virtual ~ModelRegistry();
+
+                /**
+                 * @return
+                 * current model version, empty if no model is loaded
+                 */
+                std::shared_ptr<const svm::SvmModelVersion> acquire();
+                /**
+                 * load configured model on calling thread, used for first load
+                 */
+                void load() throw (SDException&);
+                bool hasModel();
+                /**
+                 * start background load if model changed, cheap when nothing changed.
+                 * Called between images
+                 */
+                void refresh();
+            };
+
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,446 @@
+#include "SvmModelVersion.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "thirdparty/lib_svm/svm.h"
+#include "core/util/raii/RAIIS.h"
+#include "core/util/MemTracker.h"
+#include "core/util/Bytes.h"
+
+namespace core{
+    namespace util{
+        namespace prediction{
+            namespace svm{
+
+                using namespace std;
+                using namespace core::util;
+                using namespace core::util::raii;
+
+                SvmModelVersion::SvmModelVersion(const string& modelFile, uint modelVersion) throw (SDException&){
+                    version = modelVersion;
+                    file = modelFile;
+                    svs = 0;
+                    coefs = 0;
+                    rhos = 0;
+                    labels = 0;
+                    nSVs = 0;
+                    mapped = 0;
+                    mappedSize = 0;
+                    binary = isBinary(modelFile);
+                    if (binary)
+                        loadBinary();
+                    else
+                        loadText();
+                    try{
+                        validate();
+                    }
+                    catch (SDException& exception){
+                        if (mapped != 0)
+                            munmap(mapped, mappedSize);
+                        mapped = 0;
+                        throw exception;
+                    }
+                }
+
+                SvmModelVersion::~SvmModelVersion(){
+                    if (mapped != 0)
+                        munmap(mapped, mappedSize);
+                }
+
+                bool SvmModelVersion::isBinary(const string& modelFile){
+                    char magic[8];
+                    ifstream input(modelFile.c_str(), ifstream::in | ifstream::binary);
+                    if (input.is_open() == false)
+                        return false;
+                    input.read(magic, 8);
+                    return input.gcount() == 8 && memcmp(magic, SVM_BINARY_MAGIC, 8) == 0;
+                }
+
+                void SvmModelVersion::loadText() throw (SDException&){
+                    svm_model* model = svm_load_model(file.c_str());
+                    if (model == 0){
+                        SDException exc(SHADOW_READ_UNABLE, "SvmModelVersion: " + file);
+                        throw exc;
+                    }
+                    svmType = model->param.svm_type;
+                    kernelType = model->param.kernel_type;
+                    degree = model->param.degree;
+                    gamma = model->param.gamma;
+                    coef0 = model->param.coef0;
+                    nrClass = model->nr_class;
+                    l = model->l;
+
+                    //support vectors are stored by position, same as in training set
+                    int width = 0;
+                    for (int i = 0; i < l; i++){
+                        int currWidth = 1;
+                        svm_node* node = model->SV[i];
+                        while (node->index != -1){
+                            currWidth++;
+                            node++;
+                        }
+                        if (width < currWidth)
+                            width = currWidth;
+                    }
+                    svsWidth = (width + SVM_ROW_ALIGN - 1) / SVM_ROW_ALIGN * SVM_ROW_ALIGN;
+                    svsExact.assign((size_t)svsWidth * l, 0.);
+                    for (int i = 0; i < l; i++){
+                        for (int j = 0; model->SV[i][j].index != -1; j++){
+                            svsExact[(size_t)i * svsWidth + j] = model->SV[i][j].value;
+                        }
+                    }
+
+                    coefsExact.resize((size_t)(nrClass - 1) * l);
+                    for (int i = 0; i < nrClass - 1; i++){
+                        for (int j = 0; j < l; j++){
+                            coefsExact[(size_t)i * l + j] = model->sv_coef[i][j];
+                        }
+                    }
+
+                    rhosExact.assign(model->rho, model->rho + getRHOCount());
+                    //float copies for openCL and binary format
+                    svsStorage.assign(svsExact.begin(), svsExact.end());
+                    coefsStorage.assign(coefsExact.begin(), coefsExact.end());
+                    rhosStorage.assign(rhosExact.begin(), rhosExact.end());
+                    if (model->label)
+                        labelsStorage.assign(model->label, model->label + nrClass);
+                    if (model->nSV)
+                        nSVsStorage.assign(model->nSV, model->nSV + nrClass);
+                    svm_free_and_destroy_model(&model);
+
+                    svs = svsStorage.data();
+                    coefs = coefsStorage.data();
+                    rhos = rhosStorage.data();
+                    labels = labelsStorage.size() > 0 ? labelsStorage.data() : 0;
+                    nSVs = nSVsStorage.size() > 0 ? nSVsStorage.data() : 0;
+                }
+
+                void SvmModelVersion::loadBinary() throw (SDException&){
+                    int fd = open(file.c_str(), O_RDONLY);
+                    if (fd < 0){
+                        SDException exc(SHADOW_READ_UNABLE, "SvmModelVersion::loadBinary: " + file);
+                        throw exc;
+                    }
+                    struct stat fileStat;
+                    if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(SvmBinaryHeader)){
+                        close(fd);
+                        SDException exc(SHADOW_READ_UNABLE, "SvmModelVersion::loadBinary size: " + file);
+                        throw exc;
+                    }
+                    mappedSize = fileStat.st_size;
+                    mapped = mmap(0, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                    close(fd);
+                    if (mapped == MAP_FAILED){
+                        mapped = 0;
+                        SDException exc(SHADOW_READ_UNABLE, "SvmModelVersion::loadBinary mmap: " + file);
+                        throw exc;
+                    }
+
+                    const char* base = (const char*)mapped;
+                    const SvmBinaryHeader* header = (const SvmBinaryHeader*)base;
+                    svmType = header->svmType;
+                    kernelType = header->kernelType;
+                    degree = header->degree;
+                    gamma = header->gamma;
+                    coef0 = header->coef0;
+                    nrClass = header->nrClass;
+                    l = header->l;
+                    svsWidth = header->svsWidth;
+
+                    bool valid = header->formatVersion == SVM_BINARY_VERSION && header->fileSize == mappedSize &&
+                                l > 0 && nrClass >= 2 && svsWidth > 0;
+                    //counts are bounded by file size before section sizes are computed from them
+                    if (valid && ((uint64_t)l * sizeof(float) > mappedSize || (uint64_t)nrClass * sizeof(int32_t) > mappedSize))
+                        valid = false;
+                    //each section must lie inside of file
+                    uint64_t sizes[5];
+                    uint64_t offsets[5] = { header->svsOffset, header->coefsOffset, header->rhoOffset,
+                                            header->labelOffset, header->nSVOffset };
+                    if (valid){
+                        sizes[0] = (uint64_t)l * svsWidth * sizeof(float);
+                        sizes[1] = (uint64_t)(nrClass - 1) * l * sizeof(float);
+                        sizes[2] = (uint64_t)getRHOCount() * sizeof(float);
+                        sizes[3] = (uint64_t)nrClass * sizeof(int32_t);
+                        sizes[4] = (uint64_t)nrClass * sizeof(int32_t);
+                        for (int i = 0; i < 5; i++){
+                            //labels and nSV are optional
+                            if (i >= 3 && offsets[i] == 0)
+                                continue;
+                            if (offsets[i] % sizeof(float) != 0 || offsets[i] < sizeof(SvmBinaryHeader) ||
+                                offsets[i] + sizes[i] > mappedSize)
+                                valid = false;
+                        }
+                    }
+                    if (valid == false){
+                        munmap(mapped, mappedSize);
+                        mapped = 0;
+                        SDException exc(SHADOW_READ_UNABLE, "SvmModelVersion::loadBinary invalid header: " + file);
+                        throw exc;
+                    }
+                    svs = (const float*)(base + header->svsOffset);
+                    coefs = (const float*)(base + header->coefsOffset);
+                    rhos = (const float*)(base + header->rhoOffset);
+                    labels = header->labelOffset != 0 ? (const int*)(base + header->labelOffset) : 0;
+                    nSVs = header->nSVOffset != 0 ? (const int*)(base + header->nSVOffset) : 0;
+                }
+
+                void SvmModelVersion::validate() throw (SDException&){
+                    if (svmType < C_SVC || svmType > NU_SVR){
+                        SDException exc(SHADOW_INALID_SVM_TYPE, "SvmModelVersion::validate: " + file);
+                        throw exc;
+                    }
+                    //precomputed kernel needs training set, openCL kernel doesn't support it
+                    if (kernelType < LINEAR || kernelType >= PRECOMPUTED){
+                        SDException exc(SHADOW_INVALID_KERNEL_TYPE, "SvmModelVersion::validate: " + file);
+                        throw exc;
+                    }
+                    bool classification = svmType == C_SVC || svmType == NU_SVC;
+                    if (l <= 0 || nrClass < 2 || (classification && (labels == 0 || nSVs == 0))){
+                        SDException exc(SHADOW_NO_MODEL_LOADED, "SvmModelVersion::validate empty: " + file);
+                        throw exc;
+                    }
+                    if (classification){
+                        //negative count would move start of other class out of support vectors
+                        int64_t sum = 0;
+                        bool nonNegative = true;
+                        for (int i = 0; i < nrClass; i++){
+                            if (nSVs[i] < 0)
+                                nonNegative = false;
+                            sum += nSVs[i];
+                        }
+                        if (nonNegative == false || sum != l){
+                            SDException exc(SHADOW_NO_MODEL_LOADED, "SvmModelVersion::validate nSV: " + file);
+                            throw exc;
+                        }
+                    }
+                    //probe prediction, corrupted coefficients show up as non finite value
+                    vector<float> probe(svsWidth, 0.f);
+                    vector<double> kvalue(l);
+                    vector<int> start(nrClass);
+                    vector<int> vote(nrClass);
+                    double val = predict(probe.data(), svsWidth, kvalue.data(), start.data(), vote.data());
+                    if (std::isfinite(val) == false){
+                        SDException exc(SHADOW_CANT_PREDICT, "SvmModelVersion::validate probe: " + file);
+                        throw exc;
+                    }
+                }
+
+                void SvmModelVersion::saveBinary(const string& outFile) const throw (SDException&){
+                    SvmBinaryHeader header;
+                    memset(&header, 0, sizeof(SvmBinaryHeader));
+                    memcpy(header.magic, SVM_BINARY_MAGIC, 8);
+                    header.formatVersion = SVM_BINARY_VERSION;
+                    header.svmType = svmType;
+                    header.kernelType = kernelType;
+                    header.degree = degree;
+                    header.gamma = gamma;
+                    header.coef0 = coef0;
+                    header.nrClass = nrClass;
+                    header.l = l;
+                    header.svsWidth = svsWidth;
+
+                    const char* sections[5] = { (const char*)svs, (const char*)coefs, (const char*)rhos,
+                                                (const char*)labels, (const char*)nSVs };
+                    uint64_t sizes[5] = {   (uint64_t)l * svsWidth * sizeof(float),
+                                            (uint64_t)(nrClass - 1) * l * sizeof(float),
+                                            (uint64_t)getRHOCount() * sizeof(float),
+                                            labels != 0 ? (uint64_t)nrClass * sizeof(int32_t) : 0,
+                                            nSVs != 0 ? (uint64_t)nrClass * sizeof(int32_t) : 0 };
+                    uint64_t offsets[5];
+                    uint64_t offset = alignOffset(sizeof(SvmBinaryHeader), SVM_BINARY_ALIGN);
+                    for (int i = 0; i < 5; i++){
+                        if (sizes[i] == 0 && i >= 3){
+                            offsets[i] = 0;
+                            continue;
+                        }
+                        offsets[i] = offset;
+                        offset = alignOffset(offset + sizes[i], SVM_BINARY_ALIGN);
+                    }
+                    header.svsOffset = offsets[0];
+                    header.coefsOffset = offsets[1];
+                    header.rhoOffset = offsets[2];
+                    header.labelOffset = offsets[3];
+                    header.nSVOffset = offsets[4];
+                    header.fileSize = offset;
+
+                    fstream output;
+                    output.open(outFile.c_str(), fstream::out | fstream::binary | fstream::trunc);
+                    if (output.is_open() == false){
+                        SDException exc(SHADOW_WRITE_UNABLE, "SvmModelVersion::saveBinary: " + outFile);
+                        throw exc;
+                    }
+                    FileRaii fRaii(&output);
+                    vector<char> padding(SVM_BINARY_ALIGN, 0);
+                    output.write((const char*)&header, sizeof(SvmBinaryHeader));
+                    uint64_t written = sizeof(SvmBinaryHeader);
+                    for (int i = 0; i < 5; i++){
+                        if (offsets[i] == 0)
+                            continue;
+                        output.write(padding.data(), offsets[i] - written);
+                        output.write(sections[i], sizes[i]);
+                        written = offsets[i] + sizes[i];
+                    }
+                    output.write(padding.data(), offset - written);
+                    if (output.good() == false){
+                        SDException exc(SHADOW_WRITE_UNABLE, "SvmModelVersion::saveBinary write: " + outFile);
+                        throw exc;
+                    }
+                }
+
+                template<typename T> double SvmModelVersion::kernel(const float* x, int xLen, const T* sv) const{
+                    double dot = 0.;
+                    double dist = 0.;
+                    int len = xLen < svsWidth ? xLen : svsWidth;
+                    for (int i = 0; i < len; i++){
+                        dot += (double)x[i] * sv[i];
+                        double d = (double)x[i] - sv[i];
+                        dist += d * d;
+                    }
+                    //parameters without support vector value are multiplied by 0
+                    for (int i = len; i < xLen; i++){
+                        dist += (double)x[i] * x[i];
+                    }
+                    switch (kernelType){
+                        case LINEAR:
+                            return dot;
+                        case POLY:
+                            return pow(gamma * dot + coef0, degree);
+                        case RBF:
+                            return exp(-gamma * dist);
+                        case SIGMOID:
+                            return tanh(gamma * dot + coef0);
+                        default:
+                            return 0.;
+                    }
+                }
+
+                double SvmModelVersion::predict(const float* x, int xLen, double* kvalue, int* start, int* vote) const{
+                    if (binary)
+                        return predict(x, xLen, svs, coefs, rhos, kvalue, start, vote);
+                    return predict(x, xLen, svsExact.data(), coefsExact.data(), rhosExact.data(), kvalue, start, vote);
+                }
+
+                template<typename T> double SvmModelVersion::predict(const float* x, int xLen, const T* modelSVs,
+                                                                    const T* modelCoefs, const T* modelRHOs,
+                                                                    double* kvalue, int* start, int* vote) const{
+                    if (svmType == ONE_CLASS || svmType == EPSILON_SVR || svmType == NU_SVR){
+                        double sum = 0.;
+                        for (int i = 0; i < l; i++){
+                            sum += modelCoefs[i] * kernel(x, xLen, modelSVs + (size_t)i * svsWidth);
+                        }
+                        sum -= modelRHOs[0];
+                        if (svmType == ONE_CLASS)
+                            return (sum > 0) ? 1 : -1;
+                        return sum;
+                    }
+
+                    for (int i = 0; i < l; i++){
+                        kvalue[i] = kernel(x, xLen, modelSVs + (size_t)i * svsWidth);
+                    }
+                    start[0] = 0;
+                    for (int i = 1; i < nrClass; i++)
+                        start[i] = start[i - 1] + nSVs[i - 1];
+                    for (int i = 0; i < nrClass; i++)
+                        vote[i] = 0;
+
+                    int p = 0;
+                    for (int i = 0; i < nrClass; i++){
+                        for (int j = i + 1; j < nrClass; j++){
+                            double sum = 0.;
+                            int si = start[i];
+                            int sj = start[j];
+                            int ci = nSVs[i];
+                            int cj = nSVs[j];
+                            const T* coef1 = modelCoefs + (size_t)(j - 1) * l;
+                            const T* coef2 = modelCoefs + (size_t)i * l;
+                            for (int k = 0; k < ci; k++)
+                                sum += coef1[si + k] * kvalue[si + k];
+                            for (int k = 0; k < cj; k++)
+                                sum += coef2[sj + k] * kvalue[sj + k];
+                            sum -= modelRHOs[p];
+                            if (sum > 0)
+                                ++vote[i];
+                            else
+                                ++vote[j];
+                            p++;
+                        }
+                    }
+                    int voteMaxIdx = 0;
+                    for (int i = 1; i < nrClass; i++)
+                        if (vote[i] > vote[voteMaxIdx])
+                            voteMaxIdx = i;
+                    return labels[voteMaxIdx];
+                }
+
+                uint SvmModelVersion::getVersion() const{
+                    return version;
+                }
+
+                const string& SvmModelVersion::getFile() const{
+                    return file;
+                }
+
+                int SvmModelVersion::getSvmType() const{
+                    return svmType;
+                }
+
+                int SvmModelVersion::getKernelType() const{
+                    return kernelType;
+                }
+
+                int SvmModelVersion::getDegree() const{
+                    return degree;
+                }
+
+                float SvmModelVersion::getGamma() const{
+                    return gamma;
+                }
+
+                float SvmModelVersion::getCoef0() const{
+                    return coef0;
+                }
+
+                int SvmModelVersion::getNrClass() const{
+                    return nrClass;
+                }
+
+                int SvmModelVersion::getL() const{
+                    return l;
+                }
+
+                int SvmModelVersion::getSVsWidth() const{
+                    return svsWidth;
+                }
+
+                const float* SvmModelVersion::getSVs() const{
+                    return svs;
+                }
+
+                const float* SvmModelVersion::getCoefs() const{
+                    return coefs;
+                }
+
+                const float* SvmModelVersion::getRHOs() const{
+                    return rhos;
+                }
+
+                int SvmModelVersion::getRHOCount() const{
+                    return nrClass * (nrClass - 1) / 2;
+                }
+
+                const int* SvmModelVersion::getLabels() const{
+                    return labels;
+                }
+
+                const int* SvmModelVersion::getNSVs() const{
+                    return nSVs;
+                }
+
+            }
+        }
+    }
+}
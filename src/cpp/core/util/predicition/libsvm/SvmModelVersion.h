@@ -0,0 +1,195 @@
+#ifndef __SVM_MODEL_VERSION_H__
+#define __SVM_MODEL_VERSION_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "typedefs.h"
+
+/**
+ * first bytes of binary model file
+ */
+#define SVM_BINARY_MAGIC "SDSVMBIN"
+#define SVM_BINARY_VERSION 1
+/**
+ * alignment of sections in binary model file, in bytes
+ */
+#define SVM_BINARY_ALIGN 64
+/**
+ * support vector rows are padded to multiple of this number of floats
+ */
+#define SVM_ROW_ALIGN 4
+
+namespace core{
+    namespace util{
+        namespace prediction{
+            namespace svm{
+
+                /**
+                 * header of binary model file. Sections follow at header offsets:
+                 * support vectors (l rows of svsWidth floats), sv_coef (nr_class - 1 rows
+                 * of l floats), rho (nr_class * (nr_class - 1) / 2 floats),
+                 * labels and nSV (nr_class ints each, offset 0 if model has none).
+                 * Values are in host byte order. Model values are floats, as used by openCL
+                 * prediction, so CPU prediction of binary model is in float precision
+                 */
+                struct SvmBinaryHeader{
+                    char magic[8];
+                    uint32_t formatVersion;
+                    int32_t svmType;
+                    int32_t kernelType;
+                    int32_t degree;
+                    float gamma;
+                    float coef0;
+                    int32_t nrClass;
+                    int32_t l;
+                    int32_t svsWidth;
+                    int32_t reserved;
+                    uint64_t svsOffset;
+                    uint64_t coefsOffset;
+                    uint64_t rhoOffset;
+                    uint64_t labelOffset;
+                    uint64_t nSVOffset;
+                    uint64_t fileSize;
+                };
+
+                /**
+                 * One loaded and validated SVM model in dense form, used directly by CPU
+                 * prediction and uploaded as is by openCL prediction.
+                 * Libsvm text models are parsed and packed once, binary models (see
+                 * SvmBinaryHeader) are mapped with mmap and used without parsing or copying.
+                 * Text models also keep double values of support vectors, coefficients and
+                 * kernel parameters, so CPU prediction gives same decisions as svm_predict.
+                 * Immutable after construction, shared by all workers through ModelRegistry,
+                 * so images in flight keep their version alive
+                 */
+                class SvmModelVersion{
+                private:
+                    uint version;
+                    std::string file;
+                    bool binary;
+
+                    int svmType;
+                    int kernelType;
+                    int degree;
+                    double gamma;
+                    double coef0;
+                    int nrClass;
+                    int l;
+                    int svsWidth;
+                    const float* svs;
+                    const float* coefs;
+                    const float* rhos;
+                    const int* labels;
+                    const int* nSVs;
+
+                    //storage of text models
+                    std::vector<float> svsStorage;
+                    std::vector<float> coefsStorage;
+                    std::vector<float> rhosStorage;
+                    std::vector<int> labelsStorage;
+                    std::vector<int> nSVsStorage;
+                    //double values of text models, used by CPU prediction
+                    std::vector<double> svsExact;
+                    std::vector<double> coefsExact;
+                    std::vector<double> rhosExact;
+
+                    //mapping of binary models
+                    void* mapped;
+                    size_t mappedSize;
+
+                    SvmModelVersion();
+                    void loadText() throw (SDException&);
+                    void loadBinary() throw (SDException&);
+                    /**
+                     * throws if model can't be used by predictors
+                     */
+                    void validate() throw (SDException&);
+                    template<typename T> double kernel(const float* x, int xLen, const T* sv) const;
+                    template<typename T> double predict(const float* x, int xLen, const T* modelSVs,
+                                                        const T* modelCoefs, const T* modelRHOs,
+                                                        double* kvalue, int* start, int* vote) const;
+                protected:
+                public:
+                    /**
+                     * load and validate model, format is detected from file content
+                     * @param modelFile
+                     * libsvm text model or binary model
+                     * @param modelVersion
+                     * version number, used in reports
+                     */
+                    SvmModelVersion(const std::string& modelFile, uint modelVersion) throw (SDException&);
+                    virtual ~SvmModelVersion();
+
+                    /**
+                     * @return
+                     * true if file starts with SVM_BINARY_MAGIC
+                     */
+                    static bool isBinary(const std::string& modelFile);
+                    /**
+                     * write model in binary format
+                     */
+                    void saveBinary(const std::string& outFile) const throw (SDException&);
+                    /**
+                     * same decision as svm_predict (for binary model up to float precision)
+                     * @param x
+                     * dense parameters of one pixel
+                     * @param xLen
+                     * number of parameters
+                     * @param kvalue
+                     * scratch of getL() values
+                     * @param start
+                     * scratch of getNrClass() values
+                     * @param vote
+                     * scratch of getNrClass() values
+                     */
+                    double predict(const float* x, int xLen, double* kvalue, int* start, int* vote) const;
+
+                    uint getVersion() const;
+                    const std::string& getFile() const;
+                    int getSvmType() const;
+                    int getKernelType() const;
+                    int getDegree() const;
+                    float getGamma() const;
+                    float getCoef0() const;
+                    int getNrClass() const;
+                    /**
+                     * @return
+                     * number of support vectors
+                     */
+                    int getL() const;
+                    /**
+                     * @return
+                     * row stride of support vectors in floats
+                     */
+                    int getSVsWidth() const;
+                    const float* getSVs() const;
+                    /**
+                     * @return
+                     * sv_coef, nr_class - 1 rows of l values
+                     */
+                    const float* getCoefs() const;
+                    const float* getRHOs() const;
+                    /**
+                     * @return
+                     * number of rho values, one per pair of classes
+                     */
+                    int getRHOCount() const;
+                    /**
+                     * @return
+                     * 0 if model has no labels
+                     */
+                    const int* getLabels() const;
+                    /**
+                     * @return
+                     * 0 if model has no nSV
+                     */
+                    const int* getNSVs() const;
+                };
+
+            }
+        }
+    }
+}
+
+#endif
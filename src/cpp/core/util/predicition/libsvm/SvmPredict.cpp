@@ -4,10 +4,13 @@
 #include "SvmPredict.h"
 #ifdef _OPENCL
 #include "core/opencl/libsvm/OpenCLToolsPredict.h"
+#include "core/opencl/DeviceSession.h"
 #endif
 #include "core/util/Matrix.h"
 #include "core/util/Config.h"
 #include "core/util/MemTracker.h"
+#include "core/util/StageDispatcher.h"
+#include "core/util/predicition/ModelRegistry.h"
 
 namespace core{
     namespace util{
@@ -17,67 +20,77 @@ namespace core{
                 using namespace core::util;
 #ifdef _OPENCL
                 using namespace core::opencl::libsvm;
+                using namespace core::opencl;
 #endif
                 
                 REGISTER_SINGLETON(SvmPredict, core::util::prediction::svm)
                 
                 SvmPredict::SvmPredict() {
-                    model = 0;
                 }
 
                 SvmPredict::~SvmPredict() {
-                    if (model)
-                        svm_free_and_destroy_model(&model);
                 }
 
                 void SvmPredict::loadModel() throw (SDException&) {
-                    string modelFile = Config::getInstancePtr()->getPropertyValue("settings.svm.modelFile");
-                    model = svm_load_model(modelFile.c_str());
-                    if (model == 0) {
-                        SDException e(SHADOW_READ_UNABLE, "SvmPredict::loadModel");
-                        throw e;
-                    }
-#ifdef _OPENCL
-                    OpenCLToolsPredict::getInstancePtr()->markModelChanged();
-#endif
+                    //later versions are loaded by registry in background
+                    ModelRegistry::getInstancePtr()->load();
                 }
 
                 uchar* SvmPredict::predict(const Matrix<float>* imagePixelsParameters, const int& pixCount, const int& parameterCount) throw (SDException&) {
-                    if (model == 0) {
+                    //image keeps this version even if new one is published meanwhile
+                    shared_ptr<const SvmModelVersion> model = ModelRegistry::getInstancePtr()->acquire();
+                    if (model.get() == 0) {
                         SDException e(SHADOW_NO_MODEL_LOADED, "SvmPredict::predict");
                         throw e;
                     }
-                    uchar* ret = 0;
                     if (imagePixelsParameters == 0)
                         return 0;
-#ifndef _OPENCL                                
-                    ret = New uchar[pixCount];
+                    StageDispatcher* dispatcher = StageDispatcher::getInstancePtr();
+                    StageRun run = dispatcher->begin(STAGE_PREDICT, pixCount);
+                    uchar* ret = 0;
+#ifdef _OPENCL
+                    if (run.backend == BACKEND_OPENCL)
+                        ret = predictOpenCL(model, imagePixelsParameters);
+                    else
+                        ret = predictCPU(*model, imagePixelsParameters, pixCount, parameterCount);
+#else
+                    ret = predictCPU(*model, imagePixelsParameters, pixCount, parameterCount);
+#endif
+                    dispatcher->end(run);
+                    return ret;
+                }
+                
+                uchar* SvmPredict::predictCPU(  const SvmModelVersion& model, const Matrix<float>* imagePixelsParameters, 
+                                                const int& pixCount, const int& parameterCount) throw (SDException&) {
+                    uchar* ret = New uchar[pixCount];
+                    //parameters are dense already, model is evaluated without svm_node copies
+                    vector<double> kvalue(model.getL());
+                    vector<int> start(model.getNrClass());
+                    vector<int> vote(model.getNrClass());
                     for (int i = 0; i < pixCount; i++) {
-                        if (i % 1000 == 0)
-                            cout << "Pix no: " << i << endl;
                         const float* x = (*imagePixelsParameters)[i];
-                        UNIQUE_PTR(svm_node) nodes(New svm_node[parameterCount + 1]);
-                        for (int j = 0; j < parameterCount; j++) {
-                            (nodes.get())[j].index = j + 1;
-                            (nodes.get())[j].value = x[j];
-                        }
-                        (nodes.get())[parameterCount].index = -1;
-                        (nodes.get())[parameterCount].value = 0.;
-                        double val = svm_predict(model, nodes.get());
+                        double val = model.predict(x, parameterCount, kvalue.data(), start.data(), vote.data());
                         ret[i] = (uchar) round(val);                        
                     }
-#else
-                    if (OpenCLToolsPredict::getInstancePtr()->hasInitialized() == false) {
+                    return ret;
+                }
+                
+#ifdef _OPENCL
+                uchar* SvmPredict::predictOpenCL(   shared_ptr<const SvmModelVersion> model, 
+                                                    const Matrix<float>* imagePixelsParameters) throw (SDException&) {
+                    uchar* ret = 0;
+                    OpenCLToolsPredict* predictTool = DeviceSession::tool<OpenCLToolsPredict>();
+                    if (predictTool->hasInitialized() == false) {
                         SDException e(SHADOW_OPENCL_TOOLS_NOT_INITIALIZED, "SvmPredict::predict");
                         throw e;
                     }
-                    ret = OpenCLToolsPredict::getInstancePtr()->predict(model, imagePixelsParameters);
-#endif
+                    ret = predictTool->predict(model, imagePixelsParameters);
                     return ret;
                 }
+#endif
 
                 bool SvmPredict::hasLoadedModel() {
-                    return model != 0;
+                    return ModelRegistry::getInstancePtr()->hasModel();
                 }
             }
         }
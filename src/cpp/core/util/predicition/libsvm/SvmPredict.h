@@ -1,12 +1,12 @@
 #ifndef __SVM_PREDICT_H__
 #define __SVM_PREDICT_H__
 
+#include <memory>
 #include "core/util/Singleton.h"
 #include "core/util/predicition/IPrediction.h"
+#include "core/util/predicition/libsvm/SvmModelVersion.h"
 #include "core/util/rtti/ObjectFactory.h"
 
-struct svm_model;
-
 namespace core{
     namespace util{
         namespace prediction{
@@ -16,7 +16,12 @@ namespace core{
                     friend class core::util::Singleton<SvmPredict>;
                     PREPARE_REGISTRATION(SvmPredict)
                 private:
-                    svm_model* model;
+                    uchar* predictCPU(const SvmModelVersion& model, const core::util::Matrix<float>* imagePixelsParameters, 
+                                        const int& pixCount, const int& parameterCount) throw(SDException&);
+#ifdef _OPENCL
+                    uchar* predictOpenCL(std::shared_ptr<const SvmModelVersion> model, 
+                                        const core::util::Matrix<float>* imagePixelsParameters) throw(SDException&);
+#endif
                 protected:
                     SvmPredict();
                 public:
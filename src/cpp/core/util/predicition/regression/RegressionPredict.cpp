@@ -1,13 +1,20 @@
 #include "RegressionPredict.h" 
 #include "core/util/Config.h"
+#include "core/util/StageDispatcher.h"
 #include "core/opencl/regression/OpenCLRegressionPredict.h"
+#ifdef _OPENCL
+#include "core/opencl/DeviceSession.h"
+#endif
 
 namespace core{
     namespace util{
         namespace prediction{
             namespace regression{
                 
+#ifdef _OPENCL
                 using namespace core::opencl::regression;
+                using namespace core::opencl;
+#endif
                 
                 REGISTER_SINGLETON(RegressionPredict, core::util::prediction::regression)
                 
@@ -23,24 +30,11 @@ namespace core{
                 }
                 
                 void RegressionPredict::loadModel() throw(SDException&){
-                    coefs.clear();
-                    Config* conf = Config::getInstancePtr();
-                    string numOfArgsStr = conf->getPropertyValue("general.Prediction.regression.coefNum");
-                    int numOfCoefs = atoi(numOfArgsStr.c_str());
-                    for (int i = 0; i < numOfCoefs; i++){
-                        string key = "general.Prediction.regression.coefNo";
-                        char num[10];
-                        sprintf(num, "%d", (i + 1));
-                        key = key + num;
-                        string coefValStr = conf->getPropertyValue(key);
-                        float coefVal = atof(coefValStr.c_str());
-                        coefs.push_back(coefVal);
+                    //coefficients are parsed with config, only check they are complete
+                    if (Config::getInstancePtr()->getSettings().hasRegression == false){
+                        SDException exc(SHADOW_NOT_FOUND_PROPERTY, "RegressionPredict::loadModel general.Prediction.regression");
+                        throw exc;
                     }
-                    string interStrVal = conf->getPropertyValue("general.Prediction.regression.Intercept");
-                    float intercept = atof(interStrVal.c_str());
-                    coefs.push_back(intercept);
-                    interStrVal = conf->getPropertyValue("general.Prediction.regression.borderValue");
-                    borderValue = atof(interStrVal.c_str());
                     loadedModel = true;
                 }
                 
@@ -50,21 +44,48 @@ namespace core{
                         SDException exc(SHADOW_EXCEPTIONS::SHADOW_NO_MODEL_LOADED, "RegressionPredict::predict");
                         throw exc;
                     }
+                    const Settings& settings = Config::getInstancePtr()->getSettings();
+                    if (settings.hasRegression == false){
+                        SDException exc(SHADOW_EXCEPTIONS::SHADOW_NO_MODEL_LOADED, "RegressionPredict::predict");
+                        throw exc;
+                    }
+                    const vector<float>& coefs = settings.regressionCoefs;
+                    float borderValue = settings.regressionBorder;
+                    StageDispatcher* dispatcher = StageDispatcher::getInstancePtr();
+                    StageRun run = dispatcher->begin(STAGE_PREDICT, pixCount);
                     uchar* retArr = 0;
 #ifdef _OPENCL
-                    OpenCLRegressionPredict* regPredict = OpenCLRegressionPredict::getInstancePtr();
+                    if (run.backend == BACKEND_OPENCL)
+                        retArr = predictOpenCL(imagePixelsParameters, pixCount, parameterCount, coefs, borderValue);
+                    else
+                        retArr = predictCPU(imagePixelsParameters, pixCount, parameterCount, coefs, borderValue);
+#else
+                    retArr = predictCPU(imagePixelsParameters, pixCount, parameterCount, coefs, borderValue);
+#endif
+                    dispatcher->end(run);
+                    return retArr;
+                }
+                
+#ifdef _OPENCL
+                uchar* RegressionPredict::predictOpenCL(const Matrix<float>* imagePixelsParameters, 
+                                                        const int& pixCount, const int& parameterCount,
+                                                        const vector<float>& coefs, float borderValue) throw(SDException&){
+                    uchar* retArr = 0;
+                    OpenCLRegressionPredict* regPredict = DeviceSession::tool<OpenCLRegressionPredict>();
                     if (regPredict->hasInitialized() == false){
-                        Config* conf = Config::getInstancePtr();
-                        string platformStr = conf->getPropertyValue("general.openCL.platformid");
-                        int platformID = atoi(platformStr.c_str());
-                        string deviceStr = conf->getPropertyValue("general.openCL.deviceid");
-                        int deviceID = atoi(deviceStr.c_str());
-                        regPredict->init(platformID, deviceID, false);
+                        const Settings& settings = Config::getInstancePtr()->getSettings();
+                        regPredict->init(settings.platformID, settings.deviceID, false);
                     }
                     retArr = regPredict->predict(*imagePixelsParameters, pixCount, parameterCount, coefs, borderValue);
                     regPredict->cleanWorkPart();
-#else
-                    retArr = New uchar[pixCount];
+                    return retArr;
+                }
+#endif
+                
+                uchar* RegressionPredict::predictCPU(   const Matrix<float>* imagePixelsParameters, 
+                                                        const int& pixCount, const int& parameterCount,
+                                                        const vector<float>& coefs, float borderValue){
+                    uchar* retArr = New uchar[pixCount];
                     for (int i = 0; i < pixCount; i++){
                         //intercept
                         float result = coefs[parameterCount];
@@ -81,7 +102,6 @@ namespace core{
                         else
                             retArr[i] = 0U;
                     }
-#endif
                     return retArr;
                 }
                 
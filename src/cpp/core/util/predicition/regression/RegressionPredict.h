@@ -16,8 +16,19 @@ namespace core{
                     PREPARE_REGISTRATION(RegressionPredict)
                 private:
                     bool loadedModel;
-                    float borderValue;
-                    std::vector<float> coefs;                    
+                    
+                    /**
+                     * coefficients and border value come from current config snapshot,
+                     * so reloaded config is used from next image
+                     */
+                    uchar* predictCPU(  const core::util::Matrix<float>* imagePixelsParameters, 
+                                        const int& pixCount, const int& parameterCount,
+                                        const std::vector<float>& coefs, float borderValue);
+#ifdef _OPENCL
+                    uchar* predictOpenCL(   const core::util::Matrix<float>* imagePixelsParameters, 
+                                            const int& pixCount, const int& parameterCount,
+                                            const std::vector<float>& coefs, float borderValue) throw(SDException&);
+#endif
                 protected:
                     RegressionPredict();
                 public:
@@ -23,14 +23,22 @@ namespace core {
             }
             
             IImageParameteres* ObjectFactory::createImageParameters() {
-                string classID = Config::getInstancePtr()->getPropertyValue("general.Prediction.parametersClass");                
+                //class name is resolved once per snapshot, not looked up per image
+                const string& classID = Config::getInstancePtr()->getSettings().parametersClass;
+                if (classID == ""){
+                    SDException exc(SHADOW_NOT_FOUND_PROPERTY, "ObjectFactory: general.Prediction.parametersClass");
+                    throw exc;
+                }
                 IImageParameteres* parametersClass = createInstance<IImageParameteres>(classID);
                 return parametersClass;
             }
             
             IPrediction* ObjectFactory::createPredictor(){
-                Config* conf = Config::getInstancePtr();
-                string type = conf->getPropertyValue("general.Prediction.predictionClass");
+                const string& type = Config::getInstancePtr()->getSettings().predictionClass;
+                if (type == ""){
+                    SDException exc(SHADOW_NOT_FOUND_PROPERTY, "ObjectFactory: general.Prediction.predictionClass");
+                    throw exc;
+                }
                 return ObjectFactory::getInstancePtr()->createInstance<IPrediction>(type);
 //                if (type == "SVM"){
 //                    return ObjectFactory::getInstancePtr()->createInstance<IPrediction>("core::util::prediction::svm::SvmPredict");
@@ -13,6 +13,7 @@ namespace shadowdetection {
         using namespace cv;
         using namespace core::util;
         using namespace core::opencv2;
+        using namespace core::opencl;
         
         string OpenCLImageParameters::getClassName(){
             return string("shadowdetection::opencl::OpenCLImageParameters");
@@ -66,17 +67,19 @@ namespace shadowdetection {
             createBuffers(numOfPixels, parameterCount, originalImage,
                             hsvImage, hlsImage);
             setKernelArgs(parameterCount, numOfPixels);
-            size_t local_ws = workGroupSize[0];
+            size_t local_ws = getLocalWorkSize(0, numOfPixels);
             size_t global_ws = shrRoundUp(local_ws, numOfPixels);
-            err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
+            err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
             err_check(err, "OpenCLImageParameters::getImageParameters clEnqueueNDRangeKernel");
+            profileKernel(0);
             float* parameters = retMat->getVec();
             err = clEnqueueReadBuffer(  command_queue, parametersMem, CL_TRUE, 0, 
                                         numOfPixels * parameterCount * sizeof(cl_float), 
-                                        parameters, 0, NULL, NULL);
+                                        parameters, 0, NULL, profilingEvent());
             clFlush(command_queue);
             clFinish(command_queue);
             err_check(err, "OpenclTools::processRGBImage clEnqueueReadBuffer1");
+            profileTransfer(PROFILE_READ, numOfPixels * parameterCount * sizeof(cl_float));
             return retMat;
         }
         
@@ -21,6 +21,7 @@ namespace shadowdetection {
         
         class OpenCLImageParameters : public core::opencl::OpenClBase, public core::util::Singleton<OpenCLImageParameters>{
             friend class core::util::Singleton<OpenCLImageParameters>;
+            friend class core::opencl::DeviceSession;
         private:
             cl_mem parametersMem;
             cl_mem originalImageBuffer;
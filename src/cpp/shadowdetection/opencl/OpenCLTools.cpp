@@ -6,6 +6,7 @@
 #include "core/opencv/OpenCVTools.h"
 #include "thirdparty/lib_svm/svm.h"
 #include "core/util/Matrix.h"
+#include "core/util/raii/RAIIS.h"
 
 #define KERNEL_FILE_1 "image_hci_convert_kernel"
 #define KERNEL_FILE_2 "lib_svm"
@@ -19,6 +20,7 @@ namespace shadowdetection {
         using namespace core::opencv;
         using namespace cv;
         using namespace core::util;
+        using namespace core::util::raii;
         using namespace core::opencl;
         using namespace std;
         
@@ -161,76 +163,94 @@ namespace shadowdetection {
                 return 0;
             }
             
+            uchar* hsi1Ratios = 0;
+            uchar* hsi2Ratios = 0;
+            calculateRatios(image, width * height, channels, hsi1Ratios, hsi2Ratios);
+            VectorRaii<uchar> vraiiR1(hsi1Ratios);
+            VectorRaii<uchar> vraiiR2(hsi2Ratios);
+            
+            UNIQUE_PTR(Mat) ratiosImage1(OpenCV2Tools::get8bitImage(hsi1Ratios, height, width));
+            UNIQUE_PTR(Mat) binarized1(OpenCV2Tools::binarize(ratiosImage1.get()));
+            UNIQUE_PTR(Mat) ratiosImage2(OpenCV2Tools::get8bitImage(hsi2Ratios, height, width));
+            UNIQUE_PTR(Mat) binarized2(OpenCV2Tools::binarize(ratiosImage2.get()));
+            
+            Mat* processedImageMat = OpenCV2Tools::joinTwoOcl(*binarized1, *binarized2);                      
+            return processedImageMat;             
+        }
+        
+        void OpenclTools::calculateRatios(  uchar* image, u_int32_t pixelCount, uchar channels, 
+                                            uchar*& hsi1Ratios, uchar*& hsi2Ratios) throw (SDException&) {
+            //kernels are per pixel, so pixels are processed as single row image
+            u_int32_t width = pixelCount;
+            u_int32_t height = 1;
             createBuffers(image, height, width, channels);            
             
             setKernelArgs1(height, width, channels, 1);            
-            size_t local_ws = workGroupSize[0];
+            size_t local_ws = getLocalWorkSize(0, width * height);
             size_t global_ws = shrRoundUp(local_ws, width * height);
-            err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
-            err_check(err, "OpenclTools::processRGBImage clEnqueueNDRangeKernel0");
+            err = clEnqueueNDRangeKernel(command_queue, kernel[0], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
+            err_check(err, "OpenclTools::calculateRatios clEnqueueNDRangeKernel0");
+            profileKernel(0);
             clFlush(command_queue);
             clFinish(command_queue);
             
             setKernelArgs2(height, width, channels);
-            local_ws = workGroupSize[2];
+            local_ws = getLocalWorkSize(2, width * height);
             global_ws = shrRoundUp(local_ws, width * height);
-            err = clEnqueueNDRangeKernel(command_queue, kernel[2], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
-            err_check(err, "OpenclTools::processRGBImage clEnqueueNDRangeKernel2");
+            err = clEnqueueNDRangeKernel(command_queue, kernel[2], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
+            err_check(err, "OpenclTools::calculateRatios clEnqueueNDRangeKernel2");
+            profileKernel(2);
             clReleaseMemObject(hsi1Converted);
             hsi1Converted = 0;
             ratios1 = 0;
             ratios1 = New uchar[width * height];
             if (ratios1 == 0) {
-                SDException exc(SHADOW_NO_MEM, "OpenclTools::processRGBImage Calculate ratios1");
+                SDException exc(SHADOW_NO_MEM, "OpenclTools::calculateRatios Calculate ratios1");
                 throw exc;
             }
-            err = clEnqueueReadBuffer(command_queue, tsaiOutput, CL_TRUE, 0, width * height, ratios1, 0, NULL, NULL);
-            err_check(err, "OpenclTools::processRGBImage clEnqueueReadBuffer1");
+            err = clEnqueueReadBuffer(command_queue, tsaiOutput, CL_TRUE, 0, width * height, ratios1, 0, NULL, profilingEvent());
+            err_check(err, "OpenclTools::calculateRatios clEnqueueReadBuffer1");
+            profileTransfer(PROFILE_READ, width * height);
             clFlush(command_queue);
             clFinish(command_queue);
-            
-            UNIQUE_PTR(Mat) ratiosImage1(OpenCV2Tools::get8bitImage(ratios1, height, width));
-            UNIQUE_PTR(Mat) binarized1(OpenCV2Tools::binarize(ratiosImage1.get()));
-            Delete(ratios1);
-            ratios1 = 0;            
 
-            local_ws = workGroupSize[1];
+            local_ws = getLocalWorkSize(1, width * height);
             global_ws = shrRoundUp(local_ws, width * height);
-            err = clEnqueueNDRangeKernel(command_queue, kernel[1], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
-            err_check(err, "OpenclTools::processRGBImage clEnqueueNDRangeKernel1");
+            err = clEnqueueNDRangeKernel(command_queue, kernel[1], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
+            err_check(err, "OpenclTools::calculateRatios clEnqueueNDRangeKernel1");
+            profileKernel(1);
             clReleaseMemObject(inputImage);
             inputImage = 0;
             clFlush(command_queue);
             clFinish(command_queue);
             
             setKernelArgs3(height, width, channels);
-            local_ws = workGroupSize[2];
+            local_ws = getLocalWorkSize(2, width * height);
             global_ws = shrRoundUp(local_ws, width * height);
-            err = clEnqueueNDRangeKernel(command_queue, kernel[2], 1, NULL, &global_ws, &local_ws, 0, NULL, NULL);
-            err_check(err, "OpenclTools::processRGBImage clEnqueueNDRangeKernel2");
+            err = clEnqueueNDRangeKernel(command_queue, kernel[2], 1, NULL, &global_ws, &local_ws, 0, NULL, profilingEvent());
+            err_check(err, "OpenclTools::calculateRatios clEnqueueNDRangeKernel2");
+            profileKernel(2);
             clReleaseMemObject(hsi2Converted);
             hsi2Converted = 0;
             ratios2 = 0;
             ratios2 = New uchar[width * height];
             if (ratios2 == 0) {
-                SDException exc(SHADOW_NO_MEM, "OpenclTools::processRGBImage Calculate ratios2");
+                SDException exc(SHADOW_NO_MEM, "OpenclTools::calculateRatios Calculate ratios2");
                 throw exc;
             }
-            err = clEnqueueReadBuffer(command_queue, tsaiOutput, CL_TRUE, 0, width * height, ratios2, 0, NULL, NULL);
-            err_check(err, "OpenclTools::processRGBImage clEnqueueReadBuffer2");
+            err = clEnqueueReadBuffer(command_queue, tsaiOutput, CL_TRUE, 0, width * height, ratios2, 0, NULL, profilingEvent());
+            err_check(err, "OpenclTools::calculateRatios clEnqueueReadBuffer2");
+            profileTransfer(PROFILE_READ, width * height);
             clFlush(command_queue);
             clFinish(command_queue);
-
             clReleaseMemObject(tsaiOutput);
-            tsaiOutput = 0;            
-            
-            UNIQUE_PTR(Mat) ratiosImage2(OpenCV2Tools::get8bitImage(ratios2, height, width));
-            UNIQUE_PTR(Mat) binarized2(OpenCV2Tools::binarize(ratiosImage2.get()));
-            Delete(ratios2);
-            ratios2 = 0;            
+            tsaiOutput = 0;
             
-            Mat* processedImageMat = OpenCV2Tools::joinTwoOcl(*binarized1, *binarized2);                      
-            return processedImageMat;             
+            //caller takes ownership
+            hsi1Ratios = ratios1;
+            hsi2Ratios = ratios2;
+            ratios1 = 0;
+            ratios2 = 0;
         }
         
         string OpenclTools::getClassName(){
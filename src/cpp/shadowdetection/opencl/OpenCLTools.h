@@ -30,6 +30,7 @@ namespace shadowdetection {
 
         class OpenclTools : public core::opencl::OpenClBase, public core::util::Singleton<OpenclTools>{
             friend class core::util::Singleton<OpenclTools>;
+            friend class core::opencl::DeviceSession;
         private:
             cl_mem inputImage;
             cl_mem hsi1Converted;
@@ -89,6 +90,20 @@ namespace shadowdetection {
              * @return 
              */
             cv::Mat* processRGBImage(unsigned char* image, u_int32_t width, u_int32_t height, unsigned char channels) throw (SDException&);            
+            /**
+             * calculate tsai ratios of both HSI conversions, kernels are per pixel so image can be
+             * atlas of many images packed one after another
+             * @param image
+             * RGB pixels
+             * @param pixelCount
+             * @param channels
+             * @param hsi1Ratios
+             * output, ratios of first HSI conversion, caller takes ownership
+             * @param hsi2Ratios
+             * output, ratios of second HSI conversion, caller takes ownership
+             */
+            void calculateRatios(   unsigned char* image, u_int32_t pixelCount, unsigned char channels, 
+                                    unsigned char*& hsi1Ratios, unsigned char*& hsi2Ratios) throw (SDException&);
             /**
              * clean up global variables
              */
@@ -6,6 +6,7 @@ namespace shadowdetection {
     namespace opencl {
         
         using namespace core::util;
+        using namespace core::opencl;
         
         /**!!!!!!!NOT TESTED*/
         uint32_t* OpenclTools::convertHSI1( uchar* image, u_int32_t width, u_int32_t height, 
@@ -16,16 +17,18 @@ namespace shadowdetection {
             }
             createBuffers(image, height, width, channels);
             setKernelArgs1(height, width, channels, 0);
-            size_t local_ws = workGroupSize[0];
+            size_t local_ws = getLocalWorkSize(0, width * height);
             size_t global_ws = shrRoundUp(local_ws, width * height);
             err = clEnqueueNDRangeKernel(   command_queue, kernel[0], 1, 0, 
-                                            &global_ws, &local_ws, 0, 0, 0);
+                                            &global_ws, &local_ws, 0, 0, profilingEvent());
             err_check(err, "OpenclTools::convertHSI1 clEnqueueNDRangeKernel");
+            profileKernel(0);
             size_t size = width * height * channels; 
             uint32_t* retArr = New uint32_t[size];
             err = clEnqueueReadBuffer(  command_queue, hsi1Converted, CL_FALSE, 0, 
-                                        size * sizeof(cl_uint), retArr, 0, 0, 0);
+                                        size * sizeof(cl_uint), retArr, 0, 0, profilingEvent());
             err_check(err, "OpenclTools::convertHSI1 clEnqueueReadBuffer");
+            profileTransfer(PROFILE_READ, size * sizeof(cl_uint));
             clFlush(command_queue);
             clFinish(command_queue);
             cleanWorkPart();
@@ -41,16 +44,18 @@ namespace shadowdetection {
             }
             createBuffers(image, height, width, channels);
             setKernelArgs1(height, width, channels, 1);
-            size_t local_ws = workGroupSize[1];
+            size_t local_ws = getLocalWorkSize(1, width * height);
             size_t global_ws = shrRoundUp(local_ws, width * height);
             err = clEnqueueNDRangeKernel(   command_queue, kernel[1], 1, 0, 
-                                            &global_ws, &local_ws, 0, 0, 0);
+                                            &global_ws, &local_ws, 0, 0, profilingEvent());
             err_check(err, "OpenclTools::convertHSI2 clEnqueueNDRangeKernel");
+            profileKernel(1);
             size_t size = width * height * channels; 
             uint32_t* retArr = New uint32_t[size];
             err = clEnqueueReadBuffer(  command_queue, hsi1Converted, CL_FALSE, 0, 
-                                        size * sizeof(cl_uint), retArr, 0, 0, 0);
+                                        size * sizeof(cl_uint), retArr, 0, 0, profilingEvent());
             err_check(err, "OpenclTools::convertHSI2 clEnqueueReadBuffer");
+            profileTransfer(PROFILE_READ, size * sizeof(cl_uint));
             clFlush(command_queue);
             clFinish(command_queue);
             cleanWorkPart();
@@ -1,9 +1,12 @@
 #include "ShadowDetectionProcessor.h"
 #include <string>
+#include <csignal>
 #include "shadowdetection/opencl/OpenCLTools.h"
 #include "core/opencl/libsvm/OpenCLToolsPredict.h"
 #include "shadowdetection/opencl/OpenCLImageParameters.h"
 #include "core/opencl/regression/OpenCLRegressionPredict.h"
+#include "core/opencl/DeviceSession.h"
+#include "core/opencl/DevicePool.h"
 #include "core/util/Config.h"
 #include "core/opencv/OpenCV2Tools.h"
 #include "core/opencv/OpenCVTools.h"
@@ -15,7 +18,11 @@
 #include "core/tools/image/IImageParameters.h"
 #include "core/util/rtti/ObjectFactory.h"
 #include "core/util/predicition/IPrediction.h"
+#include "core/util/predicition/ModelRegistry.h"
 #include "core/util/TabParser.h"
+#include "core/util/StageDispatcher.h"
+#include "core/tools/image/ImageAtlas.h"
+#include "core/process/ProcessingContext.h"
 
 namespace shadowdetection {
     namespace process {
@@ -26,12 +33,14 @@ namespace shadowdetection {
         using namespace shadowdetection::opencl;
         using namespace core::opencl::libsvm;
         using namespace core::opencl::regression;
+        using namespace core::opencl;
 #endif
         using namespace std;
         using namespace core::util;
         using namespace core::util::raii;
         using namespace core::util::RTTI;
         using namespace core::util::prediction;
+        using namespace core::process;
         using namespace core::tools::image;
         using namespace core::opencv;
         using namespace core::opencv2;
@@ -41,21 +50,9 @@ namespace shadowdetection {
         void initOpenCL() {
 #ifdef _OPENCL
             try {
-                int platformId = 0;
-                int deviceId = 0;
-                Config* conf = Config::getInstancePtr();
-                string platformStr = conf->getPropertyValue("general.openCL.platformid");
-                string deviceStr = conf->getPropertyValue("general.openCL.deviceid");
-                int tmp = atoi(platformStr.c_str());
-                if (tmp != 0)
-                    platformId = tmp;
-                tmp = atoi(deviceStr.c_str());
-                if (tmp != 0)
-                    deviceId = tmp;
-                OpenclTools::getInstancePtr()->init(platformId, deviceId, false);
-                OpenCV2Tools::initOpenCL(platformId, deviceId);
-                OpenCLToolsPredict::getInstancePtr()->init(platformId, deviceId, false);
-                OpenCLImageParameters::getInstancePtr()->init(platformId, deviceId, false);
+                const Settings& settings = Config::getInstancePtr()->getSettings();
+                OpenCV2Tools::initOpenCL(settings.platformID, settings.deviceID);
+                //openCL tools are owned by ProcessingContext and initialized on first use
             }      
             catch (SDException& exception) {
                 cout << exception.handleException() << endl;
@@ -67,82 +64,138 @@ namespace shadowdetection {
         void initOpenMP() {
 #if defined _OPENMP_MY
             omp_set_dynamic(0);
-            int numThreads = 4;
-            string tnStr = Config::getInstancePtr()->getPropertyValue("general.openMP.threadNum");
-            int tmp = atoi(tnStr.c_str());
-            if (tmp != 0)
-                numThreads = tmp;
-            omp_set_num_threads(numThreads);
+            omp_set_num_threads(Config::getInstancePtr()->getSettings().openMPThreadNum);
 #endif
         }
 
+        /**
+         * tsai stage on CPU, ratios of both HSI conversions are binarized and joined
+         * @param image
+         * @return
+         * single channel image
+         */
+        Mat* tsaiCPU(const Mat& image) {
+            IplImage iplImage = image;
+            int height, width, channels;
+            uint* hsi1 = OpenCvTools::convertImagetoHSI(&iplImage, height, width, channels, &OpenCvTools::RGBtoHSI_1);
+            VectorRaii<uint> vraiiHsi1(hsi1);
+            uchar* ratios1 = OpenCvTools::simpleTsai(hsi1, height, width, channels);
+            VectorRaii<uchar> vraiiR1(ratios1);
+            IplImage* ratiosImage1 = OpenCvTools::get8bitImage(ratios1, height, width);
+            ImageRaii iariiR1(ratiosImage1);
+            IplImage* binarized1 = OpenCvTools::binarize(ratiosImage1);
+            ImageRaii iraiiBin1(binarized1);
+            uint* hsi2 = OpenCvTools::convertImagetoHSI(&iplImage, height, width, channels, &OpenCvTools::RGBtoHSI_2);
+            VectorRaii<uint> vraiiHsi2(hsi2);
+            uchar* ratios2 = OpenCvTools::simpleTsai(hsi2, height, width, channels);
+            VectorRaii<uchar> vraiiR2(ratios2);
+            IplImage* ratiosImage2 = OpenCvTools::get8bitImage(ratios2, height, width);
+            ImageRaii iraiiR2(ratiosImage2);
+            IplImage* binarized2 = OpenCvTools::binarize(ratiosImage2);
+            ImageRaii iraiiBin2(binarized2);
+            IplImage* joined = OpenCvTools::joinTwo(binarized1, binarized2);
+            if (joined == 0)
+                return 0;
+            ImageRaii iraiiJoined(joined);
+            Mat* ret = New Mat(joined, true);
+            return ret;
+        }
+
+#ifdef _OPENCL
+        /**
+         * tsai stage using openCL
+         * @param image
+         * @return
+         * single channel image
+         */
+        Mat* tsaiOpenCL(ProcessingContext& context, const Mat& image) {
+            OpenclTools* oclt = context.getTool<OpenclTools>();
+            uchar* buffer = OpenCV2Tools::convertImageToByteArray(&image, true);
+            VectorRaii<uchar> bufferRaii(buffer);
+            return oclt->processRGBImage(buffer, image.size().width, image.size().height, image.channels());
+        }
+#endif
+
+        /**
+         * tsai stage on backend chosen by StageDispatcher
+         * @param image
+         * @return
+         * single channel image
+         */
+        Mat* tsai(ProcessingContext& context, const Mat& image) {
+            StageDispatcher* dispatcher = StageDispatcher::getInstancePtr();
+            StageRun run = dispatcher->begin(STAGE_TSAI, image.total());
+            Mat* ret = 0;
 #ifdef _OPENCL
+            if (run.backend == BACKEND_OPENCL)
+                ret = tsaiOpenCL(context, image);
+            else
+                ret = tsaiCPU(image);
+#else
+            ret = tsaiCPU(image);
+#endif
+            dispatcher->end(run);
+            return ret;
+        }
 
         /**
-         * process single image using openCL
+         * process single image, each stage runs on CPU or openCL as chosen by StageDispatcher
+         * @param context
+         * per image state of calling worker
          * @param out
-         * @param imageNew
+         * @param image
          */
-        void processSingleOpenCL(const char* out, const Mat& image) {
+        void processSingleImage(ProcessingContext& context, const char* out, const Mat& image) {
+            ContextBinding binding(context);
             UNIQUE_PTR(Mat) hlsPtr(OpenCV2Tools::convertToHLS(&image));
             if (hlsPtr.get() == 0) {
                 return;
             }
-            OpenclTools* oclt = OpenclTools::getInstancePtr();
-            uchar* buffer = OpenCV2Tools::convertImageToByteArray(&image, true);
-            VectorRaii<uchar> bufferRaii(buffer);
             UNIQUE_PTR(Mat) processedImagePtr;
-            bool usePrediction = false;
-            string usePredStr = Config::getInstancePtr()->getPropertyValue("general.Prediction.usePrediction");
-            if (usePredStr.compare("true") == 0)
-                usePrediction = true;
+            UNIQUE_PTR(Mat) piPtr(tsai(context, image));
+            bool usePrediction = Config::getInstancePtr()->getSettings().usePrediction;
             if (usePrediction == false) {
-                try {
-                    processedImagePtr = UNIQUE_PTR(Mat)(oclt->processRGBImage(buffer, image.size().width,
-                            image.size().height, image.channels()));
-                } catch (SDException& exception) {
-                    throw exception;
+                processedImagePtr = move(piPtr);
+            } else if (piPtr.get()) {
+                int pixCount;
+                int parameterCount;
+                UNIQUE_PTR(IImageParameteres) ipPtr(ObjectFactory::getInstancePtr()->createImageParameters());
+
+                UNIQUE_PTR(Mat) hsvPtr(OpenCV2Tools::convertToHSV(&image));
+                if (hsvPtr.get() == 0) {
+                    return;
                 }
-            } else {
-                UNIQUE_PTR(Mat) piPtr(oclt->processRGBImage(buffer, image.size().width, image.size().height, image.channels()));
-                if (piPtr.get()) {
-                    int pixCount;
-                    int parameterCount;
-                    UNIQUE_PTR(IImageParameteres) ipPtr(ObjectFactory::getInstancePtr()->createImageParameters());
 
-                    UNIQUE_PTR(Mat) hsvPtr(OpenCV2Tools::convertToHSV(&image));
-                    if (hsvPtr.get() == 0) {
-                        return;
+                vector<const Mat*> images;
+                images.push_back(&image);
+                images.push_back(hsvPtr.get());
+                images.push_back(hlsPtr.get());
+                UNIQUE_PTR(Matrix<float>) parametersPtr(ipPtr->getImageParameters(images,
+                        parameterCount, pixCount));
+                if (parametersPtr.get() != 0) {
+                    IPrediction* predictor = ObjectFactory::getInstancePtr()->createPredictor();
+                    if (predictor->hasLoadedModel() == false) {
+                        predictor->loadModel();
                     }
-                    
-                    vector<const Mat*> images;
-                    images.push_back(&image);
-                    images.push_back(hsvPtr.get()); 
-                    images.push_back(hlsPtr.get());
-                    UNIQUE_PTR(Matrix<float>) parametersPtr(ipPtr->getImageParameters(images,
-                            parameterCount, pixCount));
-                    if (parametersPtr.get() != 0) {
-                        IPrediction* predictor = ObjectFactory::getInstancePtr()->createPredictor();
-                        if (predictor->hasLoadedModel() == false) {
-                            predictor->loadModel();
-                        }
-                        uchar* predicted = predictor->predict(parametersPtr.get(), pixCount, parameterCount);
-                        if (predicted) {
-                            VectorRaii<uchar> vraiiPred(predicted);
-                            //FileSaver<uchar>::saveToFile("myPredictedOCL.out", predicted, pixCount);
-                            for (int i = 0; i < pixCount; i++)
-                                predicted[i] *= 255;
-                            UNIQUE_PTR(Mat) predictedImagePtr(OpenCV2Tools::get8bitImage(predicted,
-                                    image.size().height, image.size().width));
-                            processedImagePtr = UNIQUE_PTR(Mat)(OpenCV2Tools::joinTwoOcl(*piPtr, *predictedImagePtr));
-                        } else {
-                            SDException e(SHADOW_CANT_PREDICT, "processSingleOpenCL");
-                            throw e;
-                        }
+                    uchar* predicted = predictor->predict(parametersPtr.get(), pixCount, parameterCount);
+                    if (predicted) {
+                        VectorRaii<uchar> vraiiPred(predicted);
+                        for (int i = 0; i < pixCount; i++)
+                            predicted[i] *= 255;
+                        UNIQUE_PTR(Mat) predictedImagePtr(OpenCV2Tools::get8bitImage(predicted,
+                                image.size().height, image.size().width));
+#ifdef _OPENCL
+                        processedImagePtr = UNIQUE_PTR(Mat)(OpenCV2Tools::joinTwoOcl(*piPtr, *predictedImagePtr));
+#else
+                        processedImagePtr = UNIQUE_PTR(Mat)(OpenCV2Tools::joinTwo(piPtr.get(), predictedImagePtr.get()));
+#endif
                     } else {
-                        SDException e(SHADOW_CANT_GET_PARAMETERS, "processSingleOpenCL");
+                        SDException e(SHADOW_CANT_PREDICT, "processSingleImage");
                         throw e;
                     }
+                } else {
+                    SDException e(SHADOW_CANT_GET_PARAMETERS, "processSingleImage");
+                    throw e;
                 }
             }
             if (processedImagePtr.get() != 0) {
@@ -151,84 +204,153 @@ namespace shadowdetection {
                 imwrite(out, *processedImagePtr);
             }
         }
-#else
-        /**
-        * process single image on CPU not using openCL
-        * @param out
-        * @param image
-        */
-       void processSingleCPU(const char* out, IplImage* image) {    
-           Mat imageMat(image);
-           UNIQUE_PTR(Mat) hls(OpenCV2Tools::convertToHLS(&imageMat));
-           if (hls == 0){
-               return;
-           }    
 
-           IplImage* processedImage = 0;
-           int height, width, channels;
-           uint* hsi1 = OpenCvTools::convertImagetoHSI(image, height, width, channels, &OpenCvTools::RGBtoHSI_1);
-           VectorRaii<uint> vraiiHsi1(hsi1);
-           uchar* ratios1 = OpenCvTools::simpleTsai(hsi1, height, width, channels);
-           VectorRaii<uchar> vraiiR1(ratios1);
-           IplImage* ratiosImage1 = OpenCvTools::get8bitImage(ratios1, height, width);
-           ImageRaii iariiR1(ratiosImage1);
-           IplImage* binarized1 = OpenCvTools::binarize(ratiosImage1);
-           ImageRaii iraiiBin1(binarized1);
-           uint* hsi2 = OpenCvTools::convertImagetoHSI(image, height, width, channels, &OpenCvTools::RGBtoHSI_2);
-           VectorRaii<uint> vraiiHsi2(hsi2);
-           uchar* ratios2 = OpenCvTools::simpleTsai(hsi2, height, width, channels);
-           VectorRaii<uchar> vraiiR2(ratios2);
-           IplImage* ratiosImage2 = OpenCvTools::get8bitImage(ratios2, height, width);
-           ImageRaii iraiiR2(ratiosImage2);
-           IplImage* binarized2 = OpenCvTools::binarize(ratiosImage2);
-           ImageRaii iraiiBin2(binarized2);
+        /**
+         * tsai stage for all images of atlas, on backend chosen by StageDispatcher
+         * @param atlas
+         * @param packed
+         * packed atlas image
+         * @param results
+         * output, single channel image for each image of atlas
+         */
+        void tsaiAtlas(ProcessingContext& context, ImageAtlas& atlas, const Mat& packed, vector<Mat*>& results) {
+            StageDispatcher* dispatcher = StageDispatcher::getInstancePtr();
+            StageRun run = dispatcher->begin(STAGE_TSAI, atlas.getPixelCount());
+#ifdef _OPENCL
+            if (run.backend == BACKEND_OPENCL) {
+                //kernels run once for whole atlas, only binarization is per image
+                OpenclTools* oclt = context.getTool<OpenclTools>();
+                uchar* buffer = OpenCV2Tools::convertImageToByteArray(&packed, true);
+                VectorRaii<uchar> bufferRaii(buffer);
+                uchar* hsi1Ratios = 0;
+                uchar* hsi2Ratios = 0;
+                oclt->calculateRatios(buffer, atlas.getPixelCount(), packed.channels(), hsi1Ratios, hsi2Ratios);
+                VectorRaii<uchar> vraiiR1(hsi1Ratios);
+                VectorRaii<uchar> vraiiR2(hsi2Ratios);
+                for (size_t i = 0; i < atlas.size(); i++) {
+                    const AtlasEntry& entry = atlas.get(i);
+                    Mat ratiosImage1(entry.height, entry.width, CV_8U, atlas.view(hsi1Ratios, i));
+                    UNIQUE_PTR(Mat) binarized1(OpenCV2Tools::binarize(&ratiosImage1));
+                    Mat ratiosImage2(entry.height, entry.width, CV_8U, atlas.view(hsi2Ratios, i));
+                    UNIQUE_PTR(Mat) binarized2(OpenCV2Tools::binarize(&ratiosImage2));
+                    results.push_back(OpenCV2Tools::joinTwo(binarized1.get(), binarized2.get()));
+                }
+            } else {
+                for (size_t i = 0; i < atlas.size(); i++) {
+                    Mat image = atlas.view(packed, i);
+                    results.push_back(tsaiCPU(image));
+                }
+            }
+#else
+            for (size_t i = 0; i < atlas.size(); i++) {
+                Mat image = atlas.view(packed, i);
+                results.push_back(tsaiCPU(image));
+            }
+#endif
+            dispatcher->end(run);
+        }
 
-           bool usePrediction = false;
-           string usePredStr = Config::getInstancePtr()->getPropertyValue("general.Prediction.usePrediction");
-           if (usePredStr.compare("true") == 0)
-               usePrediction = true;
-           if (usePrediction){
-               IplImage* pi = OpenCvTools::joinTwo(binarized1, binarized2);
-               ImageRaii iraii(pi);        
-               int pixCount;
-               int parameterCount;
+        /**
+         * process many small images packed in atlas, color conversions, openCL kernels, image parameters
+         * and prediction run once for whole atlas
+         * @param context
+         * per image state of calling worker
+         * @param images
+         * @param outs
+         * output path for each image
+         */
+        void processAtlas(ProcessingContext& context, const vector<const Mat*>& images, 
+                            const vector<string>& outs) throw (SDException&) {
+            ContextBinding binding(context);
+            ImageAtlas atlas;
+            for (size_t i = 0; i < images.size(); i++) {
+                atlas.add(images[i]->size().width, images[i]->size().height);
+            }
+            UNIQUE_PTR(Mat) packedPtr(atlas.pack(images));
+            UNIQUE_PTR(Mat) hlsPtr(OpenCV2Tools::convertToHLS(packedPtr.get()));
+            if (hlsPtr.get() == 0) {
+                return;
+            }
+            vector<Mat*> results;
+            try {
+                tsaiAtlas(context, atlas, *packedPtr, results);
+                if (Config::getInstancePtr()->getSettings().usePrediction) {
+                    int pixCount;
+                    int parameterCount;
+                    UNIQUE_PTR(IImageParameteres) ipPtr(ObjectFactory::getInstancePtr()->createImageParameters());
+                    UNIQUE_PTR(Mat) hsvPtr(OpenCV2Tools::convertToHSV(packedPtr.get()));
+                    if (hsvPtr.get() == 0) {
+                        SDException e(SHADOW_CANT_GET_PARAMETERS, "processAtlas");
+                        throw e;
+                    }
+                    vector<const Mat*> packedImages;
+                    packedImages.push_back(packedPtr.get());
+                    packedImages.push_back(hsvPtr.get());
+                    packedImages.push_back(hlsPtr.get());
+                    UNIQUE_PTR(Matrix<float>) parametersPtr(ipPtr->getImageParameters(packedImages,
+                            parameterCount, pixCount));
+                    if (parametersPtr.get() == 0) {
+                        SDException e(SHADOW_CANT_GET_PARAMETERS, "processAtlas");
+                        throw e;
+                    }
+                    IPrediction* predictor = ObjectFactory::getInstancePtr()->createPredictor();
+                    if (predictor->hasLoadedModel() == false) {
+                        predictor->loadModel();
+                    }
+                    uchar* predicted = predictor->predict(parametersPtr.get(), pixCount, parameterCount);
+                    if (predicted == 0) {
+                        SDException e(SHADOW_CANT_PREDICT, "processAtlas");
+                        throw e;
+                    }
+                    VectorRaii<uchar> vraiiPred(predicted);
+                    for (int i = 0; i < pixCount; i++)
+                        predicted[i] *= 255;
+                    for (size_t i = 0; i < atlas.size(); i++) {
+                        if (results[i] == 0)
+                            continue;
+                        const AtlasEntry& entry = atlas.get(i);
+                        Mat predictedImage(entry.height, entry.width, CV_8U, atlas.view(predicted, i));
+                        Mat* joined = OpenCV2Tools::joinTwo(results[i], &predictedImage);
+                        Delete(results[i]);
+                        results[i] = joined;
+                    }
+                }
+                for (size_t i = 0; i < atlas.size(); i++) {
+                    if (results[i] == 0)
+                        continue;
+                    Mat original = atlas.view(*packedPtr, i);
+                    Mat hls = atlas.view(*hlsPtr, i);
+                    ResultFixer rf;
+                    rf.applyThreshholds(*results[i], original, hls);
+                    imwrite(outs[i], *results[i]);
+                }
+            } catch (SDException& exception) {
+                for (size_t i = 0; i < results.size(); i++) {
+                    if (results[i] != 0) {
+                        Delete(results[i]);
+                    }
+                }
+                throw exception;
+            }
+            for (size_t i = 0; i < results.size(); i++) {
+                if (results[i] != 0) {
+                    Delete(results[i]);
+                }
+            }
+        }
 
-               UNIQUE_PTR(Mat) hsv(OpenCV2Tools::convertToHSV(&imageMat));
-               if (hsv == 0){
-                   return;
-               }        
+        /**
+         * apply requested config reload and start loading of changed model,
+         * called between images, in flight images keep config and model they started with
+         */
+        void applyUpdates(){
+            Config::getInstancePtr()->reloadIfRequested();
+            ModelRegistry::getInstancePtr()->refresh();
+        }
 
-               UNIQUE_PTR(IImageParameteres) ipPtr(ObjectFactory::getInstancePtr()->createImageParameters());        
-               
-               vector<const Mat*> images;
-               images.push_back(&imageMat); images.push_back(hsv.get()); images.push_back(hls.get());
-               
-               UNIQUE_PTR(Matrix<float>) parameters(ipPtr->getImageParameters(  images, 
-                                                                                parameterCount, pixCount));
-               IPrediction* predictor = ObjectFactory::getInstancePtr()->createPredictor();
-               if (predictor->hasLoadedModel() == false){            
-                   predictor->loadModel();
-               }
-               uchar* predicted = predictor->predict(parameters.get(), pixCount, parameterCount);
-               VectorRaii<uchar> vraii(predicted);        
-               for (int i = 0; i < pixCount; i++)
-                   predicted[i] *= 255;
-               IplImage* predictedImage = OpenCvTools::get8bitImage(predicted, height, width);
-               ImageRaii iraii2(predictedImage);        
-               processedImage = OpenCvTools::joinTwo(pi, predictedImage);               
-           }
-           else{
-               processedImage = OpenCvTools::joinTwo(binarized1, binarized2);
-           }
-           if (processedImage){
-               ImageRaii iraii(processedImage);
-               ResultFixer rf;
-               Mat processedImageMat(processedImage);
-               rf.applyThreshholds(processedImageMat, imageMat, *hls);
-               cvSaveImage(out, processedImage);
-           }
+        void onReloadSignal(int signal){
+            Config::requestReload();
         }
-#endif
 
         void cleanUp(){
 #ifdef _OPENCL        
@@ -237,22 +359,32 @@ namespace shadowdetection {
         OpenCLImageParameters::destroy();
         OpenCLRegressionPredict::destroy();
 #endif
+        StageDispatcher::destroy();
+        ModelRegistry::destroy();
         Config::destroy();
         }
         
-        void cleanUpWork(){
+        /**
+         * process single image
+         * @param context
+         * per image state of calling worker
+         * @param input
+         * @param out
+         * @return
+         * number of pixels in processed image
+         */
+        uint64_t processSingle(ProcessingContext& context, const char* input, const char* out) throw (SDException&) {
+            uint64_t pixels = 0;
+            string message = "===========\nProcessing: ";
+            message += input;
+            message += "\n";
 #ifdef _OPENCL
-            OpenclTools::getInstancePtr()->cleanWorkPart();
-            OpenCLToolsPredict::getInstancePtr()->cleanWorkPart();
-            OpenCLImageParameters::getInstancePtr()->cleanWorkPart();
+            //device pool workers call this concurrently
+            DevicePool::print(message);
+#else
+            cout << message;
 #endif
-        }
-       
-        void processSingle(const char* input, const char* out) throw (SDException&) {
-            cout << "===========" << endl;
-            cout << "Processing: " << input << endl;
             try {
-#ifdef _OPENCL
                 Mat imageNew = cv::imread(input);
                 if (imageNew.data == 0) {
                     string msg = "Process single image file: ";
@@ -260,46 +392,130 @@ namespace shadowdetection {
                     SDException exc(SHADOW_READ_UNABLE, msg);
                     throw exc;
                 }
-                processSingleOpenCL(out, imageNew);
-#else
-                IplImage* image = cvLoadImage(input);
-                if (image != 0) {
-                    ImageRaii rai(image);
-                    processSingleCPU(out, image);
-                } else {
-                    string msg = "Process single image file: ";
-                    msg += input;
-                    SDException exc(SHADOW_READ_UNABLE, msg);
-                    throw exc;
-                }
-#endif
+                pixels = imageNew.total();
+                processSingleImage(context, out, imageNew);
             } catch (SDException& exception) {
                 throw exception;
             }
+            return pixels;
         }
 
-        ShadowDetectionProcessor::ShadowDetectionProcessor() : IProcessor() {
+        /**
+         * read atlas settings from config
+         * @return
+         * true if small images in batch should be packed in atlases
+         */
+        bool getAtlasSettings(size_t& maxImagePixels, size_t& maxAtlasPixels) {
+            //atlas is opt-in, snapshot disables it if section is missing or invalid
+            const Settings& settings = Config::getInstancePtr()->getSettings();
+            maxImagePixels = settings.maxImagePixels;
+            maxAtlasPixels = settings.maxAtlasPixels;
+            return settings.useAtlas;
+        }
 
+        void flushAtlas(ProcessingContext& context, vector<Mat>& pending, vector<string>& pendingOuts) {
+            if (pending.size() == 0)
+                return;
+            cout << "===========" << endl;
+            cout << "Processing atlas of " << pending.size() << " images" << endl;
+            vector<const Mat*> images;
+            for (size_t i = 0; i < pending.size(); i++) {
+                images.push_back(&pending[i]);
+            }
+            try {
+                processAtlas(context, images, pendingOuts);
+            } catch (SDException& exception) {
+                cout << exception.handleException() << endl;
+                cout << "Continue to process" << endl;
+            }
+            context.cleanWorkPart();
+            pending.clear();
+            pendingOuts.clear();
+        }
+
+        /**
+         * batch processing where images with at most maxImagePixels pixels are packed in atlases
+         * of at most maxAtlasPixels pixels, larger images are processed one by one
+         */
+        void processBatchAtlas(ProcessingContext& context, TabParser& tp, size_t maxImagePixels, size_t maxAtlasPixels) {
+            vector<Mat> pending;
+            vector<string> pendingOuts;
+            size_t pendingPixels = 0;
+            for (uint i = 0; i < tp.size(); i++) {
+                applyUpdates();
+                string in = tp.get(i).getFirst();
+                string out = tp.get(i).getSecond();
+                Mat image = cv::imread(in);
+                if (image.data == 0) {
+                    SDException exc(SHADOW_READ_UNABLE, "Process single image file: " + in);
+                    cout << exc.handleException() << endl;
+                    cout << "Continue to process" << endl;
+                    continue;
+                }
+                if (image.total() > maxImagePixels) {
+                    cout << "===========" << endl;
+                    cout << "Processing: " << in << endl;
+                    try {
+                        processSingleImage(context, out.c_str(), image);
+                    } catch (SDException& exception) {
+                        cout << exception.handleException() << endl;
+                        cout << "Continue to process" << endl;
+                    }
+                    context.cleanWorkPart();
+                    continue;
+                }
+                if (pendingPixels + image.total() > maxAtlasPixels) {
+                    flushAtlas(context, pending, pendingOuts);
+                    pendingPixels = 0;
+                }
+                pending.push_back(image);
+                pendingOuts.push_back(out);
+                pendingPixels += image.total();
+            }
+            flushAtlas(context, pending, pendingOuts);
+        }
+
+        ShadowDetectionProcessor::ShadowDetectionProcessor() : IProcessor() {
+            devicePool = 0;
         }
 
         ShadowDetectionProcessor::~ShadowDetectionProcessor() {
+#ifdef _OPENCL
+            if (devicePool != 0){
+                Delete(devicePool);
+            }
+#endif
             cleanUp();
         }
 
         void ShadowDetectionProcessor::init() throw (SDException&) {
             initOpenCL();
             initOpenMP();
+            //config is reloaded between images after SIGHUP
+            signal(SIGHUP, onReloadSignal);
+#ifdef _OPENCL
+            if (DevicePool::isEnabled()){
+                devicePool = New DevicePool();
+                try{
+                    devicePool->init();
+                }
+                catch (SDException& exception){
+                    cout << exception.handleException() << endl;
+                    exit(1);
+                }
+            }
+#endif
         }
         
         void ShadowDetectionProcessor::process(int argc, char **argv) {
             Config* conf = Config::getInstancePtr();
-            string useBatch = conf->getPropertyValue("general.UseBatch");
-            if (useBatch.compare("false") == 0) {
+            if (conf->getSettings().useBatch == false) {
                 if (argc > 2) {
                     char* path = argv[1];
                     char* savePath = argv[2];
                     try {
-                        processSingle(path, savePath);
+                        ProcessingContext context;
+                        processSingle(context, path, savePath);
                     } catch (SDException& exception) {
                         cout << exception.handleException() << endl;                        
                         return;
@@ -318,17 +534,60 @@ namespace shadowdetection {
                         cout << exception.handleException() << endl;
                         exit(1);
                     }
+#ifdef _OPENCL
+                    if (devicePool != 0){
+                        if (conf->getSettings().usePrediction){
+                            //model is shared by all devices, load it before workers start
+                            IPrediction* predictor = ObjectFactory::getInstancePtr()->createPredictor();
+                            try{
+                                if (predictor->hasLoadedModel() == false)
+                                    predictor->loadModel();
+                            }
+                            catch (SDException& exception){
+                                cout << exception.handleException() << endl;
+                                exit(1);
+                            }
+                        }
+                        devicePool->run(tp.size(), [&tp](DeviceSession* session, int index) -> uint64_t {
+                            applyUpdates();
+                            ProcessingContext context(session);
+                            string in = tp.get(index).getFirst();
+                            string out = tp.get(index).getSecond();
+                            return processSingle(context, in.c_str(), out.c_str());
+                        });
+                        devicePool->printThroughput();
+                        StageDispatcher::getInstancePtr()->printModels();
+                        return;
+                    }
+#endif
+                    UNIQUE_PTR(ProcessingContext) contextPtr;
+                    try {
+                        contextPtr = UNIQUE_PTR(ProcessingContext)(New ProcessingContext());
+                    } catch (SDException& exception) {
+                        cout << exception.handleException() << endl;
+                        exit(1);
+                    }
+                    ProcessingContext& context = *contextPtr;
+                    size_t maxImagePixels = 0;
+                    size_t maxAtlasPixels = 0;
+                    if (getAtlasSettings(maxImagePixels, maxAtlasPixels)) {
+                        processBatchAtlas(context, tp, maxImagePixels, maxAtlasPixels);
+                        StageDispatcher::getInstancePtr()->printModels();
+                        return;
+                    }
                     for (uint i = 0; i < tp.size(); i++) {
+                        applyUpdates();
                         string in = tp.get(i).getFirst();
                         string out = tp.get(i).getSecond();
                         try {
-                            processSingle(in.c_str(), out.c_str());
+                            processSingle(context, in.c_str(), out.c_str());
                         } catch (SDException& exception) {
                             cout << exception.handleException() << endl;
                             cout << "Continue to process" << endl;
                         }
-                        cleanUpWork();
+                        context.cleanWorkPart();
                     }                    
+                    StageDispatcher::getInstancePtr()->printModels();
                 } else {
                     cout << "Needed parameter path to csv file" << endl;                    
                     return;
@@ -11,6 +11,9 @@ namespace core{
             class IPrediction;
         }
     }
+    namespace opencl{
+        class DevicePool;
+    }
 }
 
 namespace shadowdetection{
@@ -22,6 +25,10 @@ namespace shadowdetection{
         PREPARE_REGISTRATION(ShadowDetectionProcessor)
         private:
             core::util::prediction::IPrediction* currPrediction;
+            /**
+             * used for batch processing when general.openCL.devicePool.UseDevicePool is true, otherwise 0
+             */
+            core::opencl::DevicePool* devicePool;
         protected:
             ShadowDetectionProcessor();
         public:
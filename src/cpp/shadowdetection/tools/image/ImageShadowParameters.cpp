@@ -4,8 +4,10 @@
 #include "core/util/MemTracker.h"
 #include "core/util/raii/RAIIS.h"
 #include "core/util/Config.h"
+#include "core/util/StageDispatcher.h"
 #ifdef _OPENCL
 #include "shadowdetection/opencl/OpenCLImageParameters.h"
+#include "core/opencl/DeviceSession.h"
 #endif
 
 #define SPACES_COUNT 3
@@ -24,6 +26,7 @@ namespace shadowdetection{
             using namespace core::util::raii;
 #ifdef _OPENCL
             using namespace shadowdetection::opencl;
+            using namespace core::opencl;
 #endif            
             
             REGISTER_CLASS(ImageShadowParameters, shadowdetection::tools::image)
@@ -37,45 +40,6 @@ namespace shadowdetection{
                 reset();
             }
             
-            float* ImageShadowParameters::merge(float label, const float** arrs, int arrsLen, int* arrSize, int& retSize) {
-                retSize = 1;
-                for (int i = 0; i < arrsLen; i++) {
-                    retSize += arrSize[i];
-                }
-                float* retArr = New float[retSize];
-                if (retArr){
-                    int counter = 0;
-                    retArr[counter] = label;
-                    for (int i = 0; i < arrsLen; i++) {
-                        int size = arrSize[i];
-                        const float* arr = arrs[i];
-                        for (int j = 0; j < size; j++) {
-                            retArr[++counter] = arr[j];
-                        }
-                    }
-                }
-                return retArr;
-            }
-            
-            float* ImageShadowParameters::merge(float** arrs, int arrsLen, int* arrSize, int& retSize){
-                retSize = 0;
-                for (int i = 0; i < arrsLen; i++) {
-                    retSize += arrSize[i];
-                }
-                float* retArr = New float[retSize];
-                if (retArr){
-                    int counter = -1;
-                    for (int i = 0; i < arrsLen; i++) {
-                        int size = arrSize[i];
-                        float* arr = arrs[i];
-                        for (int j = 0; j < size; j++) {
-                            retArr[++counter] = arr[j];
-                        }
-                    }
-                }
-                return retArr;
-            }
-            
             float getLabel(uchar val) {
                 if (val == 0)
                     return 0.f;
@@ -120,33 +84,20 @@ namespace shadowdetection{
                 images1.push_back(&originalImage); images1.push_back(hsvPtr.get()); images1.push_back(hlsPtr.get());
                 UNIQUE_PTR(const Matrix<float>) noLabelPtr(getImageParameters(  images1,
                                                                                 noLabelDataRowDimension, pixelCount));
-                if (noLabelPtr.get() != 0){                    
+                if (noLabelPtr.get() != 0){
+                    //label and parameters are written directly in rows, without merge per pixel
+                    rowDimension = noLabelDataRowDimension + 1;
+                    pixelNum = width * height;
+                    retPtr = UNIQUE_PTR(Matrix<float>)(New Matrix<float>(rowDimension, pixelNum));
                     for (int i = 0; i < height; i++) {
                         for (int j = 0; j < width; j++) {
-                            float label = OpenCV2Tools::getChannelValue(maskImage, j, i, 0); //getLabel(maskImage.data[i * maskStep + j * maskChan]);
+                            float label = OpenCV2Tools::getChannelValue(maskImage, j, i, 0);
                             label /= 255.f;
-                            
-                            int sizes[1];
-                            sizes[0] = noLabelDataRowDimension;
-                            const float* procs[1];
-                            procs[0] = (*noLabelPtr)[i * width + j];
-                            int mergedSize;
-                            float* merged = merge(label, procs, 1, sizes, mergedSize);
-                            if (merged == 0){                                
-                                return 0;
-                            }
-                            VectorRaii<float> vraii(merged);
-                            if (retPtr.get() == 0){
-                                retPtr = UNIQUE_PTR(Matrix<float>)(New Matrix<float>(mergedSize, width * height));                                
-                            }
-                            
-                            (*retPtr)[i * width + j] = merged;                                                    
-                            if (i == 0 && j == 0){
-                                rowDimension = mergedSize;
-                                pixelNum = width * height;
-                            }
+                            float* row = retPtr->getVec() + (size_t)(i * width + j) * rowDimension;
+                            row[0] = label;
+                            memcpy(row + 1, (*noLabelPtr)[i * width + j], noLabelDataRowDimension * sizeof(float));
                         }
-                    }                    
+                    }
                 }
                 else{
                     return 0;
@@ -155,6 +106,48 @@ namespace shadowdetection{
                 return ret;
             }
             
+            Matrix<float>* ImageShadowParameters::getImageParameters(   const std::vector<const Mat*>& images,
+                                                                        const Mat& maskImage,
+                                                                        const std::vector<uint>& pixels,
+                                                                        int& rowDimension,
+                                                                        int& pixelNum) throw (SDException&){
+                const Mat& originalImage = *(images[0]);
+                if (originalImage.data == 0 || maskImage.data == 0)
+                    return 0;
+                if (originalImage.size().width != maskImage.size().width ||
+                    originalImage.size().height != maskImage.size().height){
+                    SDException exc(SHADOW_DIFFERENT_IMAGES_SIZES, "ImageParameters::getImageParameters, MaskImage");
+                    throw exc;
+                }
+                if (maskImage.channels() > 1){
+                    SDException exc(SHADOW_INVALID_IMAGE_FORMAT, "ImageParameters::getImageParameters, MaskImage");
+                    throw exc;
+                }
+                UNIQUE_PTR(Mat) hsvPtr(OpenCV2Tools::convertToHSV(&originalImage));
+                if (hsvPtr.get() == 0){
+                    return 0;
+                }
+                UNIQUE_PTR(Mat) hlsPtr(OpenCV2Tools::convertToHLS(&originalImage));
+                if (hlsPtr.get() == 0){
+                    return 0;
+                }
+                //only chosen pixels, parameters are same as of CPU path for whole image
+                uint width = originalImage.size().width;
+                rowDimension = 1 + HSV_PARAMETERS + HLS_PARAMETERS + BGR_PARAMETERS;
+                pixelNum = pixels.size();
+                UNIQUE_PTR(Matrix<float>) retPtr(New Matrix<float>(rowDimension, pixelNum));
+                for (int i = 0; i < pixelNum; i++){
+                    Pair<uint> location(pixels[i] % width, pixels[i] / width);
+                    float* row = retPtr->getVec() + (size_t)i * rowDimension;
+                    row[0] = OpenCV2Tools::getChannelValue(maskImage, location, 0) / 255.f;
+                    if (fillPixelParameters(originalImage, *hsvPtr, *hlsPtr, location, row + 1) == false){
+                        return 0;
+                    }
+                }
+                Matrix<float>* ret = retPtr.release();
+                return ret;
+            }
+            
             Matrix<float>* ImageShadowParameters::getImageParameters( const std::vector<const cv::Mat*>& images,
                                                                 int& rowDimension,
                                                                 int& pixelNum) throw (SDException&){
@@ -163,71 +156,95 @@ namespace shadowdetection{
                 const Mat& hlsImage = *images[2];
                 if (originalImage.data == 0 || hsvImage.data == 0 || hlsImage.data == 0)
                     return 0;
-                int height = originalImage.size().height;
-                int width = originalImage.size().width;                
+                StageDispatcher* dispatcher = StageDispatcher::getInstancePtr();
+                StageRun run = dispatcher->begin(STAGE_PARAMETERS, originalImage.total());
+                Matrix<float>* ret = 0;
+#ifdef _OPENCL
+                if (run.backend == BACKEND_OPENCL)
+                    ret = getImageParametersOpenCL(originalImage, hsvImage, hlsImage, rowDimension, pixelNum);
+                else
+                    ret = getImageParametersCPU(originalImage, hsvImage, hlsImage, rowDimension, pixelNum);
+#else
+                ret = getImageParametersCPU(originalImage, hsvImage, hlsImage, rowDimension, pixelNum);
+#endif
+                dispatcher->end(run);
+                return ret;
+            }
+            
 #ifdef _OPENCL
+            Matrix<float>* ImageShadowParameters::getImageParametersOpenCL( const Mat& originalImage, const Mat& hsvImage,
+                                                                            const Mat& hlsImage, int& rowDimension,
+                                                                            int& pixelNum) throw (SDException&){
+                int height = originalImage.size().height;
+                int width = originalImage.size().width;
                 pixelNum = width * height;
                 uint parameterCount = HSV_PARAMETERS + HLS_PARAMETERS + BGR_PARAMETERS;
-                Matrix<float>* ret = OpenCLImageParameters::getInstancePtr()->getImageParameters(&originalImage, 
+                Matrix<float>* ret = DeviceSession::tool<OpenCLImageParameters>()->getImageParameters(&originalImage, 
                                                                             &hsvImage, &hlsImage, parameterCount);
-                OpenCLImageParameters::getInstancePtr()->cleanWorkPart();
+                DeviceSession::tool<OpenCLImageParameters>()->cleanWorkPart();
                 rowDimension = parameterCount;
                 return ret;
-#else
-                UNIQUE_PTR(Matrix<float>) ret;                
+            }
+#endif
+            
+            bool ImageShadowParameters::fillPixelParameters(const Mat& originalImage, const Mat& hsvImage,
+                                                            const Mat& hlsImage, Pair<uint> location, float* row){
+                uchar hHSV = OpenCV2Tools::getChannelValue(hsvImage, location, 0);
+                uchar sHSV = OpenCV2Tools::getChannelValue(hsvImage, location, 1);
+                uchar vHSV = OpenCV2Tools::getChannelValue(hsvImage, location, 2);
+
+                uchar hHLS = OpenCV2Tools::getChannelValue(hlsImage, location, 0);
+                uchar lHLS = OpenCV2Tools::getChannelValue(hlsImage, location, 1);
+                uchar sHLS = OpenCV2Tools::getChannelValue(hlsImage, location, 2);
+
+                uchar B = OpenCV2Tools::getChannelValue(originalImage, location, 0);
+                uchar G = OpenCV2Tools::getChannelValue(originalImage, location, 1);
+                uchar R = OpenCV2Tools::getChannelValue(originalImage, location, 2);
+
+                float* procs[SPACES_COUNT];
+                int size[SPACES_COUNT];
+                procs[0] = processHSV(hHSV, sHSV, vHSV, size[0]);
+                if (procs[0] == 0){
+                    return false;
+                }
+                VectorRaii<float> vraiiProc0(procs[0]);
+                procs[1] = processHLS(hHLS, lHLS, sHLS, size[1]);
+                if (procs[1] == 0){
+                    return false;
+                }
+                VectorRaii<float> vraiiProc1(procs[1]);
+                procs[2] = processBGR(B, G, R, size[2]);
+                if (procs[2] == 0){
+                    return false;
+                }
+                VectorRaii<float> vraiiProc2(procs[2]);
+                for (int i = 0; i < SPACES_COUNT; i++){
+                    memcpy(row, procs[i], size[i] * sizeof(float));
+                    row += size[i];
+                }
+                return true;
+            }
+
+            Matrix<float>* ImageShadowParameters::getImageParametersCPU(const Mat& originalImage, const Mat& hsvImage,
+                                                                        const Mat& hlsImage, int& rowDimension,
+                                                                        int& pixelNum) throw (SDException&){
+                int height = originalImage.size().height;
+                int width = originalImage.size().width;
+                rowDimension = HSV_PARAMETERS + HLS_PARAMETERS + BGR_PARAMETERS;
+                pixelNum = width * height;
+                UNIQUE_PTR(Matrix<float>) ret(New Matrix<float>(rowDimension, pixelNum));
                 
                 for (int i = 0; i < height; i++) {
                     for (int j = 0; j < width; j++) {
                         Pair<uint> location((uint)j, (uint)i);
-                        uchar hHSV = OpenCV2Tools::getChannelValue(hsvImage, location, 0);
-                        uchar sHSV = OpenCV2Tools::getChannelValue(hsvImage, location, 1);
-                        uchar vHSV = OpenCV2Tools::getChannelValue(hsvImage, location, 2);
-
-                        uchar hHLS = OpenCV2Tools::getChannelValue(hlsImage, location, 0);
-                        uchar lHLS = OpenCV2Tools::getChannelValue(hlsImage, location, 1);
-                        uchar sHLS = OpenCV2Tools::getChannelValue(hlsImage, location, 2);
-
-                        float* procs[SPACES_COUNT];
-                        int size[SPACES_COUNT];
-                        procs[0] = processHSV(hHSV, sHSV, vHSV, size[0]);
-                        if (procs[0] == 0){
+                        float* row = ret->getVec() + (size_t)(i * width + j) * rowDimension;
+                        if (fillPixelParameters(originalImage, hsvImage, hlsImage, location, row) == false){
                             return 0;
                         }
-                        VectorRaii<float> vraiiProc0(procs[0]);
-                        procs[1] = processHLS(hHLS, lHLS, sHLS, size[1]);
-                        if (procs[1] == 0){
-                            return 0;
-                        }
-                        VectorRaii<float> vraiiProc1(procs[1]);
-                        uchar B = OpenCV2Tools::getChannelValue(originalImage, location, 0);
-                        uchar G = OpenCV2Tools::getChannelValue(originalImage, location, 1);
-                        uchar R = OpenCV2Tools::getChannelValue(originalImage, location, 2);
-                        procs[2] = processBGR(B, G, R, size[2]);
-                        if (procs[2] == 0){
-                            return 0;
-                        }
-                        VectorRaii<float> vraiiProc2(procs[2]);                                                
-                        
-                        int mergedSize = 0;
-                        float* merged = ImageShadowParameters::merge(procs, SPACES_COUNT, size, mergedSize);
-                        if (merged == 0){                            
-                            return 0;
-                        }
-                        VectorRaii<float> vraii(merged);
-                        if (ret == 0){
-                            ret = UNIQUE_PTR(Matrix<float>)(New Matrix<float>(mergedSize, width * height));                            
-                        }
-                                                
-                        (*ret)[i * width + j] = merged;                        
-                        if (i == 0 && j == 0) {
-                            rowDimension = mergedSize;
-                            pixelNum = width * height;
-                        }
                     }
                 }
                 Matrix<float>* retPtr = ret.release();
                 return retPtr;
-#endif
             }
             
             float* ImageShadowParameters::processHSV(uchar H, uchar S, uchar V, int& size) {
@@ -323,12 +340,7 @@ namespace shadowdetection{
                     throw (exc);
                 }
                 if (regionsAvgsSecondChannel == 0){
-                    numOfSegments = 16;
-                    Config* config = Config::getInstancePtr();
-                    string numSegmentsStr = config->getPropertyValue("settings.Parameters.numSegments");
-                    if (numSegmentsStr != ""){
-                        numOfSegments = atoi(numSegmentsStr.c_str());
-                    }
+                    numOfSegments = Config::getInstancePtr()->getSettings().numSegments;
                     getAvgChannelValForRegions(originalImage, channelIndex);
                 }
                 
@@ -26,9 +26,20 @@ namespace shadowdetection{
                                     int& size, uchar channelIndex) throw (SDException&);
                 core::util::Matrix<float>* getAvgChannelValForRegions(const cv::Mat* originalImage,
                                                                                 uchar channelIndex);
+                core::util::Matrix<float>* getImageParametersCPU(   const cv::Mat& originalImage, const cv::Mat& hsvImage,
+                                                                    const cv::Mat& hlsImage, int& rowDimension,
+                                                                    int& pixelNum) throw (SDException&);
+#ifdef _OPENCL
+                core::util::Matrix<float>* getImageParametersOpenCL(const cv::Mat& originalImage, const cv::Mat& hsvImage,
+                                                                    const cv::Mat& hlsImage, int& rowDimension,
+                                                                    int& pixelNum) throw (SDException&);
+#endif
+                /**
+                 * write parameters of one pixel to row, HSV, HLS and BGR parameters in that order
+                 */
+                static bool fillPixelParameters(const cv::Mat& originalImage, const cv::Mat& hsvImage,
+                                                const cv::Mat& hlsImage, Pair<uint> location, float* row);
             protected:
-                static float* merge(float** arrs, int arrsLen, int* arrSize, int& retSize);
-                static float* merge(float label, const float** arrs, int arrsLen, int* arrSize, int& retSize);
             public:
                 ImageShadowParameters();
                 virtual ~ImageShadowParameters();
@@ -38,6 +49,10 @@ namespace shadowdetection{
                 virtual core::util::Matrix<float>* getImageParameters(  const std::vector<const cv::Mat*>& images,
                                                                         const cv::Mat& maskImage,
                                                                         int& rowDimension, int& pixelNum) throw (SDException&);
+                virtual core::util::Matrix<float>* getImageParameters(  const std::vector<const cv::Mat*>& images,
+                                                                        const cv::Mat& maskImage,
+                                                                        const std::vector<uint>& pixels,
+                                                                        int& rowDimension, int& pixelNum) throw (SDException&);
                 virtual void reset();
             };
             
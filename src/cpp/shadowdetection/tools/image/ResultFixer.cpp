@@ -23,17 +23,10 @@ namespace shadowdetection{
             }
             
             void ResultFixer::init() throw(SDException&){
-                Config* conf = Config::getInstancePtr();                                
-                string lThreshStr = conf->getPropertyValue("shadowDetection.Thresholds.lValue");
-                lThresh = (uchar)atoi(lThreshStr.c_str());
-                string useThreshStr = conf->getPropertyValue("shadowDetection.useThresholds");
-                useThresh = true;
-                if (useThreshStr == "false")
-                    useThresh = false;
-                useSky = true;
-                string useSkyStr = conf->getPropertyValue("shadowDetection.useSkyDetection");
-                if (useSkyStr == "false")
-                    useSky = false;
+                const Settings& settings = Config::getInstancePtr()->getSettings();
+                lThresh = settings.shadowLThresh;
+                useThresh = settings.useThresholds;
+                useSky = settings.useSkyDetection;
             }
             
             void ResultFixer::applyThreshholds( Mat& image, const Mat& originalImage, 
@@ -15,13 +15,10 @@ namespace skydetection{
         originalImage = 0;        
         detectedImage = 0;
         
-        Config* conf = Config::getInstancePtr();
-        string rThreshStr = conf->getPropertyValue("skyDetection.Thresholds.rValue");
-        rThresh = (uchar)atoi(rThreshStr.c_str());
-        string bThreshStr = conf->getPropertyValue("skyDetection.Thresholds.bValue");
-        bThresh = (uchar)atoi(bThreshStr.c_str());
-        string lThreshStr = conf->getPropertyValue("skyDetection.Thresholds.lValue");
-        lThresh = (uchar)atoi(lThreshStr.c_str());
+        const Settings& settings = Config::getInstancePtr()->getSettings();
+        rThresh = settings.skyRThresh;
+        bThresh = settings.skyBThresh;
+        lThresh = settings.skyLThresh;
     }
     
     SkyDetection::SkyDetection(){
@@ -7,6 +7,9 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <pthread.h>
+#include <algorithm>
+#include <functional>
 #include "svm.h"
 #include "core/opencl/libsvm/OpenCLToolsTrain.h"
 #include "core/util/Matrix.h"
@@ -53,9 +56,104 @@ static inline double powi(double base, int times) {
     }
     return ret;
 }
+
+// exp for RBF kernel rows, x <= 0, relative error about 1e-7 (Cephes expf polynomial).
+// Clamping and rounding use integer operations only, float compares would keep
+// loops calling it from being vectorized without -fno-trapping-math
+
+static inline float exp_approx(float x) {
+    union {
+        float f;
+        unsigned int u;
+    } bits;
+    // for x <= 0 larger pattern is larger magnitude, below -87.3 result isn't normal
+    bits.f = x;
+    bits.u = bits.u > 0xC2AE999Au ? 0xC2AE999Au : bits.u;
+    x = bits.f;
+    // round x / ln(2) to nearest integer k by adding 1.5 * 2^23
+    bits.f = x * 1.44269504088896341f + 12582912.0f;
+    int k = (int) bits.u - 0x4B400000;
+    float fk = bits.f - 12582912.0f;
+    float r = x - fk * 0.693359375f + fk * 2.12194440e-4f;
+    float p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+    // 2^k
+    bits.u = (unsigned int) (k + 127) << 23;
+    return p * bits.f;
+}
+
+// max(x, 0) without float compare, rounding can make squared distance slightly negative
+
+static inline float non_negative(float x) {
+    union {
+        float f;
+        int i;
+    } bits;
+    bits.f = x;
+    bits.i &= ~(bits.i >> 31);
+    return bits.f;
+}
 #define INF HUGE_VAL
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+// solver loops over fewer elements run in one thread, starting parallel region costs more
+#define SOLVER_OMP_MIN_SIZE 2048
+// solver sums are added in chunks of this many elements
+#define SOLVER_SUM_CHUNK 1024
+// training data with at most this many features is kept dense for kernel rows
+#define KERNEL_DENSE_MAX_DIMS 1024
+// kernel row is computed in blocks of this many columns
+#define KERNEL_BLOCK 256
+
+// value with its index, for parallel arg max. Serial libsvm loops take the last
+// of equal values, so ties go to the larger index in every thread and in reduce_max
+
+struct ArgMax {
+    double value;
+    int index;
+};
+
+static inline void update_max(ArgMax& m, double value, int index) {
+    if (value >= m.value) {
+        m.value = value;
+        m.index = index;
+    }
+}
+
+static inline void reduce_max(ArgMax& shared, const ArgMax& local) {
+#if defined _OPENMP_MY
+#pragma omp critical(svm_reduce_max)
+#endif
+    if (local.value > shared.value || (local.value == shared.value && local.index > shared.index))
+        shared = local;
+}
+
+// sum of term(j) for j < n. Chunk sums are computed in parallel and added in chunk
+// order, so result doesn't depend on number of threads. partial has one value per chunk
+
+template <class Term> static double ordered_sum(int n, Term term, double *partial) {
+    int chunks = (n + SOLVER_SUM_CHUNK - 1) / SOLVER_SUM_CHUNK;
+    int c;
+#if defined _OPENMP_MY
+#pragma omp parallel for schedule(static) if(n >= SOLVER_OMP_MIN_SIZE)
+#endif
+    for (c = 0; c < chunks; c++) {
+        int end = min(n, (c + 1) * SOLVER_SUM_CHUNK);
+        double sum = 0;
+        for (int j = c * SOLVER_SUM_CHUNK; j < end; j++)
+            sum += term(j);
+        partial[c] = sum;
+    }
+    double sum = 0;
+    for (c = 0; c < chunks; c++)
+        sum += partial[c];
+    return sum;
+}
 
 static void print_string_stdout(const char *s) {
     fputs(s, stdout);
@@ -83,46 +181,155 @@ static void info(const char *fmt, ...) {
 //
 // l is the number of total data items
 // size is the cache size limit in bytes
+// storage is CACHE_FLOAT or 16 bit CACHE_FP16 / CACHE_BF16, which keep twice as many
+// elements. Compressed rows are decoded into one of two buffers by get_data, so
+// returned data is valid until the second next get_data, and newly filled part is
+// stored back by put_data
 //
 
+// float to IEEE half, round to nearest even (F. Giesen, float_to_half_fast3_rtne)
+
+static inline unsigned short float_to_fp16(float value) {
+    union {
+        float f;
+        unsigned int u;
+    } bits, denorm_magic;
+    denorm_magic.u = ((127 - 15) + (23 - 10) + 1) << 23;
+    bits.f = value;
+    unsigned int sign = bits.u & 0x80000000u;
+    unsigned int out;
+    bits.u ^= sign;
+    if (bits.u >= (127 + 16) << 23) // inf or nan
+        out = bits.u > 255u << 23 ? 0x7e00 : 0x7c00;
+    else if (bits.u < 113u << 23) { // subnormal or zero
+        bits.f += denorm_magic.f;
+        out = bits.u - denorm_magic.u;
+    } else {
+        unsigned int mant_odd = (bits.u >> 13) & 1;
+        bits.u += ((unsigned int) (15 - 127) << 23) + 0xfff;
+        bits.u += mant_odd;
+        out = bits.u >> 13;
+    }
+    return (unsigned short) (out | (sign >> 16));
+}
+
+static inline float fp16_to_float(unsigned short value) {
+    union {
+        float f;
+        unsigned int u;
+    } bits, magic;
+    magic.u = 113 << 23;
+    const unsigned int shifted_exp = 0x7c00 << 13;
+    bits.u = (value & 0x7fff) << 13;
+    unsigned int exp = shifted_exp & bits.u;
+    bits.u += (127 - 15) << 23;
+    if (exp == shifted_exp) // inf or nan
+        bits.u += (128 - 16) << 23;
+    else if (exp == 0) { // zero or subnormal
+        bits.u += 1 << 23;
+        bits.f -= magic.f;
+    }
+    bits.u |= (unsigned int) (value & 0x8000) << 16;
+    return bits.f;
+}
+
+// float to upper 16 bits, round to nearest even
+
+static inline unsigned short float_to_bf16(float value) {
+    union {
+        float f;
+        unsigned int u;
+    } bits;
+    bits.f = value;
+    if ((bits.u & 0x7fffffff) > 0x7f800000) // nan stays quiet nan
+        return (unsigned short) ((bits.u >> 16) | 0x40);
+    bits.u += 0x7fff + ((bits.u >> 16) & 1);
+    return (unsigned short) (bits.u >> 16);
+}
+
+static inline float bf16_to_float(unsigned short value) {
+    union {
+        float f;
+        unsigned int u;
+    } bits;
+    bits.u = (unsigned int) value << 16;
+    return bits.f;
+}
+
+static svm_cache_stats cache_stats_total = {0, 0, 0};
+// caches of concurrent trainings (grid search) are destroyed in parallel
+static pthread_mutex_t cache_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 class Cache {
 public:
-    Cache(int l, long int size);
+    Cache(int l, long int size, int storage = CACHE_FLOAT);
     ~Cache();
 
     // request data [0,len)
     // return some position p where [p,len) need to be filled
     // (p >= len if nothing needs to be filled)
     int get_data(const int index, Qfloat **data, int len);
+    // store filled [start,len) of data returned by get_data, no-op for float rows
+    void put_data(const int index, const Qfloat *data, int start, int len);
+    // true if [0,len) of row is cached, doesn't change lru order
+    bool has_data(const int index, int len) const {
+        return head[index].len >= len;
+    }
+    // store computed row [0,len), e.g. prefetched one. Doesn't evict two most
+    // recently used rows (they can be in use by solver), row isn't stored if
+    // there is no space without them
+    void store_data(const int index, const Qfloat *data, int len);
     void swap_index(int i, int j);
 private:
     int l;
-    long int size;
+    long int size; // free space in elements
+    int storage;
+    int element_size;
 
     struct head_t {
         head_t *prev, *next; // a circular list
-        Qfloat *data;
+        void *data;
         int len; // data[0,len) is cached in this entry
     };
 
     head_t *head;
     head_t lru_head;
+    Qfloat *buffer[2]; // decoded compressed rows
+    int next_buffer;
+    svm_cache_stats stats;
     void lru_delete(head_t *h);
     void lru_insert(head_t *h);
+    void drop(head_t *h);
 };
 
-Cache::Cache(int l_, long int size_) : l(l_), size(size_) {
+Cache::Cache(int l_, long int size_, int storage_) : l(l_), size(size_), storage(storage_) {
+    element_size = storage == CACHE_FLOAT ? sizeof (Qfloat) : sizeof (unsigned short);
     head = (head_t *) calloc(l, sizeof (head_t)); // initialized to 0
-    size /= sizeof (Qfloat);
-    size -= l * sizeof (head_t) / sizeof (Qfloat);
+    size /= element_size;
+    size -= l * sizeof (head_t) / element_size;
+    buffer[0] = buffer[1] = NULL;
+    next_buffer = 0;
+    if (storage != CACHE_FLOAT) {
+        buffer[0] = new Qfloat[l];
+        buffer[1] = new Qfloat[l];
+        size -= 2 * l * sizeof (Qfloat) / element_size;
+    }
     size = max(size, 2 * (long int) l); // cache must be large enough for two columns
     lru_head.next = lru_head.prev = &lru_head;
+    stats.hits = stats.misses = stats.evictions = 0;
 }
 
 Cache::~Cache() {
     for (head_t *h = lru_head.next; h != &lru_head; h = h->next)
         free(h->data);
     free(head);
+    delete[] buffer[0];
+    delete[] buffer[1];
+    pthread_mutex_lock(&cache_stats_mutex);
+    cache_stats_total.hits += stats.hits;
+    cache_stats_total.misses += stats.misses;
+    cache_stats_total.evictions += stats.evictions;
+    pthread_mutex_unlock(&cache_stats_mutex);
 }
 
 void Cache::lru_delete(head_t *h) {
@@ -139,33 +346,89 @@ void Cache::lru_insert(head_t *h) {
     h->next->prev = h;
 }
 
+void Cache::drop(head_t *h) {
+    lru_delete(h);
+    free(h->data);
+    size += h->len;
+    h->data = 0;
+    h->len = 0;
+    stats.evictions++;
+}
+
 int Cache::get_data(const int index, Qfloat **data, int len) {
     head_t *h = &head[index];
     if (h->len) lru_delete(h);
     int more = len - h->len;
 
     if (more > 0) {
+        stats.misses++;
         // free old space
-        while (size < more) {
-            head_t *old = lru_head.next;
-            lru_delete(old);
-            free(old->data);
-            size += old->len;
-            old->data = 0;
-            old->len = 0;
-        }
+        while (size < more)
+            drop(lru_head.next);
 
         // allocate new space
-        h->data = (Qfloat *) realloc(h->data, sizeof (Qfloat) * len);
+        h->data = realloc(h->data, element_size * len);
         size -= more;
         swap(h->len, len);
-    }
+    } else
+        stats.hits++;
 
     lru_insert(h);
-    *data = h->data;
+    if (storage == CACHE_FLOAT) {
+        *data = (Qfloat *) h->data;
+        return len;
+    }
+
+    Qfloat *decoded = buffer[next_buffer];
+    next_buffer = 1 - next_buffer;
+    const unsigned short *row = (const unsigned short *) h->data;
+    int j;
+    if (storage == CACHE_FP16)
+        for (j = 0; j < len; j++)
+            decoded[j] = fp16_to_float(row[j]);
+    else
+        for (j = 0; j < len; j++)
+            decoded[j] = bf16_to_float(row[j]);
+    *data = decoded;
     return len;
 }
 
+void Cache::put_data(const int index, const Qfloat *data, int start, int len) {
+    if (storage == CACHE_FLOAT)
+        return;
+    unsigned short *row = (unsigned short *) head[index].data;
+    int j;
+    if (storage == CACHE_FP16)
+        for (j = start; j < len; j++)
+            row[j] = float_to_fp16(data[j]);
+    else
+        for (j = start; j < len; j++)
+            row[j] = float_to_bf16(data[j]);
+}
+
+void Cache::store_data(const int index, const Qfloat *data, int len) {
+    head_t *h = &head[index];
+    int more = len - h->len;
+    if (more <= 0)
+        return;
+    if (h->len) lru_delete(h);
+    while (size < more && lru_head.next != &lru_head && lru_head.next->next != &lru_head
+            && lru_head.next->next->next != &lru_head)
+        drop(lru_head.next);
+    if (size < more) {
+        if (h->len) lru_insert(h);
+        return;
+    }
+    h->data = realloc(h->data, element_size * len);
+    size -= more;
+    h->len = len;
+    lru_insert(h);
+    if (storage == CACHE_FLOAT)
+        memcpy(h->data, data, sizeof (Qfloat) * len);
+    else
+        put_data(index, data, 0, len);
+}
+
 void Cache::swap_index(int i, int j) {
     if (i == j) return;
 
@@ -177,19 +440,20 @@ void Cache::swap_index(int i, int j) {
     if (head[j].len) lru_insert(&head[j]);
 
     if (i > j) swap(i, j);
-    for (head_t *h = lru_head.next; h != &lru_head; h = h->next) {
+    for (head_t *h = lru_head.next; h != &lru_head;) {
+        head_t *next = h->next;
         if (h->len > i) {
-            if (h->len > j)
-                swap(h->data[i], h->data[j]);
-            else {
+            if (h->len > j) {
+                if (storage == CACHE_FLOAT)
+                    swap(((Qfloat *) h->data)[i], ((Qfloat *) h->data)[j]);
+                else
+                    swap(((unsigned short *) h->data)[i], ((unsigned short *) h->data)[j]);
+            } else {
                 // give up
-                lru_delete(h);
-                free(h->data);
-                size += h->len;
-                h->data = 0;
-                h->len = 0;
+                drop(h);
             }
         }
+        h = next;
     }
 }
 
@@ -207,6 +471,18 @@ public:
     virtual double *get_QD() const = 0;
     virtual void swap_index(int i, int j) const = 0;
 
+    // Q matrices which compute rows in batches (openCL) take hints of rows the
+    // solver will probably need soon and compute them with next missing row.
+    // maximal number of hinted rows, 0 if hints aren't used
+    virtual int prefetch_size() const {
+        return 0;
+    }
+    virtual bool is_cached(int column, int len) const {
+        return true;
+    }
+    virtual void prefetch(const int *columns, int n, int len) {
+    }
+
     virtual ~QMatrix() {
     }
 };
@@ -218,6 +494,9 @@ public:
 
     static double k_function(const svm_node *x, const svm_node *y,
             const svm_parameter& param);
+    // storage of kernel cache for param.cache_storage. fp16 overflows above 65504, so
+    // kernels of problem which can exceed it get bf16 (same size, float range) instead
+    static int cache_storage(const svm_problem& prob, const svm_parameter& param);
     virtual Qfloat *get_Q(int column, int len) = 0;
     virtual double *get_QD() const = 0;
 
@@ -226,6 +505,16 @@ public:
         //swap((*x)[i], (*x)[j]);
         x->swap(i, j);
         if (x_square) swap(x_square[i], x_square[j]);
+#ifdef _OPENCL
+        swap(order[i], order[j]);
+        order_changed = true;
+#endif
+        if (dense) {
+            for (int d = 0; d < dense_dims; d++)
+                swap(dense[(size_t) d * dense_stride + i], dense[(size_t) d * dense_stride + j]);
+            swap(dense_square[i], dense_square[j]);
+        }
+        if (matrix_row) swap(matrix_row[i], matrix_row[j]);
     }
 protected:
 
@@ -240,8 +529,49 @@ protected:
     const double gamma;
     const double coef0;
     double *x_square;
+
+    // dense float copy of x, feature major: feature d of instance j is
+    // dense[d * dense_stride + j]. NULL for precomputed kernel or too many features
+    float *dense;
+    float *dense_square;
+    int dense_dims;
+    int dense_stride;
+
+    // param.kernel_matrix and its row of each instance, NULL if there is no matrix
+    // or some instance isn't in it
+    const svm_kernel_matrix *matrix;
+    int *matrix_row;
+
+    // out[j] = K(i, j) for j in [start, len), multiplied by y[i] * y[j] if y is not NULL.
+    // Read from matrix if there is one, otherwise uses dense and rows are computed
+    // as blocked matrix-vector products
+    void kernel_row(int i, int start, int len, const schar *y, Qfloat *out) const;
+#ifdef _OPENCL
+    // original row of instance, device keeps x, y and x_square in original order
+    int *order;
+    mutable bool order_changed;
+    // rows hinted by prefetch, launched with next missing row
+    int *hints;
+    mutable int hint_count;
+    int hint_len;
+    // launched prefetch batch
+    int *pending;
+    mutable int pending_count;
+    int pending_len;
+
+    // data[start, len) of row i computed on device, y is NULL for SVR_Q_TYPE. Waits
+    // for prefetched row i if it is launched, otherwise launches i and hinted rows
+    void device_rows(Cache *cache, int i, Qfloat *data, int start, int len,
+            const schar *y, LIBSVM_CLASS_TYPE type);
+    // wait for launched prefetch batch and store its rows, except skip, in cache.
+    // Returns rows of batch, NULL if nothing was launched
+    const Qfloat *store_pending(Cache *cache, int skip) const;
+    void set_hints(Cache *cache, const int *columns, int n, int len);
+#endif
 private:
     static double dot(const svm_node *px, const svm_node *py);
+    void make_dense(int l, svm_node * const * x_);
+    void find_matrix_rows(int l, svm_node * const * x_, const svm_kernel_matrix *km);
 
     double kernel_linear(int i, int j) const {
         return dot((*x)(i), (*x)(j));
@@ -302,13 +632,259 @@ gamma(param.gamma), coef0(param.coef0) {
     } else
         x_square = 0;
     kL = l;          
+    make_dense(l, x_);
+    find_matrix_rows(l, x_, param.kernel_matrix);
+#ifdef _OPENCL
+    order = new int[l];
+    for (int i = 0; i < l; i++)
+        order[i] = i;
+    order_changed = false;
+    int capacity = OpenCLToolsTrain::getInstancePtr()->getPrefetchRows();
+    hints = new int[capacity + 1];
+    pending = new int[capacity + 1];
+    hint_count = hint_len = 0;
+    pending_count = pending_len = 0;
+#endif
 }
 
 Kernel::~Kernel() {
+#ifdef _OPENCL
+    OpenCLToolsTrain* oclt = OpenCLToolsTrain::getInstancePtr();
+    if (oclt->hasProblem(this))
+        oclt->cleanWorkPart();
+    delete[] order;
+    delete[] hints;
+    delete[] pending;
+#endif
     if (x)
         delete x;
     delete[] x_square;
+    delete[] dense;
+    delete[] dense_square;
+    delete[] matrix_row;
+}
+
+void Kernel::make_dense(int l, svm_node * const * x_) {
+    dense = NULL;
+    dense_square = NULL;
+    dense_dims = 0;
+    dense_stride = 0;
+    if (kernel_type == PRECOMPUTED)
+        return;
+
+    int i;
+    for (i = 0; i < l; i++)
+        for (const svm_node *px = x_[i]; px->index != -1; ++px)
+            if (px->index > dense_dims)
+                dense_dims = px->index;
+    if (dense_dims == 0 || dense_dims > KERNEL_DENSE_MAX_DIMS)
+        return;
+
+    // stride is multiple of block, so block loops don't need remainder handling
+    dense_stride = (l + KERNEL_BLOCK - 1) / KERNEL_BLOCK * KERNEL_BLOCK;
+    dense = new float[(size_t) dense_dims * dense_stride];
+    dense_square = new float[dense_stride];
+    memset(dense, 0, sizeof (float) * dense_dims * dense_stride);
+    memset(dense_square, 0, sizeof (float) * dense_stride);
+#if defined _OPENMP_MY
+#pragma omp parallel for private(i)
+#endif
+    for (i = 0; i < l; i++) {
+        double sum = 0;
+        for (const svm_node *px = x_[i]; px->index != -1; ++px) {
+            float value = (float) px->value;
+            dense[(size_t) (px->index - 1) * dense_stride + i] = value;
+            sum += (double) value * value;
+        }
+        dense_square[i] = (float) sum;
+    }
+}
+
+void Kernel::find_matrix_rows(int l, svm_node * const * x_, const svm_kernel_matrix *km) {
+    matrix = NULL;
+    matrix_row = NULL;
+    if (km == NULL)
+        return;
+
+    // subproblems (classes of one-vs-one, folds) share svm_node arrays of problem
+    // matrix was made for, so rows are found by address
+    const svm_node * const *first = km->x_sorted;
+    const svm_node * const *last = km->x_sorted + km->l;
+    std::less<const svm_node *> before;
+    int *rows = new int[l];
+    for (int i = 0; i < l; i++) {
+        const svm_node * const *found = std::lower_bound(first, last, x_[i], before);
+        if (found == last || *found != x_[i]) {
+            delete[] rows;
+            return;
+        }
+        rows[i] = km->rows[found - first];
+    }
+    matrix = km;
+    matrix_row = rows;
+}
+
+void Kernel::kernel_row(int i, int start, int len, const schar *y, Qfloat *out) const {
+    if (matrix_row != NULL) {
+        const unsigned short *row = matrix->data + (size_t) matrix_row[i] * matrix->l;
+        float y_i = y != NULL ? (float) y[i] : 1.0f;
+        int j;
+#if defined _OPENMP_MY
+#pragma omp parallel for private(j) if(len - start >= SOLVER_OMP_MIN_SIZE)
+#endif
+        for (j = start; j < len; j++) {
+            float value = fp16_to_float(row[matrix_row[j]]);
+            out[j] = y != NULL ? y_i * y[j] * value : value;
+        }
+        return;
+    }
+
+    float x_i[KERNEL_DENSE_MAX_DIMS];
+    for (int d = 0; d < dense_dims; d++)
+        x_i[d] = dense[(size_t) d * dense_stride + i];
+    float square_i = dense_square[i];
+    float gamma_f = (float) gamma;
+    float y_i = y != NULL ? (float) y[i] : 1.0f;
+
+    int first_block = start / KERNEL_BLOCK;
+    int end_block = (len + KERNEL_BLOCK - 1) / KERNEL_BLOCK;
+    int b;
+#if defined _OPENMP_MY
+#pragma omp parallel for private(b) schedule(static)
+#endif
+    for (b = first_block; b < end_block; b++) {
+        int begin = b * KERNEL_BLOCK;
+        float acc[KERNEL_BLOCK];
+        int j;
+#if defined _OPENMP_MY
+#pragma omp simd
+#endif
+        for (j = 0; j < KERNEL_BLOCK; j++)
+            acc[j] = 0;
+        // columns of one feature are contiguous, so every step is a vector axpy
+        for (int d = 0; d < dense_dims; d++) {
+            const float *column = dense + (size_t) d * dense_stride + begin;
+            float value = x_i[d];
+#if defined _OPENMP_MY
+#pragma omp simd
+#endif
+            for (j = 0; j < KERNEL_BLOCK; j++)
+                acc[j] += value * column[j];
+        }
+
+        switch (kernel_type) {
+            case RBF:
+            {
+                const float *square = dense_square + begin;
+#if defined _OPENMP_MY
+#pragma omp simd
+#endif
+                for (j = 0; j < KERNEL_BLOCK; j++)
+                    acc[j] = exp_approx(-gamma_f * non_negative(square_i + square[j] - 2 * acc[j]));
+                break;
+            }
+            case POLY:
+                for (j = 0; j < KERNEL_BLOCK; j++)
+                    acc[j] = (float) powi(gamma * acc[j] + coef0, degree);
+                break;
+            case SIGMOID:
+                for (j = 0; j < KERNEL_BLOCK; j++)
+                    acc[j] = (float) tanh(gamma * acc[j] + coef0);
+                break;
+        }
+
+        int from = max(begin, start);
+        int to = min(begin + KERNEL_BLOCK, len);
+        if (y != NULL)
+            for (j = from; j < to; j++)
+                out[j] = y_i * y[j] * acc[j - begin];
+        else
+            for (j = from; j < to; j++)
+                out[j] = acc[j - begin];
+    }
+}
+
+#ifdef _OPENCL
+void Kernel::device_rows(Cache *cache, int i, Qfloat *data, int start, int len,
+        const schar *y, LIBSVM_CLASS_TYPE type) {
+    OpenCLToolsTrain* oclt = OpenCLToolsTrain::getInstancePtr();
+    if (!oclt->hasProblem(this)) {
+        oclt->setProblem(this, x, order, x_square, (const char *) y, type,
+                kernel_type, gamma, coef0, degree);
+        order_changed = false;
+        pending_count = 0;
+    }
+    int k;
+    for (k = 0; k < pending_count; k++)
+        if (pending[k] == i)
+            break;
+    if (k < pending_count && pending_len >= len) {
+        const Qfloat *rows = store_pending(cache, i);
+        memcpy(data + start, rows + (size_t) k * kL + start, sizeof (Qfloat) * (len - start));
+        return;
+    }
+
+    if (order_changed) {
+        oclt->setOrder(order);
+        order_changed = false;
+    }
+    oclt->enqueueRows(OCL_DEMAND_BATCH, &i, 1, start, len);
+    // launched after demand row, so it is computed while solver uses row i
+    bool launch = hint_count > 0;
+    if (launch && pending_count == 0) {
+        oclt->enqueueRows(OCL_PREFETCH_BATCH, hints, hint_count, 0, hint_len);
+        memcpy(pending, hints, sizeof (int) * hint_count);
+        pending_count = hint_count;
+        pending_len = hint_len;
+        hint_count = 0;
+        launch = false;
+    }
+    const Qfloat *row = oclt->waitRows(OCL_DEMAND_BATCH);
+    memcpy(data + start, row + start, sizeof (Qfloat) * (len - start));
+    if (launch) {
+        // queue is in order, previous batch is done
+        store_pending(cache, i);
+        int n = 0;
+        for (k = 0; k < hint_count; k++)
+            if (hints[k] != i)
+                hints[n++] = hints[k];
+        if (n > 0) {
+            oclt->enqueueRows(OCL_PREFETCH_BATCH, hints, n, 0, hint_len);
+            memcpy(pending, hints, sizeof (int) * n);
+            pending_count = n;
+            pending_len = hint_len;
+        }
+        hint_count = 0;
+    }
+}
+
+const Qfloat *Kernel::store_pending(Cache *cache, int skip) const {
+    if (pending_count == 0)
+        return NULL;
+    const Qfloat *rows = OpenCLToolsTrain::getInstancePtr()->waitRows(OCL_PREFETCH_BATCH);
+    for (int k = 0; k < pending_count; k++)
+        if (pending[k] != skip)
+            cache->store_data(pending[k], rows + (size_t) k * kL, pending_len);
+    pending_count = 0;
+    return rows;
+}
+
+void Kernel::set_hints(Cache *cache, const int *columns, int n, int len) {
+    int capacity = OpenCLToolsTrain::getInstancePtr()->getPrefetchRows();
+    hint_count = 0;
+    hint_len = len;
+    for (int k = 0; k < n && hint_count < capacity; k++) {
+        if (cache->has_data(columns[k], len))
+            continue;
+        int h;
+        for (h = 0; h < pending_count; h++)
+            if (pending[h] == columns[k] && pending_len >= len)
+                break;
+        if (h == pending_count)
+            hints[hint_count++] = columns[k];
+    }
 }
+#endif
 
 double Kernel::dot(const svm_node *px, const svm_node *py) {
     double sum = 0;
@@ -327,6 +903,33 @@ double Kernel::dot(const svm_node *px, const svm_node *py) {
     return sum;
 }
 
+int Kernel::cache_storage(const svm_problem& prob, const svm_parameter& param) {
+    if (param.cache_storage != CACHE_FP16)
+        return param.cache_storage;
+    // rbf values are in [0,1], sigmoid in [-1,1]
+    double bound = 1;
+    if (param.kernel_type == LINEAR || param.kernel_type == POLY) {
+        // |<x,y>| <= max |x|^2
+        double max_square = 0;
+        for (int i = 0; i < prob.l; i++)
+            max_square = max(max_square, dot(prob.x[i], prob.x[i]));
+        if (param.kernel_type == LINEAR)
+            bound = max_square;
+        else
+            bound = powi(param.gamma * max_square + fabs(param.coef0), param.degree);
+    } else if (param.kernel_type == PRECOMPUTED) {
+        // first node of instance is its serial number
+        bound = 0;
+        for (int i = 0; i < prob.l; i++)
+            for (const svm_node *node = prob.x[i] + 1; node->index != -1; node++)
+                bound = max(bound, fabs(node->value));
+    }
+    if (bound <= 65504)
+        return CACHE_FP16;
+    info("kernel values up to %g don't fit fp16 cache, using bf16\n", bound);
+    return CACHE_BF16;
+}
+
 double Kernel::k_function(const svm_node *x, const svm_node *y,
         const svm_parameter& param) {
     switch (param.kernel_type) {
@@ -382,12 +985,12 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
 //
 //		y^T \alpha = \delta
 //		y_i = +1 or -1
-//		0 <= alpha_i <= Cp for y_i = 1
-//		0 <= alpha_i <= Cn for y_i = -1
+//		0 <= alpha_i <= Cp * W_i for y_i = 1
+//		0 <= alpha_i <= Cn * W_i for y_i = -1
 //
 // Given:
 //
-//	Q, p, y, Cp, Cn, and an initial feasible point \alpha
+//	Q, p, y, Cp, Cn, W (instance weights, NULL for all 1), and an initial feasible point \alpha
 //	l is the size of vectors and matrices
 //	eps is the stopping tolerance
 //
@@ -413,7 +1016,7 @@ public:
 
     void Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
             double *alpha_, double Cp, double Cn, double eps,
-            SolutionInfo* si, int shrinking);
+            SolutionInfo* si, int shrinking, const double *W_ = NULL);
 protected:
     int active_size;
     schar *y;
@@ -428,14 +1031,24 @@ protected:
     const double *QD;
     double eps;
     double Cp, Cn;
+    double *W;
     double *p;
     int *active_set;
     double *G_bar; // gradient, if we treat free variables as 0
+    double *grad_diff; // select_working_set scratch, allocated once per Solve
+    double *obj_diff;
+    double *sum_partial; // ordered_sum scratch
+    int prefetch_rows; // Q->prefetch_size(), prefetch_violators scratch is sized by it
+    double *prefetch_values;
+    int *prefetch_indices;
+    int *prefetch_columns;
     int l;
     bool unshrink; // XXX
+    bool on_device; // G and alpha_status live on OpenCL device, host G is stale
 
     double get_C(int i) {
-        return (y[i] > 0) ? Cp : Cn;
+        double C = (y[i] > 0) ? Cp : Cn;
+        return W != NULL ? C * W[i] : C;
     }
 
     void update_alpha_status(int i) {
@@ -459,9 +1072,20 @@ protected:
     }
     void swap_index(int i, int j);
     void reconstruct_gradient();
+    // before row i is computed, hint Q with rows of most violating instances,
+    // they are likely to be selected in next iterations
+    void prefetch_violators(int i);
     virtual int select_working_set(int &i, int &j);
     virtual double calculate_rho();
     virtual void do_shrinking();
+    // solver can keep its state on device and select working set there
+    virtual bool device_capable() const {
+        return true;
+    }
+    // copy device G back before host reads it / state to device after host changed it
+    void sync_host();
+    void sync_device();
+    int select_working_set_device(int &i, int &j);
 private:
     bool be_shrunk(int i, double Gmax1, double Gmax2);
 };
@@ -473,10 +1097,55 @@ void Solver::swap_index(int i, int j) {
     swap(alpha_status[i], alpha_status[j]);
     swap(alpha[i], alpha[j]);
     swap(p[i], p[j]);
+    if (W != NULL)
+        swap(W[i], W[j]);
     swap(active_set[i], active_set[j]);
     swap(G_bar[i], G_bar[j]);
 }
 
+// keep count largest values in descending order
+static void insert_top(double *values, int *indices, int &count, int size, double value, int index) {
+    if (count == size && value <= values[count - 1])
+        return;
+    int k = count < size ? count++ : count - 1;
+    for (; k > 0 && values[k - 1] < value; k--) {
+        values[k] = values[k - 1];
+        indices[k] = indices[k - 1];
+    }
+    values[k] = value;
+    indices[k] = index;
+}
+
+void Solver::prefetch_violators(int i) {
+    int n = prefetch_rows;
+    if (n <= 0 || Q->is_cached(i, active_size))
+        return;
+    // largest -y G of I_up and largest y G of I_low
+    int up_size = (n + 1) / 2, low_size = n - up_size;
+    double *values = prefetch_values;
+    int *indices = prefetch_indices;
+    int *columns = prefetch_columns;
+    int up_count = 0, low_count = 0;
+    for (int t = 0; t < active_size; t++) {
+        if (t == i)
+            continue;
+        bool up = y[t] == +1 ? !is_upper_bound(t) : !is_lower_bound(t);
+        bool low = y[t] == +1 ? !is_lower_bound(t) : !is_upper_bound(t);
+        if (up)
+            insert_top(values, indices, up_count, up_size, -y[t] * G[t], t);
+        if (low && low_size > 0)
+            insert_top(values + up_size, indices + up_size, low_count, low_size, y[t] * G[t], t);
+    }
+    int m = 0;
+    for (int k = 0; k < up_count || k < low_count; k++) {
+        if (k < up_count)
+            columns[m++] = indices[k];
+        if (k < low_count && (k >= up_count || indices[up_size + k] != indices[k]))
+            columns[m++] = indices[up_size + k];
+    }
+    Q->prefetch(columns, m, active_size);
+}
+
 void Solver::reconstruct_gradient() {
     // reconstruct inactive elements of G from G_bar and free variables
 
@@ -485,9 +1154,15 @@ void Solver::reconstruct_gradient() {
     int i, j;
     int nr_free = 0;
 
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(l - active_size >= SOLVER_OMP_MIN_SIZE)
+#endif
     for (j = active_size; j < l; j++)
         G[j] = G_bar[j] + p[j];
 
+#if defined _OPENMP_MY
+#pragma omp parallel for reduction(+:nr_free) if(active_size >= SOLVER_OMP_MIN_SIZE)
+#endif
     for (j = 0; j < active_size; j++)
         if (is_free(j))
             nr_free++;
@@ -495,37 +1170,82 @@ void Solver::reconstruct_gradient() {
     if (2 * nr_free < active_size)
         info("\nWARNING: using -h 0 may be faster\n");
 
+    // get_Q uses the kernel cache, so only loops over one row are parallel
     if (nr_free * l > 2 * active_size * (l - active_size)) {
         for (i = active_size; i < l; i++) {
             const Qfloat *Q_i = Q->get_Q(i, active_size);
-            for (j = 0; j < active_size; j++)
-                if (is_free(j))
-                    G[i] += alpha[j] * Q_i[j];
+            G[i] += ordered_sum(active_size, [this, Q_i](int j) {
+                return is_free(j) ? alpha[j] * Q_i[j] : 0.;
+            }, sum_partial);
         }
     } else {
         for (i = 0; i < active_size; i++)
             if (is_free(i)) {
                 const Qfloat *Q_i = Q->get_Q(i, l);
                 double alpha_i = alpha[i];
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(l - active_size >= SOLVER_OMP_MIN_SIZE)
+#endif
                 for (j = active_size; j < l; j++)
                     G[j] += alpha_i * Q_i[j];
             }
     }
 }
 
+void Solver::sync_host() {
+#ifdef _OPENCL
+    if (on_device)
+        OpenCLToolsTrain::getInstancePtr()->getGradient(G, active_size);
+#endif
+}
+
+void Solver::sync_device() {
+#ifdef _OPENCL
+    if (on_device)
+        OpenCLToolsTrain::getInstancePtr()->setSolverState(l, (const char *) y, alpha_status, G, QD);
+#endif
+}
+
+int Solver::select_working_set_device(int &out_i, int &out_j) {
+#ifdef _OPENCL
+    OpenCLToolsTrain* oclt = OpenCLToolsTrain::getInstancePtr();
+    int i, j;
+    double Gmax, Gmax2, G_i, G_j;
+    oclt->selectMaxViolating(active_size, i, Gmax, G_i);
+    if (i == -1)
+        return 1;
+    const Qfloat *Q_i = Q->get_Q(i, active_size);
+    oclt->selectWorkingSet(active_size, i, Gmax, Q_i, j, Gmax2, G_j);
+    if (Gmax + Gmax2 < eps || j == -1)
+        return 1;
+    // only pair is on host, alpha step needs its gradients
+    G[i] = G_i;
+    G[j] = G_j;
+    out_i = i;
+    out_j = j;
+    return 0;
+#else
+    return select_working_set(out_i, out_j);
+#endif
+}
+
 void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
         double *alpha_, double Cp, double Cn, double eps,
-        SolutionInfo* si, int shrinking) {
+        SolutionInfo* si, int shrinking, const double *W_) {
     this->l = l;
     this->Q = &Q;
     QD = Q.get_QD();
     clone(p, p_, l);
     clone(y, y_, l);
     clone(alpha, alpha_, l);
+    W = NULL;
+    if (W_ != NULL)
+        clone(W, W_, l);
     this->Cp = Cp;
     this->Cn = Cn;
     this->eps = eps;
     unshrink = false;
+    on_device = false;
 
     // initialize alpha_status
     {
@@ -546,6 +1266,13 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
     {
         G = new double[l];
         G_bar = new double[l];
+        grad_diff = new double[l];
+        obj_diff = new double[l];
+        sum_partial = new double[(l + SOLVER_SUM_CHUNK - 1) / SOLVER_SUM_CHUNK];
+        prefetch_rows = max(Q.prefetch_size(), 0);
+        prefetch_values = new double[prefetch_rows];
+        prefetch_indices = new int[prefetch_rows];
+        prefetch_columns = new int[prefetch_rows];
         int i;
         for (i = 0; i < l; i++) {
             G[i] = p[i];
@@ -556,14 +1283,27 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
                 const Qfloat *Q_i = Q.get_Q(i, l);
                 double alpha_i = alpha[i];
                 int j;
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(l >= SOLVER_OMP_MIN_SIZE)
+#endif
                 for (j = 0; j < l; j++)
                     G[j] += alpha_i * Q_i[j];
-                if (is_upper_bound(i))
+                if (is_upper_bound(i)) {
+                    double C_i = get_C(i);
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(l >= SOLVER_OMP_MIN_SIZE)
+#endif
                     for (j = 0; j < l; j++)
-                        G_bar[j] += get_C(i) * Q_i[j];
+                        G_bar[j] += C_i * Q_i[j];
+                }
             }
     }
 
+#ifdef _OPENCL
+    on_device = device_capable() && OpenCLToolsTrain::getInstancePtr()->useDeviceSolver(l);
+    sync_device();
+#endif
+
     // optimization step
 
     int iter = 0;
@@ -575,16 +1315,22 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
 
         if (--counter == 0) {
             counter = min(l, 1000);
-            if (shrinking) do_shrinking();
+            if (shrinking) {
+                sync_host();
+                do_shrinking();
+                sync_device();
+            }
             info(".");
         }
 
         int i, j;
         if (select_working_set(i, j) != 0) {
             // reconstruct the whole gradient
+            sync_host();
             reconstruct_gradient();
             // reset active set size and check
             active_size = l;
+            sync_device();
             info("*");
             if (select_working_set(i, j) != 0)
                 break;
@@ -674,10 +1420,14 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
         double delta_alpha_i = alpha[i] - old_alpha_i;
         double delta_alpha_j = alpha[j] - old_alpha_j;
 
-        //TODO parallelize with OMP
         int k;
-        for (k = 0; k < active_size; k++) {
-            G[k] += Q_i[k] * delta_alpha_i + Q_j[k] * delta_alpha_j;
+        if (!on_device) {
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(active_size >= SOLVER_OMP_MIN_SIZE)
+#endif
+            for (k = 0; k < active_size; k++) {
+                G[k] += Q_i[k] * delta_alpha_i + Q_j[k] * delta_alpha_j;
+            }
         }
 
         // update alpha_status and G_bar
@@ -687,29 +1437,42 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
             bool uj = is_upper_bound(j);
             update_alpha_status(i);
             update_alpha_status(j);
+#ifdef _OPENCL
+            if (on_device)
+                OpenCLToolsTrain::getInstancePtr()->updateGradient(active_size, i, j, Q_j,
+                    delta_alpha_i, delta_alpha_j, alpha_status[i], alpha_status[j]);
+#endif
             int k;
             if (ui != is_upper_bound(i)) {
                 Q_i = Q.get_Q(i, l);
-                if (ui)                    
-                    for (k = 0; k < l; k++)
-                        G_bar[k] -= C_i * Q_i[k];
-                else
-                    for (k = 0; k < l; k++)
-                        G_bar[k] += C_i * Q_i[k];
+                double C_diff = ui ? -C_i : C_i;
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(l >= SOLVER_OMP_MIN_SIZE)
+#endif
+                for (k = 0; k < l; k++)
+                    G_bar[k] += C_diff * Q_i[k];
             }
 
             if (uj != is_upper_bound(j)) {
                 Q_j = Q.get_Q(j, l);
-                if (uj)
-                    for (k = 0; k < l; k++)
-                        G_bar[k] -= C_j * Q_j[k];
-                else                  
-                    for (k = 0; k < l; k++)
-                        G_bar[k] += C_j * Q_j[k];
+                double C_diff = uj ? -C_j : C_j;
+#if defined _OPENMP_MY
+#pragma omp parallel for simd if(l >= SOLVER_OMP_MIN_SIZE)
+#endif
+                for (k = 0; k < l; k++)
+                    G_bar[k] += C_diff * Q_j[k];
             }
         }
     }
 
+#ifdef _OPENCL
+    if (on_device) {
+        sync_host();
+        OpenCLToolsTrain::getInstancePtr()->releaseSolverState();
+        on_device = false;
+    }
+#endif
+
     if (iter >= max_iter) {
         if (active_size < l) {
             // reconstruct the whole gradient to calculate objective value
@@ -726,11 +1489,9 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
 
     // calculate objective value
     {
-        double v = 0;
-        int i;
-        //TODO parallelize with OMP
-        for (i = 0; i < l; i++)
-            v += alpha[i] * (G[i] + p[i]);
+        double v = ordered_sum(l, [this](int i) {
+            return alpha[i] * (G[i] + p[i]);
+        }, sum_partial);
 
         si->obj = v / 2;
     }
@@ -761,6 +1522,13 @@ void Solver::Solve(int l, QMatrix& Q, const double *p_, const schar *y_,
     delete[] active_set;
     delete[] G;
     delete[] G_bar;
+    delete[] grad_diff;
+    delete[] obj_diff;
+    delete[] sum_partial;
+    delete[] prefetch_values;
+    delete[] prefetch_indices;
+    delete[] prefetch_columns;
+    delete[] W;
 }
 
 // return 1 if already optimal, return 0 otherwise
@@ -772,46 +1540,50 @@ int Solver::select_working_set(int &out_i, int &out_j) {
     //    (if quadratic coefficeint <= 0, replace it with tau)
     //    -y_j*grad(f)_j < -y_i*grad(f)_i, j in I_low(\alpha)
 
-    double Gmax = -INF;
+    if (on_device)
+        return select_working_set_device(out_i, out_j);
+
+    ArgMax Gmax = {-INF, -1};
     double Gmax2 = -INF;
-    int Gmax_idx = -1;
-    int Gmin_idx = -1;
-    double obj_diff_min = INF;
-
-    for (int t = 0; t < active_size; t++)
-        if (y[t] == +1) {
-            if (!is_upper_bound(t))
-                if (-G[t] >= Gmax) {
-                    Gmax = -G[t];
-                    Gmax_idx = t;
-                }
-        } else {
-            if (!is_lower_bound(t))
-                if (G[t] >= Gmax) {
-                    Gmax = G[t];
-                    Gmax_idx = t;
-                }
-        }
+    // minimal obj_diff, kept negated
+    ArgMax obj_diff_min = {-INF, -1};
+    int n = active_size;
 
-    int i = Gmax_idx;
+#if defined _OPENMP_MY
+#pragma omp parallel if(n >= SOLVER_OMP_MIN_SIZE)
+#endif
+    {
+        ArgMax local = {-INF, -1};
+        int t;
+#if defined _OPENMP_MY
+#pragma omp for schedule(static) nowait
+#endif
+        for (t = 0; t < n; t++)
+            if (y[t] == +1) {
+                if (!is_upper_bound(t))
+                    update_max(local, -G[t], t);
+            } else {
+                if (!is_lower_bound(t))
+                    update_max(local, G[t], t);
+            }
+        reduce_max(Gmax, local);
+    }
+
+    int i = Gmax.index;
     const Qfloat *Q_i = NULL;
-    if (i != -1) // NULL Q_i not accessed: Gmax=-INF if i=-1
+    if (i != -1) { // NULL Q_i not accessed: Gmax=-INF if i=-1
+        prefetch_violators(i);
         Q_i = Q->get_Q(i, active_size);
-    
-    double* grad_diff = new double[active_size];
-    double* obj_diff = new double[active_size];
-    
-//#ifdef _OPENCL    
-//    OpenclTools* oclt = OpenclTools::getInstancePtr();
-//    oclt->selectWorkingSet(active_size, i, (const char*)y, alpha_status, l, grad_diff, Gmax, G, QD, Q_i, obj_diff);
-//    oclt->cleanWorkPart();
-//#else
-    //TODO parallelize with OMP
+    }
+
     int j;
-    for (j = 0; j < active_size; j++) {
+#if defined _OPENMP_MY
+#pragma omp parallel for if(n >= SOLVER_OMP_MIN_SIZE)
+#endif
+    for (j = 0; j < n; j++) {
         if (y[j] == +1) {
             if (!is_lower_bound(j)) {
-                grad_diff[j] = Gmax + G[j];                
+                grad_diff[j] = Gmax.value + G[j];
                 if (grad_diff[j] > 0) {                    
                     double quad_coef = QD[i] + QD[j] - 2.0 * y[i] * Q_i[j];
                     if (quad_coef > 0)
@@ -822,7 +1594,7 @@ int Solver::select_working_set(int &out_i, int &out_j) {
             }
         } else {
             if (!is_upper_bound(j)) {
-                grad_diff[j] = Gmax - G[j];                
+                grad_diff[j] = Gmax.value - G[j];
                 if (grad_diff[j] > 0) {                    
                     double quad_coef = QD[i] + QD[j] + 2.0 * y[i] * Q_i[j];
                     if (quad_coef > 0)
@@ -833,43 +1605,42 @@ int Solver::select_working_set(int &out_i, int &out_j) {
             }
         }
     }
-//#endif
-    
-    for (int j = 0; j < active_size; j++) {
-        if (y[j] == +1) {
-            if (!is_lower_bound(j)) {
-                if (G[j] >= Gmax2)
-                    Gmax2 = G[j];
-                if (grad_diff[j] > 0) {
-                    if (obj_diff[j] <= obj_diff_min) {
-                        Gmin_idx = j;
-                        obj_diff_min = obj_diff[j];
-                    }
+
+#if defined _OPENMP_MY
+#pragma omp parallel reduction(max:Gmax2) if(n >= SOLVER_OMP_MIN_SIZE)
+#endif
+    {
+        ArgMax local = {-INF, -1};
+        int t;
+#if defined _OPENMP_MY
+#pragma omp for schedule(static) nowait
+#endif
+        for (t = 0; t < n; t++) {
+            if (y[t] == +1) {
+                if (!is_lower_bound(t)) {
+                    if (G[t] >= Gmax2)
+                        Gmax2 = G[t];
+                    if (grad_diff[t] > 0)
+                        update_max(local, -obj_diff[t], t);
                 }
             }
-        }
-        else{
-            if (!is_upper_bound(j)) {
-                if (-G[j] >= Gmax2)
-                    Gmax2 = -G[j];
-                if (grad_diff[j] > 0) {
-                    if (obj_diff[j] <= obj_diff_min) {
-                        Gmin_idx = j;
-                        obj_diff_min = obj_diff[j];
-                    }
+            else{
+                if (!is_upper_bound(t)) {
+                    if (-G[t] >= Gmax2)
+                        Gmax2 = -G[t];
+                    if (grad_diff[t] > 0)
+                        update_max(local, -obj_diff[t], t);
                 }
             }
         }
+        reduce_max(obj_diff_min, local);
     }
-    
-    delete[] grad_diff;
-    delete[] obj_diff;
 
-    if (Gmax + Gmax2 < eps)
+    if (Gmax.value + Gmax2 < eps)
         return 1;
 
-    out_i = Gmax_idx;
-    out_j = Gmin_idx;
+    out_i = Gmax.index;
+    out_j = obj_diff_min.index;
     return 0;
 }
 
@@ -894,6 +1665,9 @@ void Solver::do_shrinking() {
     double Gmax2 = -INF; // max { y_i * grad(f)_i | i in I_low(\alpha) }
 
     // find maximal violating pair first
+#if defined _OPENMP_MY
+#pragma omp parallel for reduction(max:Gmax1,Gmax2) if(active_size >= SOLVER_OMP_MIN_SIZE)
+#endif
     for (i = 0; i < active_size; i++) {
         if (y[i] == +1) {
             if (!is_upper_bound(i)) {
@@ -991,6 +1765,11 @@ private:
     double calculate_rho();
     bool be_shrunk(int i, double Gmax1, double Gmax2, double Gmax3, double Gmax4);
     void do_shrinking();
+
+    // nu selection splits by class, it stays on host
+    bool device_capable() const {
+        return false;
+    }
 };
 
 // return 1 if already optimal, return 0 otherwise
@@ -1002,91 +1781,104 @@ int Solver_NU::select_working_set(int &out_i, int &out_j) {
     //    (if quadratic coefficeint <= 0, replace it with tau)
     //    -y_j*grad(f)_j < -y_i*grad(f)_i, j in I_low(\alpha)
 
-    double Gmaxp = -INF;
+    ArgMax Gmaxp = {-INF, -1};
     double Gmaxp2 = -INF;
-    int Gmaxp_idx = -1;
 
-    double Gmaxn = -INF;
+    ArgMax Gmaxn = {-INF, -1};
     double Gmaxn2 = -INF;
-    int Gmaxn_idx = -1;
 
-    int Gmin_idx = -1;
-    double obj_diff_min = INF;
+    // minimal obj_diff, kept negated
+    ArgMax obj_diff_min = {-INF, -1};
+    int n = active_size;
 
-    for (int t = 0; t < active_size; t++)
-        if (y[t] == +1) {
-            if (!is_upper_bound(t))
-                if (-G[t] >= Gmaxp) {
-                    Gmaxp = -G[t];
-                    Gmaxp_idx = t;
-                }
-        } else {
-            if (!is_lower_bound(t))
-                if (G[t] >= Gmaxn) {
-                    Gmaxn = G[t];
-                    Gmaxn_idx = t;
-                }
-        }
+#if defined _OPENMP_MY
+#pragma omp parallel if(n >= SOLVER_OMP_MIN_SIZE)
+#endif
+    {
+        ArgMax localp = {-INF, -1};
+        ArgMax localn = {-INF, -1};
+        int t;
+#if defined _OPENMP_MY
+#pragma omp for schedule(static) nowait
+#endif
+        for (t = 0; t < n; t++)
+            if (y[t] == +1) {
+                if (!is_upper_bound(t))
+                    update_max(localp, -G[t], t);
+            } else {
+                if (!is_lower_bound(t))
+                    update_max(localn, G[t], t);
+            }
+        reduce_max(Gmaxp, localp);
+        reduce_max(Gmaxn, localn);
+    }
 
-    int ip = Gmaxp_idx;
-    int in = Gmaxn_idx;
+    int ip = Gmaxp.index;
+    int in = Gmaxn.index;
     const Qfloat *Q_ip = NULL;
     const Qfloat *Q_in = NULL;
-    if (ip != -1) // NULL Q_ip not accessed: Gmaxp=-INF if ip=-1
+    if (ip != -1) { // NULL Q_ip not accessed: Gmaxp=-INF if ip=-1
+        prefetch_violators(ip);
         Q_ip = Q->get_Q(ip, active_size);
-    if (in != -1)
+    }
+    if (in != -1) {
+        prefetch_violators(in);
         Q_in = Q->get_Q(in, active_size);
+    }
     
-    //TODO make changes and parallelize with OMP
-    for (int j = 0; j < active_size; j++) {
-        if (y[j] == +1) {
-            if (!is_lower_bound(j)) {
-                double grad_diff = Gmaxp + G[j];
-                if (G[j] >= Gmaxp2)
-                    Gmaxp2 = G[j];
-                if (grad_diff > 0) {
-                    double obj_diff;
-                    double quad_coef = QD[ip] + QD[j] - 2 * Q_ip[j];
-                    if (quad_coef > 0)
-                        obj_diff = -(grad_diff * grad_diff) / quad_coef;
-                    else
-                        obj_diff = -(grad_diff * grad_diff) / TAU;
-
-                    if (obj_diff <= obj_diff_min) {
-                        Gmin_idx = j;
-                        obj_diff_min = obj_diff;
+#if defined _OPENMP_MY
+#pragma omp parallel reduction(max:Gmaxp2,Gmaxn2) if(n >= SOLVER_OMP_MIN_SIZE)
+#endif
+    {
+        ArgMax local = {-INF, -1};
+        int j;
+#if defined _OPENMP_MY
+#pragma omp for schedule(static) nowait
+#endif
+        for (j = 0; j < n; j++) {
+            if (y[j] == +1) {
+                if (!is_lower_bound(j)) {
+                    double grad_diff = Gmaxp.value + G[j];
+                    if (G[j] >= Gmaxp2)
+                        Gmaxp2 = G[j];
+                    if (grad_diff > 0) {
+                        double obj_diff;
+                        double quad_coef = QD[ip] + QD[j] - 2 * Q_ip[j];
+                        if (quad_coef > 0)
+                            obj_diff = -(grad_diff * grad_diff) / quad_coef;
+                        else
+                            obj_diff = -(grad_diff * grad_diff) / TAU;
+                        update_max(local, -obj_diff, j);
                     }
                 }
-            }
-        } else {
-            if (!is_upper_bound(j)) {
-                double grad_diff = Gmaxn - G[j];
-                if (-G[j] >= Gmaxn2)
-                    Gmaxn2 = -G[j];
-                if (grad_diff > 0) {
-                    double obj_diff;
-                    double quad_coef = QD[in] + QD[j] - 2 * Q_in[j];
-                    if (quad_coef > 0)
-                        obj_diff = -(grad_diff * grad_diff) / quad_coef;
-                    else
-                        obj_diff = -(grad_diff * grad_diff) / TAU;
-
-                    if (obj_diff <= obj_diff_min) {
-                        Gmin_idx = j;
-                        obj_diff_min = obj_diff;
+            } else {
+                if (!is_upper_bound(j)) {
+                    double grad_diff = Gmaxn.value - G[j];
+                    if (-G[j] >= Gmaxn2)
+                        Gmaxn2 = -G[j];
+                    if (grad_diff > 0) {
+                        double obj_diff;
+                        double quad_coef = QD[in] + QD[j] - 2 * Q_in[j];
+                        if (quad_coef > 0)
+                            obj_diff = -(grad_diff * grad_diff) / quad_coef;
+                        else
+                            obj_diff = -(grad_diff * grad_diff) / TAU;
+                        update_max(local, -obj_diff, j);
                     }
                 }
             }
         }
+        reduce_max(obj_diff_min, local);
     }
 
-    if (max(Gmaxp + Gmaxp2, Gmaxn + Gmaxn2) < eps)
+    if (max(Gmaxp.value + Gmaxp2, Gmaxn.value + Gmaxn2) < eps)
         return 1;
 
+    int Gmin_idx = obj_diff_min.index;
     if (y[Gmin_idx] == +1)
-        out_i = Gmaxp_idx;
+        out_i = Gmaxp.index;
     else
-        out_i = Gmaxn_idx;
+        out_i = Gmaxn.index;
     out_j = Gmin_idx;
 
     return 0;
@@ -1115,6 +1907,9 @@ void Solver_NU::do_shrinking() {
 
     // find maximal violating pair first
     int i;
+#if defined _OPENMP_MY
+#pragma omp parallel for reduction(max:Gmax1,Gmax2,Gmax3,Gmax4) if(active_size >= SOLVER_OMP_MIN_SIZE)
+#endif
     for (i = 0; i < active_size; i++) {
         if (!is_upper_bound(i)) {
             if (y[i] == +1) {
@@ -1200,7 +1995,7 @@ public:
     SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_)
     : Kernel(prob.l, prob.x, param) {
         clone(y, y_, prob.l);
-        cache = new Cache(prob.l, (long int) (param.cache_size * (1 << 20)));
+        cache = new Cache(prob.l, (long int) (param.cache_size * (1 << 20)), cache_storage(prob, param));
         QD = new double[prob.l];
         int i;
 #if defined _OPENMP_MY
@@ -1215,16 +2010,21 @@ public:
         int start;
         if ((start = cache->get_data(i, &data, len)) < len) {
 #ifndef _OPENCL         
-            int j;
+            if (dense != NULL || matrix_row != NULL)
+                kernel_row(i, start, len, y, data);
+            else {
+                int j;
 #pragma omp parallel for private(j)            
-            for (j = start; j < len; j++)
-                data[j] = (Qfloat) (y[i] * y[j]*(this->*kernel_function)(i, j));        
+                for (j = start; j < len; j++)
+                    data[j] = (Qfloat) (y[i] * y[j]*(this->*kernel_function)(i, j));        
+            }
 #else         
-            OpenCLToolsTrain* oclt = OpenCLToolsTrain::getInstancePtr();            
-            oclt->get_Q(data, len, start, len, i, kernel_type, (char*)y, kL, x, 
-                        SVC_Q_TYPE, gamma, coef0, degree, x_square);
-            oclt->cleanWorkPart();
+            if (matrix_row != NULL)
+                kernel_row(i, start, len, y, data);
+            else
+                device_rows(cache, i, data, start, len, y, SVC_Q_TYPE);
 #endif  
+            cache->put_data(i, data, start, len);
         }
         return data;
     }
@@ -1233,7 +2033,27 @@ public:
         return QD;
     }
 
+#ifdef _OPENCL
+    int prefetch_size() const {
+        // rows read from matrix aren't computed on device
+        return matrix_row != NULL ? 0 : OpenCLToolsTrain::getInstancePtr()->getPrefetchRows();
+    }
+
+    bool is_cached(int column, int len) const {
+        return cache->has_data(column, len);
+    }
+
+    void prefetch(const int *columns, int n, int len) {
+        set_hints(cache, columns, n, len);
+    }
+#endif
+
     void swap_index(int i, int j) const {
+#ifdef _OPENCL
+        // prefetched rows and hints use indices before swap
+        store_pending(cache, -1);
+        hint_count = 0;
+#endif
         cache->swap_index(i, j);
         Kernel::swap_index(i, j);
         swap(y[i], y[j]);
@@ -1256,7 +2076,7 @@ public:
 
     ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
     : Kernel(prob.l, prob.x, param) {
-        cache = new Cache(prob.l, (long int) (param.cache_size * (1 << 20)));
+        cache = new Cache(prob.l, (long int) (param.cache_size * (1 << 20)), cache_storage(prob, param));
         QD = new double[prob.l];
         int i;
 #if defined _OPENMP_MY
@@ -1270,12 +2090,17 @@ public:
         Qfloat *data;
         int start, j;
         if ((start = cache->get_data(i, &data, len)) < len) {
+            if (dense != NULL || matrix_row != NULL)
+                kernel_row(i, start, len, NULL, data);
+            else {
 #ifdef _OPENMP_MY             
 #pragma omp parallel for private(j)
 #endif
-            for (j = start; j < len; j++){
-                data[j] = (Qfloat) (this->*kernel_function)(i, j);
+                for (j = start; j < len; j++){
+                    data[j] = (Qfloat) (this->*kernel_function)(i, j);
+                }
             }
+            cache->put_data(i, data, start, len);
         }
         return data;
     }
@@ -1305,7 +2130,7 @@ public:
     SVR_Q(const svm_problem& prob, const svm_parameter& param)
     : Kernel(prob.l, prob.x, param) {
         l = prob.l;
-        cache = new Cache(l, (long int) (param.cache_size * (1 << 20)));
+        cache = new Cache(l, (long int) (param.cache_size * (1 << 20)), cache_storage(prob, param));
         QD = new double[2 * l];
         sign = new schar[2 * l];
         index = new int[2 * l];        
@@ -1337,15 +2162,20 @@ public:
         int j, real_i = index[i];
         if (cache->get_data(real_i, &data, l) < l) {
 #ifndef _OPENCL
+            if (dense != NULL || matrix_row != NULL)
+                kernel_row(real_i, 0, l, NULL, data);
+            else {
 #pragma omp parallel for private(j)
-            for (j = 0; j < l; j++)
-                data[j] = (Qfloat) (this->*kernel_function)(real_i, j);        
+                for (j = 0; j < l; j++)
+                    data[j] = (Qfloat) (this->*kernel_function)(real_i, j);        
+            }
 #else            
-            OpenCLToolsTrain* oclt = OpenCLToolsTrain::getInstancePtr();
-            oclt->get_Q(data, l, 0, l, real_i, kernel_type, 0, 0, x, 
-                        SVR_Q_TYPE, gamma, coef0, degree, x_square);            
-            oclt->cleanWorkPart();
+            if (matrix_row != NULL)
+                kernel_row(real_i, 0, l, NULL, data);
+            else
+                device_rows(cache, real_i, data, 0, l, NULL, SVR_Q_TYPE);
 #endif
+            cache->put_data(real_i, data, 0, l);
         }
         // reorder and copy
         Qfloat *buf = buffer[next_buffer];
@@ -1360,6 +2190,31 @@ public:
         return QD;
     }
 
+#ifdef _OPENCL
+    int prefetch_size() const {
+        // rows read from matrix aren't computed on device
+        return matrix_row != NULL ? 0 : OpenCLToolsTrain::getInstancePtr()->getPrefetchRows();
+    }
+
+    bool is_cached(int column, int len) const {
+        return cache->has_data(index[column], l);
+    }
+
+    // cache keeps whole rows of real instances, both signs of instance share row
+    void prefetch(const int *columns, int n, int len) {
+        int *real = new int[n];
+        int m = 0;
+        for (int k = 0; k < n; k++) {
+            int r = index[columns[k]], h;
+            for (h = 0; h < m && real[h] != r; h++);
+            if (h == m)
+                real[m++] = r;
+        }
+        set_hints(cache, real, m, l);
+        delete[] real;
+    }
+#endif
+
     ~SVR_Q() {
         delete cache;
         delete[] sign;
@@ -1382,6 +2237,35 @@ private:
 // construct and solve various formulations
 //
 
+// feasible start from alpha of earlier training: values are clipped to [0, C_i] and
+// the larger class sum is scaled down, so sum of y[i] * alpha[i] is 0
+static void warm_start_alpha(int l, const schar *y, const double *init_alpha, const double *W,
+        double Cp, double Cn, double *alpha) {
+    double sum_p = 0, sum_n = 0;
+    int i, nonzero = 0;
+    for (i = 0; i < l; i++) {
+        double C_i = (y[i] > 0 ? Cp : Cn) * (W != NULL ? W[i] : 1);
+        alpha[i] = max(0.0, min(init_alpha[i], C_i));
+        if (y[i] > 0)
+            sum_p += alpha[i];
+        else
+            sum_n += alpha[i];
+    }
+    if (sum_p == 0 || sum_n == 0) {
+        for (i = 0; i < l; i++)
+            alpha[i] = 0;
+        return;
+    }
+    double scale_p = sum_p > sum_n ? sum_n / sum_p : 1;
+    double scale_n = sum_n > sum_p ? sum_p / sum_n : 1;
+    for (i = 0; i < l; i++) {
+        alpha[i] *= y[i] > 0 ? scale_p : scale_n;
+        if (alpha[i] > 0)
+            ++nonzero;
+    }
+    info("warm start from %d nonzero alpha\n", nonzero);
+}
+
 static void solve_c_svc(
         const svm_problem *prob, const svm_parameter* param,
         double *alpha, Solver::SolutionInfo* si, double Cp, double Cn) {
@@ -1397,11 +2281,14 @@ static void solve_c_svc(
         if (prob->y[i] > 0) y[i] = +1;
         else y[i] = -1;
     }
+    // solver computes gradient of initial alpha
+    if (param->init_alpha != NULL)
+        warm_start_alpha(l, y, param->init_alpha, prob->W, Cp, Cn, alpha);
 
     Solver s;
     SVC_Q svc(*prob, *param, y);
     s.Solve(l, svc, minus_ones, y,
-            alpha, Cp, Cn, param->eps, si, param->shrinking);
+            alpha, Cp, Cn, param->eps, si, param->shrinking, prob->W);
 
     double sum_alpha = 0;
     for (i = 0; i < l; i++)
@@ -1507,8 +2394,15 @@ static void solve_epsilon_svr(
     double *alpha2 = new double[2 * l];
     double *linear_term = new double[2 * l];
     schar *y = new schar[2 * l];
+    double *W2 = NULL;
     int i;
 
+    if (prob->W != NULL) {
+        W2 = new double[2 * l];
+        for (i = 0; i < l; i++)
+            W2[i] = W2[i + l] = prob->W[i];
+    }
+
     for (i = 0; i < l; i++) {
         alpha2[i] = 0;
         linear_term[i] = param->p - prob->y[i];
@@ -1522,7 +2416,7 @@ static void solve_epsilon_svr(
     Solver s;
     SVR_Q svr(*prob, *param);
     s.Solve(2 * l, svr, linear_term, y,
-            alpha2, param->C, param->C, param->eps, si, param->shrinking);
+            alpha2, param->C, param->C, param->eps, si, param->shrinking, W2);
 
     double sum_alpha = 0;
     for (i = 0; i < l; i++) {
@@ -1534,6 +2428,7 @@ static void solve_epsilon_svr(
     delete[] alpha2;
     delete[] linear_term;
     delete[] y;
+    delete[] W2;
 }
 
 static void solve_nu_svr(
@@ -1614,11 +2509,12 @@ static decision_function svm_train_one(
     for (int i = 0; i < prob->l; i++) {
         if (fabs(alpha[i]) > 0) {
             ++nSV;
+            double weight = prob->W != NULL ? prob->W[i] : 1;
             if (prob->y[i] > 0) {
-                if (fabs(alpha[i]) >= si.upper_bound_p)
+                if (fabs(alpha[i]) >= si.upper_bound_p * weight)
                     ++nBSV;
             } else {
-                if (fabs(alpha[i]) >= si.upper_bound_n)
+                if (fabs(alpha[i]) >= si.upper_bound_n * weight)
                     ++nBSV;
             }
         }
@@ -1830,16 +2726,21 @@ static void svm_binary_svc_probability(
         subprob.l = prob->l - (end - begin);
         subprob.x = Malloc(struct svm_node*, subprob.l);
         subprob.y = Malloc(double, subprob.l);
+        subprob.W = prob->W != NULL ? Malloc(double, subprob.l) : NULL;
 
         k = 0;
         for (j = 0; j < begin; j++) {
             subprob.x[k] = prob->x[perm[j]];
             subprob.y[k] = prob->y[perm[j]];
+            if (subprob.W != NULL)
+                subprob.W[k] = prob->W[perm[j]];
             ++k;
         }
         for (j = end; j < prob->l; j++) {
             subprob.x[k] = prob->x[perm[j]];
             subprob.y[k] = prob->y[perm[j]];
+            if (subprob.W != NULL)
+                subprob.W[k] = prob->W[perm[j]];
             ++k;
         }
         int p_count = 0, n_count = 0;
@@ -1861,6 +2762,7 @@ static void svm_binary_svc_probability(
         else {
             svm_parameter subparam = *param;
             subparam.probability = 0;
+            subparam.init_alpha = NULL;
             subparam.C = 1.0;
             subparam.nr_weight = 2;
             subparam.weight_label = Malloc(int, 2);
@@ -1880,6 +2782,7 @@ static void svm_binary_svc_probability(
         }
         free(subprob.x);
         free(subprob.y);
+        free(subprob.W);
     }
     sigmoid_train(prob->l, dec_values, prob->y, probA, probB);
     free(dec_values);
@@ -1897,6 +2800,7 @@ static double svm_svr_probability(
 
     svm_parameter newparam = *param;
     newparam.probability = 0;
+    newparam.init_alpha = NULL;
     svm_cross_validation(prob, &newparam, nr_fold, ymv);
     for (i = 0; i < prob->l; i++) {
         ymv[i] = prob->y[i] - ymv[i];
@@ -1994,6 +2898,9 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 svm_model *svm_train(const svm_problem *prob, const svm_parameter *param) {
     svm_model *model = Malloc(svm_model, 1);
     model->param = *param;
+    // matrix belongs to caller and is valid only during training
+    model->param.kernel_matrix = NULL;
+    model->param.init_alpha = NULL;
     model->free_sv = 0; // XXX
 
     if (param->svm_type == ONE_CLASS ||
@@ -2051,9 +2958,24 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param) {
             info("WARNING: training data in only one class. See README for details.\n");
 
         svm_node **x = Malloc(svm_node *, l);
+        double *W = prob->W != NULL ? Malloc(double, l) : NULL;
         int i;
-        for (i = 0; i < l; i++)
+        for (i = 0; i < l; i++) {
             x[i] = prob->x[perm[i]];
+            if (W != NULL)
+                W[i] = prob->W[perm[i]];
+        }
+
+        // two classes are one subproblem in grouped order, more classes start from 0
+        svm_parameter pair_param = *param;
+        pair_param.init_alpha = NULL;
+        double *init_alpha = NULL;
+        if (param->init_alpha != NULL && param->svm_type == C_SVC && nr_class == 2) {
+            init_alpha = Malloc(double, l);
+            for (i = 0; i < l; i++)
+                init_alpha[i] = param->init_alpha[perm[i]];
+            pair_param.init_alpha = init_alpha;
+        }
 
         // calculate weighted C
 
@@ -2093,20 +3015,25 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param) {
                 sub_prob.l = ci + cj;
                 sub_prob.x = Malloc(svm_node *, sub_prob.l);
                 sub_prob.y = Malloc(double, sub_prob.l);
+                sub_prob.W = W != NULL ? Malloc(double, sub_prob.l) : NULL;
                 int k;
                 for (k = 0; k < ci; k++) {
                     sub_prob.x[k] = x[si + k];
                     sub_prob.y[k] = +1;
+                    if (W != NULL)
+                        sub_prob.W[k] = W[si + k];
                 }
                 for (k = 0; k < cj; k++) {
                     sub_prob.x[ci + k] = x[sj + k];
                     sub_prob.y[ci + k] = -1;
+                    if (W != NULL)
+                        sub_prob.W[ci + k] = W[sj + k];
                 }
 
                 if (param->probability)
                     svm_binary_svc_probability(&sub_prob, param, weighted_C[i], weighted_C[j], probA[p], probB[p]);
 
-                f[p] = svm_train_one(&sub_prob, param, weighted_C[i], weighted_C[j]);
+                f[p] = svm_train_one(&sub_prob, &pair_param, weighted_C[i], weighted_C[j]);
                 for (k = 0; k < ci; k++)
                     if (!nonzero[si + k] && fabs(f[p].alpha[k]) > 0)
                         nonzero[si + k] = true;
@@ -2115,6 +3042,7 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param) {
                         nonzero[sj + k] = true;
                 free(sub_prob.x);
                 free(sub_prob.y);
+                free(sub_prob.W);
                 ++p;
             }
 
@@ -2208,8 +3136,10 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param) {
         free(perm);
         free(start);
         free(x);
+        free(W);
         free(weighted_C);
         free(nonzero);
+        free(init_alpha);
         for (i = 0; i < nr_class * (nr_class - 1) / 2; i++)
             free(f[i].alpha);
         free(f);
@@ -2296,19 +3226,27 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
         subprob.l = l - (end - begin);
         subprob.x = Malloc(struct svm_node*, subprob.l);
         subprob.y = Malloc(double, subprob.l);
+        subprob.W = prob->W != NULL ? Malloc(double, subprob.l) : NULL;
 
         k = 0;
         for (j = 0; j < begin; j++) {
             subprob.x[k] = prob->x[perm[j]];
             subprob.y[k] = prob->y[perm[j]];
+            if (subprob.W != NULL)
+                subprob.W[k] = prob->W[perm[j]];
             ++k;
         }
         for (j = end; j < l; j++) {
             subprob.x[k] = prob->x[perm[j]];
             subprob.y[k] = prob->y[perm[j]];
+            if (subprob.W != NULL)
+                subprob.W[k] = prob->W[perm[j]];
             ++k;
         }
-        struct svm_model *submodel = svm_train(&subprob, param);
+        // init_alpha is for instances of whole problem
+        svm_parameter subparam = *param;
+        subparam.init_alpha = NULL;
+        struct svm_model *submodel = svm_train(&subprob, &subparam);
         if (param->probability &&
                 (param->svm_type == C_SVC || param->svm_type == NU_SVC)) {
             double *prob_estimates = Malloc(double, svm_get_nr_class(submodel));
@@ -2321,6 +3259,7 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
         svm_free_and_destroy_model(&submodel);
         free(subprob.x);
         free(subprob.y);
+        free(subprob.W);
     }
     free(fold_start);
     free(perm);
@@ -2715,6 +3654,8 @@ svm_model *svm_load_model(const char *model_file_name) {
     // read parameters
 
     svm_model *model = Malloc(svm_model, 1);
+    model->param.kernel_matrix = NULL;
+    model->param.init_alpha = NULL;
     model->rho = NULL;
     model->probA = NULL;
     model->probB = NULL;
@@ -2881,6 +3822,11 @@ const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *pa
     if (param->cache_size <= 0)
         return "cache_size <= 0";
 
+    if (param->cache_storage != CACHE_FLOAT &&
+            param->cache_storage != CACHE_FP16 &&
+            param->cache_storage != CACHE_BF16)
+        return "unknown cache storage";
+
     if (param->eps <= 0)
         return "eps <= 0";
 
@@ -2912,6 +3858,15 @@ const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *pa
             svm_type == ONE_CLASS)
         return "one-class SVM probability output not supported yet";
 
+    if (prob->W != NULL) {
+        if (svm_type != C_SVC &&
+                svm_type != EPSILON_SVR)
+            return "instance weights are supported only for C-SVC and epsilon-SVR";
+        for (int i = 0; i < prob->l; i++)
+            if (prob->W[i] <= 0)
+                return "instance weight <= 0";
+    }
+
 
     // check whether nu-svc is feasible
 
@@ -2968,6 +3923,71 @@ int svm_check_probability_model(const svm_model *model) {
             model->probA != NULL);
 }
 
+void svm_get_cache_stats(svm_cache_stats *stats) {
+    pthread_mutex_lock(&cache_stats_mutex);
+    *stats = cache_stats_total;
+    pthread_mutex_unlock(&cache_stats_mutex);
+}
+
+// Kernel of whole problem computes rows, get_Q isn't used
+class Matrix_Q : public Kernel {
+public:
+
+    Matrix_Q(const svm_problem& prob, const svm_parameter& param)
+    : Kernel(prob.l, prob.x, param) {
+    }
+
+    Qfloat *get_Q(int column, int len) {
+        return NULL;
+    }
+
+    double *get_QD() const {
+        return NULL;
+    }
+
+    void row(int i, Qfloat *out) const {
+        if (dense != NULL)
+            kernel_row(i, 0, kL, NULL, out);
+        else {
+            int j;
+#pragma omp parallel for private(j)
+            for (j = 0; j < kL; j++)
+                out[j] = (Qfloat) (this->*kernel_function)(i, j);
+        }
+    }
+};
+
+int svm_kernel_matrix_blocks(const svm_problem *prob, const svm_parameter *param,
+        int block_rows, int (*write)(const unsigned short *block, int rows, void *user), void *user) {
+    // rows are computed, not read from other matrix
+    svm_parameter kernel_param = *param;
+    kernel_param.kernel_matrix = NULL;
+    // one kernel for all blocks, its setup (dense copy, x_square) is done once
+    Matrix_Q kernel(*prob, kernel_param);
+    int l = prob->l;
+    Qfloat *row = new Qfloat[l];
+    unsigned short *block = new unsigned short[(size_t) block_rows * l];
+    int result = 0;
+    for (int begin = 0; begin < l && result == 0; begin += block_rows) {
+        int end = min(begin + block_rows, l);
+        for (int i = begin; i < end; i++) {
+            kernel.row(i, row);
+            unsigned short *target = block + (size_t) (i - begin) * l;
+            for (int j = 0; j < l; j++) {
+                // fp16 overflows above 65504
+                if (fabs(row[j]) > 65504.0f)
+                    result = -1;
+                target[j] = float_to_fp16(row[j]);
+            }
+        }
+        if (result == 0 && write(block, end - begin, user) != 0)
+            result = -2;
+    }
+    delete[] row;
+    delete[] block;
+    return result;
+}
+
 void svm_set_print_string_function(void (*print_func)(const char *)) {
     if (print_func == NULL)
         svm_print_string = &print_string_stdout;
@@ -20,11 +20,25 @@ struct svm_problem
 	int l;
 	double *y;
 	struct svm_node **x;
+	double *W; /* instance weights, multiply C of instance, NULL for all 1 */
 };
 
 enum { C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR };	/* svm_type */
 enum { LINEAR, POLY, RBF, SIGMOID, PRECOMPUTED }; /* kernel_type */
 
+enum { CACHE_FLOAT, CACHE_FP16, CACHE_BF16 };	/* cache_storage */
+
+/* precomputed kernel matrix of a problem, K of rows r and s is fp16 data[r * l + s].
+   Instances are matched to rows by address of their svm_node array, row of x_sorted[k]
+   is rows[k] and x_sorted is in ascending address order */
+struct svm_kernel_matrix
+{
+	int l;
+	const unsigned short *data;
+	const struct svm_node * const *x_sorted;
+	const int *rows;
+};
+
 struct svm_parameter
 {
 	int svm_type;
@@ -35,6 +49,7 @@ struct svm_parameter
 
 	/* these are for training only */
 	double cache_size; /* in MB */
+	int cache_storage; /* CACHE_FLOAT, CACHE_FP16 or CACHE_BF16 */
 	double eps;	/* stopping criteria */
 	double C;	/* for C_SVC, EPSILON_SVR and NU_SVR */
 	int nr_weight;		/* for C_SVC */
@@ -44,6 +59,8 @@ struct svm_parameter
 	double p;	/* for EPSILON_SVR */
 	int shrinking;	/* use the shrinking heuristics */
 	int probability; /* do probability estimates */
+	const struct svm_kernel_matrix *kernel_matrix; /* NULL, or kernel rows are read from it */
+	const double *init_alpha; /* NULL, or alpha (>= 0) of every instance to start two class C_SVC from */
 };
 
 //
@@ -97,6 +114,22 @@ int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
 
+struct svm_cache_stats
+{
+	long hits;	/* requested part of Q row was cached */
+	long misses;	/* Q row or its part was computed */
+	long evictions;	/* rows dropped to free space */
+};
+
+/* totals of kernel caches of all finished trainings */
+void svm_get_cache_stats(struct svm_cache_stats *stats);
+
+/* kernel matrix of prob as fp16, computed in blocks of block_rows rows. Every block
+   (rows * prob->l values, row major) is passed to write, which returns 0 on success.
+   returns 0, -1 if some value is out of fp16 range or -2 if write failed */
+int svm_kernel_matrix_blocks(const struct svm_problem *prob, const struct svm_parameter *param,
+		int block_rows, int (*write)(const unsigned short *block, int rows, void *user), void *user);
+
 #ifdef __cplusplus
 }
 #endif